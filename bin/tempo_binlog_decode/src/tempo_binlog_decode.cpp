@@ -0,0 +1,84 @@
+
+#include <tempo_command/command.h>
+#include <tempo_command/command_help.h>
+#include <tempo_config/base_conversions.h>
+#include <tempo_utils/binary_log.h>
+#include <tempo_utils/file_reader.h>
+#include <tempo_utils/log_sink.h>
+
+/**
+ * Decode the binary log file specified on the command line, writing each log entry as text.
+ *
+ * @param argc
+ * @param argv
+ * @return
+ */
+tempo_utils::Status
+run(int argc, const char *argv[])
+{
+    tempo_config::PathParser binaryLogFileParser;
+    tempo_config::PathParser outputFileParser(std::filesystem::path{});
+    tempo_config::BooleanParser displayShortFormParser(false);
+
+    tempo_command::Command command("tempo-binlog-decode");
+
+    command.addOption("outputFile", {"-o", "--output-file"},
+        tempo_command::MappingType::ZERO_OR_ONE_INSTANCE,
+        "Write the decoded log to the specified file instead of stdout", "FILE");
+    command.addFlag("displayShortForm", {"--short-form"}, tempo_command::MappingType::TRUE_IF_INSTANCE,
+        "Display only the message of each log entry");
+    command.addArgument("binaryLogFile", "FILE", tempo_command::MappingType::ONE_INSTANCE,
+        "Path to the binary log file");
+    command.addHelpOption("help", {"-h", "--help"},
+        "Decode a binary log file to text");
+
+    TU_RETURN_IF_NOT_OK (command.parse(argc - 1, &argv[1]));
+
+    std::filesystem::path binaryLogFile;
+    TU_RETURN_IF_NOT_OK (command.convert(binaryLogFile, binaryLogFileParser, "binaryLogFile"));
+
+    std::filesystem::path outputFile;
+    TU_RETURN_IF_NOT_OK (command.convert(outputFile, outputFileParser, "outputFile"));
+
+    bool displayShortForm;
+    TU_RETURN_IF_NOT_OK (command.convert(displayShortForm, displayShortFormParser, "displayShortForm"));
+
+    // decoded entries are rendered by the same sinks which render text logs
+    std::unique_ptr<tempo_utils::AbstractLogSink> sink;
+    if (outputFile.empty()) {
+        sink = std::make_unique<tempo_utils::DefaultLogSink>(displayShortForm, true);
+    } else {
+        sink = std::make_unique<tempo_utils::LogFileSink>(outputFile, displayShortForm);
+    }
+    TU_RETURN_IF_NOT_OK (sink->openSink());
+
+    tempo_utils::FileReader reader(binaryLogFile);
+    TU_RETURN_IF_NOT_OK (reader.getStatus());
+
+    tempo_utils::BinaryLogReader binaryLogReader(reader.getStringView());
+    TU_RETURN_IF_NOT_OK (binaryLogReader.readHeader());
+
+    tempo_utils::BinaryLogEntry entry;
+    for (;;) {
+        bool hasEntry;
+        TU_ASSIGN_OR_RETURN (hasEntry, binaryLogReader.readEntry(entry));
+        if (!hasEntry)
+            break;
+        sink->writeLog(entry.ts, entry.severity, entry.filePath.c_str(), entry.lineNr, entry.message);
+    }
+    sink->closeSink();
+
+    return {};
+}
+
+int
+main(int argc, const char *argv[])
+{
+    if (argc == 0 || argv == nullptr)
+        return -1;
+
+    auto status = run(argc, argv);
+    if (!status.isOk())
+        tempo_command::display_status_and_exit(status);
+    return 0;
+}
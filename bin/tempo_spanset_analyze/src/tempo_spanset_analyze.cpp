@@ -0,0 +1,116 @@
+#include <iostream>
+
+#include <fmt/format.h>
+
+#include <tempo_command/command.h>
+#include <tempo_command/command_help.h>
+#include <tempo_config/base_conversions.h>
+#include <tempo_config/container_conversions.h>
+#include <tempo_tracing/spanset_analysis.h>
+#include <tempo_tracing/spanset_stream.h>
+#include <tempo_tracing/tracing_result.h>
+#include <tempo_utils/file_reader.h>
+#include <tempo_utils/file_writer.h>
+
+/**
+ * Load the spanset file. The file either contains a single spanset, or a sequence of spanset
+ * fragments written by a streaming trace recorder, which are concatenated into one spanset.
+ */
+static tempo_utils::Result<tempo_tracing::TempoSpanset>
+load_spanset_file(const std::filesystem::path &spansetFile)
+{
+    tempo_utils::FileReader reader(spansetFile);
+    TU_RETURN_IF_NOT_OK (reader.getStatus());
+    auto bytes = reader.getBytes();
+    if (tempo_tracing::TempoSpanset::verify(bytes->getSpan()))
+        return tempo_tracing::TempoSpanset(bytes);
+    tempo_tracing::TempoSpanset spanset;
+    TU_ASSIGN_OR_RETURN (spanset, tempo_tracing::concatenate_spanset_fragments(bytes->getSpan()));
+    if (!spanset.isValid())
+        return tempo_tracing::TracingStatus::forCondition(tempo_tracing::TracingCondition::kTracingInvariant,
+            "{} is not a spanset file", spansetFile.string());
+    return spanset;
+}
+
+static std::string
+format_operations(const tempo_tracing::SpansetProfile &profile)
+{
+    std::string output = fmt::format("{:<40} {:>10} {:>14} {:>14} {:>14}\n",
+        "OPERATION", "COUNT", "TOTAL (ms)", "SELF (ms)", "CRITICAL (ms)");
+    for (const auto &[operationName, operation] : profile.listOperations()) {
+        output.append(fmt::format("{:<40} {:>10} {:>14.3f} {:>14.3f} {:>14.3f}\n",
+            operationName, operation.count,
+            absl::ToDoubleMilliseconds(operation.totalTime),
+            absl::ToDoubleMilliseconds(operation.selfTime),
+            absl::ToDoubleMilliseconds(operation.criticalTime)));
+    }
+    return output;
+}
+
+/**
+ * Analyze the spanset files specified on the command line, writing the self time and critical
+ * path time of each operation, or the folded stacks for a flame graph.
+ *
+ * @param argc
+ * @param argv
+ * @return
+ */
+tempo_utils::Status
+run(int argc, const char *argv[])
+{
+    tempo_config::PathParser spansetFileParser;
+    tempo_config::SeqTParser<std::filesystem::path> spansetFilesParser(&spansetFileParser);
+    tempo_config::PathParser outputFileParser(std::filesystem::path{});
+    tempo_config::BooleanParser foldedStacksParser(false);
+
+    tempo_command::Command command("tempo-spanset-analyze");
+
+    command.addOption("outputFile", {"-o", "--output-file"},
+        tempo_command::MappingType::ZERO_OR_ONE_INSTANCE,
+        "Write the analysis to the specified file instead of stdout", "FILE");
+    command.addFlag("foldedStacks", {"--folded-stacks"}, tempo_command::MappingType::TRUE_IF_INSTANCE,
+        "Write the self time of each stack of operations in folded stack format");
+    command.addArgument("spansetFiles", "FILE", tempo_command::MappingType::ONE_OR_MORE_INSTANCES,
+        "Path to a spanset file");
+    command.addHelpOption("help", {"-h", "--help"},
+        "Analyze where the latency in spanset files is spent");
+
+    TU_RETURN_IF_NOT_OK (command.parse(argc - 1, &argv[1]));
+
+    std::vector<std::filesystem::path> spansetFiles;
+    TU_RETURN_IF_NOT_OK (command.convert(spansetFiles, spansetFilesParser, "spansetFiles"));
+
+    std::filesystem::path outputFile;
+    TU_RETURN_IF_NOT_OK (command.convert(outputFile, outputFileParser, "outputFile"));
+
+    bool foldedStacks;
+    TU_RETURN_IF_NOT_OK (command.convert(foldedStacks, foldedStacksParser, "foldedStacks"));
+
+    tempo_tracing::SpansetProfile profile;
+    for (const auto &spansetFile : spansetFiles) {
+        tempo_tracing::TempoSpanset spanset;
+        TU_ASSIGN_OR_RETURN (spanset, load_spanset_file(spansetFile));
+        TU_RETURN_IF_NOT_OK (profile.addSpanset(spanset));
+    }
+
+    auto output = foldedStacks? profile.toFoldedStacks() : format_operations(profile);
+
+    if (outputFile.empty()) {
+        std::cout << output;
+        return {};
+    }
+    tempo_utils::FileWriter writer(outputFile, output, tempo_utils::FileWriterMode::CREATE_OR_OVERWRITE);
+    return writer.getStatus();
+}
+
+int
+main(int argc, const char *argv[])
+{
+    if (argc == 0 || argv == nullptr)
+        return -1;
+
+    auto status = run(argc, argv);
+    if (!status.isOk())
+        tempo_command::display_status_and_exit(status);
+    return 0;
+}
@@ -22,6 +22,17 @@ namespace tempo_command {
             }, defaultSeverityFilter) {}
         SeverityFilterParser() : SeverityFilterParser(tempo_utils::SeverityFilter::kDefault) {}
     };
+
+    class LogQueuePolicyParser : public tempo_config::EnumTParser<tempo_utils::LogQueuePolicy> {
+    public:
+        explicit LogQueuePolicyParser(tempo_utils::LogQueuePolicy defaultLogQueuePolicy)
+            : EnumTParser({
+            {"Block", tempo_utils::LogQueuePolicy::kBlock},
+            {"DropOldest", tempo_utils::LogQueuePolicy::kDropOldest},
+            {"DropNewest", tempo_utils::LogQueuePolicy::kDropNewest},
+            }, defaultLogQueuePolicy) {}
+        LogQueuePolicyParser() : LogQueuePolicyParser(tempo_utils::LogQueuePolicy::kBlock) {}
+    };
 }
 
 #endif // TEMPO_COMMAND_COMMAND_CONVERSIONS_H
\ No newline at end of file
@@ -6,7 +6,9 @@
 #include <tempo_config/config_types.h>
 #include <tempo_config/config_utils.h>
 #include <tempo_config/merge_map.h>
+#include <tempo_config/number_conversions.h>
 #include <tempo_config/parse_config.h>
+#include <tempo_config/time_conversions.h>
 #include <tempo_utils/logging.h>
 #include <tempo_utils/log_sink.h>
 #include <tempo_utils/result.h>
@@ -92,6 +94,70 @@ parse_log_file_sink(
     return {};
 }
 
+static tempo_utils::Status
+parse_rotating_log_file_sink(
+    const tempo_config::ConfigMap &loggingMap,
+    std::unique_ptr<tempo_utils::AbstractLogSink> &logSink)
+{
+    tempo_utils::RotatingLogFileOptions options;
+
+    tempo_config::BooleanParser displayShortFormParser(options.displayShortForm);
+    TU_RETURN_IF_NOT_OK (tempo_config::parse_config(options.displayShortForm, displayShortFormParser,
+        loggingMap, "displayShortForm"));
+
+    tempo_config::PathParser logFilePathParser;
+    std::filesystem::path logFilePath;
+    TU_RETURN_IF_NOT_OK (tempo_config::parse_config(logFilePath, logFilePathParser,
+        loggingMap, "logFilePath"));
+
+    tempo_config::IntegerParser bufferSizeParser(static_cast<int>(options.bufferSize));
+    int bufferSize;
+    TU_RETURN_IF_NOT_OK (tempo_config::parse_config(bufferSize, bufferSizeParser,
+        loggingMap, "bufferSize"));
+    if (bufferSize <= 0)
+        return tempo_command::CommandStatus::forCondition(
+            tempo_command::CommandCondition::kInvalidConfiguration,
+            "invalid logging configuration for 'bufferSize'; value must be positive");
+    options.bufferSize = bufferSize;
+
+    tempo_config::DurationParser flushIntervalParser(options.flushInterval);
+    TU_RETURN_IF_NOT_OK (tempo_config::parse_config(options.flushInterval, flushIntervalParser,
+        loggingMap, "flushInterval"));
+
+    tempo_config::UInt64Parser maxFileSizeParser(options.maxFileSize);
+    TU_RETURN_IF_NOT_OK (tempo_config::parse_config(options.maxFileSize, maxFileSizeParser,
+        loggingMap, "maxFileSize"));
+
+    tempo_config::DurationParser maxFileAgeParser(options.maxFileAge);
+    TU_RETURN_IF_NOT_OK (tempo_config::parse_config(options.maxFileAge, maxFileAgeParser,
+        loggingMap, "maxFileAge"));
+
+    tempo_config::IntegerParser maxRetainedFilesParser(options.maxRetainedFiles);
+    TU_RETURN_IF_NOT_OK (tempo_config::parse_config(options.maxRetainedFiles, maxRetainedFilesParser,
+        loggingMap, "maxRetainedFiles"));
+    if (options.maxRetainedFiles < 0)
+        return tempo_command::CommandStatus::forCondition(
+            tempo_command::CommandCondition::kInvalidConfiguration,
+            "invalid logging configuration for 'maxRetainedFiles'; value must not be negative");
+
+    logSink = std::make_unique<tempo_utils::RotatingLogFileSink>(logFilePath, options);
+    return {};
+}
+
+static tempo_utils::Status
+parse_binary_log_file_sink(
+    const tempo_config::ConfigMap &loggingMap,
+    std::unique_ptr<tempo_utils::AbstractLogSink> &logSink)
+{
+    tempo_config::PathParser logFilePathParser;
+    std::filesystem::path logFilePath;
+    TU_RETURN_IF_NOT_OK (tempo_config::parse_config(logFilePath, logFilePathParser,
+        loggingMap, "logFilePath"));
+
+    logSink = std::make_unique<tempo_utils::BinaryLogFileSink>(logFilePath);
+    return {};
+}
+
 static tempo_utils::Status
 parse_custom_log_sink(
     const tempo_config::ConfigMap &loggingMap,
@@ -125,6 +191,30 @@ parse_logging_config(
     TU_RETURN_IF_NOT_OK (tempo_config::parse_config(loggingConfig.severityFilter, severityFilterParser,
         loggingMap, "severityFilter"));
 
+    tempo_config::BooleanParser asyncLoggingParser(false);
+    TU_RETURN_IF_NOT_OK (tempo_config::parse_config(loggingConfig.asyncLogging, asyncLoggingParser,
+        loggingMap, "asyncLogging"));
+
+    tempo_config::IntegerParser asyncQueueSizeParser(8192);
+    TU_RETURN_IF_NOT_OK (tempo_config::parse_config(loggingConfig.asyncQueueSize, asyncQueueSizeParser,
+        loggingMap, "asyncQueueSize"));
+    if (loggingConfig.asyncQueueSize <= 0)
+        return tempo_command::CommandStatus::forCondition(
+            tempo_command::CommandCondition::kInvalidConfiguration,
+            "invalid logging configuration for 'asyncQueueSize'; value must be positive");
+
+    tempo_command::LogQueuePolicyParser asyncQueuePolicyParser(tempo_utils::LogQueuePolicy::kBlock);
+    TU_RETURN_IF_NOT_OK (tempo_config::parse_config(loggingConfig.asyncQueuePolicy, asyncQueuePolicyParser,
+        loggingMap, "asyncQueuePolicy"));
+
+    tempo_command::SeverityFilterParser flightRecorderFilterParser(tempo_utils::SeverityFilter::kSilent);
+    TU_RETURN_IF_NOT_OK (tempo_config::parse_config(loggingConfig.flightRecorderFilter, flightRecorderFilterParser,
+        loggingMap, "flightRecorderFilter"));
+
+    tempo_config::BooleanParser installFaultHandlerParser(false);
+    TU_RETURN_IF_NOT_OK (tempo_config::parse_config(loggingConfig.installFaultHandler, installFaultHandlerParser,
+        loggingMap, "installFaultHandler"));
+
     auto logSinkNode = loggingMap.mapAt("logSink");
     auto logSinkNodeType = logSinkNode.getNodeType();
     switch (logSinkNodeType) {
@@ -134,6 +224,10 @@ parse_logging_config(
                 return parse_default_log_sink(loggingMap, logSink);
             if (logSinkType == "LogFile")
                 return parse_log_file_sink(loggingMap, logSink);
+            if (logSinkType == "RotatingLogFile")
+                return parse_rotating_log_file_sink(loggingMap, logSink);
+            if (logSinkType == "BinaryLogFile")
+                return parse_binary_log_file_sink(loggingMap, logSink);
             return tempo_command::CommandStatus::forCondition(
                 tempo_command::CommandCondition::kInvalidConfiguration,
                 "invalid logging configuration for 'logSink'; '{}' is not a valid log sink",
@@ -47,6 +47,9 @@ tempo_config::internal::ConfigListener::logErrorOrThrow(
     tempo_tracing::CurrentScope scope;
     scope.putTag(tempo_tracing::kOpentracingError, true);
     auto log = scope.appendLog(absl::Now(), tempo_tracing::LogSeverity::kError);
+    // there is no span to log to if tracing is disabled
+    if (log == nullptr)
+        return;
     log->putField(tempo_tracing::kTempoTracingLineNumber, (tu_uint64) lineNr);
     log->putField(tempo_tracing::kTempoTracingColumnNumber, (tu_uint64) columnNr);
     log->putField(tempo_tracing::kOpentracingMessage, message);
@@ -1,10 +1,38 @@
 #ifndef TEMPO_TRACING_BASE_SCOPE_H
 #define TEMPO_TRACING_BASE_SCOPE_H
 
+#include <atomic>
+
 #include "trace_context.h"
 
 namespace tempo_tracing {
 
+    namespace internal {
+        extern std::atomic<bool> tracingEnabled;
+    }
+
+#ifdef TEMPO_TRACING_STRIP
+    constexpr bool kTracingStripped = true;
+#else
+    constexpr bool kTracingStripped = false;
+#endif
+
+    /**
+     * Returns true if tracing scopes should make spans. If tracing is disabled then entering a
+     * scope costs a single relaxed load, and if tempo_tracing is built with TEMPO_TRACING_STRIP
+     * then scopes are compiled down to nothing.
+     */
+    inline bool
+    is_tracing_enabled()
+    {
+        if constexpr (kTracingStripped)
+            return false;
+        else
+            return internal::tracingEnabled.load(std::memory_order_relaxed);
+    }
+
+    void set_tracing_enabled(bool enabled);
+
     class BaseScope {
     public:
         explicit BaseScope(std::string_view contextName);
@@ -29,6 +57,8 @@ namespace tempo_tracing {
         std::shared_ptr<TraceContext> m_context;
         tempo_utils::Status m_status;
 
+        BaseScope() = default;
+        void attachContext(std::string_view contextName);
         bool checkCurrentContext();
 
     public:
@@ -0,0 +1,51 @@
+#ifndef TEMPO_TRACING_CHROME_TRACE_EXPORTER_H
+#define TEMPO_TRACING_CHROME_TRACE_EXPORTER_H
+
+#include <span>
+#include <string>
+#include <vector>
+
+#include <tempo_utils/file_appender.h>
+
+#include "spanset_stream.h"
+#include "tempo_spanset.h"
+#include "tracing_result.h"
+
+namespace tempo_tracing {
+
+    /**
+     * Writes spansets as Chrome trace-event JSON, which can be loaded into chrome://tracing or
+     * Perfetto. Each span is written as a complete event and each log entry as an instant event.
+     * Events are appended to the file in batches as they are produced, so the memory used by the
+     * exporter does not grow with the size of the output. Spans which overlap without nesting are
+     * placed on separate tracks, since a track can only display nested events.
+     */
+    class ChromeTraceExporter {
+
+    public:
+        explicit ChromeTraceExporter(std::shared_ptr<tempo_utils::FileAppender> appender);
+
+        tempo_utils::Status exportSpanset(const TempoSpanset &spanset);
+        tempo_utils::Status exportFragments(std::span<const tu_uint8> bytes);
+        tempo_utils::Status finish();
+
+        tu_uint32 numEvents() const;
+        tu_uint32 numTracks() const;
+
+    private:
+        std::shared_ptr<tempo_utils::FileAppender> m_appender;
+        tu_uint32 m_numEvents;
+        // the latest end time of the events on each track
+        std::vector<tu_int64> m_trackEnds;
+        bool m_finished;
+        std::string m_pending;
+
+        tempo_utils::Status exportSpans(const internal::SpansetReader &reader);
+        tempo_utils::Status appendEvent(std::string_view event);
+        tempo_utils::Status flushPending();
+    };
+
+    SpansetFragmentCallback export_chrome_trace_fragments(std::shared_ptr<ChromeTraceExporter> exporter);
+}
+
+#endif // TEMPO_TRACING_CHROME_TRACE_EXPORTER_H
@@ -10,8 +10,18 @@ namespace tempo_tracing {
     class CurrentScope : public BaseScope {
 
     public:
-        explicit CurrentScope(std::string_view contextName = {});
-        ~CurrentScope();
+        explicit CurrentScope(std::string_view contextName = {})
+        {
+            if (is_tracing_enabled()) {
+                enterScope(contextName);
+            }
+        }
+        ~CurrentScope()
+        {
+            if (!kTracingStripped && m_span != nullptr) {
+                exitScope();
+            }
+        }
 
         CurrentScope(const CurrentScope &) = delete;
         CurrentScope(CurrentScope &&) = delete;
@@ -20,6 +30,9 @@ namespace tempo_tracing {
 
     private:
         std::shared_ptr<TraceSpan> m_span;
+
+        void enterScope(std::string_view contextName);
+        void exitScope();
     };
 }
 
@@ -14,8 +14,18 @@ namespace tempo_tracing {
             std::string_view operationName,
             std::string_view contextName = {},
             FailurePropagation propagation = FailurePropagation::NoPropagation,
-            FailureCollection collection = FailureCollection::IgnoresPropagation);
-        ~EnterScope();
+            FailureCollection collection = FailureCollection::IgnoresPropagation)
+        {
+            if (is_tracing_enabled()) {
+                enterScope(operationName, contextName, propagation, collection);
+            }
+        }
+        ~EnterScope()
+        {
+            if (!kTracingStripped && m_span != nullptr) {
+                exitScope();
+            }
+        }
 
         EnterScope() = delete;
         EnterScope(const EnterScope &) = delete;
@@ -25,6 +35,13 @@ namespace tempo_tracing {
 
     private:
         std::shared_ptr<TraceSpan> m_span;
+
+        void enterScope(
+            std::string_view operationName,
+            std::string_view contextName,
+            FailurePropagation propagation,
+            FailureCollection collection);
+        void exitScope();
     };
 }
 
@@ -10,8 +10,18 @@ namespace tempo_tracing {
     class ExitScope : public BaseScope {
 
     public:
-        explicit ExitScope(std::string_view contextName = {});
-        ~ExitScope();
+        explicit ExitScope(std::string_view contextName = {})
+        {
+            if (is_tracing_enabled()) {
+                enterScope(contextName);
+            }
+        }
+        ~ExitScope()
+        {
+            if (!kTracingStripped && m_span != nullptr) {
+                exitScope();
+            }
+        }
 
         ExitScope(const ExitScope &) = delete;
         ExitScope(ExitScope &&) = delete;
@@ -20,6 +30,9 @@ namespace tempo_tracing {
 
     private:
         std::shared_ptr<TraceSpan> m_span;
+
+        void enterScope(std::string_view contextName);
+        void exitScope();
     };
 }
 
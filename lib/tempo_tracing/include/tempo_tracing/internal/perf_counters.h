@@ -0,0 +1,46 @@
+#ifndef TEMPO_TRACING_INTERNAL_PERF_COUNTERS_H
+#define TEMPO_TRACING_INTERNAL_PERF_COUNTERS_H
+
+#include <array>
+
+#include <tempo_utils/integer_types.h>
+
+namespace tempo_tracing::internal {
+
+    enum class PerfCounter {
+        kCycles,
+        kInstructions,
+        kCacheMisses,
+        kContextSwitches,
+        kTaskClockNanos,
+        NUM_COUNTERS,
+    };
+
+    constexpr int kNumPerfCounters = static_cast<int>(PerfCounter::NUM_COUNTERS);
+
+    /**
+     * Values of the performance counters of the calling thread. The source identifies the
+     * thread counters which produced the sample, since only samples from the same source can be
+     * subtracted.
+     */
+    struct PerfCounterSample {
+        const void *source = nullptr;
+        std::array<tu_uint64,kNumPerfCounters> values{};
+        tu_uint32 validMask = 0;
+    };
+
+    /**
+     * Counter deltas accumulated by a span across each of its active intervals.
+     */
+    struct PerfCounterState {
+        PerfCounterSample start;
+        std::array<tu_uint64,kNumPerfCounters> totals{};
+        tu_uint32 validMask = 0;
+
+        void accumulate(const PerfCounterSample &end);
+    };
+
+    bool read_thread_perf_counters(PerfCounterSample &sample);
+}
+
+#endif // TEMPO_TRACING_INTERNAL_PERF_COUNTERS_H
@@ -4,6 +4,8 @@
 #include <span>
 #include <string>
 
+#include <absl/container/flat_hash_map.h>
+
 #include <tempo_tracing/generated/spanset.h>
 #include <tempo_utils/tracing.h>
 
@@ -22,6 +24,7 @@ namespace tempo_tracing::internal {
 
         const tts1::NamespaceDescriptor *getNamespace(uint32_t index) const;
         uint32_t numNamespaces() const;
+        uint32_t findNamespace(std::string_view nsUrl) const;
 
         const tts1::AttributeDescriptor *getAttribute(uint32_t index) const;
         uint32_t numAttributes() const;
@@ -45,8 +48,12 @@ namespace tempo_tracing::internal {
     private:
         std::span<const tu_uint8> m_bytes;
         const tts1::Spanset *m_spanset;
+        absl::flat_hash_map<std::string_view,uint32_t> m_namespaceIndex;
     };
 
+    tu_int64 get_span_start_nanos(const tts1::SpanDescriptor *span);
+    tu_int64 get_span_end_nanos(const tts1::SpanDescriptor *span);
+
 };
 
 #endif // TEMPO_TRACING_INTERNAL_SPANSET_READER_H
@@ -0,0 +1,78 @@
+#ifndef TEMPO_TRACING_INTERNAL_SPANSET_WRITER_H
+#define TEMPO_TRACING_INTERNAL_SPANSET_WRITER_H
+
+#include <span>
+#include <string>
+
+#include <absl/container/flat_hash_map.h>
+
+#include <tempo_tracing/generated/spanset.h>
+#include <tempo_tracing/tracing_types.h>
+#include <tempo_utils/immutable_bytes.h>
+#include <tempo_utils/tracing.h>
+
+namespace tempo_tracing::internal {
+
+    class SpansetReader;
+
+    /**
+     * Incrementally builds a spanset. Spans are serialized as they are appended, so the caller
+     * does not need to retain the span data after appending it. A span is recorded as a root
+     * if it has no parent span id, or if it is copied from another spanset without a parent in
+     * this spanset, and as an error if it is appended as failed.
+     */
+    class SpansetWriter {
+
+    public:
+        explicit SpansetWriter(tempo_utils::TraceId traceId);
+
+        tu_uint32 numSpans() const;
+
+        tu_uint32 appendSpan(
+            const SpanData &spanData,
+            tu_uint32 parentIndex,
+            std::span<const tu_uint32> children,
+            bool failed);
+        tu_uint32 appendSpan(
+            const SpansetReader &reader,
+            const tts1::SpanDescriptor *span,
+            tu_uint32 parentIndex,
+            std::span<const tu_uint32> children);
+
+        std::shared_ptr<const tempo_utils::ImmutableBytes> finish();
+
+    private:
+        tempo_utils::TraceId m_traceId;
+        flatbuffers::FlatBufferBuilder m_buffer;
+        // namespace urls are either static schema strings or owned by the source spanset
+        absl::flat_hash_map<std::string_view,tu_uint32> m_nscache;
+        std::vector<flatbuffers::Offset<tts1::NamespaceDescriptor>> m_namespaces;
+        std::vector<flatbuffers::Offset<tts1::SpanDescriptor>> m_spans;
+        std::vector<flatbuffers::Offset<tts1::AttributeDescriptor>> m_attrs;
+        std::vector<tts1::TagKey> m_attrKeys;
+        std::vector<flatbuffers::Offset<tts1::LogDescriptor>> m_logs;
+        std::vector<tu_uint32> m_roots;
+        std::vector<tu_uint32> m_errors;
+
+        tu_uint32 putNamespace(std::string_view nsUrl);
+        tu_uint32 appendAttr(const tempo_schema::AttrKey &key, const tempo_schema::AttrValue &value);
+        tu_uint32 copyAttr(const SpansetReader &reader, tu_uint32 index);
+        tu_uint32 appendSpanDescriptor(
+            tu_uint64 spanId,
+            std::string_view operationName,
+            tu_uint32 parentIndex,
+            tu_uint64 parentId,
+            bool root,
+            std::span<const tu_uint32> children,
+            bool failed,
+            tu_int64 startTime,
+            tu_int64 endTime,
+            tu_int64 startTimeNanos,
+            tu_int64 endTimeNanos,
+            tu_int64 duration,
+            const std::vector<tu_uint32> &tags,
+            const std::vector<tu_uint32> &logs);
+    };
+}
+
+#endif // TEMPO_TRACING_INTERNAL_SPANSET_WRITER_H
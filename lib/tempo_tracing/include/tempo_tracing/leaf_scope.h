@@ -14,8 +14,18 @@ namespace tempo_tracing {
             std::string_view operationName,
             std::string_view contextName = {},
             FailurePropagation propagation = FailurePropagation::NoPropagation,
-            FailureCollection collection = FailureCollection::IgnoresPropagation);
-        ~LeafScope();
+            FailureCollection collection = FailureCollection::IgnoresPropagation)
+        {
+            if (is_tracing_enabled()) {
+                enterScope(operationName, contextName, propagation, collection);
+            }
+        }
+        ~LeafScope()
+        {
+            if (!kTracingStripped && m_span != nullptr) {
+                exitScope();
+            }
+        }
 
         LeafScope() = delete;
         LeafScope(const LeafScope &) = delete;
@@ -25,6 +35,13 @@ namespace tempo_tracing {
 
     private:
         std::shared_ptr<TraceSpan> m_span;
+
+        void enterScope(
+            std::string_view operationName,
+            std::string_view contextName,
+            FailurePropagation propagation,
+            FailureCollection collection);
+        void exitScope();
     };
 }
 
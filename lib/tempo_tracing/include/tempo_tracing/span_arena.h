@@ -0,0 +1,49 @@
+#ifndef TEMPO_TRACING_SPAN_ARENA_H
+#define TEMPO_TRACING_SPAN_ARENA_H
+
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "tracing_types.h"
+
+namespace tempo_tracing {
+
+    /**
+     * Append-only store of span data. Spans are constructed in place in fixed-size chunks, so
+     * each chunk is contiguous and a reference to a span remains valid until the arena is
+     * destroyed. Memory is allocated and freed one chunk at a time.
+     */
+    class SpanArena {
+
+    public:
+        static constexpr tu_uint32 kDefaultChunkSize = 64;
+
+        explicit SpanArena(tu_uint32 chunkSize = kDefaultChunkSize);
+        SpanArena(const SpanArena &other) = delete;
+        SpanArena& operator=(const SpanArena &other) = delete;
+        ~SpanArena();
+
+        SpanData& append(
+            tu_uint32 spanIndex,
+            tempo_utils::SpanId spanId,
+            tu_uint32 parentIndex,
+            tempo_utils::SpanId parentId);
+
+        tu_uint32 size() const;
+        int numChunks() const;
+        std::span<const SpanData> getChunk(int index) const;
+
+    private:
+        struct Chunk {
+            SpanData *spans;
+            tu_uint32 size;
+        };
+
+        tu_uint32 m_chunkSize;
+        tu_uint32 m_size;
+        std::vector<Chunk> m_chunks;
+    };
+}
+
+#endif // TEMPO_TRACING_SPAN_ARENA_H
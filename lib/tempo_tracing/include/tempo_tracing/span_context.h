@@ -0,0 +1,49 @@
+#ifndef TEMPO_TRACING_SPAN_CONTEXT_H
+#define TEMPO_TRACING_SPAN_CONTEXT_H
+
+#include <memory>
+
+#include <tempo_utils/tracing.h>
+
+#include "tracing_types.h"
+
+namespace tempo_tracing {
+
+    // forward declarations
+    class TraceRecorder;
+    class TraceSpan;
+
+    /**
+     * A copyable reference to a span, which can be captured into a task or coroutine and used to
+     * make child spans of the span on any thread. The context holds the recorder and the
+     * immutable index and id of the span but not the span itself, so making a child span never
+     * takes the lock of the parent span.
+     */
+    class SpanContext {
+
+    public:
+        SpanContext();
+        SpanContext(const SpanContext &other) = default;
+        SpanContext& operator=(const SpanContext &other) = default;
+
+        bool isValid() const;
+
+        tempo_utils::TraceId getTraceId() const;
+        tempo_utils::SpanId getSpanId() const;
+        std::shared_ptr<TraceRecorder> getRecorder() const;
+
+        std::shared_ptr<TraceSpan> makeSpan(
+            FailurePropagation propagation = FailurePropagation::NoPropagation,
+            FailureCollection collection = FailureCollection::IgnoresPropagation) const;
+
+    private:
+        std::shared_ptr<TraceRecorder> m_recorder;
+        tu_uint32 m_spanIndex;
+        tempo_utils::SpanId m_spanId;
+
+        SpanContext(std::shared_ptr<TraceRecorder> recorder, tu_uint32 spanIndex, const tempo_utils::SpanId &spanId);
+        friend class TraceSpan;
+    };
+}
+
+#endif // TEMPO_TRACING_SPAN_CONTEXT_H
@@ -0,0 +1,82 @@
+#ifndef TEMPO_TRACING_SPAN_LATENCY_METRICS_H
+#define TEMPO_TRACING_SPAN_LATENCY_METRICS_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <absl/base/thread_annotations.h>
+#include <absl/container/flat_hash_map.h>
+#include <absl/synchronization/mutex.h>
+#include <absl/time/time.h>
+
+#include <tempo_utils/hdr_histogram.h>
+
+namespace tempo_tracing {
+
+    struct SpanLatencyMetricsOptions {
+        absl::Duration lowestDiscernibleLatency = absl::Microseconds(1);
+        absl::Duration maxTrackableLatency = absl::Minutes(1);
+        int significantFigures = 2;
+    };
+
+    /**
+     * Latency of the spans with the same operation name which closed during the snapshot
+     * interval. Durations are recorded in nanoseconds.
+     */
+    struct OperationLatency {
+        tu_uint64 numSpans = 0;
+        tu_uint64 numFailed = 0;
+        tempo_utils::HdrHistogram durations;
+    };
+
+    struct SpanLatencySnapshot {
+        absl::Time intervalStart;
+        absl::Time intervalEnd;
+        absl::flat_hash_map<std::string,OperationLatency> operations;
+    };
+
+    /**
+     * Per-operation latency histograms derived from closed spans. Each thread records into its
+     * own shard, which is only written by that thread, so recording a span takes no lock. Each
+     * operation in a shard has two sets of histogram buckets: the owner thread records into the
+     * active set, and `takeSnapshot` swaps the sets and then drains the inactive set. The shard of
+     * a thread is reclaimed by the next snapshot after the thread exits. Spans are not retained,
+     * only their durations.
+     */
+    class SpanLatencyMetrics {
+
+    public:
+        explicit SpanLatencyMetrics(const SpanLatencyMetricsOptions &options = {});
+        ~SpanLatencyMetrics();
+
+        void recordSpan(std::string_view operationName, absl::Duration duration, bool failed);
+
+        SpanLatencySnapshot takeSnapshot(bool reset = true);
+
+        int numThreadShards();
+
+    private:
+        struct Shard;
+        struct ThreadShards;
+
+        const tu_uint64 m_metricsId;
+        SpanLatencyMetricsOptions m_options;
+        tu_int64 m_unitNanos;
+        tu_int64 m_maxUnits;
+        int m_subBucketBits;
+        tu_uint32 m_numBuckets;
+        absl::Mutex m_shardsLock;
+        std::vector<std::shared_ptr<Shard>> m_shards ABSL_GUARDED_BY(m_shardsLock);
+        absl::flat_hash_map<std::string,OperationLatency> m_retained ABSL_GUARDED_BY(m_shardsLock);
+        absl::Time m_intervalStart ABSL_GUARDED_BY(m_shardsLock);
+
+        static ThreadShards& getThreadShards();
+        Shard *getThreadShard();
+        tu_uint32 bucketIndex(tu_int64 units) const;
+        tu_int64 bucketValue(tu_uint32 index) const;
+        void drainShard(Shard *shard, int buffer) ABSL_EXCLUSIVE_LOCKS_REQUIRED(m_shardsLock);
+    };
+}
+
+#endif // TEMPO_TRACING_SPAN_LATENCY_METRICS_H
@@ -36,6 +36,9 @@ namespace tempo_tracing {
         tempo_utils::Status
         putField(const tempo_schema::AttrSerde<T> &serde, const T &value)
         {
+            // fields of an unsampled span are discarded, so skip serializing the value
+            if (!m_span->isSampled())
+                return {};
             SpansetAttrWriter writer;
             auto result = serde.writeAttr(&writer, value);
             if (result.isStatus())
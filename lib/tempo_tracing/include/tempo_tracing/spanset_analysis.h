@@ -0,0 +1,64 @@
+#ifndef TEMPO_TRACING_SPANSET_ANALYSIS_H
+#define TEMPO_TRACING_SPANSET_ANALYSIS_H
+
+#include <string>
+#include <vector>
+
+#include <absl/container/flat_hash_map.h>
+#include <absl/time/time.h>
+
+#include <tempo_utils/result.h>
+
+#include "tempo_spanset.h"
+
+namespace tempo_tracing {
+
+    /**
+     * Where the latency of a span went. Self time is the part of the span which is not covered
+     * by any of its children, so concurrent children are only counted once. Critical time is
+     * the part of the span which lies on the critical path of its trace, which is the chain of
+     * spans determining when the root span ended.
+     */
+    struct SpanTiming {
+        tempo_utils::SpanId spanId;
+        std::string operationName;
+        absl::Duration duration;
+        absl::Duration selfTime;
+        absl::Duration criticalTime;
+    };
+
+    tempo_utils::Result<std::vector<SpanTiming>> analyze_span_timings(const TempoSpanset &spanset);
+
+    /**
+     * Aggregated timings of the spans with the same operation name.
+     */
+    struct OperationProfile {
+        tu_uint64 count = 0;
+        absl::Duration totalTime;
+        absl::Duration selfTime;
+        absl::Duration criticalTime;
+    };
+
+    /**
+     * Aggregates span timings across many spansets, by operation name and by stack of operation
+     * names from the root span.
+     */
+    class SpansetProfile {
+
+    public:
+        SpansetProfile();
+
+        tempo_utils::Status addSpanset(const TempoSpanset &spanset);
+
+        int numSpansets() const;
+        std::vector<std::pair<std::string,OperationProfile>> listOperations() const;
+        std::string toFoldedStacks() const;
+
+    private:
+        int m_numSpansets;
+        absl::flat_hash_map<std::string,OperationProfile> m_operations;
+        absl::flat_hash_map<std::string,absl::Duration> m_stacks;
+    };
+}
+
+#endif // TEMPO_TRACING_SPANSET_ANALYSIS_H
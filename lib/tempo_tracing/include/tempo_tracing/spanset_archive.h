@@ -0,0 +1,98 @@
+#ifndef TEMPO_TRACING_SPANSET_ARCHIVE_H
+#define TEMPO_TRACING_SPANSET_ARCHIVE_H
+
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <tempo_schema/attr.h>
+#include <tempo_utils/hdr_histogram.h>
+#include <tempo_utils/immutable_bytes.h>
+#include <tempo_utils/result.h>
+
+#include "tracing_result.h"
+#include "tracing_types.h"
+
+namespace tempo_tracing {
+
+    constexpr const char *kSpansetArchiveMagic = "TSAR";
+    constexpr tu_uint32 kSpansetArchiveVersion = 1;
+
+    /**
+     * Matches spans where the tag with the specified key has the specified value. Tag values are
+     * compared by their string representation.
+     */
+    struct ArchiveTagFilter {
+        std::string ns;
+        tu_uint32 type;
+        std::string value;
+
+        ArchiveTagFilter(const tempo_schema::AttrKey &key, std::string_view value);
+    };
+
+    /**
+     * Selects the spans in an archive which match all of the specified conditions.
+     */
+    struct ArchiveQuery {
+        std::string operationName;              /**< match spans with the operation name, or any span if empty. */
+        std::vector<ArchiveTagFilter> tags;     /**< match spans which have each tag value. */
+        bool failedOnly = false;                /**< match only failed spans. */
+    };
+
+    /**
+     * Aggregate of the spans matched by a query. Durations are measured in nanoseconds from the
+     * start to the end of each span, and spans without both a start and end time are counted but
+     * not recorded in the duration histogram.
+     */
+    struct ArchiveAggregate {
+        tu_uint64 numSpans = 0;
+        tu_uint64 numFailed = 0;
+        tempo_utils::HdrHistogram durations;
+    };
+
+    /**
+     * Read-only view of a spanset archive, which stores the spans of many spansets in columnar
+     * blocks. The columns are read in place from the archive bytes, so an archive opened from a
+     * file is backed by the memory mapping and is not copied.
+     */
+    class SpansetArchive {
+
+    public:
+        SpansetArchive();
+        SpansetArchive(const SpansetArchive &other);
+
+        bool isValid() const;
+
+        tu_uint32 numBlocks() const;
+        tu_uint64 numSpans() const;
+
+        tempo_utils::Result<ArchiveAggregate> aggregate(const ArchiveQuery &query) const;
+
+        static tempo_utils::Result<SpansetArchive> open(const std::filesystem::path &path);
+        static tempo_utils::Result<SpansetArchive> load(std::shared_ptr<const tempo_utils::ImmutableBytes> bytes);
+
+    private:
+        struct TagColumn {
+            std::string_view ns;
+            tu_uint32 type;
+            std::vector<std::string_view> values;
+            std::span<const tu_uint32> codes;
+        };
+        struct Block {
+            tu_uint32 numSpans;
+            std::vector<std::string_view> operations;
+            std::span<const tu_uint32> operationCodes;
+            std::span<const tu_int64> durations;
+            std::span<const tu_uint64> failed;
+            std::vector<TagColumn> tagColumns;
+        };
+
+        std::shared_ptr<const tempo_utils::ImmutableBytes> m_bytes;
+        std::vector<Block> m_blocks;
+
+        bool selectSpans(const Block &block, const ArchiveQuery &query, std::vector<tu_uint64> &mask) const;
+    };
+}
+
+#endif // TEMPO_TRACING_SPANSET_ARCHIVE_H
@@ -0,0 +1,66 @@
+#ifndef TEMPO_TRACING_SPANSET_ARCHIVE_WRITER_H
+#define TEMPO_TRACING_SPANSET_ARCHIVE_WRITER_H
+
+#include <string>
+#include <vector>
+
+#include <absl/container/flat_hash_map.h>
+
+#include <tempo_utils/bytes_appender.h>
+#include <tempo_utils/immutable_bytes.h>
+#include <tempo_utils/status.h>
+
+#include "tempo_spanset.h"
+
+namespace tempo_tracing {
+
+    struct SpansetArchiveOptions {
+        tu_uint32 maxBlockSpans = 65536;        /**< spans per block before the block is written. */
+    };
+
+    /**
+     * Compacts the spans of many spansets into a spanset archive. Spans are buffered as columns
+     * until a block is full, then the block is encoded and the columns are cleared. Operation
+     * names and tag values are dictionary encoded within each block.
+     */
+    class SpansetArchiveWriter {
+
+    public:
+        explicit SpansetArchiveWriter(const SpansetArchiveOptions &options = {});
+
+        tu_uint32 numBlocks() const;
+
+        tempo_utils::Status appendSpanset(const TempoSpanset &spanset);
+
+        std::shared_ptr<const tempo_utils::ImmutableBytes> finish();
+
+    private:
+        struct StringDictionary {
+            absl::flat_hash_map<std::string,tu_uint32> codes;
+            std::vector<std::string> strings;
+
+            tu_uint32 put(std::string_view str);
+        };
+        struct TagColumn {
+            std::string ns;
+            tu_uint32 type;
+            StringDictionary values;
+            std::vector<tu_uint32> codes;
+        };
+
+        SpansetArchiveOptions m_options;
+        tempo_utils::BytesAppender m_blocks;
+        tu_uint32 m_numBlocks;
+        StringDictionary m_operations;
+        std::vector<tu_uint32> m_operationCodes;
+        std::vector<tu_int64> m_durations;
+        std::vector<bool> m_failed;
+        std::vector<TagColumn> m_tagColumns;
+        absl::flat_hash_map<std::pair<std::string,tu_uint32>,tu_uint32> m_tagColumnIndex;
+
+        TagColumn& getTagColumn(std::string_view ns, tu_uint32 type);
+        void writeBlock();
+    };
+}
+
+#endif // TEMPO_TRACING_SPANSET_ARCHIVE_WRITER_H
@@ -1,35 +1,70 @@
 #ifndef TEMPO_TRACING_SPANSET_STATE_H
 #define TEMPO_TRACING_SPANSET_STATE_H
 
+#include <atomic>
+#include <thread>
+
+#include <absl/base/thread_annotations.h>
+#include <absl/container/flat_hash_map.h>
+#include <absl/synchronization/mutex.h>
+
+#include "span_arena.h"
 #include "tempo_spanset.h"
 #include "trace_span.h"
 #include "tracing_result.h"
 
 namespace tempo_tracing {
 
+    /**
+     * Span data recorded by a trace. Spans are appended to a shard owned by the calling thread,
+     * so threads which create spans concurrently never contend with each other. Each shard has
+     * its own lock, which is only contended when the spans are merged by `seal` and `toSpanset`.
+     * Span indexes are allocated from a single atomic counter, so the merged spans are ordered
+     * by creation as if they had been recorded by a single thread.
+     */
     class SpansetState {
 
     public:
         SpansetState(tempo_utils::TraceId id);
 
-        SpanData& appendSpan(
+        SpanData *appendSpan(
             const tempo_utils::SpanId &id,
             FailurePropagation propagation = FailurePropagation::NoPropagation,
             FailureCollection collection = FailureCollection::IgnoresPropagation);
-        SpanData& appendSpan(
+        SpanData *appendSpan(
             const tempo_utils::SpanId &id,
             tu_uint32 parentIndex,
             const tempo_utils::SpanId &parentId,
             FailurePropagation propagation = FailurePropagation::NoPropagation,
             FailureCollection collection = FailureCollection::IgnoresPropagation);
 
-        tempo_utils::Result<tempo_tracing::TempoSpanset> toSpanset() const;
+        bool isSealed() const;
+        void seal();
+
+        tempo_utils::Result<tempo_tracing::TempoSpanset> toSpanset(const SamplingPolicy &policy = {}) const;
 
     private:
+        struct Shard {
+            absl::Mutex lock;
+            SpanArena spans ABSL_GUARDED_BY(lock);
+        };
+
+        const tu_uint64 m_stateId;
         tempo_utils::TraceId m_id;
-        std::list<SpanData> m_spans;
-        uint32_t m_size;
+        std::atomic<tu_uint32> m_size;
+        std::atomic<bool> m_sealed;
+        mutable absl::Mutex m_shardsLock;
+        std::vector<std::unique_ptr<Shard>> m_shards ABSL_GUARDED_BY(m_shardsLock);
+        absl::flat_hash_map<std::thread::id,Shard *> m_threadShards ABSL_GUARDED_BY(m_shardsLock);
+
+        Shard *getThreadShard();
+        SpanData *appendSpanToShard(
+            const tempo_utils::SpanId &id,
+            tu_uint32 parentIndex,
+            const tempo_utils::SpanId &parentId,
+            FailurePropagation propagation,
+            FailureCollection collection);
     };
 }
 
-#endif // TEMPO_TRACING_SPANSET_STATE_H
\ No newline at end of file
+#endif // TEMPO_TRACING_SPANSET_STATE_H
@@ -0,0 +1,85 @@
+#ifndef TEMPO_TRACING_SPANSET_STREAM_H
+#define TEMPO_TRACING_SPANSET_STREAM_H
+
+#include <functional>
+#include <span>
+
+#include <absl/base/thread_annotations.h>
+#include <absl/container/flat_hash_map.h>
+#include <absl/synchronization/mutex.h>
+
+#include <tempo_utils/file_appender.h>
+
+#include "tempo_spanset.h"
+#include "tracing_types.h"
+
+namespace tempo_tracing {
+
+    // forward declarations
+    namespace internal {
+        class SpansetWriter;
+    }
+
+    /**
+     * Receives each length-prefixed spanset fragment written by a SpansetStream. Concatenating
+     * the fragments in the order they are received produces a valid spanset fragment stream.
+     */
+    using SpansetFragmentCallback = std::function<tempo_utils::Status(std::span<const tu_uint8>)>;
+
+    struct SpansetStreamOptions {
+        tu_uint32 maxFragmentSpans = 256;       /**< number of spans serialized before a fragment is written. */
+    };
+
+    /**
+     * Serializes spans incrementally as spanset fragments. A span is serialized once it and all
+     * of its descendants have been closed, after which the stream retains no data for the span.
+     * Each fragment is a complete spanset prefixed by its size as a little-endian 32-bit integer.
+     * Spans in a fragment record only the id of their parent, so `concatenate_spanset_fragments`
+     * is used to rebuild the span tree.
+     */
+    class SpansetStream {
+
+    public:
+        SpansetStream(
+            tempo_utils::TraceId traceId,
+            SpansetFragmentCallback callback,
+            const SpansetStreamOptions &options = {});
+        ~SpansetStream();
+
+        tu_uint32 registerSpan(tu_uint32 parentIndex);
+        void completeSpan(const SpanData &spanData);
+
+        bool isSealed() const;
+        void seal();
+
+        tempo_utils::Status flush();
+
+    private:
+        struct PendingSpan {
+            tu_uint32 parentIndex;
+            tu_uint32 numChildren = 0;
+            tu_uint32 numOpenChildren = 0;
+            tu_uint32 numFailedChildren = 0;
+            std::unique_ptr<SpanData> closedData;   // copy of a span which closed before its children
+        };
+
+        tempo_utils::TraceId m_traceId;
+        SpansetFragmentCallback m_callback;
+        SpansetStreamOptions m_options;
+        mutable absl::Mutex m_lock;
+        tu_uint32 m_nextIndex ABSL_GUARDED_BY(m_lock);
+        bool m_sealed ABSL_GUARDED_BY(m_lock);
+        absl::flat_hash_map<tu_uint32,PendingSpan> m_pending ABSL_GUARDED_BY(m_lock);
+        std::unique_ptr<internal::SpansetWriter> m_writer ABSL_GUARDED_BY(m_lock);
+        tempo_utils::Status m_status ABSL_GUARDED_BY(m_lock);
+
+        void writeCompletedSpanUnlocked(const SpanData *spanData);
+        tempo_utils::Status flushUnlocked();
+    };
+
+    SpansetFragmentCallback append_spanset_fragments(std::shared_ptr<tempo_utils::FileAppender> appender);
+
+    tempo_utils::Result<TempoSpanset> concatenate_spanset_fragments(std::span<const tu_uint8> bytes);
+}
+
+#endif // TEMPO_TRACING_SPANSET_STREAM_H
@@ -29,6 +29,12 @@ namespace tempo_tracing {
         static tempo_utils::Result<std::shared_ptr<TraceContext>> makeUnownedContextAndSwitch(
             std::shared_ptr<TraceRecorder> recorder,
             std::string_view name = {});
+        static tempo_utils::Result<std::shared_ptr<TraceContext>> resumeContext(
+            const SpanContext &parent,
+            std::string_view name = {});
+        static tempo_utils::Result<std::shared_ptr<TraceContext>> resumeContextAndSwitch(
+            const SpanContext &parent,
+            std::string_view name = {});
         static tempo_utils::Result<std::shared_ptr<TraceRecorder>> releaseContext(std::string_view name);
 
         std::string getName() const;
@@ -59,10 +65,15 @@ namespace tempo_tracing {
         std::thread::id m_tid;
         std::shared_ptr<TraceRecorder> m_recorder;
         bool m_unowned;
+        SpanContext m_parent;
         std::vector<std::shared_ptr<TraceSpan>> m_spanStack;
         bool m_isActive;
 
-        TraceContext(std::string_view name, std::shared_ptr<TraceRecorder> recorder, bool unowned);
+        TraceContext(
+            std::string_view name,
+            std::shared_ptr<TraceRecorder> recorder,
+            bool unowned,
+            const SpanContext &parent = {});
         void checkCurrentThreadOrThrow() const;
 
         friend class EnterScope;
@@ -7,7 +7,10 @@
 #include <absl/container/node_hash_map.h>
 #include <absl/strings/string_view.h>
 
+#include "span_context.h"
+#include "span_latency_metrics.h"
 #include "spanset_state.h"
+#include "spanset_stream.h"
 #include "tracing_types.h"
 #include "trace_span.h"
 
@@ -18,9 +21,27 @@ namespace tempo_tracing {
     public:
         static std::shared_ptr<TraceRecorder> create();
         static std::shared_ptr<TraceRecorder> create(tempo_utils::TraceId traceId);
+        static std::shared_ptr<TraceRecorder> create(const SamplingPolicy &policy);
+        static std::shared_ptr<TraceRecorder> create(tempo_utils::TraceId traceId, const SamplingPolicy &policy);
+        static std::shared_ptr<TraceRecorder> createStreaming(
+            tempo_utils::TraceId traceId,
+            SpansetFragmentCallback callback,
+            const SpansetStreamOptions &options = {});
+        static std::shared_ptr<TraceRecorder> createStreaming(
+            tempo_utils::TraceId traceId,
+            std::shared_ptr<tempo_utils::FileAppender> appender,
+            const SpansetStreamOptions &options = {});
         ~TraceRecorder();
 
         tempo_utils::TraceId traceId() const;
+        SamplingPolicy getSamplingPolicy() const;
+        bool isSampled() const;
+        bool isStreaming() const;
+
+        std::shared_ptr<SpanLatencyMetrics> getLatencyMetrics() const;
+        void setLatencyMetrics(std::shared_ptr<SpanLatencyMetrics> metrics);
+        bool isPerfCountersEnabled() const;
+        void setPerfCountersEnabled(bool enabled);
 
         std::shared_ptr<TraceSpan> makeSpan(
             FailurePropagation propagation = FailurePropagation::NoPropagation,
@@ -32,17 +53,42 @@ namespace tempo_tracing {
 
         bool isClosed() const;
         void close();
+        tempo_utils::Status flush();
 
         tempo_utils::Result<TempoSpanset> toSpanset() const;
 
     private:
         tempo_utils::TraceId m_id;
-        absl::Mutex *m_lock;
-        std::unique_ptr<SpansetState> m_state ABSL_GUARDED_BY(m_lock);
-        bool m_closed ABSL_GUARDED_BY(m_lock);
+        SamplingPolicy m_policy;
+        bool m_sampled;
+        // the state and stream are internally synchronized, so the recorder does not need a lock
+        std::unique_ptr<SpansetState> m_state;
+        std::unique_ptr<SpansetStream> m_stream;
+        // the metrics are set before any spans are made, so they are not guarded
+        std::shared_ptr<SpanLatencyMetrics> m_metrics;
+        bool m_perfCounters;
+
+        TraceRecorder(
+            tempo_utils::TraceId id,
+            const SamplingPolicy &policy,
+            std::unique_ptr<SpansetStream> stream = {});
+
+        std::shared_ptr<TraceSpan> makeUnsampledSpan(FailurePropagation propagation, FailureCollection collection);
+        std::shared_ptr<TraceSpan> makeStreamedSpan(
+            tu_uint32 parentIndex,
+            const tempo_utils::SpanId &parentId,
+            FailurePropagation propagation,
+            FailureCollection collection);
+        std::shared_ptr<TraceSpan> makeChildSpan(
+            tu_uint32 parentIndex,
+            const tempo_utils::SpanId &parentId,
+            FailurePropagation propagation,
+            FailureCollection collection);
+        void completeStreamedSpan(const SpanData &spanData);
+        void recordSpanLatency(std::string_view operationName, absl::Duration activeDuration, bool failed);
 
-        TraceRecorder();
-        TraceRecorder(tempo_utils::TraceId id);
+        friend class SpanContext;
+        friend class TraceSpan;
     };
 }
 
@@ -1,6 +1,9 @@
 #ifndef TEMPO_TRACING_TRACE_SPAN_H
 #define TEMPO_TRACING_TRACE_SPAN_H
 
+#include <atomic>
+#include <optional>
+
 #include <absl/base/thread_annotations.h>
 #include <fmt/core.h>
 
@@ -8,6 +11,7 @@
 #include <tempo_utils/status.h>
 #include <tempo_utils/tracing.h>
 
+#include "span_context.h"
 #include "spanset_attr_writer.h"
 #include "tracing_result.h"
 #include "tracing_types.h"
@@ -18,6 +22,9 @@ namespace tempo_tracing {
     class ActiveScope;
     class SpanLog;
     class TraceRecorder;
+    namespace internal {
+        struct PerfCounterState;
+    }
 
     /**
      *
@@ -30,6 +37,8 @@ namespace tempo_tracing {
         tempo_utils::TraceId traceId() const;
         tempo_utils::SpanId spanId() const;
         std::shared_ptr<TraceRecorder> traceRecorder() const;
+        bool isSampled() const;
+        SpanContext getContext() const;
 
         std::string getOperationName() const;
         void setOperationName(std::string_view name);
@@ -74,12 +83,40 @@ namespace tempo_tracing {
         void close();
 
     private:
+        enum class SpanStorage {
+            kSpanset,           /**< span data is stored in the spanset state of the recorder. */
+            kStreamed,          /**< span data is owned by the span and streamed when closed. */
+            kUnsampled,         /**< span data is owned by the span and never written. */
+        };
+
         std::shared_ptr<TraceRecorder> m_recorder;
+        SpanStorage m_storage;
+        // lock protecting the span data, or nullptr if the span is unsampled
         absl::Mutex *m_lock;
+        // span data owned by the span if it is not stored in the spanset state, otherwise empty
+        std::optional<SpanData> m_ownedData;
         SpanData& m_data ABSL_GUARDED_BY(m_lock);
         ActiveScope *m_scope ABSL_GUARDED_BY(m_lock);
+        // fast clock reading when the start time was set on activation, or -1 if it was not
+        tu_int64 m_startClockNanos ABSL_GUARDED_BY(m_lock);
+        // counter deltas of the span, only allocated if the recorder has perf counters enabled
+        std::unique_ptr<internal::PerfCounterState> m_perfCounters ABSL_GUARDED_BY(m_lock);
+        // state of an unsampled span, which has no lock
+        std::atomic<bool> m_unsampledFailed;
+        std::atomic<bool> m_unsampledClosed;
+        std::atomic<tu_int64> m_unsampledActiveNanos;
+        std::atomic<tu_int64> m_unsampledDurationNanos;
 
         TraceSpan(std::shared_ptr<TraceRecorder> recorder, SpanData &data);
+        TraceSpan(
+            std::shared_ptr<TraceRecorder> recorder,
+            SpanStorage storage,
+            tu_uint32 spanIndex,
+            tempo_utils::SpanId spanId,
+            tu_uint32 parentIndex,
+            tempo_utils::SpanId parentId,
+            FailurePropagation propagation,
+            FailureCollection collection);
 
         void putTagUnlocked(const tempo_schema::AttrKey &key, const tempo_schema::AttrValue &value);
         LogEntry& appendLogUnlocked(absl::Time ts, LogSeverity severity);
@@ -88,6 +125,9 @@ namespace tempo_tracing {
             const tempo_schema::AttrKey &key,
             const tempo_schema::AttrValue &value);
         void deactivateUnlocked();
+        void deactivateUnsampled();
+        void closeUnsampled(bool failed);
+        void putPerfCounterTagsUnlocked();
         void logStatusAndClose(std::string_view category, int code, LogSeverity severity, std::string_view message);
 
         friend class SpanLog;
@@ -105,6 +145,9 @@ namespace tempo_tracing {
         tempo_utils::Status
         putTag(const tempo_schema::AttrSerde<T> &serde, const T &value)
         {
+            // tags of an unsampled span are discarded, so skip serializing the value
+            if (!isSampled())
+                return {};
             SpansetAttrWriter writer;
             auto result = serde.writeAttr(&writer, value);
             if (result.isStatus())
@@ -18,6 +18,7 @@ namespace tempo_tracing {
         kMissingLog,
         kRecorderNotClosed,
         kTracingInvariant,
+        kInvalidArchive,
     };
 
     class TracingStatus : public tempo_utils::TypedStatus<TracingCondition> {
@@ -106,6 +107,8 @@ namespace tempo_utils {
                     return tempo_utils::StatusCode::kInternal;
                 case tempo_tracing::TracingCondition::kTracingInvariant:
                     return tempo_utils::StatusCode::kInternal;
+                case tempo_tracing::TracingCondition::kInvalidArchive:
+                    return tempo_utils::StatusCode::kInvalidArgument;
                 default:
                     return tempo_utils::StatusCode::kUnknown;
             }
@@ -121,6 +124,8 @@ namespace tempo_utils {
                     return "Recorder is not closed";
                 case tempo_tracing::TracingCondition::kTracingInvariant:
                     return "Tracing invariant";
+                case tempo_tracing::TracingCondition::kInvalidArchive:
+                    return "Invalid spanset archive";
                 default:
                     return "INVALID";
             }
@@ -83,6 +83,11 @@ namespace tempo_tracing {
         FileOffset,
         TextSpan,
         FilePath,
+        PerfCycles,
+        PerfInstructions,
+        PerfCacheMisses,
+        PerfContextSwitches,
+        PerfTaskClock,
         NUM_IDS,
     };
 
@@ -156,6 +161,41 @@ namespace tempo_tracing {
         "FilePath",
         tempo_schema::PropertyType::kString);
 
+    constexpr tempo_schema::SchemaProperty<TempoTracingNs,TempoTracingId>
+    kTempoTracingPerfCyclesProperty(
+        &kTempoTracingNs,
+        TempoTracingId::PerfCycles,
+        "PerfCycles",
+        tempo_schema::PropertyType::kUInt64);
+
+    constexpr tempo_schema::SchemaProperty<TempoTracingNs,TempoTracingId>
+    kTempoTracingPerfInstructionsProperty(
+        &kTempoTracingNs,
+        TempoTracingId::PerfInstructions,
+        "PerfInstructions",
+        tempo_schema::PropertyType::kUInt64);
+
+    constexpr tempo_schema::SchemaProperty<TempoTracingNs,TempoTracingId>
+    kTempoTracingPerfCacheMissesProperty(
+        &kTempoTracingNs,
+        TempoTracingId::PerfCacheMisses,
+        "PerfCacheMisses",
+        tempo_schema::PropertyType::kUInt64);
+
+    constexpr tempo_schema::SchemaProperty<TempoTracingNs,TempoTracingId>
+    kTempoTracingPerfContextSwitchesProperty(
+        &kTempoTracingNs,
+        TempoTracingId::PerfContextSwitches,
+        "PerfContextSwitches",
+        tempo_schema::PropertyType::kUInt64);
+
+    constexpr tempo_schema::SchemaProperty<TempoTracingNs,TempoTracingId>
+    kTempoTracingPerfTaskClockProperty(
+        &kTempoTracingNs,
+        TempoTracingId::PerfTaskClock,
+        "PerfTaskClock",
+        tempo_schema::PropertyType::kUInt64);
+
     constexpr std::array<
         const tempo_schema::SchemaResource<TempoTracingNs,TempoTracingId> *,
         static_cast<std::size_t>(TempoTracingId::NUM_IDS)>
@@ -170,6 +210,11 @@ namespace tempo_tracing {
         &kTempoTracingFileOffsetProperty,
         &kTempoTracingTextSpanProperty,
         &kTempoTracingFilePathProperty,
+        &kTempoTracingPerfCyclesProperty,
+        &kTempoTracingPerfInstructionsProperty,
+        &kTempoTracingPerfCacheMissesProperty,
+        &kTempoTracingPerfContextSwitchesProperty,
+        &kTempoTracingPerfTaskClockProperty,
     };
 
     constexpr tempo_schema::SchemaVocabulary<TempoTracingNs, TempoTracingId>
@@ -185,6 +230,11 @@ namespace tempo_tracing {
     extern const tempo_schema::UInt64Attr kTempoTracingFileOffset;
     extern const tempo_schema::UInt64Attr kTempoTracingTextSpan;
     extern const tempo_schema::StringAttr kTempoTracingFilePath;
+    extern const tempo_schema::UInt64Attr kTempoTracingPerfCycles;
+    extern const tempo_schema::UInt64Attr kTempoTracingPerfInstructions;
+    extern const tempo_schema::UInt64Attr kTempoTracingPerfCacheMisses;
+    extern const tempo_schema::UInt64Attr kTempoTracingPerfContextSwitches;
+    extern const tempo_schema::UInt64Attr kTempoTracingPerfTaskClock;
 }
 
 #endif // TEMPO_TRACING_TRACING_SCHEMA_H
\ No newline at end of file
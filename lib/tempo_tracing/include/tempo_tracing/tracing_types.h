@@ -17,6 +17,7 @@ namespace tempo_tracing {
     enum class SpansetVersion {
         Unknown,
         Version1,
+        Version2,
     };
 
     enum class LogSeverity {
@@ -39,6 +40,18 @@ namespace tempo_tracing {
         AllChildrenFailed,      /**< span is marked failed if all children have propagated failure. */
     };
 
+    /**
+     * Determines which traces are recorded. Head sampling is decided once when the recorder is
+     * created, and spans of an unsampled trace record no tags or logs. Tail sampling is decided
+     * when the spanset is built, after failure propagation has been evaluated, so a trace which
+     * neither failed nor exceeded the latency threshold is discarded before it is serialized.
+     */
+    struct SamplingPolicy {
+        double headSampleRate = 1.0;            /**< probability in [0, 1] that a trace is recorded. */
+        bool tailSampling = false;              /**< keep only traces which failed or were slow. */
+        absl::Duration latencyThreshold = absl::InfiniteDuration();    /**< a trace with a span at least this long is slow. */
+    };
+
     struct LogEntry {
         absl::Time ts;
         LogSeverity severity;
@@ -53,11 +66,10 @@ namespace tempo_tracing {
         const uint32_t parentIndex;
         tempo_utils::SpanId parentId;
         std::string operationName;
-        tu_int64 startTimeMillisSinceEpoch = -1;
-        tu_int64 endTimeMillisSinceEpoch = -1;
+        tu_int64 startTimeNanosSinceEpoch = -1;
+        tu_int64 endTimeNanosSinceEpoch = -1;
         tu_int64 activeTimeNanosSinceEpoch = -1;
         absl::Duration activeDuration;
-        std::vector<uint32_t> children;
         tempo_schema::AttrMap tags;
         std::vector<LogEntry> logs;
         FailurePropagation propagation = FailurePropagation::NoPropagation;
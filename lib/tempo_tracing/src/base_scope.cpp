@@ -15,8 +15,27 @@ get_context(std::string_view contextName, std::shared_ptr<tempo_tracing::TraceCo
     return {};
 }
 
+std::atomic<bool> tempo_tracing::internal::tracingEnabled = true;
+
+/**
+ * Enable or disable tracing scopes at runtime. Scopes which were entered while tracing was
+ * enabled are still exited normally after tracing is disabled. Has no effect if tempo_tracing
+ * is built with TEMPO_TRACING_STRIP.
+ */
+void
+tempo_tracing::set_tracing_enabled(bool enabled)
+{
+    internal::tracingEnabled.store(enabled, std::memory_order_relaxed);
+}
+
 tempo_tracing::BaseScope::BaseScope(std::string_view contextName)
     : m_context(nullptr)
+{
+    attachContext(contextName);
+}
+
+void
+tempo_tracing::BaseScope::attachContext(std::string_view contextName)
 {
     m_status = get_context(contextName, m_context);
 }
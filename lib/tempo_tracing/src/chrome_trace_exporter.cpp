@@ -0,0 +1,433 @@
+
+#include <algorithm>
+
+#include <fmt/format.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include <tempo_tracing/chrome_trace_exporter.h>
+#include <tempo_tracing/internal/spanset_reader.h>
+#include <tempo_utils/bytes_iterator.h>
+#include <tempo_utils/log_stream.h>
+
+using JsonWriter = rapidjson::Writer<rapidjson::StringBuffer>;
+
+// all events are written to a single process, tracks are threads of the process
+constexpr int kChromeTracePid = 1;
+
+// size of the pending events which triggers a write to the appender
+constexpr size_t kPendingFlushSize = 64 * 1024;
+
+/**
+ * Write the epoch nanos as fractional microseconds. The value is formatted from the integer
+ * rather than converted to a double, which cannot represent epoch times with nanosecond precision.
+ */
+static void
+write_micros(JsonWriter &writer, tu_int64 nanos)
+{
+    auto micros = fmt::format("{}.{:03}", nanos / 1000, nanos % 1000);
+    writer.RawValue(micros.data(), micros.size(), rapidjson::kNumberType);
+}
+
+static void
+write_attr_value(JsonWriter &writer, const tts1::AttributeDescriptor *attr)
+{
+    switch (attr->attr_value_type()) {
+        case tts1::Value::TrueFalseNilValue:
+            switch (attr->attr_value_as_TrueFalseNilValue()->tfn()) {
+                case tts1::TrueFalseNil::True:
+                    writer.Bool(true);
+                    return;
+                case tts1::TrueFalseNil::False:
+                    writer.Bool(false);
+                    return;
+                default:
+                    writer.Null();
+                    return;
+            }
+        case tts1::Value::Int64Value:
+            writer.Int64(attr->attr_value_as_Int64Value()->i64());
+            return;
+        case tts1::Value::Float64Value:
+            writer.Double(attr->attr_value_as_Float64Value()->f64());
+            return;
+        case tts1::Value::UInt64Value:
+            writer.Uint64(attr->attr_value_as_UInt64Value()->u64());
+            return;
+        case tts1::Value::UInt32Value:
+            writer.Uint(attr->attr_value_as_UInt32Value()->u32());
+            return;
+        case tts1::Value::UInt16Value:
+            writer.Uint(attr->attr_value_as_UInt16Value()->u16());
+            return;
+        case tts1::Value::UInt8Value:
+            writer.Uint(attr->attr_value_as_UInt8Value()->u8());
+            return;
+        case tts1::Value::StringValue: {
+            auto *utf8 = attr->attr_value_as_StringValue()->utf8();
+            if (utf8) {
+                writer.String(utf8->c_str(), utf8->size());
+            } else {
+                writer.String("");
+            }
+            return;
+        }
+        default:
+            writer.Null();
+            return;
+    }
+}
+
+/**
+ * Write each attribute as a member of the current object. Attributes are named by their
+ * namespace url and type, since the spanset does not record the attribute name.
+ */
+static void
+write_attrs(
+    JsonWriter &writer,
+    const tempo_tracing::internal::SpansetReader &reader,
+    const flatbuffers::Vector<tu_uint32> *attrs)
+{
+    if (attrs == nullptr)
+        return;
+    for (auto attrIndex : *attrs) {
+        auto *attr = reader.getAttribute(attrIndex);
+        if (attr == nullptr)
+            continue;
+        auto *ns = reader.getNamespace(attr->attr_ns());
+        auto nsUrl = ns && ns->ns_url()? ns->ns_url()->string_view() : std::string_view();
+        auto key = fmt::format("{}#{}", nsUrl, attr->attr_type());
+        writer.Key(key.data(), key.size());
+        write_attr_value(writer, attr);
+    }
+}
+
+static const char *
+log_severity_to_name(tts1::LogSeverity severity)
+{
+    switch (severity) {
+        case tts1::LogSeverity::Fatal:
+            return "fatal";
+        case tts1::LogSeverity::Error:
+            return "error";
+        case tts1::LogSeverity::Warn:
+            return "warn";
+        case tts1::LogSeverity::Info:
+            return "info";
+        case tts1::LogSeverity::Verbose:
+            return "verbose";
+        case tts1::LogSeverity::VeryVerbose:
+            return "veryverbose";
+        default:
+            return "unknown";
+    }
+}
+
+static void
+write_metadata_event(JsonWriter &writer, std::string_view name, tu_uint32 tid, std::string_view value)
+{
+    writer.StartObject();
+    writer.Key("name");
+    writer.String(name.data(), name.size());
+    writer.Key("ph");
+    writer.String("M");
+    writer.Key("pid");
+    writer.Int(kChromeTracePid);
+    writer.Key("tid");
+    writer.Uint(tid);
+    writer.Key("args");
+    writer.StartObject();
+    writer.Key("name");
+    writer.String(value.data(), value.size());
+    writer.EndObject();
+    writer.EndObject();
+}
+
+tempo_tracing::ChromeTraceExporter::ChromeTraceExporter(std::shared_ptr<tempo_utils::FileAppender> appender)
+    : m_appender(std::move(appender)),
+      m_numEvents(0),
+      m_finished(false)
+{
+    TU_ASSERT (m_appender != nullptr);
+}
+
+tu_uint32
+tempo_tracing::ChromeTraceExporter::numEvents() const
+{
+    return m_numEvents;
+}
+
+tu_uint32
+tempo_tracing::ChromeTraceExporter::numTracks() const
+{
+    return m_trackEnds.size();
+}
+
+tempo_utils::Status
+tempo_tracing::ChromeTraceExporter::appendEvent(std::string_view event)
+{
+    if (m_finished)
+        return TracingStatus::forCondition(TracingCondition::kTracingInvariant,
+            "chrome trace exporter is finished");
+    m_pending.append(m_numEvents == 0? "{\"traceEvents\":[\n" : ",\n");
+    m_pending.append(event);
+    m_numEvents++;
+    if (m_pending.size() < kPendingFlushSize)
+        return {};
+    return flushPending();
+}
+
+tempo_utils::Status
+tempo_tracing::ChromeTraceExporter::flushPending()
+{
+    auto status = m_appender->appendBytes(std::string_view(m_pending));
+    m_pending.clear();
+    return status;
+}
+
+/**
+ * Write the spans and logs of the spanset. Tracks are assigned by visiting spans in order of
+ * start time: a span is placed on the track of its parent if it nests within the events already
+ * open on that track, otherwise on the first track where it nests, otherwise on a new track.
+ * A track used by previously exported spansets is only reused once all of its events have
+ * ended, so that spans are never nested within spans of another spanset. The state used for
+ * track assignment is proportional to the number of spans in the reader and the number of
+ * tracks, so fragments are exported in constant memory regardless of the size of the trace.
+ */
+tempo_utils::Status
+tempo_tracing::ChromeTraceExporter::exportSpans(const internal::SpansetReader &reader)
+{
+    tu_uint32 numSpans = reader.numSpans();
+
+    // spans in a fragment record only the id of their parent, so the parent is resolved by id
+    // if the parent offset is not present
+    absl::flat_hash_map<tu_uint64,tu_uint32> spanIds;
+    for (tu_uint32 i = 0; i < numSpans; i++) {
+        spanIds[reader.getSpan(i)->span_id()] = i;
+    }
+
+    struct Interval {
+        tu_int64 start;
+        tu_int64 end;
+        tu_uint32 parent;
+        tu_uint32 track = kInvalidAddressU32;
+    };
+    std::vector<Interval> intervals(numSpans);
+    std::vector<tu_uint32> order;
+    for (tu_uint32 i = 0; i < numSpans; i++) {
+        auto *span = reader.getSpan(i);
+        auto &interval = intervals[i];
+        interval.start = internal::get_span_start_nanos(span);
+        interval.end = std::max(internal::get_span_end_nanos(span), interval.start);
+        interval.parent = span->parent();
+        if (interval.parent >= numSpans) {
+            auto entry = spanIds.find(span->parent_id());
+            interval.parent = entry != spanIds.cend()? entry->second : kInvalidAddressU32;
+        }
+        // spans which were never started have no position on the timeline
+        if (interval.start >= 0) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [&](tu_uint32 lhs, tu_uint32 rhs) {
+        if (intervals[lhs].start != intervals[rhs].start)
+            return intervals[lhs].start < intervals[rhs].start;
+        if (intervals[lhs].end != intervals[rhs].end)
+            return intervals[lhs].end > intervals[rhs].end;
+        return lhs < rhs;
+    });
+
+    // each track holds the end times of its open events, innermost last. the end times of the
+    // events of previously exported spansets are only updated once the spanset is written
+    tu_uint32 numPriorTracks = m_trackEnds.size();
+    std::vector<std::vector<tu_int64>> tracks(numPriorTracks);
+    std::vector<tu_int64> trackEnds(m_trackEnds);
+    auto nests = [&](tu_uint32 track, const Interval &interval) -> bool {
+        if (track < numPriorTracks && interval.start < m_trackEnds[track])
+            return false;
+        auto &open = tracks[track];
+        while (!open.empty() && open.back() <= interval.start) {
+            open.pop_back();
+        }
+        return open.empty() || interval.end <= open.back();
+    };
+
+    // spans of different traces may share a track, so each span records its trace
+    auto traceId = fmt::format("{:016x}{:016x}", reader.getTraceId().getHi(), reader.getTraceId().getLo());
+
+    rapidjson::StringBuffer buffer;
+    JsonWriter writer;
+
+    for (auto index : order) {
+        auto &interval = intervals[index];
+        auto track = kInvalidAddressU32;
+        if (interval.parent != kInvalidAddressU32) {
+            auto parentTrack = intervals[interval.parent].track;
+            if (parentTrack != kInvalidAddressU32 && nests(parentTrack, interval)) {
+                track = parentTrack;
+            }
+        }
+        for (tu_uint32 i = 0; track == kInvalidAddressU32 && i < tracks.size(); i++) {
+            if (nests(i, interval)) {
+                track = i;
+            }
+        }
+        if (track == kInvalidAddressU32) {
+            track = tracks.size();
+            tracks.emplace_back();
+            trackEnds.push_back(interval.end);
+        }
+        tracks[track].push_back(interval.end);
+        trackEnds[track] = std::max(trackEnds[track], interval.end);
+        interval.track = track;
+
+        auto *span = reader.getSpan(index);
+        auto operationName = span->operation_name()? span->operation_name()->string_view() : std::string_view();
+
+        buffer.Clear();
+        writer.Reset(buffer);
+        writer.StartObject();
+        writer.Key("name");
+        writer.String(operationName.data(), operationName.size());
+        writer.Key("cat");
+        writer.String("span");
+        writer.Key("ph");
+        writer.String("X");
+        writer.Key("ts");
+        write_micros(writer, interval.start);
+        writer.Key("dur");
+        write_micros(writer, interval.end - interval.start);
+        writer.Key("pid");
+        writer.Int(kChromeTracePid);
+        writer.Key("tid");
+        writer.Uint(track);
+        writer.Key("args");
+        writer.StartObject();
+        writer.Key("trace_id");
+        writer.String(traceId.data(), traceId.size());
+        auto spanId = fmt::format("{:016x}", span->span_id());
+        writer.Key("span_id");
+        writer.String(spanId.data(), spanId.size());
+        if (span->failed()) {
+            writer.Key("failed");
+            writer.Bool(true);
+        }
+        write_attrs(writer, reader, span->span_tags());
+        writer.EndObject();
+        writer.EndObject();
+        TU_RETURN_IF_NOT_OK (appendEvent(std::string_view(buffer.GetString(), buffer.GetSize())));
+
+        if (span->span_logs() == nullptr)
+            continue;
+        for (auto logIndex : *span->span_logs()) {
+            auto *log = reader.getLog(logIndex);
+            if (log == nullptr)
+                continue;
+            buffer.Clear();
+            writer.Reset(buffer);
+            writer.StartObject();
+            writer.Key("name");
+            writer.String(log_severity_to_name(log->log_severity()));
+            writer.Key("cat");
+            writer.String("log");
+            writer.Key("ph");
+            writer.String("i");
+            writer.Key("s");
+            writer.String("t");
+            writer.Key("ts");
+            write_micros(writer, static_cast<tu_int64>(log->log_ts()) * 1000000);
+            writer.Key("pid");
+            writer.Int(kChromeTracePid);
+            writer.Key("tid");
+            writer.Uint(track);
+            writer.Key("args");
+            writer.StartObject();
+            write_attrs(writer, reader, log->log_fields());
+            writer.EndObject();
+            writer.EndObject();
+            TU_RETURN_IF_NOT_OK (appendEvent(std::string_view(buffer.GetString(), buffer.GetSize())));
+        }
+    }
+
+    // name each new track, tracks which are reused keep the name they were given
+    for (tu_uint32 i = numPriorTracks; i < tracks.size(); i++) {
+        auto trackName = fmt::format("context {}", i);
+        buffer.Clear();
+        writer.Reset(buffer);
+        write_metadata_event(writer, "thread_name", i, trackName);
+        TU_RETURN_IF_NOT_OK (appendEvent(std::string_view(buffer.GetString(), buffer.GetSize())));
+    }
+    m_trackEnds = std::move(trackEnds);
+
+    return {};
+}
+
+/**
+ * Write the spans and logs of the spanset.
+ */
+tempo_utils::Status
+tempo_tracing::ChromeTraceExporter::exportSpanset(const TempoSpanset &spanset)
+{
+    if (!spanset.isValid())
+        return TracingStatus::forCondition(TracingCondition::kTracingInvariant,
+            "cannot export invalid spanset");
+    return exportSpans(*spanset.getReader());
+}
+
+/**
+ * Write the spans and logs of a sequence of length-prefixed spanset fragments written by a
+ * SpansetStream. Each fragment is written as soon as it is read, so only one fragment is held
+ * in memory at a time. Tracks are assigned within each fragment, and a track is reused by later
+ * fragments once the events of earlier fragments on the track have ended.
+ *
+ * @param bytes The concatenated fragments.
+ * @return Ok status if all fragments were written.
+ */
+tempo_utils::Status
+tempo_tracing::ChromeTraceExporter::exportFragments(std::span<const tu_uint8> bytes)
+{
+    tempo_utils::BytesIterator it(bytes);
+    while (it.bytesLeft() > 0) {
+        tu_uint32 size;
+        std::span<const tu_uint8> fragment;
+        if (!it.nextU32LE(size) || !it.nextSlice(fragment, size))
+            return TracingStatus::forCondition(TracingCondition::kTracingInvariant,
+                "truncated spanset fragment");
+        if (!TempoSpanset::verify(fragment))
+            return TracingStatus::forCondition(TracingCondition::kTracingInvariant,
+                "invalid spanset fragment");
+        internal::SpansetReader reader(fragment);
+        TU_RETURN_IF_NOT_OK (exportSpans(reader));
+    }
+    return {};
+}
+
+/**
+ * Terminate the JSON document and finish the appender. The exporter must not be used after
+ * calling this method.
+ */
+tempo_utils::Status
+tempo_tracing::ChromeTraceExporter::finish()
+{
+    if (m_finished)
+        return TracingStatus::forCondition(TracingCondition::kTracingInvariant,
+            "chrome trace exporter is finished");
+    m_pending.append(m_numEvents == 0? "{\"traceEvents\":[\n" : "\n");
+    m_pending.append("],\"displayTimeUnit\":\"ns\"}\n");
+    m_finished = true;
+    TU_RETURN_IF_NOT_OK (flushPending());
+    return m_appender->finish();
+}
+
+/**
+ * Returns a fragment callback which exports each fragment as Chrome trace events, so a
+ * streaming recorder can write a trace-event file directly.
+ */
+tempo_tracing::SpansetFragmentCallback
+tempo_tracing::export_chrome_trace_fragments(std::shared_ptr<ChromeTraceExporter> exporter)
+{
+    TU_ASSERT (exporter != nullptr);
+    return [exporter](std::span<const tu_uint8> fragment) -> tempo_utils::Status {
+        return exporter->exportFragments(fragment);
+    };
+}
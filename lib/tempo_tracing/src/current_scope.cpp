@@ -2,9 +2,10 @@
 #include <tempo_tracing/current_scope.h>
 #include <tempo_tracing/trace_context.h>
 
-tempo_tracing::CurrentScope::CurrentScope(std::string_view contextName)
-    : BaseScope(contextName)
+void
+tempo_tracing::CurrentScope::enterScope(std::string_view contextName)
 {
+    attachContext(contextName);
     if (m_context != nullptr) {
         m_context->activate();
         m_span = m_context->peekSpan();
@@ -14,10 +15,9 @@ tempo_tracing::CurrentScope::CurrentScope(std::string_view contextName)
     }
 }
 
-tempo_tracing::CurrentScope::~CurrentScope()
+void
+tempo_tracing::CurrentScope::exitScope()
 {
-    if (m_span == nullptr)
-        return;
     if (!checkCurrentContext())
         return;
     auto top = m_context->peekSpan();
@@ -2,13 +2,14 @@
 #include <tempo_tracing/enter_scope.h>
 #include <tempo_tracing/trace_context.h>
 
-tempo_tracing::EnterScope::EnterScope(
+void
+tempo_tracing::EnterScope::enterScope(
     std::string_view operationName,
     std::string_view contextName,
     FailurePropagation propagation,
     FailureCollection collection)
-    : BaseScope(contextName)
 {
+    attachContext(contextName);
     if (m_context != nullptr) {
         m_context->activate();
         m_span = m_context->pushSpan(propagation, collection);
@@ -17,10 +18,9 @@ tempo_tracing::EnterScope::EnterScope(
     }
 }
 
-tempo_tracing::EnterScope::~EnterScope()
+void
+tempo_tracing::EnterScope::exitScope()
 {
-    if (m_span == nullptr)
-        return;
     if (!checkCurrentContext())
         return;
     auto top = m_context->peekSpan();
@@ -2,9 +2,10 @@
 #include <tempo_tracing/exit_scope.h>
 #include <tempo_tracing/trace_context.h>
 
-tempo_tracing::ExitScope::ExitScope(std::string_view contextName)
-    : BaseScope(contextName)
+void
+tempo_tracing::ExitScope::enterScope(std::string_view contextName)
 {
+    attachContext(contextName);
     if (m_context != nullptr) {
         m_context->activate();
         m_span = m_context->peekSpan();
@@ -14,10 +15,9 @@ tempo_tracing::ExitScope::ExitScope(std::string_view contextName)
     }
 }
 
-tempo_tracing::ExitScope::~ExitScope()
+void
+tempo_tracing::ExitScope::exitScope()
 {
-    if (m_span == nullptr)
-        return;
     if (!checkCurrentContext())
         return;
     auto top = m_context->peekSpan();
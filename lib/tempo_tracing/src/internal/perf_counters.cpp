@@ -0,0 +1,195 @@
+
+#include <tempo_tracing/internal/perf_counters.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define TEMPO_TRACING_HAS_PERF_EVENTS 1
+#endif
+
+#ifdef TEMPO_TRACING_HAS_PERF_EVENTS
+
+namespace {
+
+    struct CounterConfig {
+        tempo_tracing::internal::PerfCounter counter;
+        tu_uint32 type;
+        tu_uint64 config;
+        bool excludeKernel;
+    };
+
+    constexpr CounterConfig kCounterConfigs[] = {
+        {tempo_tracing::internal::PerfCounter::kCycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, true},
+        {tempo_tracing::internal::PerfCounter::kInstructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, true},
+        {tempo_tracing::internal::PerfCounter::kCacheMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, true},
+        // context switches happen in the kernel, so the counter reads zero if the kernel is excluded
+        {tempo_tracing::internal::PerfCounter::kContextSwitches, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, false},
+        {tempo_tracing::internal::PerfCounter::kTaskClockNanos, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, true},
+    };
+
+    /**
+     * The performance counters of a single thread. The counters which can be opened are placed
+     * in one group, so all of them are read with a single read syscall. If the kernel schedules
+     * the group for only part of the time it is enabled, because more counters are in use than
+     * the processor has, the counter values are scaled up to estimate the full count. If no
+     * counter can be opened, for example because perf_event_paranoid forbids it or the process
+     * runs under a seccomp filter, the context switches and cpu time of the thread are read from
+     * getrusage. The context switch counter must count kernel events, which an unprivileged
+     * process may not be allowed to do, so if only that counter fails to open then the context
+     * switches are read from getrusage as well.
+     */
+    class ThreadPerfCounters {
+
+    public:
+        ThreadPerfCounters()
+            : m_leaderFd(-1),
+              m_numOpened(0),
+              m_rusageContextSwitches(false)
+        {
+            for (const auto &config : kCounterConfigs) {
+                perf_event_attr attr{};
+                attr.size = sizeof(attr);
+                attr.type = config.type;
+                attr.config = config.config;
+                attr.disabled = m_leaderFd < 0? 1 : 0;
+                attr.exclude_kernel = config.excludeKernel? 1 : 0;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_GROUP
+                    | PERF_FORMAT_TOTAL_TIME_ENABLED
+                    | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                auto fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, m_leaderFd, 0));
+                if (fd < 0) {
+                    if (config.counter == tempo_tracing::internal::PerfCounter::kContextSwitches) {
+                        m_rusageContextSwitches = true;
+                    }
+                    continue;
+                }
+                if (m_leaderFd < 0) {
+                    m_leaderFd = fd;
+                }
+                m_fds[m_numOpened] = fd;
+                m_counters[m_numOpened] = config.counter;
+                m_numOpened++;
+            }
+            if (m_leaderFd >= 0) {
+                ioctl(m_leaderFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            }
+        }
+
+        ~ThreadPerfCounters()
+        {
+            for (int i = 0; i < m_numOpened; i++) {
+                close(m_fds[i]);
+            }
+        }
+
+        bool read(tempo_tracing::internal::PerfCounterSample &sample) const
+        {
+            sample.source = this;
+            sample.validMask = 0;
+            if (m_leaderFd < 0)
+                return readRusage(sample, true);
+            if (!readGroup(sample))
+                return false;
+            if (m_rusageContextSwitches) {
+                readRusage(sample, false);
+            }
+            return true;
+        }
+
+    private:
+        int m_leaderFd;
+        int m_numOpened;
+        int m_fds[tempo_tracing::internal::kNumPerfCounters];
+        tempo_tracing::internal::PerfCounter m_counters[tempo_tracing::internal::kNumPerfCounters];
+        bool m_rusageContextSwitches;
+
+        bool readGroup(tempo_tracing::internal::PerfCounterSample &sample) const
+        {
+            // the group read format is the number of counters, the time the group was enabled,
+            // the time the group was running, and then each counter value in the order the
+            // counters were added to the group
+            tu_uint64 buf[3 + tempo_tracing::internal::kNumPerfCounters];
+            auto size = ::read(m_leaderFd, buf, sizeof(buf));
+            if (size < static_cast<ssize_t>(3 * sizeof(tu_uint64)) || buf[0] != static_cast<tu_uint64>(m_numOpened))
+                return false;
+            auto timeEnabled = buf[1];
+            auto timeRunning = buf[2];
+            // if the group has never been scheduled then there is nothing to scale
+            if (timeRunning == 0)
+                return false;
+            for (int i = 0; i < m_numOpened; i++) {
+                auto index = static_cast<int>(m_counters[i]);
+                auto value = buf[3 + i];
+                if (timeRunning < timeEnabled) {
+                    value = static_cast<tu_uint64>(
+                        static_cast<unsigned __int128>(value) * timeEnabled / timeRunning);
+                }
+                sample.values[index] = value;
+                sample.validMask |= 1u << index;
+            }
+            return true;
+        }
+
+        static bool readRusage(tempo_tracing::internal::PerfCounterSample &sample, bool readTaskClock)
+        {
+            rusage usage{};
+            if (getrusage(RUSAGE_THREAD, &usage) != 0)
+                return false;
+            auto contextSwitches = static_cast<int>(tempo_tracing::internal::PerfCounter::kContextSwitches);
+            sample.values[contextSwitches] = usage.ru_nvcsw + usage.ru_nivcsw;
+            sample.validMask |= 1u << contextSwitches;
+            if (!readTaskClock)
+                return true;
+            auto taskClock = static_cast<int>(tempo_tracing::internal::PerfCounter::kTaskClockNanos);
+            sample.values[taskClock] =
+                (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ull
+                + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ull;
+            sample.validMask |= 1u << taskClock;
+            return true;
+        }
+    };
+}
+
+#endif // TEMPO_TRACING_HAS_PERF_EVENTS
+
+/**
+ * Read the performance counters of the calling thread. The counters are opened the first time
+ * a thread reads them, and remain open until the thread exits.
+ *
+ * @param sample The sample to fill.
+ * @return true if any counter was read, otherwise false.
+ */
+bool
+tempo_tracing::internal::read_thread_perf_counters(PerfCounterSample &sample)
+{
+#ifdef TEMPO_TRACING_HAS_PERF_EVENTS
+    thread_local ThreadPerfCounters threadCounters;
+    return threadCounters.read(sample);
+#else
+    sample = {};
+    return false;
+#endif
+}
+
+/**
+ * Add the difference between the start sample and the end sample to the totals. If the samples
+ * were read on different threads then the interval is dropped, since the counters of different
+ * threads cannot be subtracted.
+ */
+void
+tempo_tracing::internal::PerfCounterState::accumulate(const PerfCounterSample &end)
+{
+    if (start.source == nullptr || start.source != end.source)
+        return;
+    auto mask = start.validMask & end.validMask;
+    for (int i = 0; i < kNumPerfCounters; i++) {
+        if ((mask & (1u << i)) && end.values[i] >= start.values[i]) {
+            totals[i] += end.values[i] - start.values[i];
+        }
+    }
+    validMask |= mask;
+}
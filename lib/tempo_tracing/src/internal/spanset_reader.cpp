@@ -9,6 +9,16 @@ tempo_tracing::internal::SpansetReader::SpansetReader(std::span<const tu_uint8>
     : m_bytes(bytes)
 {
     m_spanset = tts1::GetSpanset(m_bytes.data());
+    // index the namespaces by url, so tags can be looked up by namespace offset
+    if (m_spanset != nullptr && m_spanset->namespaces() != nullptr) {
+        auto *namespaces = m_spanset->namespaces();
+        for (uint32_t i = 0; i < namespaces->size(); i++) {
+            auto *nsUrl = namespaces->Get(i)->ns_url();
+            if (nsUrl != nullptr) {
+                m_namespaceIndex.try_emplace(nsUrl->string_view(), i);
+            }
+        }
+    }
 }
 
 bool
@@ -54,6 +64,19 @@ tempo_tracing::internal::SpansetReader::numNamespaces() const
     return m_spanset->namespaces()? m_spanset->namespaces()->size() : 0;
 }
 
+/**
+ * Return the offset of the namespace with the specified url, or INVALID_ADDRESS_U32 if the
+ * spanset does not contain the namespace.
+ */
+uint32_t
+tempo_tracing::internal::SpansetReader::findNamespace(std::string_view nsUrl) const
+{
+    auto entry = m_namespaceIndex.find(nsUrl);
+    if (entry == m_namespaceIndex.cend())
+        return tempo_tracing::kInvalidAddressU32;
+    return entry->second;
+}
+
 const tts1::AttributeDescriptor *
 tempo_tracing::internal::SpansetReader::getAttribute(uint32_t index) const
 {
@@ -162,3 +185,33 @@ tempo_tracing::internal::SpansetReader::dumpJson() const
     TU_ASSERT (err == nullptr);
     return jsonData;
 }
+
+static tu_int64
+span_time_nanos(tu_int64 nanos, tu_int64 millis)
+{
+    if (nanos != 0)
+        return nanos;
+    if (millis < 0)
+        return -1;
+    return millis * 1000000;
+}
+
+/**
+ * Return the start time of the span in epoch nanos, or -1 if the start time was never set. The
+ * nanosecond field is preferred, falling back to the millisecond field for spansets which were
+ * written before the nanosecond field was added.
+ */
+tu_int64
+tempo_tracing::internal::get_span_start_nanos(const tts1::SpanDescriptor *span)
+{
+    return span_time_nanos(span->span_start_ns(), span->span_start());
+}
+
+/**
+ * Return the end time of the span in epoch nanos, or -1 if the end time was never set.
+ */
+tu_int64
+tempo_tracing::internal::get_span_end_nanos(const tts1::SpanDescriptor *span)
+{
+    return span_time_nanos(span->span_end_ns(), span->span_end());
+}
@@ -0,0 +1,380 @@
+
+#include <algorithm>
+
+#include <tempo_tracing/internal/spanset_reader.h>
+#include <tempo_tracing/internal/spanset_writer.h>
+#include <tempo_utils/log_stream.h>
+#include <tempo_utils/memory_bytes.h>
+
+tempo_tracing::internal::SpansetWriter::SpansetWriter(tempo_utils::TraceId traceId)
+    : m_traceId(traceId)
+{
+}
+
+tu_uint32
+tempo_tracing::internal::SpansetWriter::numSpans() const
+{
+    return m_spans.size();
+}
+
+static std::pair<tts1::Value,flatbuffers::Offset<void>>
+serialize_value(flatbuffers::FlatBufferBuilder &buffer, const tempo_schema::AttrValue &value)
+{
+    switch (value.getType()) {
+        case tempo_schema::ValueType::Nil: {
+            auto type = tts1::Value::TrueFalseNilValue;
+            auto offset = tts1::CreateTrueFalseNilValue(buffer, tts1::TrueFalseNil::Nil).Union();
+            return {type, offset};
+        }
+        case tempo_schema::ValueType::Bool: {
+            auto type = tts1::Value::TrueFalseNilValue;
+            auto tfn = value.getBool()? tts1::TrueFalseNil::True : tts1::TrueFalseNil::False;
+            auto offset = tts1::CreateTrueFalseNilValue(buffer, tfn).Union();
+            return {type, offset};
+        }
+        case tempo_schema::ValueType::Int64: {
+            auto type = tts1::Value::Int64Value;
+            auto offset = tts1::CreateInt64Value(buffer, value.getInt64()).Union();
+            return {type, offset};
+        }
+        case tempo_schema::ValueType::Float64: {
+            auto type = tts1::Value::Float64Value;
+            auto offset = tts1::CreateFloat64Value(buffer, value.getFloat64()).Union();
+            return {type, offset};
+        }
+        case tempo_schema::ValueType::UInt64: {
+            auto type = tts1::Value::UInt64Value;
+            auto offset = tts1::CreateUInt64Value(buffer, value.getUInt64()).Union();
+            return {type, offset};
+        }
+        case tempo_schema::ValueType::UInt32: {
+            auto type = tts1::Value::UInt32Value;
+            auto offset = tts1::CreateUInt32Value(buffer, value.getUInt32()).Union();
+            return {type, offset};
+        }
+        case tempo_schema::ValueType::UInt16: {
+            auto type = tts1::Value::UInt16Value;
+            auto offset = tts1::CreateUInt16Value(buffer, value.getUInt16()).Union();
+            return {type, offset};
+        }
+        case tempo_schema::ValueType::UInt8: {
+            auto type = tts1::Value::UInt8Value;
+            auto offset = tts1::CreateUInt8Value(buffer, value.getUInt8()).Union();
+            return {type, offset};
+        }
+        case tempo_schema::ValueType::String: {
+            auto type = tts1::Value::StringValue;
+            auto offset = tts1::CreateStringValue(buffer, buffer.CreateSharedString(value.stringView())).Union();
+            return {type, offset};
+        }
+        default:
+            TU_UNREACHABLE();
+    }
+}
+
+static std::pair<tts1::Value,flatbuffers::Offset<void>>
+copy_value(flatbuffers::FlatBufferBuilder &buffer, const tts1::AttributeDescriptor *attr)
+{
+    auto type = attr->attr_value_type();
+    switch (type) {
+        case tts1::Value::TrueFalseNilValue:
+            return {type, tts1::CreateTrueFalseNilValue(buffer,
+                attr->attr_value_as_TrueFalseNilValue()->tfn()).Union()};
+        case tts1::Value::Int64Value:
+            return {type, tts1::CreateInt64Value(buffer,
+                attr->attr_value_as_Int64Value()->i64()).Union()};
+        case tts1::Value::Float64Value:
+            return {type, tts1::CreateFloat64Value(buffer,
+                attr->attr_value_as_Float64Value()->f64()).Union()};
+        case tts1::Value::UInt64Value:
+            return {type, tts1::CreateUInt64Value(buffer,
+                attr->attr_value_as_UInt64Value()->u64()).Union()};
+        case tts1::Value::UInt32Value:
+            return {type, tts1::CreateUInt32Value(buffer,
+                attr->attr_value_as_UInt32Value()->u32()).Union()};
+        case tts1::Value::UInt16Value:
+            return {type, tts1::CreateUInt16Value(buffer,
+                attr->attr_value_as_UInt16Value()->u16()).Union()};
+        case tts1::Value::UInt8Value:
+            return {type, tts1::CreateUInt8Value(buffer,
+                attr->attr_value_as_UInt8Value()->u8()).Union()};
+        case tts1::Value::StringValue: {
+            auto *utf8 = attr->attr_value_as_StringValue()->utf8();
+            auto str = utf8? utf8->string_view() : std::string_view();
+            return {type, tts1::CreateStringValue(buffer, buffer.CreateSharedString(str)).Union()};
+        }
+        default:
+            return {tts1::Value::NONE, flatbuffers::Offset<void>()};
+    }
+}
+
+static tts1::LogSeverity
+serialize_severity(tempo_tracing::LogSeverity severity)
+{
+    switch (severity) {
+        case tempo_tracing::LogSeverity::kFatal:
+            return tts1::LogSeverity::Fatal;
+        case tempo_tracing::LogSeverity::kError:
+            return tts1::LogSeverity::Error;
+        case tempo_tracing::LogSeverity::kWarn:
+            return tts1::LogSeverity::Warn;
+        case tempo_tracing::LogSeverity::kInfo:
+            return tts1::LogSeverity::Info;
+        case tempo_tracing::LogSeverity::kVerbose:
+            return tts1::LogSeverity::Verbose;
+        case tempo_tracing::LogSeverity::kVeryVerbose:
+            return tts1::LogSeverity::VeryVerbose;
+        default:
+            TU_UNREACHABLE();
+    }
+}
+
+/**
+ * Convert a timestamp in epoch nanos to epoch millis, preserving -1 for an unset timestamp.
+ */
+static tu_int64
+nanos_to_millis(tu_int64 nanos)
+{
+    return nanos < 0? -1 : nanos / 1000000;
+}
+
+tu_uint32
+tempo_tracing::internal::SpansetWriter::putNamespace(std::string_view nsUrl)
+{
+    auto entry = m_nscache.find(nsUrl);
+    if (entry != m_nscache.cend())
+        return entry->second;
+    tu_uint32 ns = m_namespaces.size();
+    m_namespaces.push_back(tts1::CreateNamespaceDescriptor(m_buffer, m_buffer.CreateString(nsUrl)));
+    m_nscache[nsUrl] = ns;
+    return ns;
+}
+
+tu_uint32
+tempo_tracing::internal::SpansetWriter::appendAttr(
+    const tempo_schema::AttrKey &key,
+    const tempo_schema::AttrValue &value)
+{
+    tu_uint32 index = m_attrs.size();
+    auto ns = putNamespace(key.ns);
+    auto p = serialize_value(m_buffer, value);
+    m_attrs.push_back(tts1::CreateAttributeDescriptor(m_buffer, ns, key.id, p.first, p.second));
+    m_attrKeys.emplace_back(ns, key.id, index);
+    return index;
+}
+
+tu_uint32
+tempo_tracing::internal::SpansetWriter::copyAttr(const SpansetReader &reader, tu_uint32 index)
+{
+    auto *attr = reader.getAttribute(index);
+    TU_NOTNULL (attr);
+    auto *nsDescriptor = reader.getNamespace(attr->attr_ns());
+    TU_NOTNULL (nsDescriptor);
+    auto ns = putNamespace(nsDescriptor->ns_url()->string_view());
+    auto p = copy_value(m_buffer, attr);
+    tu_uint32 attrIndex = m_attrs.size();
+    m_attrs.push_back(tts1::CreateAttributeDescriptor(m_buffer, ns, attr->attr_type(), p.first, p.second));
+    m_attrKeys.emplace_back(ns, attr->attr_type(), attrIndex);
+    return attrIndex;
+}
+
+tu_uint32
+tempo_tracing::internal::SpansetWriter::appendSpanDescriptor(
+    tu_uint64 spanId,
+    std::string_view operationName,
+    tu_uint32 parentIndex,
+    tu_uint64 parentId,
+    bool root,
+    std::span<const tu_uint32> children,
+    bool failed,
+    tu_int64 startTime,
+    tu_int64 endTime,
+    tu_int64 startTimeNanos,
+    tu_int64 endTimeNanos,
+    tu_int64 duration,
+    const std::vector<tu_uint32> &tags,
+    const std::vector<tu_uint32> &logs)
+{
+    tu_uint32 spanIndex = m_spans.size();
+
+    if (root) {
+        m_roots.push_back(spanIndex);
+    }
+    // if span is marked failed, then add the index to the errors vector
+    if (failed) {
+        m_errors.push_back(spanIndex);
+    }
+
+    // build the tag index, which lets readers find a tag by binary search instead of
+    // comparing the namespace url of every tag
+    std::vector<tts1::TagKey> tagKeys;
+    tagKeys.reserve(tags.size());
+    for (auto tag : tags) {
+        tagKeys.push_back(m_attrKeys.at(tag));
+    }
+    std::sort(tagKeys.begin(), tagKeys.end(), [](const tts1::TagKey &lhs, const tts1::TagKey &rhs) {
+        return std::pair(lhs.tag_ns(), lhs.tag_type()) < std::pair(rhs.tag_ns(), rhs.tag_type());
+    });
+
+    m_spans.push_back(tts1::CreateSpanDescriptor(m_buffer,
+        spanId,
+        m_buffer.CreateSharedString(operationName),
+        parentIndex,
+        parentId,
+        m_buffer.CreateVector(children.data(), children.size()),
+        failed,
+        startTime,
+        endTime,
+        duration,
+        m_buffer.CreateVector(tags),
+        m_buffer.CreateVector(logs),
+        startTimeNanos,
+        endTimeNanos,
+        m_buffer.CreateVectorOfStructs(tagKeys)));
+
+    return spanIndex;
+}
+
+/**
+ * Serialize the span data and append it to the spanset.
+ *
+ * @param spanData The span data.
+ * @param parentIndex The index of the parent span in this spanset, or kInvalidAddressU32 if the
+ *   span is a root or the parent is not in this spanset.
+ * @param children The indexes of the children of the span in this spanset.
+ * @param failed true if the span failed, including failure propagated from its children.
+ * @return The index of the span in this spanset.
+ */
+tu_uint32
+tempo_tracing::internal::SpansetWriter::appendSpan(
+    const SpanData &spanData,
+    tu_uint32 parentIndex,
+    std::span<const tu_uint32> children,
+    bool failed)
+{
+    std::vector<tu_uint32> tags;
+    for (const auto &tag : spanData.tags) {
+        tags.push_back(appendAttr(tag.first, tag.second));
+    }
+
+    std::vector<tu_uint32> logs;
+    for (const auto &log : spanData.logs) {
+        std::vector<tu_uint32> fields;
+        for (const auto &field : log.fields) {
+            fields.push_back(appendAttr(field.first, field.second));
+        }
+        tu_uint64 log_ts = ToUnixMillis(log.ts);
+        auto log_fields = m_buffer.CreateVector(fields);
+        logs.push_back(m_logs.size());
+        m_logs.push_back(tts1::CreateLogDescriptor(m_buffer, log_ts, serialize_severity(log.severity), log_fields));
+    }
+
+    tu_uint64 parentId = 0;
+    if (spanData.parentId.isValid()) {
+        parentId = spanData.parentId.getId();
+    } else {
+        parentIndex = kInvalidAddressU32;
+    }
+
+    // span times are recorded in nanoseconds, but are also written in millis so the spanset can
+    // be read by consumers which predate the nanosecond fields
+    auto startTime = spanData.startTimeNanosSinceEpoch;
+    auto endTime = spanData.endTimeNanosSinceEpoch;
+
+    return appendSpanDescriptor(spanData.spanId.getId(), spanData.operationName, parentIndex, parentId,
+        parentId == 0, children, failed, nanos_to_millis(startTime), nanos_to_millis(endTime),
+        std::max<tu_int64>(startTime, 0), std::max<tu_int64>(endTime, 0),
+        absl::ToInt64Nanoseconds(spanData.activeDuration), tags, logs);
+}
+
+/**
+ * Copy a span from another spanset. The tags and logs of the span are copied, but the parent
+ * and children are replaced by the specified indexes in this spanset. A span without a parent
+ * in this spanset is recorded as a root, even if it has a parent span id, so that the subtree
+ * of a span whose parent was lost is still reachable from the roots.
+ *
+ * @param reader The reader of the source spanset.
+ * @param span The span descriptor in the source spanset.
+ * @param parentIndex The index of the parent span in this spanset, or kInvalidAddressU32 if the
+ *   span is a root or the parent is not in this spanset.
+ * @param children The indexes of the children of the span in this spanset.
+ * @return The index of the span in this spanset.
+ */
+tu_uint32
+tempo_tracing::internal::SpansetWriter::appendSpan(
+    const SpansetReader &reader,
+    const tts1::SpanDescriptor *span,
+    tu_uint32 parentIndex,
+    std::span<const tu_uint32> children)
+{
+    TU_NOTNULL (span);
+
+    std::vector<tu_uint32> tags;
+    if (span->span_tags()) {
+        for (auto index : *span->span_tags()) {
+            tags.push_back(copyAttr(reader, index));
+        }
+    }
+
+    std::vector<tu_uint32> logs;
+    if (span->span_logs()) {
+        for (auto index : *span->span_logs()) {
+            auto *log = reader.getLog(index);
+            TU_NOTNULL (log);
+            std::vector<tu_uint32> fields;
+            if (log->log_fields()) {
+                for (auto fieldIndex : *log->log_fields()) {
+                    fields.push_back(copyAttr(reader, fieldIndex));
+                }
+            }
+            auto log_fields = m_buffer.CreateVector(fields);
+            logs.push_back(m_logs.size());
+            m_logs.push_back(tts1::CreateLogDescriptor(m_buffer, log->log_ts(), log->log_severity(), log_fields));
+        }
+    }
+
+    auto operationName = span->operation_name()? span->operation_name()->string_view() : std::string_view();
+    if (span->parent_id() == 0) {
+        parentIndex = kInvalidAddressU32;
+    }
+
+    return appendSpanDescriptor(span->span_id(), operationName, parentIndex, span->parent_id(),
+        parentIndex == kInvalidAddressU32, children, span->failed(), span->span_start(), span->span_end(),
+        span->span_start_ns(), span->span_end_ns(), span->span_duration(), tags, logs);
+}
+
+/**
+ * Finish building the spanset. The writer must not be used after calling this method.
+ *
+ * @return The serialized spanset.
+ */
+std::shared_ptr<const tempo_utils::ImmutableBytes>
+tempo_tracing::internal::SpansetWriter::finish()
+{
+    auto fb_namespaces = m_buffer.CreateVector(m_namespaces);
+    auto fb_spans = m_buffer.CreateVector(m_spans);
+    auto fb_attrs = m_buffer.CreateVector(m_attrs);
+    auto fb_logs = m_buffer.CreateVector(m_logs);
+    auto fb_roots = m_buffer.CreateVector(m_roots);
+    auto fb_errors = m_buffer.CreateVector(m_errors);
+
+    // build spanset from buffer
+    tts1::SpansetBuilder spansetBuilder(m_buffer);
+
+    spansetBuilder.add_abi(tts1::SpansetVersion::Version2);
+    spansetBuilder.add_trace_id_hi(m_traceId.getHi());
+    spansetBuilder.add_trace_id_lo(m_traceId.getLo());
+    spansetBuilder.add_namespaces(fb_namespaces);
+    spansetBuilder.add_spans(fb_spans);
+    spansetBuilder.add_attrs(fb_attrs);
+    spansetBuilder.add_logs(fb_logs);
+    spansetBuilder.add_roots(fb_roots);
+    spansetBuilder.add_errors(fb_errors);
+
+    // serialize spanset and mark the buffer as finished
+    auto spanset = spansetBuilder.Finish();
+    m_buffer.Finish(spanset, tts1::SpansetIdentifier());
+
+    // copy the flatbuffer into our own byte array
+    return tempo_utils::MemoryBytes::copy(m_buffer.GetBufferSpan());
+}
@@ -0,0 +1,61 @@
+
+#include <tempo_tracing/span_arena.h>
+#include <tempo_utils/log_stream.h>
+
+tempo_tracing::SpanArena::SpanArena(tu_uint32 chunkSize)
+    : m_chunkSize(chunkSize),
+      m_size(0)
+{
+    TU_ASSERT (m_chunkSize > 0);
+}
+
+tempo_tracing::SpanArena::~SpanArena()
+{
+    std::allocator<SpanData> allocator;
+    for (auto &chunk : m_chunks) {
+        std::destroy_n(chunk.spans, chunk.size);
+        allocator.deallocate(chunk.spans, m_chunkSize);
+    }
+}
+
+/**
+ * Construct a span at the end of the arena, allocating a new chunk if the last chunk is full.
+ *
+ * @return A reference to the span, which remains valid for the lifetime of the arena.
+ */
+tempo_tracing::SpanData&
+tempo_tracing::SpanArena::append(
+    tu_uint32 spanIndex,
+    tempo_utils::SpanId spanId,
+    tu_uint32 parentIndex,
+    tempo_utils::SpanId parentId)
+{
+    if (m_chunks.empty() || m_chunks.back().size == m_chunkSize) {
+        std::allocator<SpanData> allocator;
+        m_chunks.push_back({allocator.allocate(m_chunkSize), 0});
+    }
+    auto &chunk = m_chunks.back();
+    auto *data = std::construct_at(chunk.spans + chunk.size, spanIndex, spanId, parentIndex, parentId);
+    chunk.size++;
+    m_size++;
+    return *data;
+}
+
+tu_uint32
+tempo_tracing::SpanArena::size() const
+{
+    return m_size;
+}
+
+int
+tempo_tracing::SpanArena::numChunks() const
+{
+    return m_chunks.size();
+}
+
+std::span<const tempo_tracing::SpanData>
+tempo_tracing::SpanArena::getChunk(int index) const
+{
+    const auto &chunk = m_chunks.at(index);
+    return std::span<const SpanData>(chunk.spans, chunk.size);
+}
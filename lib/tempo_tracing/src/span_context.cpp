@@ -0,0 +1,63 @@
+
+#include <tempo_tracing/span_context.h>
+#include <tempo_tracing/trace_recorder.h>
+#include <tempo_tracing/trace_span.h>
+
+tempo_tracing::SpanContext::SpanContext()
+    : m_spanIndex(kInvalidAddressU32)
+{
+}
+
+tempo_tracing::SpanContext::SpanContext(
+    std::shared_ptr<TraceRecorder> recorder,
+    tu_uint32 spanIndex,
+    const tempo_utils::SpanId &spanId)
+    : m_recorder(std::move(recorder)),
+      m_spanIndex(spanIndex),
+      m_spanId(spanId)
+{
+    TU_ASSERT (m_recorder != nullptr);
+}
+
+bool
+tempo_tracing::SpanContext::isValid() const
+{
+    return m_recorder != nullptr;
+}
+
+tempo_utils::TraceId
+tempo_tracing::SpanContext::getTraceId() const
+{
+    if (m_recorder == nullptr)
+        return {};
+    return m_recorder->traceId();
+}
+
+tempo_utils::SpanId
+tempo_tracing::SpanContext::getSpanId() const
+{
+    return m_spanId;
+}
+
+std::shared_ptr<tempo_tracing::TraceRecorder>
+tempo_tracing::SpanContext::getRecorder() const
+{
+    return m_recorder;
+}
+
+/**
+ * Make a child span of the span referenced by the context. The child span is appended to the
+ * recorder from the calling thread, so the caller does not need to be on the thread which made
+ * the parent span.
+ *
+ * @param propagation The failure propagation of the child span.
+ * @param collection The failure collection of the child span.
+ * @return The child span, or nullptr if the context is invalid or the recorder is closed.
+ */
+std::shared_ptr<tempo_tracing::TraceSpan>
+tempo_tracing::SpanContext::makeSpan(FailurePropagation propagation, FailureCollection collection) const
+{
+    if (m_recorder == nullptr)
+        return {};
+    return m_recorder->makeChildSpan(m_spanIndex, m_spanId, propagation, collection);
+}
@@ -0,0 +1,334 @@
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <thread>
+
+#include <tempo_tracing/span_latency_metrics.h>
+#include <tempo_utils/log_stream.h>
+
+namespace {
+    /**
+     * A set of histogram buckets for one operation. Only the owner thread of the shard writes to
+     * the active set, so counters are incremented with a relaxed load and store rather than a
+     * read-modify-write.
+     */
+    struct Buckets {
+        std::atomic<tu_uint64> numSpans{0};
+        std::atomic<tu_uint64> numFailed{0};
+        std::unique_ptr<std::atomic<tu_uint64>[]> counts;
+    };
+
+    struct Operation {
+        Operation(std::string_view name, tu_uint32 numBuckets)
+            : name(name)
+        {
+            for (auto &buffer : buffers) {
+                buffer.counts = std::make_unique<std::atomic<tu_uint64>[]>(numBuckets);
+            }
+        }
+        const std::string name;
+        Buckets buffers[2];
+        Operation *next = nullptr;
+    };
+
+    inline void
+    increment(std::atomic<tu_uint64> &counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * The latencies recorded by a single thread. The operation list is published by the owner thread
+ * and read by `takeSnapshot`; the operation index and the last used operation are only accessed
+ * by the owner thread.
+ */
+struct tempo_tracing::SpanLatencyMetrics::Shard {
+    std::atomic<int> active{0};                 // the buffer the owner thread records into
+    std::atomic<tu_uint64> seq{0};              // odd while the owner thread is recording
+    std::atomic<Operation *> operations{nullptr};
+    std::atomic<bool> retired{false};           // the owner thread has exited
+    std::atomic<bool> detached{false};          // the metrics have been destroyed
+    absl::flat_hash_map<std::string,Operation *> index;
+    Operation *last = nullptr;
+
+    ~Shard()
+    {
+        auto *op = operations.load(std::memory_order_acquire);
+        while (op != nullptr) {
+            auto *next = op->next;
+            delete op;
+            op = next;
+        }
+    }
+};
+
+/**
+ * The shards owned by the current thread, keyed by the metrics id rather than the metrics address
+ * so that new metrics allocated at the same address are not confused with destroyed ones. When
+ * the thread exits its shards are marked as retired, and the metrics reclaim them.
+ */
+struct tempo_tracing::SpanLatencyMetrics::ThreadShards {
+    tu_uint64 lastMetricsId = 0;
+    Shard *lastShard = nullptr;
+    absl::flat_hash_map<tu_uint64,std::shared_ptr<Shard>> shards;
+
+    ~ThreadShards()
+    {
+        for (auto &entry : shards) {
+            entry.second->retired.store(true, std::memory_order_release);
+        }
+    }
+};
+
+static std::atomic<tu_uint64> nextMetricsId = 1;
+
+tempo_tracing::SpanLatencyMetrics::SpanLatencyMetrics(const SpanLatencyMetricsOptions &options)
+    : m_metricsId(nextMetricsId.fetch_add(1, std::memory_order_relaxed)),
+      m_options(options),
+      m_intervalStart(absl::Now())
+{
+    TU_ASSERT (m_options.lowestDiscernibleLatency > absl::ZeroDuration());
+    TU_ASSERT (m_options.maxTrackableLatency > m_options.lowestDiscernibleLatency);
+    TU_ASSERT (1 <= m_options.significantFigures && m_options.significantFigures <= 5);
+
+    m_unitNanos = std::max<tu_int64>(absl::ToInt64Nanoseconds(m_options.lowestDiscernibleLatency), 1);
+    m_maxUnits = absl::ToInt64Nanoseconds(m_options.maxTrackableLatency) / m_unitNanos;
+
+    // each power of two range is divided into enough sub-buckets to resolve the significant figures
+    tu_int64 resolution = 2;
+    for (int i = 0; i < m_options.significantFigures; i++) {
+        resolution *= 10;
+    }
+    m_subBucketBits = std::bit_width(static_cast<tu_uint64>(resolution - 1));
+    m_numBuckets = bucketIndex(m_maxUnits) + 1;
+}
+
+tempo_tracing::SpanLatencyMetrics::~SpanLatencyMetrics()
+{
+    absl::MutexLock locker(&m_shardsLock);
+    for (auto &shard : m_shards) {
+        shard->detached.store(true, std::memory_order_release);
+    }
+}
+
+/**
+ * Return the bucket containing `units`. Values below 2^subBucketBits have a bucket each, and each
+ * subsequent power of two range is divided into 2^(subBucketBits - 1) buckets.
+ */
+tu_uint32
+tempo_tracing::SpanLatencyMetrics::bucketIndex(tu_int64 units) const
+{
+    auto value = static_cast<tu_uint64>(units);
+    if (value < (1ull << m_subBucketBits))
+        return static_cast<tu_uint32>(value);
+    int shift = std::bit_width(value) - m_subBucketBits;
+    return static_cast<tu_uint32>((static_cast<tu_uint64>(shift) << (m_subBucketBits - 1)) + (value >> shift));
+}
+
+/**
+ * Return the lowest value in the bucket at `index`.
+ */
+tu_int64
+tempo_tracing::SpanLatencyMetrics::bucketValue(tu_uint32 index) const
+{
+    tu_uint32 halfCount = 1u << (m_subBucketBits - 1);
+    if (index < 2 * halfCount)
+        return index;
+    tu_uint32 shift = index / halfCount - 1;
+    tu_uint64 subBucket = index - shift * halfCount;
+    return static_cast<tu_int64>(subBucket << shift);
+}
+
+tempo_tracing::SpanLatencyMetrics::ThreadShards&
+tempo_tracing::SpanLatencyMetrics::getThreadShards()
+{
+    thread_local ThreadShards threadShards;
+    return threadShards;
+}
+
+/**
+ * Return the shard owned by the current thread, creating it if the thread has not recorded
+ * a span yet. The shards lock is only taken the first time a thread records into these metrics.
+ * Shards of destroyed metrics are released when the thread creates a new shard.
+ */
+tempo_tracing::SpanLatencyMetrics::Shard *
+tempo_tracing::SpanLatencyMetrics::getThreadShard()
+{
+    auto &threadShards = getThreadShards();
+    if (threadShards.lastMetricsId == m_metricsId)
+        return threadShards.lastShard;
+
+    Shard *shard;
+    auto entry = threadShards.shards.find(m_metricsId);
+    if (entry != threadShards.shards.cend()) {
+        shard = entry->second.get();
+    } else {
+        absl::erase_if(threadShards.shards, [](const auto &e) {
+            return e.second->detached.load(std::memory_order_acquire);
+        });
+        auto created = std::make_shared<Shard>();
+        shard = created.get();
+        {
+            absl::MutexLock locker(&m_shardsLock);
+            m_shards.push_back(created);
+        }
+        threadShards.shards[m_metricsId] = std::move(created);
+    }
+    threadShards.lastMetricsId = m_metricsId;
+    threadShards.lastShard = shard;
+    return shard;
+}
+
+/**
+ * Record the duration of a closed span. Durations longer than the maximum trackable latency are
+ * clamped to the maximum, so the span is still counted. Only the current thread writes to its
+ * shard, so no lock is taken; the shard sequence is odd while the span is being recorded, which
+ * lets `takeSnapshot` wait for a recording into the buffer it is about to drain.
+ *
+ * @param operationName The operation name of the span.
+ * @param duration The active duration of the span.
+ * @param failed True if the span failed.
+ */
+void
+tempo_tracing::SpanLatencyMetrics::recordSpan(
+    std::string_view operationName,
+    absl::Duration duration,
+    bool failed)
+{
+    auto units = std::clamp<tu_int64>(absl::ToInt64Nanoseconds(duration) / m_unitNanos, 0, m_maxUnits);
+
+    auto *shard = getThreadShard();
+    auto *op = shard->last;
+    if (op == nullptr || op->name != operationName) {
+        auto entry = shard->index.find(operationName);
+        if (entry != shard->index.end()) {
+            op = entry->second;
+        } else {
+            op = new Operation(operationName, m_numBuckets);
+            op->next = shard->operations.load(std::memory_order_relaxed);
+            shard->operations.store(op, std::memory_order_release);
+            shard->index[op->name] = op;
+        }
+        shard->last = op;
+    }
+
+    auto seq = shard->seq.load(std::memory_order_relaxed);
+    shard->seq.store(seq + 1, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    auto &buckets = op->buffers[shard->active.load(std::memory_order_acquire)];
+    increment(buckets.numSpans);
+    if (failed) {
+        increment(buckets.numFailed);
+    }
+    increment(buckets.counts[bucketIndex(units)]);
+
+    shard->seq.store(seq + 2, std::memory_order_release);
+}
+
+/**
+ * Merge the counts in the specified buffer of each operation in `shard` into the retained
+ * latencies, and clear the buffer. The owner thread must not be recording into the buffer.
+ */
+void
+tempo_tracing::SpanLatencyMetrics::drainShard(Shard *shard, int buffer)
+{
+    auto maxNanos = m_maxUnits * m_unitNanos;
+    for (auto *op = shard->operations.load(std::memory_order_acquire); op != nullptr; op = op->next) {
+        auto &buckets = op->buffers[buffer];
+        auto numSpans = buckets.numSpans.load(std::memory_order_relaxed);
+        if (numSpans == 0)
+            continue;
+
+        auto entry = m_retained.find(op->name);
+        if (entry == m_retained.end()) {
+            OperationLatency latency;
+            latency.durations = tempo_utils::HdrHistogram(m_unitNanos, maxNanos, m_options.significantFigures);
+            entry = m_retained.try_emplace(op->name, std::move(latency)).first;
+        }
+        auto &latency = entry->second;
+        latency.numSpans += numSpans;
+        latency.numFailed += buckets.numFailed.load(std::memory_order_relaxed);
+        for (tu_uint32 i = 0; i < m_numBuckets; i++) {
+            auto count = buckets.counts[i].load(std::memory_order_relaxed);
+            if (count == 0)
+                continue;
+            latency.durations.record(bucketValue(i) * m_unitNanos, count);
+            buckets.counts[i].store(0, std::memory_order_relaxed);
+        }
+        buckets.numSpans.store(0, std::memory_order_relaxed);
+        buckets.numFailed.store(0, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Merge the latencies recorded by each thread since the previous snapshot. The active buffer of
+ * each shard is swapped, and once the owner thread is no longer recording into the previous buffer
+ * it is drained. Shards of threads which have exited are drained completely and released. If
+ * `reset` is false then the recorded latencies are retained, and the next snapshot covers the same
+ * interval start.
+ *
+ * @param reset If true then start a new interval.
+ * @return The snapshot.
+ */
+tempo_tracing::SpanLatencySnapshot
+tempo_tracing::SpanLatencyMetrics::takeSnapshot(bool reset)
+{
+    absl::MutexLock shardsLocker(&m_shardsLock);
+
+    SpanLatencySnapshot snapshot;
+    snapshot.intervalStart = m_intervalStart;
+    snapshot.intervalEnd = absl::Now();
+
+    std::vector<std::shared_ptr<Shard>> live;
+    for (auto &shard : m_shards) {
+        if (shard->retired.load(std::memory_order_acquire)) {
+            drainShard(shard.get(), 0);
+            drainShard(shard.get(), 1);
+            continue;
+        }
+
+        // if the owner thread was recording when the buffers were swapped then it may still be
+        // writing to the previous buffer, so wait until its recording completes
+        auto previous = shard->active.load(std::memory_order_relaxed);
+        shard->active.store(1 - previous);
+        auto seq = shard->seq.load();
+        if (seq & 1) {
+            while (shard->seq.load(std::memory_order_acquire) == seq) {
+                std::this_thread::yield();
+            }
+        }
+        drainShard(shard.get(), previous);
+        live.push_back(std::move(shard));
+    }
+    m_shards = std::move(live);
+
+    for (auto &[operationName, latency] : m_retained) {
+        if (latency.numSpans == 0)
+            continue;
+        snapshot.operations[operationName] = latency;
+        if (reset) {
+            latency.numSpans = 0;
+            latency.numFailed = 0;
+            latency.durations.reset();
+        }
+    }
+
+    if (reset) {
+        m_intervalStart = snapshot.intervalEnd;
+    }
+    return snapshot;
+}
+
+/**
+ * Return the number of thread shards which have not been reclaimed. The shard of an exited thread
+ * is reclaimed by the next snapshot.
+ */
+int
+tempo_tracing::SpanLatencyMetrics::numThreadShards()
+{
+    absl::MutexLock locker(&m_shardsLock);
+    return m_shards.size();
+}
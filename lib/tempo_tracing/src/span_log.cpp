@@ -22,14 +22,14 @@ tempo_tracing::SpanLog::getSeverity() const
 bool
 tempo_tracing::SpanLog::hasField(const tempo_schema::AttrKey &key) const
 {
-    absl::MutexLock locker(m_span->m_lock);
+    absl::MutexLockMaybe locker(m_span->m_lock);
     return m_logEntry.fields.contains(key);
 }
 
 tempo_schema::AttrValue
 tempo_tracing::SpanLog::getField(const tempo_schema::AttrKey &key) const
 {
-    absl::MutexLock locker(m_span->m_lock);
+    absl::MutexLockMaybe locker(m_span->m_lock);
     if (!m_logEntry.fields.contains(key))
         return {};
     return m_logEntry.fields.at(key);
@@ -38,6 +38,9 @@ tempo_tracing::SpanLog::getField(const tempo_schema::AttrKey &key) const
 void
 tempo_tracing::SpanLog::putFieldLocked(const tempo_schema::AttrKey &key, const tempo_schema::AttrValue &value)
 {
+    // the fields of an unsampled span are discarded, and an unsampled span has no lock
+    if (!m_span->isSampled())
+        return;
     absl::MutexLock locker(m_span->m_lock);
     TU_LOG_FATAL_IF(m_span->m_data.complete) << "failed to put field on closed span";
     m_span->putFieldUnlocked(m_logEntry, key, value);
@@ -56,6 +56,9 @@ tempo_tracing::SpanWalker::getStartTime() const
         return {};
     auto *span = m_reader->getSpan(m_index);
     TU_ASSERT (span != nullptr);
+    // prefer the nanosecond timestamp, which is absent in spansets written before it was added
+    if (span->span_start_ns() != 0)
+        return absl::FromUnixNanos(span->span_start_ns());
     return absl::FromUnixMillis(span->span_start());
 }
 
@@ -66,6 +69,8 @@ tempo_tracing::SpanWalker::getEndTime() const
         return {};
     auto *span = m_reader->getSpan(m_index);
     TU_ASSERT (span != nullptr);
+    if (span->span_end_ns() != 0)
+        return absl::FromUnixNanos(span->span_end_ns());
     return absl::FromUnixMillis(span->span_end());
 }
 
@@ -99,6 +104,32 @@ tempo_tracing::SpanWalker::findIndexForTag(const tempo_schema::AttrKey &key) con
         return kInvalidAddressU32;
     auto *span = m_reader->getSpan(m_index);
     TU_ASSERT (span != nullptr);
+
+    // if the span has a tag index then binary search it by namespace offset and type
+    auto *tagKeys = span->span_tag_keys();
+    if (tagKeys != nullptr) {
+        auto ns = m_reader->findNamespace(key.ns);
+        if (ns == kInvalidAddressU32)   // no tag in the spanset has the namespace
+            return kInvalidAddressU32;
+        auto target = std::pair<tu_uint32,tu_uint32>(ns, key.id);
+        tu_uint32 lo = 0;
+        tu_uint32 hi = tagKeys->size();
+        while (lo < hi) {
+            auto mid = lo + (hi - lo) / 2;
+            auto *tagKey = tagKeys->Get(mid);
+            auto curr = std::pair<tu_uint32,tu_uint32>(tagKey->tag_ns(), tagKey->tag_type());
+            if (curr == target)
+                return tagKey->tag_attr();
+            if (curr < target) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return kInvalidAddressU32;
+    }
+
+    // otherwise the spanset predates the tag index, so scan the tags
     auto *tags = span->span_tags();
     if (tags == nullptr)    // span has no tags
         return kInvalidAddressU32;
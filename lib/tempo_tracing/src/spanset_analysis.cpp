@@ -0,0 +1,262 @@
+
+#include <algorithm>
+
+#include <absl/strings/str_cat.h>
+#include <absl/strings/str_replace.h>
+#include <fmt/format.h>
+
+#include <tempo_tracing/internal/spanset_reader.h>
+#include <tempo_tracing/spanset_analysis.h>
+#include <tempo_utils/log_stream.h>
+
+namespace {
+    struct SpanInterval {
+        tu_int64 start = -1;
+        tu_int64 end = -1;
+        std::vector<tu_uint32> children;
+
+        bool isValid() const { return start >= 0 && end >= start; }
+    };
+}
+
+/**
+ * Read the interval and children of each span. Child offsets which are out of range are
+ * dropped, so the analysis never indexes outside of the spanset.
+ */
+static std::vector<SpanInterval>
+read_span_intervals(const tempo_tracing::internal::SpansetReader &reader)
+{
+    std::vector<SpanInterval> spans(reader.numSpans());
+    for (tu_uint32 i = 0; i < spans.size(); i++) {
+        auto *span = reader.getSpan(i);
+        TU_NOTNULL (span);
+        auto &interval = spans[i];
+        interval.start = tempo_tracing::internal::get_span_start_nanos(span);
+        interval.end = tempo_tracing::internal::get_span_end_nanos(span);
+        if (span->children()) {
+            for (auto child : *span->children()) {
+                if (child < spans.size() && child != i) {
+                    interval.children.push_back(child);
+                }
+            }
+        }
+    }
+    return spans;
+}
+
+/**
+ * Return the time in the span which is not covered by any child. The child intervals are
+ * clipped to the span and merged, so overlapping children are only subtracted once.
+ */
+static tu_int64
+compute_self_time(const std::vector<SpanInterval> &spans, const SpanInterval &span)
+{
+    std::vector<std::pair<tu_int64,tu_int64>> covered;
+    for (auto child : span.children) {
+        const auto &interval = spans[child];
+        if (!interval.isValid())
+            continue;
+        auto start = std::max(interval.start, span.start);
+        auto end = std::min(interval.end, span.end);
+        if (start < end) {
+            covered.emplace_back(start, end);
+        }
+    }
+    std::sort(covered.begin(), covered.end());
+
+    tu_int64 coveredTime = 0;
+    tu_int64 cursor = span.start;
+    for (const auto &[start, end] : covered) {
+        if (end <= cursor)
+            continue;
+        coveredTime += end - std::max(start, cursor);
+        cursor = end;
+    }
+    return (span.end - span.start) - coveredTime;
+}
+
+/**
+ * Attribute the window [from, to] of the span to the critical path. Starting from the end of
+ * the window and walking backwards, the child which ended last before the cursor is on the
+ * critical path, and the cursor moves to the start of that child; time in the window which is
+ * not covered by a critical child is attributed to the span itself.
+ */
+static void
+accumulate_critical_time(
+    const std::vector<SpanInterval> &spans,
+    tu_uint32 index,
+    tu_int64 from,
+    tu_int64 to,
+    std::vector<bool> &visited,
+    std::vector<tu_int64> &critical)
+{
+    // a malformed spanset may contain a cycle, so each span is only visited once
+    if (visited[index])
+        return;
+    visited[index] = true;
+
+    std::vector<tu_uint32> children;
+    for (auto child : spans[index].children) {
+        if (spans[child].isValid()) {
+            children.push_back(child);
+        }
+    }
+    std::sort(children.begin(), children.end(), [&](tu_uint32 lhs, tu_uint32 rhs) {
+        return spans[lhs].end > spans[rhs].end;
+    });
+
+    auto cursor = to;
+    for (auto child : children) {
+        if (cursor <= from)
+            break;
+        const auto &interval = spans[child];
+        auto childStart = std::max(interval.start, from);
+        auto childEnd = std::min(interval.end, cursor);
+        if (childEnd <= childStart)
+            continue;
+        critical[index] += cursor - childEnd;
+        accumulate_critical_time(spans, child, childStart, childEnd, visited, critical);
+        cursor = childStart;
+    }
+    if (cursor > from) {
+        critical[index] += cursor - from;
+    }
+}
+
+/**
+ * Compute the self time and critical time of each span in the spanset. Spans without both a
+ * start and end time have zero duration and are never on the critical path.
+ *
+ * @param spanset The spanset.
+ * @return The timings of the spans, indexed by the offset of the span in the spanset.
+ */
+tempo_utils::Result<std::vector<tempo_tracing::SpanTiming>>
+tempo_tracing::analyze_span_timings(const TempoSpanset &spanset)
+{
+    if (!spanset.isValid())
+        return TracingStatus::forCondition(TracingCondition::kTracingInvariant,
+            "cannot analyze invalid spanset");
+    auto reader = spanset.getReader();
+    auto spans = read_span_intervals(*reader);
+
+    std::vector<tu_int64> critical(spans.size(), 0);
+    std::vector<bool> visited(spans.size(), false);
+    for (tu_uint32 i = 0; i < spans.size(); i++) {
+        auto *span = reader->getSpan(i);
+        if (span->parent() == kInvalidAddressU32 && spans[i].isValid()) {
+            accumulate_critical_time(spans, i, spans[i].start, spans[i].end, visited, critical);
+        }
+    }
+
+    std::vector<SpanTiming> timings(spans.size());
+    for (tu_uint32 i = 0; i < spans.size(); i++) {
+        auto *span = reader->getSpan(i);
+        auto &timing = timings[i];
+        timing.spanId = tempo_utils::SpanId(span->span_id());
+        if (span->operation_name()) {
+            timing.operationName = span->operation_name()->str();
+        }
+        if (spans[i].isValid()) {
+            timing.duration = absl::Nanoseconds(spans[i].end - spans[i].start);
+            timing.selfTime = absl::Nanoseconds(compute_self_time(spans, spans[i]));
+            timing.criticalTime = absl::Nanoseconds(critical[i]);
+        }
+    }
+    return timings;
+}
+
+tempo_tracing::SpansetProfile::SpansetProfile()
+    : m_numSpansets(0)
+{
+}
+
+/**
+ * Add the timings of the spans in the spanset to the profile.
+ */
+tempo_utils::Status
+tempo_tracing::SpansetProfile::addSpanset(const TempoSpanset &spanset)
+{
+    std::vector<SpanTiming> timings;
+    TU_ASSIGN_OR_RETURN (timings, analyze_span_timings(spanset));
+
+    for (const auto &timing : timings) {
+        auto &operation = m_operations[timing.operationName];
+        operation.count++;
+        operation.totalTime += timing.duration;
+        operation.selfTime += timing.selfTime;
+        operation.criticalTime += timing.criticalTime;
+    }
+
+    // build the stack of each span from the stack of its parent, visiting parents before
+    // children. semicolons separate frames in the folded format, so they are replaced in names.
+    auto reader = spanset.getReader();
+    std::vector<std::string> stacks(timings.size());
+    std::vector<bool> visited(timings.size(), false);
+    std::vector<tu_uint32> pending;
+    for (tu_uint32 i = 0; i < timings.size(); i++) {
+        if (reader->getSpan(i)->parent() != kInvalidAddressU32)
+            continue;
+        stacks[i] = absl::StrReplaceAll(timings[i].operationName, {{";", ":"}});
+        visited[i] = true;
+        pending.push_back(i);
+    }
+    while (!pending.empty()) {
+        auto index = pending.back();
+        pending.pop_back();
+        m_stacks[stacks[index]] += timings[index].selfTime;
+        auto *children = reader->getSpan(index)->children();
+        if (children == nullptr)
+            continue;
+        for (auto child : *children) {
+            if (child >= timings.size() || visited[child])
+                continue;
+            visited[child] = true;
+            stacks[child] = absl::StrCat(stacks[index], ";",
+                absl::StrReplaceAll(timings[child].operationName, {{";", ":"}}));
+            pending.push_back(child);
+        }
+    }
+
+    m_numSpansets++;
+    return {};
+}
+
+int
+tempo_tracing::SpansetProfile::numSpansets() const
+{
+    return m_numSpansets;
+}
+
+/**
+ * Return the profile of each operation, ordered by descending self time.
+ */
+std::vector<std::pair<std::string,tempo_tracing::OperationProfile>>
+tempo_tracing::SpansetProfile::listOperations() const
+{
+    std::vector<std::pair<std::string,OperationProfile>> operations(m_operations.cbegin(), m_operations.cend());
+    std::sort(operations.begin(), operations.end(), [](const auto &lhs, const auto &rhs) {
+        if (lhs.second.selfTime != rhs.second.selfTime)
+            return lhs.second.selfTime > rhs.second.selfTime;
+        return lhs.first < rhs.first;
+    });
+    return operations;
+}
+
+/**
+ * Return the profile in the folded stack format read by flame graph tools. Each line contains
+ * the operation names from the root span separated by semicolons, followed by the total self
+ * time of the stack in nanoseconds.
+ */
+std::string
+tempo_tracing::SpansetProfile::toFoldedStacks() const
+{
+    std::vector<std::pair<std::string,absl::Duration>> stacks(m_stacks.cbegin(), m_stacks.cend());
+    std::sort(stacks.begin(), stacks.end(), [](const auto &lhs, const auto &rhs) {
+        return lhs.first < rhs.first;
+    });
+    std::string folded;
+    for (const auto &[stack, selfTime] : stacks) {
+        folded.append(fmt::format("{} {}\n", stack, absl::ToInt64Nanoseconds(selfTime)));
+    }
+    return folded;
+}
@@ -0,0 +1,308 @@
+
+#include <bit>
+
+#include <tempo_tracing/spanset_archive.h>
+#include <tempo_utils/bytes_iterator.h>
+#include <tempo_utils/log_stream.h>
+#include <tempo_utils/memory_mapped_bytes.h>
+
+// the columns are read in place, so the archive encoding must match the host byte order
+static_assert(std::endian::native == std::endian::little);
+
+constexpr size_t kColumnAlignment = 8;
+
+// durations above one hour saturate the histogram
+constexpr tu_int64 kMaxHistogramNanos = 3600LL * 1000 * 1000 * 1000;
+
+tempo_tracing::ArchiveTagFilter::ArchiveTagFilter(const tempo_schema::AttrKey &key, std::string_view value)
+    : ns(key.ns),
+      type(key.id),
+      value(value)
+{
+}
+
+tempo_tracing::SpansetArchive::SpansetArchive()
+{
+}
+
+tempo_tracing::SpansetArchive::SpansetArchive(const SpansetArchive &other)
+    : m_bytes(other.m_bytes),
+      m_blocks(other.m_blocks)
+{
+}
+
+bool
+tempo_tracing::SpansetArchive::isValid() const
+{
+    return m_bytes != nullptr;
+}
+
+tu_uint32
+tempo_tracing::SpansetArchive::numBlocks() const
+{
+    return m_blocks.size();
+}
+
+tu_uint64
+tempo_tracing::SpansetArchive::numSpans() const
+{
+    tu_uint64 numSpans = 0;
+    for (const auto &block : m_blocks) {
+        numSpans += block.numSpans;
+    }
+    return numSpans;
+}
+
+namespace {
+
+    /**
+     * Reads the archive encoding, tracking the offset from the start of the archive so that
+     * the alignment padding before each column can be skipped.
+     */
+    class ArchiveParser {
+    public:
+        explicit ArchiveParser(std::span<const tu_uint8> bytes)
+            : m_it(bytes)
+        {
+        }
+
+        bool readU32(tu_uint32 &u32) { return m_it.nextU32LE(u32); }
+        bool readBytes(std::span<const tu_uint8> &bytes, tu_uint32 count) { return m_it.nextSlice(bytes, count); }
+
+        bool skipPadding()
+        {
+            std::span<const tu_uint8> padding;
+            auto remainder = m_it.bytesConsumed() % kColumnAlignment;
+            return remainder == 0 || m_it.nextSlice(padding, kColumnAlignment - remainder);
+        }
+
+        bool readStringTable(std::vector<std::string_view> &strings)
+        {
+            tu_uint32 count;
+            if (!m_it.nextU32LE(count) || count > m_it.bytesLeft())
+                return false;
+            strings.reserve(count);
+            for (tu_uint32 i = 0; i < count; i++) {
+                tu_uint32 length;
+                std::span<const tu_uint8> str;
+                if (!m_it.nextU32LE(length) || !m_it.nextSlice(str, length))
+                    return false;
+                strings.emplace_back(reinterpret_cast<const char *>(str.data()), str.size());
+            }
+            return skipPadding();
+        }
+
+        template<typename T>
+        bool readColumn(std::span<const T> &column, tu_uint32 count)
+        {
+            auto size = static_cast<tu_uint64>(count) * sizeof(T);
+            std::span<const tu_uint8> slice;
+            if (size > m_it.bytesLeft() || !m_it.nextSlice(slice, static_cast<tu_uint32>(size)))
+                return false;
+            column = std::span<const T>(reinterpret_cast<const T *>(slice.data()), count);
+            return skipPadding();
+        }
+
+    private:
+        tempo_utils::BytesIterator m_it;
+    };
+}
+
+static tempo_tracing::TracingStatus
+invalid_archive(std::string_view message)
+{
+    return tempo_tracing::TracingStatus::forCondition(
+        tempo_tracing::TracingCondition::kInvalidArchive, message);
+}
+
+/**
+ * Load the archive from the specified bytes. The bytes are retained by the archive, and the
+ * columns are read in place.
+ */
+tempo_utils::Result<tempo_tracing::SpansetArchive>
+tempo_tracing::SpansetArchive::load(std::shared_ptr<const tempo_utils::ImmutableBytes> bytes)
+{
+    TU_NOTNULL (bytes);
+    if (reinterpret_cast<std::uintptr_t>(bytes->getData()) % kColumnAlignment != 0)
+        return invalid_archive("archive bytes are not aligned");
+
+    ArchiveParser parser(std::span<const tu_uint8>(bytes->getData(), bytes->getSize()));
+
+    std::span<const tu_uint8> magic;
+    tu_uint32 version, numBlocks, reserved;
+    if (!parser.readBytes(magic, 4)
+        || std::string_view(reinterpret_cast<const char *>(magic.data()), magic.size()) != kSpansetArchiveMagic)
+        return invalid_archive("missing archive magic");
+    if (!parser.readU32(version) || !parser.readU32(numBlocks) || !parser.readU32(reserved))
+        return invalid_archive("truncated archive header");
+    if (version != kSpansetArchiveVersion)
+        return invalid_archive("unsupported archive version");
+
+    SpansetArchive archive;
+    archive.m_bytes = bytes;
+
+    for (tu_uint32 i = 0; i < numBlocks; i++) {
+        Block block;
+        tu_uint32 numTagColumns;
+        if (!parser.readU32(block.numSpans) || !parser.readU32(numTagColumns))
+            return invalid_archive("truncated block header");
+        if (!parser.readStringTable(block.operations)
+            || !parser.readColumn(block.operationCodes, block.numSpans)
+            || !parser.readColumn(block.durations, block.numSpans)
+            || !parser.readColumn(block.failed, (block.numSpans + 63) / 64))
+            return invalid_archive("truncated block columns");
+        for (auto code : block.operationCodes) {
+            if (code >= block.operations.size())
+                return invalid_archive("invalid operation name code");
+        }
+
+        for (tu_uint32 j = 0; j < numTagColumns; j++) {
+            TagColumn column;
+            std::vector<std::string_view> ns;
+            if (!parser.readU32(column.type) || !parser.readStringTable(ns) || ns.size() != 1
+                || !parser.readStringTable(column.values)
+                || !parser.readColumn(column.codes, block.numSpans))
+                return invalid_archive("truncated tag column");
+            column.ns = ns.front();
+            block.tagColumns.push_back(std::move(column));
+        }
+
+        archive.m_blocks.push_back(std::move(block));
+    }
+
+    return archive;
+}
+
+/**
+ * Open the archive at the specified path. The file is memory mapped rather than read.
+ */
+tempo_utils::Result<tempo_tracing::SpansetArchive>
+tempo_tracing::SpansetArchive::open(const std::filesystem::path &path)
+{
+    std::shared_ptr<tempo_utils::MemoryMappedBytes> bytes;
+    TU_ASSIGN_OR_RETURN (bytes, tempo_utils::MemoryMappedBytes::open(path));
+    return load(bytes);
+}
+
+/**
+ * Clear the bits in the mask for each span whose code in the column is not equal to the
+ * specified code. The inner loop compares 64 codes at a time without branching so that the
+ * compiler can vectorize it.
+ */
+static void
+select_equal(std::span<const tu_uint32> codes, tu_uint32 code, std::vector<tu_uint64> &mask)
+{
+    size_t numSpans = codes.size();
+    for (size_t word = 0; word < mask.size(); word++) {
+        auto base = word * 64;
+        auto count = std::min<size_t>(64, numSpans - base);
+        tu_uint64 bits = 0;
+        for (size_t i = 0; i < count; i++) {
+            bits |= static_cast<tu_uint64>(codes[base + i] == code) << i;
+        }
+        mask[word] &= bits;
+    }
+}
+
+static tu_uint32
+find_string(const std::vector<std::string_view> &strings, std::string_view str)
+{
+    for (tu_uint32 i = 0; i < strings.size(); i++) {
+        if (strings[i] == str)
+            return i;
+    }
+    return tempo_tracing::kInvalidAddressU32;
+}
+
+/**
+ * Build a mask of the spans in the block which match the query.
+ *
+ * @return false if no span in the block can match the query, in which case the mask is not
+ *   built.
+ */
+bool
+tempo_tracing::SpansetArchive::selectSpans(
+    const Block &block,
+    const ArchiveQuery &query,
+    std::vector<tu_uint64> &mask) const
+{
+    // resolve each filter to a dictionary code first, so a block which does not contain a
+    // filter value is skipped without scanning its columns
+    auto operationCode = kInvalidAddressU32;
+    if (!query.operationName.empty()) {
+        operationCode = find_string(block.operations, query.operationName);
+        if (operationCode == kInvalidAddressU32)
+            return false;
+    }
+    std::vector<std::pair<const TagColumn *,tu_uint32>> tagCodes;
+    for (const auto &filter : query.tags) {
+        const TagColumn *match = nullptr;
+        for (const auto &column : block.tagColumns) {
+            if (column.type == filter.type && column.ns == filter.ns) {
+                match = &column;
+                break;
+            }
+        }
+        if (match == nullptr)
+            return false;
+        auto code = find_string(match->values, filter.value);
+        if (code == kInvalidAddressU32)
+            return false;
+        tagCodes.emplace_back(match, code);
+    }
+
+    mask.assign((block.numSpans + 63) / 64, ~tu_uint64{0});
+    if (block.numSpans % 64 != 0) {
+        mask.back() = (tu_uint64{1} << (block.numSpans % 64)) - 1;
+    }
+
+    if (operationCode != kInvalidAddressU32) {
+        select_equal(block.operationCodes, operationCode, mask);
+    }
+    for (const auto &[column, code] : tagCodes) {
+        select_equal(column->codes, code, mask);
+    }
+    if (query.failedOnly) {
+        for (size_t word = 0; word < mask.size(); word++) {
+            mask[word] &= block.failed[word];
+        }
+    }
+    return true;
+}
+
+/**
+ * Aggregate the spans in the archive which match the query.
+ *
+ * @param query The query.
+ * @return The aggregate of the matching spans.
+ */
+tempo_utils::Result<tempo_tracing::ArchiveAggregate>
+tempo_tracing::SpansetArchive::aggregate(const ArchiveQuery &query) const
+{
+    if (!isValid())
+        return TracingStatus::forCondition(TracingCondition::kInvalidArchive, "invalid archive");
+
+    ArchiveAggregate aggregate;
+    aggregate.durations = tempo_utils::HdrHistogram(1, kMaxHistogramNanos, 3);
+
+    std::vector<tu_uint64> mask;
+    for (const auto &block : m_blocks) {
+        if (!selectSpans(block, query, mask))
+            continue;
+        for (size_t word = 0; word < mask.size(); word++) {
+            auto bits = mask[word];
+            aggregate.numFailed += std::popcount(bits & block.failed[word]);
+            while (bits != 0) {
+                auto index = word * 64 + std::countr_zero(bits);
+                bits &= bits - 1;
+                aggregate.numSpans++;
+                auto duration = block.durations[index];
+                if (duration >= 0) {
+                    aggregate.durations.record(std::clamp<tu_int64>(duration, 1, kMaxHistogramNanos));
+                }
+            }
+        }
+    }
+
+    return aggregate;
+}
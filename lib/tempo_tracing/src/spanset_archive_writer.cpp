@@ -0,0 +1,243 @@
+
+#include <tempo_tracing/internal/spanset_reader.h>
+#include <tempo_tracing/spanset_archive.h>
+#include <tempo_tracing/spanset_archive_writer.h>
+#include <tempo_utils/log_stream.h>
+
+// Layout of a spanset archive. All integers are little-endian, and each column starts on an
+// 8 byte boundary so it can be read in place from a memory mapping.
+//
+//   header:        magic "TSAR", u32 version, u32 number of blocks, u32 reserved
+//   block:         u32 number of spans (N), u32 number of tag columns
+//                  operation names: string table
+//                  operation name codes: u32[N]
+//                  durations in nanoseconds, or -1 if unknown: i64[N]
+//                  failed bits: u64[(N + 63) / 64]
+//                  tag columns, each: u32 attr type, string table containing the attr ns,
+//                      string table of values, value codes or INVALID_ADDRESS_U32: u32[N]
+//   string table:  u32 count, then for each string u32 length followed by the utf8 bytes
+
+constexpr size_t kColumnAlignment = 8;
+
+static void
+pad_to_alignment(tempo_utils::BytesAppender &appender)
+{
+    while (appender.getSize() % kColumnAlignment != 0) {
+        appender.appendU8(0);
+    }
+}
+
+static void
+append_string_table(tempo_utils::BytesAppender &appender, const std::vector<std::string> &strings)
+{
+    appender.appendU32LE(strings.size());
+    for (const auto &str : strings) {
+        appender.appendU32LE(str.size());
+        appender.appendBytes(std::string_view(str));
+    }
+    pad_to_alignment(appender);
+}
+
+static void
+append_u32_column(tempo_utils::BytesAppender &appender, const std::vector<tu_uint32> &column)
+{
+    for (auto value : column) {
+        appender.appendU32LE(value);
+    }
+    pad_to_alignment(appender);
+}
+
+/**
+ * Return the string representation of the attribute value, which is what tag filters match.
+ */
+static std::string
+attr_value_to_string(const tts1::AttributeDescriptor *attr)
+{
+    switch (attr->attr_value_type()) {
+        case tts1::Value::TrueFalseNilValue:
+            switch (attr->attr_value_as_TrueFalseNilValue()->tfn()) {
+                case tts1::TrueFalseNil::True:
+                    return "true";
+                case tts1::TrueFalseNil::False:
+                    return "false";
+                default:
+                    return "nil";
+            }
+        case tts1::Value::Int64Value:
+            return std::to_string(attr->attr_value_as_Int64Value()->i64());
+        case tts1::Value::Float64Value:
+            return std::to_string(attr->attr_value_as_Float64Value()->f64());
+        case tts1::Value::UInt64Value:
+            return std::to_string(attr->attr_value_as_UInt64Value()->u64());
+        case tts1::Value::UInt32Value:
+            return std::to_string(attr->attr_value_as_UInt32Value()->u32());
+        case tts1::Value::UInt16Value:
+            return std::to_string(attr->attr_value_as_UInt16Value()->u16());
+        case tts1::Value::UInt8Value:
+            return std::to_string(attr->attr_value_as_UInt8Value()->u8());
+        case tts1::Value::StringValue: {
+            auto *utf8 = attr->attr_value_as_StringValue()->utf8();
+            return utf8? utf8->str() : std::string();
+        }
+        default:
+            return {};
+    }
+}
+
+tu_uint32
+tempo_tracing::SpansetArchiveWriter::StringDictionary::put(std::string_view str)
+{
+    auto entry = codes.find(str);
+    if (entry != codes.cend())
+        return entry->second;
+    tu_uint32 code = strings.size();
+    strings.emplace_back(str);
+    codes[str] = code;
+    return code;
+}
+
+tempo_tracing::SpansetArchiveWriter::SpansetArchiveWriter(const SpansetArchiveOptions &options)
+    : m_options(options),
+      m_numBlocks(0)
+{
+    TU_ASSERT (m_options.maxBlockSpans > 0);
+}
+
+tu_uint32
+tempo_tracing::SpansetArchiveWriter::numBlocks() const
+{
+    return m_numBlocks;
+}
+
+/**
+ * Return the column for the tag with the specified key, creating it if the current block does
+ * not have the column yet. A new column is filled with absent values for the spans which were
+ * appended to the block before the column was created.
+ */
+tempo_tracing::SpansetArchiveWriter::TagColumn&
+tempo_tracing::SpansetArchiveWriter::getTagColumn(std::string_view ns, tu_uint32 type)
+{
+    auto key = std::pair<std::string,tu_uint32>(ns, type);
+    auto entry = m_tagColumnIndex.find(key);
+    if (entry != m_tagColumnIndex.cend())
+        return m_tagColumns.at(entry->second);
+    m_tagColumnIndex[key] = m_tagColumns.size();
+    auto &column = m_tagColumns.emplace_back();
+    column.ns = ns;
+    column.type = type;
+    column.codes.resize(m_operationCodes.size(), kInvalidAddressU32);
+    return column;
+}
+
+/**
+ * Append the spans of the spanset to the archive. Blocks are written as they fill, so the
+ * spanset does not need to be retained after it is appended.
+ */
+tempo_utils::Status
+tempo_tracing::SpansetArchiveWriter::appendSpanset(const TempoSpanset &spanset)
+{
+    if (!spanset.isValid())
+        return TracingStatus::forCondition(TracingCondition::kTracingInvariant,
+            "cannot archive invalid spanset");
+    auto reader = spanset.getReader();
+
+    for (tu_uint32 i = 0; i < reader->numSpans(); i++) {
+        auto *span = reader->getSpan(i);
+        TU_NOTNULL (span);
+
+        auto operationName = span->operation_name()? span->operation_name()->string_view() : std::string_view();
+        m_operationCodes.push_back(m_operations.put(operationName));
+
+        auto startTime = internal::get_span_start_nanos(span);
+        auto endTime = internal::get_span_end_nanos(span);
+        m_durations.push_back(startTime >= 0 && endTime >= startTime? endTime - startTime : -1);
+        m_failed.push_back(span->failed());
+
+        for (auto &column : m_tagColumns) {
+            column.codes.push_back(kInvalidAddressU32);
+        }
+        if (span->span_tags()) {
+            for (auto tagIndex : *span->span_tags()) {
+                auto *attr = reader->getAttribute(tagIndex);
+                TU_NOTNULL (attr);
+                auto *ns = reader->getNamespace(attr->attr_ns());
+                if (ns == nullptr || ns->ns_url() == nullptr)
+                    continue;
+                auto &column = getTagColumn(ns->ns_url()->string_view(), attr->attr_type());
+                column.codes.back() = column.values.put(attr_value_to_string(attr));
+            }
+        }
+
+        if (m_operationCodes.size() == m_options.maxBlockSpans) {
+            writeBlock();
+        }
+    }
+
+    return {};
+}
+
+/**
+ * Encode the buffered columns as a block and clear them.
+ */
+void
+tempo_tracing::SpansetArchiveWriter::writeBlock()
+{
+    tu_uint32 numSpans = m_operationCodes.size();
+    if (numSpans == 0)
+        return;
+
+    m_blocks.appendU32LE(numSpans);
+    m_blocks.appendU32LE(m_tagColumns.size());
+
+    append_string_table(m_blocks, m_operations.strings);
+    append_u32_column(m_blocks, m_operationCodes);
+
+    for (auto duration : m_durations) {
+        m_blocks.appendS64LE(duration);
+    }
+
+    std::vector<tu_uint64> failed((numSpans + 63) / 64, 0);
+    for (tu_uint32 i = 0; i < numSpans; i++) {
+        if (m_failed[i]) {
+            failed[i / 64] |= tu_uint64{1} << (i % 64);
+        }
+    }
+    for (auto word : failed) {
+        m_blocks.appendU64LE(word);
+    }
+
+    for (const auto &column : m_tagColumns) {
+        m_blocks.appendU32LE(column.type);
+        append_string_table(m_blocks, {column.ns});
+        append_string_table(m_blocks, column.values.strings);
+        append_u32_column(m_blocks, column.codes);
+    }
+
+    m_numBlocks++;
+    m_operations = {};
+    m_operationCodes.clear();
+    m_durations.clear();
+    m_failed.clear();
+    m_tagColumns.clear();
+    m_tagColumnIndex.clear();
+}
+
+/**
+ * Write any buffered spans and return the archive. The writer must not be used after calling
+ * this method.
+ *
+ * @return The serialized archive.
+ */
+std::shared_ptr<const tempo_utils::ImmutableBytes>
+tempo_tracing::SpansetArchiveWriter::finish()
+{
+    writeBlock();
+
+    tempo_utils::BytesAppender archive(16 + m_blocks.getSize());
+    archive.appendBytes(std::string_view(kSpansetArchiveMagic, 4));
+    archive.appendU32LE(kSpansetArchiveVersion);
+    archive.appendU32LE(m_numBlocks);
+    archive.appendU32LE(0);
+    archive.appendBytes(m_blocks);
+    return archive.finish();
+}
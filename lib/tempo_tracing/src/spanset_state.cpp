@@ -1,38 +1,110 @@
 
 #include <stack>
 
-#include <tempo_tracing/internal/spanset_reader.h>
+#include <tempo_tracing/internal/spanset_writer.h>
 #include <tempo_tracing/spanset_state.h>
 #include <tempo_tracing/tempo_spanset.h>
 #include <tempo_tracing/tracing_types.h>
 #include <tempo_utils/compressed_bitmap.h>
-#include <tempo_utils/memory_bytes.h>
+
+namespace {
+    // the shard most recently used by the current thread, keyed by the state id rather than
+    // the state address so that a new state allocated at the same address is not confused
+    // with a destroyed one
+    struct ThreadShardCache {
+        tu_uint64 stateId = 0;
+        void *shard = nullptr;
+    };
+    thread_local ThreadShardCache threadShardCache;
+}
+
+static std::atomic<tu_uint64> nextStateId = 1;
 
 tempo_tracing::SpansetState::SpansetState(tempo_utils::TraceId id)
-    : m_id(id),
-      m_size(0)
+    : m_stateId(nextStateId.fetch_add(1, std::memory_order_relaxed)),
+      m_id(id),
+      m_size(0),
+      m_sealed(false)
 {
 }
 
-tempo_tracing::SpanData&
-tempo_tracing::SpansetState::appendSpan(
+/**
+ * Return the shard owned by the current thread, creating it if the thread has not appended
+ * a span yet. The shards lock is only taken the first time a thread appends to this state, or
+ * when the thread alternates between states.
+ */
+tempo_tracing::SpansetState::Shard *
+tempo_tracing::SpansetState::getThreadShard()
+{
+    if (threadShardCache.stateId == m_stateId)
+        return static_cast<Shard *>(threadShardCache.shard);
+
+    absl::MutexLock locker(&m_shardsLock);
+    auto tid = std::this_thread::get_id();
+    Shard *shard;
+    auto entry = m_threadShards.find(tid);
+    if (entry != m_threadShards.cend()) {
+        shard = entry->second;
+    } else {
+        shard = m_shards.emplace_back(std::make_unique<Shard>()).get();
+        m_threadShards[tid] = shard;
+    }
+    threadShardCache.stateId = m_stateId;
+    threadShardCache.shard = shard;
+    return shard;
+}
+
+tempo_tracing::SpanData *
+tempo_tracing::SpansetState::appendSpanToShard(
     const tempo_utils::SpanId &id,
+    tu_uint32 parentIndex,
+    const tempo_utils::SpanId &parentId,
     FailurePropagation propagation,
     FailureCollection collection)
 {
-    tu_uint32 index = m_size;
+    auto *shard = getThreadShard();
+    absl::MutexLock locker(&shard->lock);
 
-    // construct span data in-place at the end of the spans list
-    auto data = m_spans.emplace(m_spans.cend(), index, id);
-    m_size++;
+    // the sealed flag is checked while holding the shard lock, so once seal() returns no
+    // further spans can be appended
+    if (m_sealed.load(std::memory_order_acquire))
+        return nullptr;
 
-    data->propagation = propagation;
-    data->collection = collection;
+    tu_uint32 index = m_size.fetch_add(1, std::memory_order_relaxed);
+    TU_ASSERT (parentIndex == kInvalidAddressU32 || parentIndex < index);   // the parent span must come before the child span (prevents cycles)
 
-    return *data;
+    // construct span data in-place at the end of the shard arena
+    auto &data = shard->spans.append(index, id, parentIndex, parentId);
+
+    data.propagation = propagation;
+    data.collection = collection;
+
+    return &data;
+}
+
+/**
+ * Append a root span.
+ *
+ * @return The span data, or nullptr if the state is sealed. The span data remains valid for the
+ *   lifetime of the state.
+ */
+tempo_tracing::SpanData *
+tempo_tracing::SpansetState::appendSpan(
+    const tempo_utils::SpanId &id,
+    FailurePropagation propagation,
+    FailureCollection collection)
+{
+    return appendSpanToShard(id, kInvalidAddressU32, {}, propagation, collection);
 }
 
-tempo_tracing::SpanData&
+/**
+ * Append a child span. The child span is added to the children of the parent when the spans
+ * are merged, so the parent span data is not modified.
+ *
+ * @return The span data, or nullptr if the state is sealed. The span data remains valid for the
+ *   lifetime of the state.
+ */
+tempo_tracing::SpanData *
 tempo_tracing::SpansetState::appendSpan(
     const tempo_utils::SpanId &id,
     tu_uint32 parentIndex,
@@ -40,76 +112,77 @@ tempo_tracing::SpansetState::appendSpan(
     FailurePropagation propagation,
     FailureCollection collection)
 {
-    tu_uint32 index = m_size;
-    TU_ASSERT (parentIndex < index);    // the parent span must come before the child  span (prevents cycles)
-
-    // construct span data in-place at the end of the spans list
-    auto data = m_spans.emplace(m_spans.cend(), index, id, parentIndex, parentId);
-    m_size++;
+    return appendSpanToShard(id, parentIndex, parentId, propagation, collection);
+}
 
-    data->propagation = propagation;
-    data->collection = collection;
+bool
+tempo_tracing::SpansetState::isSealed() const
+{
+    return m_sealed.load(std::memory_order_acquire);
+}
 
-    return *data;
+/**
+ * Prevent any further spans from being appended. When this method returns, every span which
+ * was being appended concurrently has been completely appended.
+ */
+void
+tempo_tracing::SpansetState::seal()
+{
+    absl::MutexLock locker(&m_shardsLock);
+    m_sealed.store(true, std::memory_order_release);
+    // wait for any append which observed the state before it was sealed
+    for (auto &shard : m_shards) {
+        absl::MutexLock shardLocker(&shard->lock);
+    }
 }
 
-static std::pair<tts1::Value,flatbuffers::Offset<void>>
-serialize_value(flatbuffers::FlatBufferBuilder &buffer, const tempo_schema::AttrValue &value)
+/**
+ * Index of the children of each span in compressed sparse row form, where the children of span
+ * N are `indexes[offsets[N]]` through `indexes[offsets[N + 1] - 1]`, ordered by span index.
+ */
+struct SpanChildren {
+    std::vector<tu_uint32> offsets;
+    std::vector<tu_uint32> indexes;
+
+    std::span<const tu_uint32> of(tu_uint32 spanIndex) const {
+        return std::span<const tu_uint32>(indexes).subspan(
+            offsets[spanIndex], offsets[spanIndex + 1] - offsets[spanIndex]);
+    }
+};
+
+static SpanChildren
+index_span_children(const std::vector<const tempo_tracing::SpanData *> &spans)
 {
-    switch (value.getType()) {
-        case tempo_schema::ValueType::Nil: {
-            auto type = tts1::Value::TrueFalseNilValue;
-            auto offset = tts1::CreateTrueFalseNilValue(buffer, tts1::TrueFalseNil::Nil).Union();
-            return {type, offset};
-        }
-        case tempo_schema::ValueType::Bool: {
-            auto type = tts1::Value::TrueFalseNilValue;
-            auto tfn = value.getBool()? tts1::TrueFalseNil::True : tts1::TrueFalseNil::False;
-            auto offset = tts1::CreateTrueFalseNilValue(buffer, tfn).Union();
-            return {type, offset};
-        }
-        case tempo_schema::ValueType::Int64: {
-            auto type = tts1::Value::Int64Value;
-            auto offset = tts1::CreateInt64Value(buffer, value.getInt64()).Union();
-            return {type, offset};
+    SpanChildren children;
+    children.offsets.resize(spans.size() + 1, 0);
+    for (const auto *span : spans) {
+        if (span->parentIndex != tempo_tracing::kInvalidAddressU32) {
+            children.offsets[span->parentIndex + 1]++;
         }
-        case tempo_schema::ValueType::Float64: {
-            auto type = tts1::Value::Float64Value;
-            auto offset = tts1::CreateFloat64Value(buffer, value.getFloat64()).Union();
-            return {type, offset};
-        }
-        case tempo_schema::ValueType::UInt64: {
-            auto type = tts1::Value::UInt64Value;
-            auto offset = tts1::CreateUInt64Value(buffer, value.getUInt64()).Union();
-            return {type, offset};
-        }
-        case tempo_schema::ValueType::UInt32: {
-            auto type = tts1::Value::UInt32Value;
-            auto offset = tts1::CreateUInt32Value(buffer, value.getUInt32()).Union();
-            return {type, offset};
-        }
-        case tempo_schema::ValueType::UInt16: {
-            auto type = tts1::Value::UInt16Value;
-            auto offset = tts1::CreateUInt16Value(buffer, value.getUInt16()).Union();
-            return {type, offset};
-        }
-        case tempo_schema::ValueType::UInt8: {
-            auto type = tts1::Value::UInt8Value;
-            auto offset = tts1::CreateUInt8Value(buffer, value.getUInt8()).Union();
-            return {type, offset};
-        }
-        case tempo_schema::ValueType::String: {
-            auto type = tts1::Value::StringValue;
-            auto offset = tts1::CreateStringValue(buffer, buffer.CreateSharedString(value.stringView())).Union();
-            return {type, offset};
+    }
+    for (size_t i = 1; i < children.offsets.size(); i++) {
+        children.offsets[i] += children.offsets[i - 1];
+    }
+    // spans are visited in index order, so the children of each span are ordered by creation
+    children.indexes.resize(children.offsets.back());
+    std::vector<tu_uint32> next(children.offsets.cbegin(), children.offsets.cend() - 1);
+    for (const auto *span : spans) {
+        if (span->parentIndex != tempo_tracing::kInvalidAddressU32) {
+            children.indexes[next[span->parentIndex]++] = span->spanIndex;
         }
-        default:
-            TU_UNREACHABLE();
     }
+    return children;
 }
 
-void
-evaluate_error_propagation(std::vector<tempo_tracing::SpanData> &spans)
+/**
+ * Apply failure propagation to the spans. The span data is not modified; instead the failed
+ * state of each span is read from and written to `failed`, which is indexed by span index.
+ */
+static void
+evaluate_error_propagation(
+    const std::vector<const tempo_tracing::SpanData *> &spans,
+    const SpanChildren &children,
+    std::vector<bool> &failed)
 {
     if (spans.empty())
         return;
@@ -117,42 +190,41 @@ evaluate_error_propagation(std::vector<tempo_tracing::SpanData> &spans)
     tempo_utils::CompressedBitmap seenMap(spans.size());
 
     std::stack<tu_uint32> stack;
-    stack.emplace(spans.front().spanIndex);
+    stack.emplace(spans.front()->spanIndex);
 
     while (!stack.empty()) {
         auto span_index = stack.top();
         if (!seenMap.contains(span_index)) {
             seenMap.add(span_index);
-            const auto &span = spans.at(span_index);
-            for (auto child_index : span.children) {
-                const auto &child = spans.at(child_index);
-                stack.push(child.spanIndex);
+            for (auto child_index : children.of(span_index)) {
+                stack.push(child_index);
             }
         } else {
             stack.pop();
-            auto &span = spans.at(span_index);
+            const auto *span = spans.at(span_index);
             // if span ignores propagation then do nothing
-            if (span.collection == tempo_tracing::FailureCollection::IgnoresPropagation)
+            if (span->collection == tempo_tracing::FailureCollection::IgnoresPropagation)
                 continue;
             // otherwise count the number of failed children with propagation enabled
             int nerrors = 0;
-            for (auto child_index : span.children) {
-                const auto &child = spans.at(child_index);
-                if (child.failed && child.propagation == tempo_tracing::FailurePropagation::PropagatesToParent) {
+            auto span_children = children.of(span_index);
+            for (auto child_index : span_children) {
+                const auto *child = spans.at(child_index);
+                if (failed[child_index] && child->propagation == tempo_tracing::FailurePropagation::PropagatesToParent) {
                     nerrors++;
                 }
             }
-            switch (span.collection) {
+            switch (span->collection) {
                 // set failure on span if all children failed
                 case tempo_tracing::FailureCollection::AllChildrenFailed:
-                    if (nerrors == span.children.size()) {
-                        span.failed = true;
+                    if (nerrors == span_children.size()) {
+                        failed[span_index] = true;
                     }
                     break;
                 // set failure on span if at least one child failed
                 case tempo_tracing::FailureCollection::AnyChildFailed:
                     if (nerrors > 0) {
-                        span.failed = true;
+                        failed[span_index] = true;
                     }
                     break;
                 default:
@@ -162,182 +234,76 @@ evaluate_error_propagation(std::vector<tempo_tracing::SpanData> &spans)
     }
 }
 
-tempo_utils::Result<tempo_tracing::TempoSpanset>
-tempo_tracing::SpansetState::toSpanset() const
+/**
+ * Returns true if the trace should be kept under tail sampling, which is the case if any span
+ * failed (including failures applied by propagation) or if any span was active or open for at
+ * least the latency threshold.
+ */
+static bool
+is_tail_sampled(
+    const std::vector<const tempo_tracing::SpanData *> &spans,
+    const std::vector<bool> &failed,
+    absl::Duration latencyThreshold)
 {
-    flatbuffers::FlatBufferBuilder buffer;
-
-    auto trace_id_hi = m_id.getHi();
-    auto trace_id_lo = m_id.getLo();
-
-    absl::flat_hash_map<std::string_view,tu_uint32> nscache;
-
-    std::vector<flatbuffers::Offset<tts1::NamespaceDescriptor>> namespaces_vector;
-    std::vector<flatbuffers::Offset<tts1::SpanDescriptor>> spans_vector;
-    std::vector<flatbuffers::Offset<tts1::AttributeDescriptor>> attrs_vector;
-    std::vector<flatbuffers::Offset<tts1::LogDescriptor>> logs_vector;
-    std::vector<tu_uint32> roots_vector;
-    std::vector<tu_uint32> errors_vector;
-
-    // copy spans list into mutable span vector
-    std::vector spans(m_spans.cbegin(), m_spans.cend());
-
-    // apply error propagation
-    evaluate_error_propagation(spans);
-
-    // build vector of span descriptors
-    for (const auto &spanData : spans) {
-
-        tu_uint32 span_index = spans_vector.size();
-
-        tu_int64 start_time = spanData.startTimeMillisSinceEpoch;
-        tu_int64 end_time = spanData.endTimeMillisSinceEpoch;
-        tu_int64 duration = absl::ToInt64Nanoseconds(spanData.activeDuration);
-
-        tu_uint32 parent_index = tempo_tracing::kInvalidAddressU32;
-        tu_uint64 parent_id = 0;
-        if (!spanData.parentId.isValid()) {
-            // if parent is invalid then this is a root span
-            roots_vector.push_back(span_index);
-        } else {
-            // otherwise record the parent span id
-            parent_index = spanData.parentIndex;
-            parent_id = spanData.parentId.getId();
-        }
-
-        // if span is marked failed, then add the index to the errors vector
-        if (spanData.failed) {
-            errors_vector.push_back(span_index);
-        }
-
-        std::vector<tu_uint32> children;
-        std::vector<tu_uint32> tags;
-        std::vector<tu_uint32> logs;
-
-        for (const auto index : spanData.children) {
-            children.push_back(index);
+    for (const auto *span : spans) {
+        if (failed[span->spanIndex])
+            return true;
+        if (span->activeDuration >= latencyThreshold)
+            return true;
+        if (span->startTimeNanosSinceEpoch >= 0 && span->endTimeNanosSinceEpoch >= 0) {
+            auto elapsed = absl::Nanoseconds(span->endTimeNanosSinceEpoch - span->startTimeNanosSinceEpoch);
+            if (elapsed >= latencyThreshold)
+                return true;
         }
+    }
+    return false;
+}
 
-        for (const auto &tag : spanData.tags) {
-            tu_uint32 index = attrs_vector.size();
-
-            const auto &key = tag.first;
-            tu_uint32 ns;
-            std::string_view nskey(key.ns);
-            if (!nscache.contains(nskey)) {
-                ns = namespaces_vector.size();
-                namespaces_vector.push_back(tts1::CreateNamespaceDescriptor(buffer,
-                    buffer.CreateString(key.ns)));
-                nscache[nskey] = ns;
-            } else {
-                ns = nscache.at(std::string_view(key.ns));
+/**
+ * Build a spanset from the recorded spans. The state must be sealed.
+ *
+ * @param policy The sampling policy. If tail sampling is enabled and the trace is not kept,
+ *   then the spanset is not built and an invalid TempoSpanset is returned.
+ * @return The spanset.
+ */
+tempo_utils::Result<tempo_tracing::TempoSpanset>
+tempo_tracing::SpansetState::toSpanset(const SamplingPolicy &policy) const
+{
+    if (!isSealed())
+        return TracingStatus::forCondition(TracingCondition::kRecorderNotClosed);
+
+    // merge the shards into a vector of spans ordered by span index. the shards are not
+    // modified after the state is sealed, so the span data is read in place rather than copied.
+    absl::MutexLock locker(&m_shardsLock);
+    std::vector<const SpanData *> spans(m_size.load(std::memory_order_acquire), nullptr);
+    for (const auto &shard : m_shards) {
+        absl::MutexLock shardLocker(&shard->lock);
+        for (int i = 0; i < shard->spans.numChunks(); i++) {
+            for (const auto &spanData : shard->spans.getChunk(i)) {
+                spans[spanData.spanIndex] = &spanData;
             }
-
-            auto p = serialize_value(buffer, tag.second);
-
-            attrs_vector.push_back(tts1::CreateAttributeDescriptor(buffer,
-                ns, key.id, p.first, p.second));
-            tags.push_back(index);
         }
+    }
 
-        for (const auto &log : spanData.logs) {
-            std::vector<tu_uint32> fields;
-
-            for (const auto &field : log.fields) {
-                tu_uint32 index = attrs_vector.size();
-
-                const auto &key = field.first;
-                tu_uint32 ns;
-                std::string_view nskey(key.ns);
-                if (!nscache.contains(nskey)) {
-                    ns = namespaces_vector.size();
-                    namespaces_vector.push_back(tts1::CreateNamespaceDescriptor(buffer,
-                        buffer.CreateString(key.ns)));
-                    nscache[nskey] = ns;
-                } else {
-                    ns = nscache.at(std::string_view(key.ns));
-                }
-
-                auto p = serialize_value(buffer, field.second);
-
-                attrs_vector.push_back(tts1::CreateAttributeDescriptor(buffer,
-                    ns, key.id, p.first, p.second));
-                fields.push_back(index);
-            }
+    auto children = index_span_children(spans);
 
-            tts1::LogSeverity log_severity;
-            switch (log.severity) {
-                case LogSeverity::kFatal:
-                    log_severity = tts1::LogSeverity::Fatal;
-                    break;
-                case LogSeverity::kError:
-                    log_severity = tts1::LogSeverity::Error;
-                    break;
-                case LogSeverity::kWarn:
-                    log_severity = tts1::LogSeverity::Warn;
-                    break;
-                case LogSeverity::kInfo:
-                    log_severity = tts1::LogSeverity::Info;
-                    break;
-                case LogSeverity::kVerbose:
-                    log_severity = tts1::LogSeverity::Verbose;
-                    break;
-                case LogSeverity::kVeryVerbose:
-                    log_severity = tts1::LogSeverity::VeryVerbose;
-                    break;
-                default:
-                    TU_UNREACHABLE();
-            }
-
-            tu_uint64 log_ts = ToUnixMillis(log.ts);
-            auto log_fields = buffer.CreateVector(fields);
+    // apply error propagation
+    std::vector<bool> failed(spans.size());
+    for (const auto *spanData : spans) {
+        TU_NOTNULL (spanData);
+        failed[spanData->spanIndex] = spanData->failed;
+    }
+    evaluate_error_propagation(spans, children, failed);
 
-            tu_uint32 index = logs_vector.size();
-            logs_vector.push_back(tts1::CreateLogDescriptor(buffer, log_ts, log_severity, log_fields));
-            logs.push_back(index);
-        }
+    // discard the trace before serializing it if tail sampling does not keep it
+    if (policy.tailSampling && !is_tail_sampled(spans, failed, policy.latencyThreshold))
+        return TempoSpanset();
 
-        tu_uint64 span_id = spanData.spanId.getId();
-
-        spans_vector.push_back(tts1::CreateSpanDescriptor(buffer,
-            span_id,
-            buffer.CreateSharedString(spanData.operationName),
-            parent_index,
-            parent_id,
-            buffer.CreateVector(children),
-            spanData.failed,
-            start_time,
-            end_time,
-            duration,
-            buffer.CreateVector(tags),
-            buffer.CreateVector(logs)));
+    // serialize the spans in index order, so span indexes in the spanset match the state
+    internal::SpansetWriter writer(m_id);
+    for (const auto *span : spans) {
+        writer.appendSpan(*span, span->parentIndex, children.of(span->spanIndex), failed[span->spanIndex]);
     }
 
-    auto fb_namespaces = buffer.CreateVector(namespaces_vector);
-    auto fb_spans = buffer.CreateVector(spans_vector);
-    auto fb_attrs = buffer.CreateVector(attrs_vector);
-    auto fb_logs = buffer.CreateVector(logs_vector);
-    auto fb_roots = buffer.CreateVector(roots_vector);
-    auto fb_errors = buffer.CreateVector(errors_vector);
-
-    // build spanset from buffer
-    tts1::SpansetBuilder spansetBuilder(buffer);
-
-    spansetBuilder.add_abi(tts1::SpansetVersion::Version1);
-    spansetBuilder.add_trace_id_hi(trace_id_hi);
-    spansetBuilder.add_trace_id_lo(trace_id_lo);
-    spansetBuilder.add_namespaces(fb_namespaces);
-    spansetBuilder.add_spans(fb_spans);
-    spansetBuilder.add_attrs(fb_attrs);
-    spansetBuilder.add_logs(fb_logs);
-    spansetBuilder.add_roots(fb_roots);
-    spansetBuilder.add_errors(fb_errors);
-
-    // serialize spanset and mark the buffer as finished
-    auto spanset = spansetBuilder.Finish();
-    buffer.Finish(spanset, tts1::SpansetIdentifier());
-
-    // copy the flatbuffer into our own byte array and instantiate package
-    auto bytes = tempo_utils::MemoryBytes::copy(buffer.GetBufferSpan());
-    return tempo_tracing::TempoSpanset(bytes);
+    return tempo_tracing::TempoSpanset(writer.finish());
 }
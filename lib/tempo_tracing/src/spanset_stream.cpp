@@ -0,0 +1,289 @@
+
+#include <tempo_tracing/internal/spanset_reader.h>
+#include <tempo_tracing/internal/spanset_writer.h>
+#include <tempo_tracing/spanset_stream.h>
+#include <tempo_tracing/tracing_result.h>
+#include <tempo_utils/bytes_appender.h>
+#include <tempo_utils/bytes_iterator.h>
+
+tempo_tracing::SpansetStream::SpansetStream(
+    tempo_utils::TraceId traceId,
+    SpansetFragmentCallback callback,
+    const SpansetStreamOptions &options)
+    : m_traceId(traceId),
+      m_callback(std::move(callback)),
+      m_options(options),
+      m_nextIndex(0),
+      m_sealed(false)
+{
+    TU_ASSERT (m_callback != nullptr);
+    TU_ASSERT (m_options.maxFragmentSpans > 0);
+    m_writer = std::make_unique<internal::SpansetWriter>(m_traceId);
+}
+
+/**
+ * Write any spans which were completed after the stream was last flushed. Spans which have not
+ * been completed are discarded.
+ */
+tempo_tracing::SpansetStream::~SpansetStream()
+{
+    absl::MutexLock locker(&m_lock);
+    flushUnlocked();
+}
+
+/**
+ * Allocate an index for a new span. If the parent span and its subtree were already written, which
+ * happens when a child is made from a SpanContext after the parent closed, then the span is tracked
+ * as a root of the stream. The span still records the id of its parent, so
+ * `concatenate_spanset_fragments` links it to the parent, but its failure is not propagated.
+ *
+ * @param parentIndex The index of the parent span, or kInvalidAddressU32 if the span is a root.
+ * @return The span index, or kInvalidAddressU32 if the stream is sealed.
+ */
+tu_uint32
+tempo_tracing::SpansetStream::registerSpan(tu_uint32 parentIndex)
+{
+    absl::MutexLock locker(&m_lock);
+    if (m_sealed)
+        return kInvalidAddressU32;
+
+    tu_uint32 index = m_nextIndex++;
+    if (parentIndex != kInvalidAddressU32) {
+        auto entry = m_pending.find(parentIndex);
+        if (entry != m_pending.cend()) {
+            entry->second.numChildren++;
+            entry->second.numOpenChildren++;
+        } else {
+            parentIndex = kInvalidAddressU32;
+        }
+    }
+    m_pending[index].parentIndex = parentIndex;
+    return index;
+}
+
+/**
+ * Mark the span as closed. If all descendants of the span are closed then the span is written
+ * immediately, otherwise a copy of the span data is kept until the last descendant is closed.
+ *
+ * @param spanData The span data, which is not referenced after this method returns.
+ */
+void
+tempo_tracing::SpansetStream::completeSpan(const SpanData &spanData)
+{
+    absl::MutexLock locker(&m_lock);
+    auto &pending = m_pending.at(spanData.spanIndex);
+    if (pending.numOpenChildren > 0) {
+        pending.closedData = std::make_unique<SpanData>(spanData);
+        return;
+    }
+    writeCompletedSpanUnlocked(&spanData);
+}
+
+/**
+ * Serialize the span, then notify the parent span that its child is complete. If the parent
+ * was already closed and this was its last open child then the parent is written as well, and
+ * so on up the tree. Failure is propagated to the parent using the same rules applied by
+ * `SpansetState::toSpanset`.
+ */
+void
+tempo_tracing::SpansetStream::writeCompletedSpanUnlocked(const SpanData *spanData)
+{
+    std::unique_ptr<SpanData> closedData;
+
+    while (spanData != nullptr) {
+        auto entry = m_pending.find(spanData->spanIndex);
+        TU_ASSERT (entry != m_pending.cend());
+        const auto &pending = entry->second;
+
+        bool failed = spanData->failed;
+        switch (spanData->collection) {
+            case FailureCollection::AllChildrenFailed:
+                failed |= pending.numFailedChildren == pending.numChildren;
+                break;
+            case FailureCollection::AnyChildFailed:
+                failed |= pending.numFailedChildren > 0;
+                break;
+            default:
+                break;
+        }
+
+        // the parent index is only meaningful within the stream, so it is not written
+        m_writer->appendSpan(*spanData, kInvalidAddressU32, {}, failed);
+
+        auto parentIndex = pending.parentIndex;
+        bool propagates = failed && spanData->propagation == FailurePropagation::PropagatesToParent;
+        m_pending.erase(entry);
+        spanData = nullptr;
+
+        if (m_writer->numSpans() >= m_options.maxFragmentSpans) {
+            flushUnlocked();
+        }
+
+        if (parentIndex == kInvalidAddressU32)
+            break;
+        auto &parent = m_pending.at(parentIndex);
+        parent.numOpenChildren--;
+        if (propagates) {
+            parent.numFailedChildren++;
+        }
+        if (parent.numOpenChildren == 0 && parent.closedData != nullptr) {
+            closedData = std::move(parent.closedData);
+            spanData = closedData.get();
+        }
+    }
+}
+
+tempo_utils::Status
+tempo_tracing::SpansetStream::flushUnlocked()
+{
+    if (m_writer->numSpans() == 0)
+        return m_status;
+
+    auto bytes = m_writer->finish();
+    m_writer = std::make_unique<internal::SpansetWriter>(m_traceId);
+
+    // once the callback has failed no further fragments are written, because the stream
+    // would be missing spans
+    if (m_status.notOk())
+        return m_status;
+
+    tempo_utils::BytesAppender appender(sizeof(tu_uint32) + bytes->getSize());
+    appender.appendU32LE(bytes->getSize());
+    appender.appendBytes(bytes->getSpan());
+    m_status = m_callback(std::span<const tu_uint8>(appender.getData(), appender.getSize()));
+    return m_status;
+}
+
+/**
+ * Write the spans which have been completed but not yet written.
+ *
+ * @return The status of the first fragment which failed to be written, or ok.
+ */
+tempo_utils::Status
+tempo_tracing::SpansetStream::flush()
+{
+    absl::MutexLock locker(&m_lock);
+    return flushUnlocked();
+}
+
+bool
+tempo_tracing::SpansetStream::isSealed() const
+{
+    absl::MutexLock locker(&m_lock);
+    return m_sealed;
+}
+
+/**
+ * Prevent any further spans from being registered, and write the completed spans. Spans which
+ * are still open are written when they are closed.
+ */
+void
+tempo_tracing::SpansetStream::seal()
+{
+    absl::MutexLock locker(&m_lock);
+    m_sealed = true;
+    flushUnlocked();
+}
+
+/**
+ * Returns a fragment callback which appends each fragment to the specified file.
+ */
+tempo_tracing::SpansetFragmentCallback
+tempo_tracing::append_spanset_fragments(std::shared_ptr<tempo_utils::FileAppender> appender)
+{
+    TU_ASSERT (appender != nullptr);
+    return [appender](std::span<const tu_uint8> fragment) -> tempo_utils::Status {
+        return appender->appendBytes(fragment);
+    };
+}
+
+/**
+ * Rebuild a spanset from a sequence of length-prefixed spanset fragments written by a
+ * SpansetStream. The parent and children of each span are resolved from the parent span ids,
+ * and spans are ordered so that each parent precedes its children.
+ *
+ * @param bytes The concatenated fragments.
+ * @return The spanset.
+ */
+tempo_utils::Result<tempo_tracing::TempoSpanset>
+tempo_tracing::concatenate_spanset_fragments(std::span<const tu_uint8> bytes)
+{
+    std::vector<std::unique_ptr<internal::SpansetReader>> readers;
+    tempo_utils::TraceId traceId;
+
+    struct FragmentSpan {
+        const internal::SpansetReader *reader;
+        const tts1::SpanDescriptor *span;
+        std::vector<tu_uint32> children;
+        tu_uint32 index = kInvalidAddressU32;
+        tu_uint32 parentIndex = kInvalidAddressU32;
+    };
+    std::vector<FragmentSpan> spans;
+
+    tempo_utils::BytesIterator it(bytes);
+    while (it.bytesLeft() > 0) {
+        tu_uint32 size;
+        std::span<const tu_uint8> fragment;
+        if (!it.nextU32LE(size) || !it.nextSlice(fragment, size))
+            return TracingStatus::forCondition(TracingCondition::kTracingInvariant,
+                "truncated spanset fragment");
+        if (!TempoSpanset::verify(fragment))
+            return TracingStatus::forCondition(TracingCondition::kTracingInvariant,
+                "invalid spanset fragment");
+
+        auto *reader = readers.emplace_back(std::make_unique<internal::SpansetReader>(fragment)).get();
+        if (readers.size() == 1) {
+            traceId = reader->getTraceId();
+        } else if (reader->getTraceId() != traceId) {
+            return TracingStatus::forCondition(TracingCondition::kTracingInvariant,
+                "spanset fragment has unexpected trace id");
+        }
+        for (tu_uint32 i = 0; i < reader->numSpans(); i++) {
+            spans.push_back({reader, reader->getSpan(i), {}});
+        }
+    }
+
+    // link each span to its parent. spans are written after their children, so the parent is
+    // resolved only after all fragments have been read. a span whose parent is in none of the
+    // fragments is an orphan, and is written as a root so its subtree remains reachable
+    absl::flat_hash_map<tu_uint64,tu_uint32> spanIds;
+    for (tu_uint32 i = 0; i < spans.size(); i++) {
+        spanIds[spans[i].span->span_id()] = i;
+    }
+    std::vector<tu_uint32> roots;
+    for (tu_uint32 i = 0; i < spans.size(); i++) {
+        auto entry = spanIds.find(spans[i].span->parent_id());
+        if (spans[i].span->parent_id() == 0 || entry == spanIds.cend()) {
+            roots.push_back(i);
+        } else {
+            spans[entry->second].children.push_back(i);
+        }
+    }
+
+    // assign spanset indexes in depth-first order so that each parent precedes its children
+    std::vector<tu_uint32> order;
+    std::vector<tu_uint32> stack(roots.crbegin(), roots.crend());
+    while (!stack.empty()) {
+        auto curr = stack.back();
+        stack.pop_back();
+        spans[curr].index = order.size();
+        order.push_back(curr);
+        const auto &children = spans[curr].children;
+        for (auto child = children.crbegin(); child != children.crend(); child++) {
+            spans[*child].parentIndex = spans[curr].index;
+            stack.push_back(*child);
+        }
+    }
+
+    internal::SpansetWriter writer(traceId);
+    for (auto curr : order) {
+        const auto &fragmentSpan = spans[curr];
+        std::vector<tu_uint32> children;
+        for (auto child : fragmentSpan.children) {
+            children.push_back(spans[child].index);
+        }
+        writer.appendSpan(*fragmentSpan.reader, fragmentSpan.span, fragmentSpan.parentIndex, children);
+    }
+
+    return TempoSpanset(writer.finish());
+}
@@ -41,6 +41,8 @@ tempo_tracing::TempoSpanset::getABI() const
     switch (m_reader->getABI()) {
         case tts1::SpansetVersion::Version1:
             return SpansetVersion::Version1;
+        case tts1::SpansetVersion::Version2:
+            return SpansetVersion::Version2;
         case tts1::SpansetVersion::Unknown:
         default:
             return SpansetVersion::Unknown;
@@ -169,6 +169,60 @@ tempo_tracing::TraceContext::makeUnownedContextAndSwitch(
     return switchCurrent(context->m_name);
 }
 
+/**
+ * Create a new unowned context in the thread-local context map which resumes the trace of the
+ * span referenced by the specified SpanContext. The first span pushed onto the context is made a
+ * child of the referenced span, so work handed off to another thread or resumed in a coroutine
+ * is attached to the span which started it. If the specified name is empty then a name is
+ * autogenerated.
+ *
+ * @param parent
+ * @param name
+ * @return
+ */
+tempo_utils::Result<std::shared_ptr<tempo_tracing::TraceContext>>
+tempo_tracing::TraceContext::resumeContext(
+    const SpanContext &parent,
+    std::string_view name)
+{
+    if (!parent.isValid())
+        return TracingStatus::forCondition(TracingCondition::kTracingInvariant,
+            "invalid span context");
+    auto &thread_context = internal::get_thread_context();
+    std::string contextName;
+    if (name.empty()) {
+        auto uuid = tempo_utils::UUID::randomUUID();
+        contextName = uuid.toRfc4122String();
+    } else {
+        contextName = name;
+    }
+    if (thread_context.contexts.contains(contextName))
+        return TracingStatus::forCondition(TracingCondition::kTracingInvariant,
+            "trace context {} already exists", contextName);
+    auto context = std::shared_ptr<TraceContext>(
+        new TraceContext(contextName, parent.getRecorder(), /* unowned= */ true, parent));
+    thread_context.contexts[contextName] = context;
+    return context;
+}
+
+/**
+ * Create a new unowned context which resumes the trace of the span referenced by the specified
+ * SpanContext, and make it the current context for the thread.
+ *
+ * @param parent
+ * @param name
+ * @return
+ */
+tempo_utils::Result<std::shared_ptr<tempo_tracing::TraceContext>>
+tempo_tracing::TraceContext::resumeContextAndSwitch(
+    const SpanContext &parent,
+    std::string_view name)
+{
+    std::shared_ptr<TraceContext> context;
+    TU_ASSIGN_OR_RETURN (context, resumeContext(parent, name));
+    return switchCurrent(context->m_name);
+}
+
 /**
  * Releases the specified context from the thread-local context map and returns the associated
  * recorder. The recorder is not closed.
@@ -195,11 +249,13 @@ tempo_tracing::TraceContext::releaseContext(std::string_view name)
 tempo_tracing::TraceContext::TraceContext(
     std::string_view name,
     std::shared_ptr<TraceRecorder> recorder,
-    bool unowned)
+    bool unowned,
+    const SpanContext &parent)
     : m_name(name),
       m_tid(std::this_thread::get_id()),
       m_recorder(std::move(recorder)),
       m_unowned(unowned),
+      m_parent(parent),
       m_isActive(false)
 {
     TU_ASSERT (!m_name.empty());
@@ -289,6 +345,8 @@ tempo_tracing::TraceContext::pushSpan(FailurePropagation propagation, FailureCol
     if (!m_spanStack.empty()) {
         auto &parent = m_spanStack.back();
         span = parent->makeSpan(propagation, collection);
+    } else if (m_parent.isValid()) {
+        span = m_parent.makeSpan(propagation, collection);
     } else {
         span = m_recorder->makeSpan(propagation, collection);
     }
@@ -4,25 +4,36 @@
 #include <tempo_tracing/trace_recorder.h>
 #include <tempo_tracing/trace_span.h>
 
-tempo_tracing::TraceRecorder::TraceRecorder()
-    : m_id(tempo_utils::TraceId::generate()),
-      m_closed(false)
+/**
+ * Make the head sampling decision for a new trace.
+ */
+static bool
+is_head_sampled(double headSampleRate)
 {
-    m_state = std::make_unique<SpansetState>(m_id);
-    m_lock = new absl::Mutex();
+    if (headSampleRate >= 1.0)
+        return true;
+    if (headSampleRate <= 0.0)
+        return false;
+    static thread_local std::mt19937_64 randengine{std::random_device()()};
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    return dist(randengine) < headSampleRate;
 }
 
-tempo_tracing::TraceRecorder::TraceRecorder(tempo_utils::TraceId id)
+tempo_tracing::TraceRecorder::TraceRecorder(
+    tempo_utils::TraceId id,
+    const SamplingPolicy &policy,
+    std::unique_ptr<SpansetStream> stream)
     : m_id(id),
-      m_closed(false)
+      m_policy(policy),
+      m_sampled(is_head_sampled(policy.headSampleRate)),
+      m_stream(std::move(stream)),
+      m_perfCounters(false)
 {
     m_state = std::make_unique<SpansetState>(m_id);
-    m_lock = new absl::Mutex();
 }
 
 tempo_tracing::TraceRecorder::~TraceRecorder()
 {
-    delete m_lock;
 }
 
 tempo_utils::TraceId
@@ -31,17 +42,80 @@ tempo_tracing::TraceRecorder::traceId() const
     return m_id;
 }
 
+tempo_tracing::SamplingPolicy
+tempo_tracing::TraceRecorder::getSamplingPolicy() const
+{
+    return m_policy;
+}
+
+/**
+ * Returns true if the trace was selected by head sampling. Spans of an unsampled trace are not
+ * appended to the spanset, and do not record tags or logs.
+ */
+bool
+tempo_tracing::TraceRecorder::isSampled() const
+{
+    return m_sampled;
+}
+
+/**
+ * Returns true if spans are streamed as spanset fragments rather than retained until the
+ * recorder is closed.
+ */
+bool
+tempo_tracing::TraceRecorder::isStreaming() const
+{
+    return m_stream != nullptr;
+}
+
+std::shared_ptr<tempo_tracing::SpanLatencyMetrics>
+tempo_tracing::TraceRecorder::getLatencyMetrics() const
+{
+    return m_metrics;
+}
+
+/**
+ * Record the duration of each span into the specified metrics when the span is closed. Spans
+ * are recorded whether or not the trace is sampled. The metrics may be shared by many recorders,
+ * and must be set before the recorder makes any spans.
+ */
+void
+tempo_tracing::TraceRecorder::setLatencyMetrics(std::shared_ptr<SpanLatencyMetrics> metrics)
+{
+    m_metrics = std::move(metrics);
+}
+
+bool
+tempo_tracing::TraceRecorder::isPerfCountersEnabled() const
+{
+    return m_perfCounters;
+}
+
+/**
+ * Read the performance counters of the thread each time a span is activated and deactivated,
+ * and tag each sampled span with the counter deltas when it is closed. Hardware counters are
+ * used if they are available, otherwise only the software counters are recorded. Must be set
+ * before the recorder makes any spans.
+ */
+void
+tempo_tracing::TraceRecorder::setPerfCountersEnabled(bool enabled)
+{
+    m_perfCounters = enabled;
+}
+
 std::shared_ptr<tempo_tracing::TraceSpan>
 tempo_tracing::TraceRecorder::makeSpan(FailurePropagation propagation, FailureCollection collection)
 {
-    absl::MutexLock locker(m_lock);
+    if (!m_sampled)
+        return makeUnsampledSpan(propagation, collection);
+    if (m_stream != nullptr)
+        return makeStreamedSpan(kInvalidAddressU32, {}, propagation, collection);
 
-    if (m_closed)
+    auto *data = m_state->appendSpan(tempo_utils::SpanId::generate(), propagation, collection);
+    if (data == nullptr)
         return {};
 
-    SpanData& data = m_state->appendSpan(tempo_utils::SpanId::generate(), propagation, collection);
-
-    auto *span = new TraceSpan(shared_from_this(), data);
+    auto *span = new TraceSpan(shared_from_this(), *data);
     return std::shared_ptr<TraceSpan>(span);
 }
 
@@ -52,52 +126,194 @@ tempo_tracing::TraceRecorder::makeSpan(
     FailureCollection collection)
 {
     TU_ASSERT (parentSpan != nullptr);
+    // the parent span index and id are immutable, so the parent span lock is not needed
+    const SpanData& parentData = parentSpan->m_data;
+    return makeChildSpan(parentData.spanIndex, parentData.spanId, propagation, collection);
+}
 
-    absl::MutexLock locker(m_lock);
+/**
+ * Make a child span of the span with the specified index and id. The parent span is not
+ * accessed, so a child span can be made from a SpanContext on any thread.
+ */
+std::shared_ptr<tempo_tracing::TraceSpan>
+tempo_tracing::TraceRecorder::makeChildSpan(
+    tu_uint32 parentIndex,
+    const tempo_utils::SpanId &parentId,
+    FailurePropagation propagation,
+    FailureCollection collection)
+{
+    if (!m_sampled)
+        return makeUnsampledSpan(propagation, collection);
+    if (m_stream != nullptr)
+        return makeStreamedSpan(parentIndex, parentId, propagation, collection);
+    auto *data = m_state->appendSpan(tempo_utils::SpanId::generate(), parentIndex,
+        parentId, propagation, collection);
+    if (data == nullptr)
+        return {};
 
-    if (m_closed)
+    auto *span = new TraceSpan(shared_from_this(), *data);
+    return std::shared_ptr<TraceSpan>(span);
+}
+
+/**
+ * Make a span which is not recorded in the spanset. The span is still a valid handle, so callers
+ * do not need to distinguish between sampled and unsampled traces, but it has no lock and no
+ * span id. It only tracks its operation name, active duration and whether it failed, so that its
+ * latency is still recorded when it is closed.
+ */
+std::shared_ptr<tempo_tracing::TraceSpan>
+tempo_tracing::TraceRecorder::makeUnsampledSpan(FailurePropagation propagation, FailureCollection collection)
+{
+    if (isClosed())
         return {};
 
-    SpanData& parentData = parentSpan->m_data;
-    SpanData& data = m_state->appendSpan(tempo_utils::SpanId::generate(), parentData.spanIndex,
-        parentData.spanId, propagation, collection);
-    parentData.children.push_back(data.spanIndex);
+    auto *span = new TraceSpan(shared_from_this(), TraceSpan::SpanStorage::kUnsampled,
+        kInvalidAddressU32, {}, kInvalidAddressU32, {}, propagation, collection);
+    return std::shared_ptr<TraceSpan>(span);
+}
+
+/**
+ * Make a span which owns its span data until it is closed, at which point the span data is
+ * written to the stream.
+ */
+std::shared_ptr<tempo_tracing::TraceSpan>
+tempo_tracing::TraceRecorder::makeStreamedSpan(
+    tu_uint32 parentIndex,
+    const tempo_utils::SpanId &parentId,
+    FailurePropagation propagation,
+    FailureCollection collection)
+{
+    auto index = m_stream->registerSpan(parentIndex);
+    if (index == kInvalidAddressU32)
+        return {};
 
-    auto *span = new TraceSpan(shared_from_this(), data);
+    auto *span = new TraceSpan(shared_from_this(), TraceSpan::SpanStorage::kStreamed,
+        index, tempo_utils::SpanId::generate(), parentIndex, parentId, propagation, collection);
     return std::shared_ptr<TraceSpan>(span);
 }
 
+void
+tempo_tracing::TraceRecorder::completeStreamedSpan(const SpanData &spanData)
+{
+    TU_NOTNULL (m_stream);
+    m_stream->completeSpan(spanData);
+}
+
+void
+tempo_tracing::TraceRecorder::recordSpanLatency(
+    std::string_view operationName,
+    absl::Duration activeDuration,
+    bool failed)
+{
+    if (m_metrics != nullptr) {
+        m_metrics->recordSpan(operationName, activeDuration, failed);
+    }
+}
+
 bool
 tempo_tracing::TraceRecorder::isClosed() const
 {
-    absl::MutexLock locker(m_lock);
-    return m_closed;
+    if (m_stream != nullptr)
+        return m_stream->isSealed();
+    return m_state->isSealed();
 }
 
+/**
+ * Close the recorder, so no further spans can be made. If the recorder is streaming then the
+ * completed spans are written; spans which are still open are written when they are closed.
+ */
 void
 tempo_tracing::TraceRecorder::close()
 {
-    absl::MutexLock locker(m_lock);
-    m_closed = true;
+    if (m_stream != nullptr) {
+        m_stream->seal();
+    }
+    m_state->seal();
+}
+
+/**
+ * Write the completed spans to the stream if the recorder is streaming, otherwise do nothing.
+ *
+ * @return The status of the stream.
+ */
+tempo_utils::Status
+tempo_tracing::TraceRecorder::flush()
+{
+    if (m_stream == nullptr)
+        return {};
+    return m_stream->flush();
 }
 
 tempo_utils::Result<tempo_tracing::TempoSpanset>
 tempo_tracing::TraceRecorder::toSpanset() const
 {
-    absl::MutexLock locker(m_lock);
-    if (!m_closed)
+    if (m_stream != nullptr)
+        return TracingStatus::forCondition(TracingCondition::kTracingInvariant,
+            "spans were streamed; use concatenate_spanset_fragments to build the spanset");
+    if (!m_state->isSealed())
         return TracingStatus::forCondition(TracingCondition::kRecorderNotClosed);
-    return m_state->toSpanset();
+    // a trace which was not selected by head sampling has no spans to serialize
+    if (!m_sampled)
+        return TempoSpanset();
+    return m_state->toSpanset(m_policy);
 }
 
 std::shared_ptr<tempo_tracing::TraceRecorder>
 tempo_tracing::TraceRecorder::create()
 {
-    return std::shared_ptr<TraceRecorder>(new TraceRecorder());
+    return create(tempo_utils::TraceId::generate(), SamplingPolicy{});
 }
 
 std::shared_ptr<tempo_tracing::TraceRecorder>
 tempo_tracing::TraceRecorder::create(tempo_utils::TraceId traceId)
 {
-    return std::shared_ptr<TraceRecorder>(new TraceRecorder(traceId));
+    return create(traceId, SamplingPolicy{});
+}
+
+std::shared_ptr<tempo_tracing::TraceRecorder>
+tempo_tracing::TraceRecorder::create(const SamplingPolicy &policy)
+{
+    return create(tempo_utils::TraceId::generate(), policy);
+}
+
+/**
+ * Create a trace recorder which records spans according to the specified sampling policy.
+ *
+ * @param traceId The trace id.
+ * @param policy The sampling policy.
+ * @return The trace recorder.
+ */
+std::shared_ptr<tempo_tracing::TraceRecorder>
+tempo_tracing::TraceRecorder::create(tempo_utils::TraceId traceId, const SamplingPolicy &policy)
+{
+    return std::shared_ptr<TraceRecorder>(new TraceRecorder(traceId, policy));
+}
+
+/**
+ * Create a trace recorder which streams completed spans as spanset fragments to the specified
+ * callback, so the memory used by the recorder is bounded by the number of open spans and the
+ * maximum fragment size rather than the total number of spans.
+ *
+ * @param traceId The trace id.
+ * @param callback The callback which receives each length-prefixed spanset fragment.
+ * @param options The stream options.
+ * @return The trace recorder.
+ */
+std::shared_ptr<tempo_tracing::TraceRecorder>
+tempo_tracing::TraceRecorder::createStreaming(
+    tempo_utils::TraceId traceId,
+    SpansetFragmentCallback callback,
+    const SpansetStreamOptions &options)
+{
+    auto stream = std::make_unique<SpansetStream>(traceId, std::move(callback), options);
+    return std::shared_ptr<TraceRecorder>(new TraceRecorder(traceId, SamplingPolicy{}, std::move(stream)));
+}
+
+std::shared_ptr<tempo_tracing::TraceRecorder>
+tempo_tracing::TraceRecorder::createStreaming(
+    tempo_utils::TraceId traceId,
+    std::shared_ptr<tempo_utils::FileAppender> appender,
+    const SpansetStreamOptions &options)
+{
+    return createStreaming(traceId, append_spanset_fragments(std::move(appender)), options);
 }
@@ -1,19 +1,60 @@
 
+#include <tempo_tracing/internal/perf_counters.h>
 #include <tempo_tracing/span_log.h>
 #include <tempo_tracing/trace_span.h>
 #include <tempo_tracing/trace_recorder.h>
 #include <tempo_tracing/tracing_schema.h>
 #include <tempo_tracing/tracing_types.h>
+#include <tempo_utils/fast_clock.h>
+#include <tempo_utils/flight_recorder.h>
 #include <tempo_utils/log_stream.h>
 
 tempo_tracing::TraceSpan::TraceSpan(std::shared_ptr<tempo_tracing::TraceRecorder> recorder, SpanData &data)
     : m_recorder(recorder),
-      m_data(data)
+      m_storage(SpanStorage::kSpanset),
+      m_data(data),
+      m_startClockNanos(-1),
+      m_unsampledFailed(false),
+      m_unsampledClosed(false),
+      m_unsampledActiveNanos(-1),
+      m_unsampledDurationNanos(0)
 {
     TU_ASSERT (m_recorder != nullptr);
     m_lock = new absl::Mutex();
 }
 
+/**
+ * Construct a span which owns its span data. The span data of a streamed span is passed to the
+ * recorder when the span is closed. An unsampled span is a lightweight handle which has no lock:
+ * only its operation name, its active duration, whether it failed and whether it is closed are
+ * tracked, so that its latency can still be recorded when it is closed.
+ */
+tempo_tracing::TraceSpan::TraceSpan(
+    std::shared_ptr<TraceRecorder> recorder,
+    SpanStorage storage,
+    tu_uint32 spanIndex,
+    tempo_utils::SpanId spanId,
+    tu_uint32 parentIndex,
+    tempo_utils::SpanId parentId,
+    FailurePropagation propagation,
+    FailureCollection collection)
+    : m_recorder(recorder),
+      m_storage(storage),
+      m_ownedData(std::in_place, spanIndex, spanId, parentIndex, parentId),
+      m_data(*m_ownedData),
+      m_startClockNanos(-1),
+      m_unsampledFailed(false),
+      m_unsampledClosed(false),
+      m_unsampledActiveNanos(-1),
+      m_unsampledDurationNanos(0)
+{
+    TU_ASSERT (m_storage != SpanStorage::kSpanset);
+    TU_ASSERT (m_recorder != nullptr);
+    m_lock = m_storage != SpanStorage::kUnsampled? new absl::Mutex() : nullptr;
+    m_data.propagation = propagation;
+    m_data.collection = collection;
+}
+
 tempo_tracing::TraceSpan::~TraceSpan()
 {
     close();
@@ -41,16 +82,44 @@ tempo_tracing::TraceSpan::traceRecorder() const
     return m_recorder;
 }
 
+bool
+tempo_tracing::TraceSpan::isSampled() const
+{
+    // no lock is needed because the sampling decision is immutable
+    return m_storage != SpanStorage::kUnsampled;
+}
+
+/**
+ * Return a context referencing the span, which can be passed to another thread or coroutine to
+ * make child spans of this span.
+ */
+tempo_tracing::SpanContext
+tempo_tracing::TraceSpan::getContext() const
+{
+    // no lock is needed because the span index and span id are immutable
+    return SpanContext(m_recorder, m_data.spanIndex, m_data.spanId);
+}
+
 std::string
 tempo_tracing::TraceSpan::getOperationName() const
 {
-    absl::MutexLock locker(m_lock);
+    absl::MutexLockMaybe locker(m_lock);
     return m_data.operationName;
 }
 
+/**
+ * Set the operation name of the span. An unsampled span has no lock, so its operation name must
+ * not be set concurrently with closing the span.
+ */
 void
 tempo_tracing::TraceSpan::setOperationName(std::string_view name)
 {
+    if (!isSampled()) {
+        TU_LOG_FATAL_IF(m_unsampledClosed.load(std::memory_order_acquire))
+            << "failed to set operation name on closed span";
+        m_data.operationName = name;
+        return;
+    }
     absl::MutexLock locker(m_lock);
     TU_LOG_FATAL_IF(m_data.complete) << "failed to set operation name on closed span";
     m_data.operationName = name;
@@ -59,13 +128,15 @@ tempo_tracing::TraceSpan::setOperationName(std::string_view name)
 tempo_tracing::FailurePropagation
 tempo_tracing::TraceSpan::getPropagation() const
 {
-    absl::MutexLock locker(m_lock);
+    absl::MutexLockMaybe locker(m_lock);
     return m_data.propagation;
 }
 
 void
 tempo_tracing::TraceSpan::setPropagation(FailurePropagation propagation)
 {
+    if (!isSampled())
+        return;
     absl::MutexLock locker(m_lock);
     m_data.propagation = propagation;
 }
@@ -73,13 +144,15 @@ tempo_tracing::TraceSpan::setPropagation(FailurePropagation propagation)
 tempo_tracing::FailureCollection
 tempo_tracing::TraceSpan::getCollection() const
 {
-    absl::MutexLock locker(m_lock);
+    absl::MutexLockMaybe locker(m_lock);
     return m_data.collection;
 }
 
 void
 tempo_tracing::TraceSpan::setCollection(FailureCollection collection)
 {
+    if (!isSampled())
+        return;
     absl::MutexLock locker(m_lock);
     m_data.collection = collection;
 }
@@ -87,6 +160,8 @@ tempo_tracing::TraceSpan::setCollection(FailureCollection collection)
 bool
 tempo_tracing::TraceSpan::isFailed() const
 {
+    if (!isSampled())
+        return m_unsampledFailed.load(std::memory_order_relaxed);
     absl::MutexLock locker(m_lock);
     return m_data.failed;
 }
@@ -94,6 +169,10 @@ tempo_tracing::TraceSpan::isFailed() const
 void
 tempo_tracing::TraceSpan::setFailed(bool failed)
 {
+    if (!isSampled()) {
+        m_unsampledFailed.store(failed, std::memory_order_relaxed);
+        return;
+    }
     absl::MutexLock locker(m_lock);
     m_data.failed = failed;
 }
@@ -101,36 +180,44 @@ tempo_tracing::TraceSpan::setFailed(bool failed)
 absl::Time
 tempo_tracing::TraceSpan::getStartTime() const
 {
-    absl::MutexLock locker(m_lock);
-    return absl::FromUnixMillis(m_data.startTimeMillisSinceEpoch);
+    absl::MutexLockMaybe locker(m_lock);
+    return absl::FromUnixNanos(m_data.startTimeNanosSinceEpoch);
 }
 
 void
 tempo_tracing::TraceSpan::setStartTime(absl::Time startTime)
 {
+    if (!isSampled())
+        return;
     absl::MutexLock locker(m_lock);
     TU_LOG_FATAL_IF(m_data.complete) << "failed to set start time on closed span";
-    m_data.startTimeMillisSinceEpoch = absl::ToUnixMillis(startTime);
+    m_data.startTimeNanosSinceEpoch = absl::ToUnixNanos(startTime);
+    // the end time can no longer be derived from the fast clock reading at activation
+    m_startClockNanos = -1;
 }
 
 absl::Time
 tempo_tracing::TraceSpan::getEndTime() const
 {
-    absl::MutexLock locker(m_lock);
-    return absl::FromUnixMillis(m_data.endTimeMillisSinceEpoch);
+    absl::MutexLockMaybe locker(m_lock);
+    return absl::FromUnixNanos(m_data.endTimeNanosSinceEpoch);
 }
 
 void
 tempo_tracing::TraceSpan::setEndTime(absl::Time endTime)
 {
+    if (!isSampled())
+        return;
     absl::MutexLock locker(m_lock);
     TU_LOG_FATAL_IF(m_data.complete) << "failed to set end time on closed span";
-    m_data.endTimeMillisSinceEpoch = absl::ToUnixMillis(endTime);
+    m_data.endTimeNanosSinceEpoch = absl::ToUnixNanos(endTime);
 }
 
 bool
 tempo_tracing::TraceSpan::isActive() const
 {
+    if (!isSampled())
+        return m_unsampledActiveNanos.load(std::memory_order_relaxed) >= 0;
     absl::MutexLock locker(m_lock);
     return m_data.activeTimeNanosSinceEpoch >= 0;
 }
@@ -138,16 +225,32 @@ tempo_tracing::TraceSpan::isActive() const
 void
 tempo_tracing::TraceSpan::activate()
 {
+    // an unsampled span only tracks its active duration, so that its latency can be recorded
+    if (!isSampled()) {
+        TU_LOG_FATAL_IF(m_unsampledClosed.load(std::memory_order_acquire)) << "failed to activate closed span";
+        if (m_unsampledActiveNanos.load(std::memory_order_relaxed) < 0) {
+            m_unsampledActiveNanos.store(tempo_utils::FastClock::nanosSinceEpoch(), std::memory_order_relaxed);
+        }
+        return;
+    }
     absl::MutexLock locker(m_lock);
     TU_LOG_FATAL_IF(m_data.complete) << "failed to activate closed span";
-    auto now = absl::Now();
-    // if start time has never been set then set it
-    if (m_data.startTimeMillisSinceEpoch < 0) {
-        m_data.startTimeMillisSinceEpoch = absl::ToUnixMillis(now);
+    // if start time has never been set then set it from the wall clock. the fast clock is only
+    // calibrated once, so it is used to measure durations but not to timestamp the span
+    if (m_data.startTimeNanosSinceEpoch < 0) {
+        m_data.startTimeNanosSinceEpoch = absl::ToUnixNanos(absl::Now());
+        m_startClockNanos = tempo_utils::FastClock::nanosSinceEpoch();
     }
+    auto now = tempo_utils::FastClock::nanosSinceEpoch();
     // if we are not already active then set active time
     if (m_data.activeTimeNanosSinceEpoch < 0) {
-        m_data.activeTimeNanosSinceEpoch = ToUnixNanos(now);
+        m_data.activeTimeNanosSinceEpoch = now;
+        if (m_recorder->isPerfCountersEnabled()) {
+            if (m_perfCounters == nullptr) {
+                m_perfCounters = std::make_unique<internal::PerfCounterState>();
+            }
+            internal::read_thread_perf_counters(m_perfCounters->start);
+        }
     }
 }
 
@@ -158,23 +261,81 @@ tempo_tracing::TraceSpan::deactivateUnlocked()
     // if we are not already active then do nothing
     if (m_data.activeTimeNanosSinceEpoch < 0)
         return;
+    // accumulate the counter deltas for the active interval
+    if (m_perfCounters != nullptr) {
+        internal::PerfCounterSample end;
+        if (internal::read_thread_perf_counters(end)) {
+            m_perfCounters->accumulate(end);
+        }
+        m_perfCounters->start = {};
+    }
     // calculate the active duration
-    auto now = absl::Now();
-    auto durationNanos = ToUnixNanos(now) - m_data.activeTimeNanosSinceEpoch;
+    auto now = tempo_utils::FastClock::nanosSinceEpoch();
+    auto durationNanos = now - m_data.activeTimeNanosSinceEpoch;
     auto duration = absl::Nanoseconds(durationNanos);
     // add duration to existing duration
     m_data.activeDuration += duration;
     // clear the active time
     m_data.activeTimeNanosSinceEpoch = -1;
-    // if end time has never been set then set it
-    if (m_data.endTimeMillisSinceEpoch >= 0) {
-        m_data.endTimeMillisSinceEpoch = absl::ToUnixMillis(now);
+    // if end time has never been set then set it. if the start time was set on activation then
+    // the end time is offset from the start time by the elapsed fast clock time, so the span
+    // duration is not affected by adjustments to the wall clock
+    if (m_data.endTimeNanosSinceEpoch < 0) {
+        if (m_startClockNanos >= 0) {
+            m_data.endTimeNanosSinceEpoch = m_data.startTimeNanosSinceEpoch + (now - m_startClockNanos);
+        } else {
+            m_data.endTimeNanosSinceEpoch = absl::ToUnixNanos(absl::Now());
+        }
     }
 }
 
+/**
+ * Tag the span with the counter deltas accumulated across its active intervals. A counter is
+ * only tagged if it was read at the start and end of at least one interval.
+ */
+void
+tempo_tracing::TraceSpan::putPerfCounterTagsUnlocked()
+{
+    if (m_perfCounters == nullptr)
+        return;
+    const std::pair<internal::PerfCounter,const tempo_schema::UInt64Attr *> counterAttrs[] = {
+        {internal::PerfCounter::kCycles, &kTempoTracingPerfCycles},
+        {internal::PerfCounter::kInstructions, &kTempoTracingPerfInstructions},
+        {internal::PerfCounter::kCacheMisses, &kTempoTracingPerfCacheMisses},
+        {internal::PerfCounter::kContextSwitches, &kTempoTracingPerfContextSwitches},
+        {internal::PerfCounter::kTaskClockNanos, &kTempoTracingPerfTaskClock},
+    };
+    SpansetAttrWriter writer;
+    for (const auto &[counter, attr] : counterAttrs) {
+        auto index = static_cast<int>(counter);
+        if ((m_perfCounters->validMask & (1u << index)) == 0)
+            continue;
+        attr->writeAttr(&writer, m_perfCounters->totals[index]);
+        putTagUnlocked(attr->getKey(), writer.getValue());
+    }
+}
+
+/**
+ * Add the time since an unsampled span was activated to its active duration.
+ */
+void
+tempo_tracing::TraceSpan::deactivateUnsampled()
+{
+    auto activeNanos = m_unsampledActiveNanos.exchange(-1, std::memory_order_relaxed);
+    if (activeNanos < 0)
+        return;
+    auto now = tempo_utils::FastClock::nanosSinceEpoch();
+    m_unsampledDurationNanos.fetch_add(now - activeNanos, std::memory_order_relaxed);
+}
+
 void
 tempo_tracing::TraceSpan::deactivate()
 {
+    if (!isSampled()) {
+        TU_LOG_FATAL_IF(m_unsampledClosed.load(std::memory_order_acquire)) << "failed to deactivate closed span";
+        deactivateUnsampled();
+        return;
+    }
     absl::MutexLock locker(m_lock);
     deactivateUnlocked();
 }
@@ -182,6 +343,8 @@ tempo_tracing::TraceSpan::deactivate()
 absl::Duration
 tempo_tracing::TraceSpan::getActiveDuration() const
 {
+    if (!isSampled())
+        return absl::Nanoseconds(m_unsampledDurationNanos.load(std::memory_order_relaxed));
     absl::MutexLock locker(m_lock);
     return m_data.activeDuration;
 }
@@ -189,6 +352,10 @@ tempo_tracing::TraceSpan::getActiveDuration() const
 void
 tempo_tracing::TraceSpan::addToActiveDuration(absl::Duration duration)
 {
+    if (!isSampled()) {
+        m_unsampledDurationNanos.fetch_add(absl::ToInt64Nanoseconds(duration), std::memory_order_relaxed);
+        return;
+    }
     absl::MutexLock locker(m_lock);
     TU_LOG_FATAL_IF(m_data.complete) << "failed to add active time on closed span";
     m_data.activeDuration += duration;
@@ -197,6 +364,10 @@ tempo_tracing::TraceSpan::addToActiveDuration(absl::Duration duration)
 void
 tempo_tracing::TraceSpan::setActiveDuration(absl::Duration duration)
 {
+    if (!isSampled()) {
+        m_unsampledDurationNanos.store(absl::ToInt64Nanoseconds(duration), std::memory_order_relaxed);
+        return;
+    }
     absl::MutexLock locker(m_lock);
     TU_LOG_FATAL_IF(m_data.complete) << "failed to add active time on closed span";
     m_data.activeDuration = duration;
@@ -205,14 +376,14 @@ tempo_tracing::TraceSpan::setActiveDuration(absl::Duration duration)
 bool
 tempo_tracing::TraceSpan::hasTag(const tempo_schema::AttrKey &key) const
 {
-    absl::MutexLock locker(m_lock);
+    absl::MutexLockMaybe locker(m_lock);
     return m_data.tags.contains(key);
 }
 
 tempo_schema::AttrValue
 tempo_tracing::TraceSpan::getTag(const tempo_schema::AttrKey &key) const
 {
-    absl::MutexLock locker(m_lock);
+    absl::MutexLockMaybe locker(m_lock);
     if (!m_data.tags.contains(key))
         return {};
     return m_data.tags.at(key);
@@ -221,6 +392,8 @@ tempo_tracing::TraceSpan::getTag(const tempo_schema::AttrKey &key) const
 void
 tempo_tracing::TraceSpan::putTagUnlocked(const tempo_schema::AttrKey &key, const tempo_schema::AttrValue &value)
 {
+    if (m_storage == SpanStorage::kUnsampled)
+        return;
     m_data.tags[key] = value;
 }
 
@@ -230,9 +403,28 @@ tempo_tracing::TraceSpan::appendLogUnlocked(absl::Time ts, LogSeverity severity)
     return m_data.logs.emplace_back(ts, severity, tempo_schema::AttrMap());
 }
 
+/**
+ * Returns the log entry shared by the logs of every unsampled span. The entry is never modified,
+ * since the fields of an unsampled span are discarded.
+ */
+static tempo_tracing::LogEntry&
+unsampled_log_entry()
+{
+    static tempo_tracing::LogEntry entry(absl::InfinitePast(), tempo_tracing::LogSeverity::kInfo, {});
+    return entry;
+}
+
 std::shared_ptr<tempo_tracing::SpanLog>
 tempo_tracing::TraceSpan::appendLog(absl::Time ts, LogSeverity severity)
 {
+    if (!isSampled()) {
+        TU_LOG_FATAL_IF(m_unsampledClosed.load(std::memory_order_acquire)) << "failed to append log on closed span";
+        if (severity == LogSeverity::kFatal || severity == LogSeverity::kError) {
+            m_unsampledFailed.store(true, std::memory_order_relaxed);
+        }
+        return std::make_shared<SpanLog>(shared_from_this(), unsampled_log_entry());
+    }
+
     absl::MutexLock locker(m_lock);
     TU_LOG_FATAL_IF(m_data.complete) << "failed to append log on closed span";
     auto &entry = appendLogUnlocked(absl::Now(), severity);
@@ -253,6 +445,8 @@ tempo_tracing::TraceSpan::putFieldUnlocked(
     const tempo_schema::AttrKey &key,
     const tempo_schema::AttrValue &value)
 {
+    if (m_storage == SpanStorage::kUnsampled)
+        return;
     logEntry.fields[key] = value;
 }
 
@@ -309,6 +503,11 @@ tempo_tracing::TraceSpan::checkStatus(const tempo_utils::Status &status, LogSeve
 std::shared_ptr<tempo_tracing::TraceSpan>
 tempo_tracing::TraceSpan::makeSpan(FailurePropagation propagation, FailureCollection collection)
 {
+    if (!isSampled()) {
+        TU_LOG_FATAL_IF(m_unsampledClosed.load(std::memory_order_acquire)) << "failed to make child span on closed span";
+        return m_recorder->makeSpan(shared_from_this(), propagation, collection);
+    }
+
     absl::MutexLock locker(m_lock);
     TU_LOG_FATAL_IF(m_data.complete) << "failed to make child span on closed span";
     return m_recorder->makeSpan(shared_from_this(), propagation, collection);
@@ -317,17 +516,55 @@ tempo_tracing::TraceSpan::makeSpan(FailurePropagation propagation, FailureCollec
 bool
 tempo_tracing::TraceSpan::isOpen() const
 {
+    if (!isSampled())
+        return !m_unsampledClosed.load(std::memory_order_acquire);
     absl::MutexLock locker(m_lock);
     return !m_data.complete;
 }
 
+/**
+ * Record a summary of the completed span in the flight recorder, so that recently closed spans
+ * are included in the crash dump.
+ */
+static void
+record_completed_span(const tempo_tracing::SpanData &data)
+{
+    tempo_utils::record_flight_span(tempo_utils::FastClock::now(), data.spanId.getId(), data.operationName,
+        data.activeDuration, data.failed);
+}
+
+/**
+ * Close an unsampled span, recording its latency. An unsampled span is not recorded in the flight
+ * recorder, since it has no span id.
+ */
+void
+tempo_tracing::TraceSpan::closeUnsampled(bool failed)
+{
+    deactivateUnsampled();
+    m_recorder->recordSpanLatency(m_data.operationName,
+        absl::Nanoseconds(m_unsampledDurationNanos.load(std::memory_order_relaxed)), failed);
+}
+
 void
 tempo_tracing::TraceSpan::close()
 {
+    if (!isSampled()) {
+        if (!m_unsampledClosed.exchange(true, std::memory_order_acq_rel)) {
+            closeUnsampled(m_unsampledFailed.load(std::memory_order_relaxed));
+        }
+        return;
+    }
+
     absl::MutexLock locker(m_lock);
     if (!m_data.complete) {
         deactivateUnlocked();
+        putPerfCounterTagsUnlocked();
         m_data.complete = true;
+        record_completed_span(m_data);
+        m_recorder->recordSpanLatency(m_data.operationName, m_data.activeDuration, m_data.failed);
+        if (m_storage == SpanStorage::kStreamed) {
+            m_recorder->completeStreamedSpan(m_data);
+        }
     }
 }
 
@@ -338,12 +575,23 @@ tempo_tracing::TraceSpan::logStatusAndClose(
     LogSeverity severity,
     std::string_view message)
 {
+    if (!isSampled()) {
+        TU_LOG_FATAL_IF(m_unsampledClosed.exchange(true, std::memory_order_acq_rel))
+            << "failed to apply status to closed span";
+        m_unsampledFailed.store(true, std::memory_order_relaxed);
+        closeUnsampled(true);
+        return;
+    }
+
     absl::MutexLock locker(m_lock);
     TU_LOG_FATAL_IF(m_data.complete) << "failed to apply status to closed span";
 
     deactivateUnlocked();
+    putPerfCounterTagsUnlocked();
     m_data.failed = true;
     m_data.complete = true;
+    record_completed_span(m_data);
+    m_recorder->recordSpanLatency(m_data.operationName, m_data.activeDuration, m_data.failed);
 
     SpansetAttrWriter writer;
 
@@ -363,4 +611,8 @@ tempo_tracing::TraceSpan::logStatusAndClose(
         kOpentracingMessage.writeAttr(&writer, std::string(message));
         putFieldUnlocked(entry, kOpentracingMessage.getKey(), writer.getValue());
     }
+
+    if (m_storage == SpanStorage::kStreamed) {
+        m_recorder->completeStreamedSpan(m_data);
+    }
 }
\ No newline at end of file
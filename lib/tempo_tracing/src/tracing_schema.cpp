@@ -48,3 +48,18 @@ const tempo_schema::UInt64Attr tempo_tracing::kTempoTracingTextSpan(
 
 const tempo_schema::StringAttr tempo_tracing::kTempoTracingFilePath(
     &tempo_tracing::kTempoTracingFilePathProperty);
+
+const tempo_schema::UInt64Attr tempo_tracing::kTempoTracingPerfCycles(
+    &tempo_tracing::kTempoTracingPerfCyclesProperty);
+
+const tempo_schema::UInt64Attr tempo_tracing::kTempoTracingPerfInstructions(
+    &tempo_tracing::kTempoTracingPerfInstructionsProperty);
+
+const tempo_schema::UInt64Attr tempo_tracing::kTempoTracingPerfCacheMisses(
+    &tempo_tracing::kTempoTracingPerfCacheMissesProperty);
+
+const tempo_schema::UInt64Attr tempo_tracing::kTempoTracingPerfContextSwitches(
+    &tempo_tracing::kTempoTracingPerfContextSwitchesProperty);
+
+const tempo_schema::UInt64Attr tempo_tracing::kTempoTracingPerfTaskClock(
+    &tempo_tracing::kTempoTracingPerfTaskClockProperty);
@@ -16,8 +16,8 @@ tempo_tracing::SpanData::SpanData(uint32_t index, tempo_utils::SpanId id)
       spanId(id),
       parentIndex(kInvalidAddressU32),
       parentId(),
-      startTimeMillisSinceEpoch(-1),
-      endTimeMillisSinceEpoch(-1),
+      startTimeNanosSinceEpoch(-1),
+      endTimeNanosSinceEpoch(-1),
       activeTimeNanosSinceEpoch(-1),
       complete(false)
 {
@@ -32,8 +32,8 @@ tempo_tracing::SpanData::SpanData(
       spanId(spanId),
       parentIndex(parentIndex),
       parentId(parentId),
-      startTimeMillisSinceEpoch(-1),
-      endTimeMillisSinceEpoch(-1),
+      startTimeNanosSinceEpoch(-1),
+      endTimeNanosSinceEpoch(-1),
       activeTimeNanosSinceEpoch(-1),
       complete(false)
 {
@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <tempo_tracing/chrome_trace_exporter.h>
+#include <tempo_tracing/trace_recorder.h>
+#include <tempo_test/status_matchers.h>
+#include <tempo_utils/file_reader.h>
+#include <tempo_utils/tempfile_maker.h>
+
+static std::shared_ptr<tempo_tracing::TraceSpan>
+make_timed_span(
+    std::shared_ptr<tempo_tracing::TraceSpan> parent,
+    std::string_view operationName,
+    int startMillis,
+    int endMillis)
+{
+    auto span = parent->makeSpan();
+    span->setOperationName(operationName);
+    span->setStartTime(absl::FromUnixMillis(startMillis));
+    span->setEndTime(absl::FromUnixMillis(endMillis));
+    return span;
+}
+
+static std::string
+read_file(const std::filesystem::path &path)
+{
+    tempo_utils::FileReader reader(path);
+    TU_RAISE_IF_NOT_OK (reader.getStatus());
+    auto bytes = reader.getBytes();
+    return bytes->toString();
+}
+
+TEST(ChromeTraceExporter, ExportOverlappingSpansOnSeparateTracks)
+{
+    auto recorder = tempo_tracing::TraceRecorder::create();
+    auto root = recorder->makeSpan();
+    root->setOperationName("root");
+    root->setStartTime(absl::FromUnixMillis(0));
+    root->setEndTime(absl::FromUnixMillis(100));
+    auto a = make_timed_span(root, "a", 10, 50);
+    a->appendLog(absl::FromUnixMillis(20), tempo_tracing::LogSeverity::kWarn);
+    a->close();
+    make_timed_span(root, "b", 20, 80)->close();
+    root->close();
+    recorder->close();
+    auto spanset = recorder->toSpanset().orElseThrow();
+
+    tempo_utils::TempfileMaker tempfileMaker(std::filesystem::current_path(), "trace.XXXXXXXX", std::string_view());
+    ASSERT_TRUE (tempfileMaker.isValid());
+    auto appender = std::make_shared<tempo_utils::FileAppender>(tempfileMaker.getTempfile(),
+        tempo_utils::FileAppenderMode::CREATE_OR_OVERWRITE);
+
+    tempo_tracing::ChromeTraceExporter exporter(appender);
+    ASSERT_THAT (exporter.exportSpanset(spanset), tempo_test::IsOk());
+    ASSERT_THAT (exporter.finish(), tempo_test::IsOk());
+
+    // a nests within root, but b overlaps a so it is moved to a second track
+    ASSERT_EQ (2, exporter.numTracks());
+    ASSERT_EQ (6, exporter.numEvents());
+
+    auto json = read_file(tempfileMaker.getTempfile());
+    ASSERT_THAT (json, ::testing::StartsWith("{\"traceEvents\":["));
+    ASSERT_THAT (json, ::testing::HasSubstr(
+        R"("name":"a","cat":"span","ph":"X","ts":10000.000,"dur":40000.000,"pid":1,"tid":0)"));
+    ASSERT_THAT (json, ::testing::HasSubstr(
+        R"("name":"b","cat":"span","ph":"X","ts":20000.000,"dur":60000.000,"pid":1,"tid":1)"));
+    ASSERT_THAT (json, ::testing::HasSubstr(
+        R"("name":"warn","cat":"log","ph":"i","s":"t","ts":20000.000,"pid":1,"tid":0)"));
+    ASSERT_THAT (json, ::testing::EndsWith("],\"displayTimeUnit\":\"ns\"}\n"));
+}
+
+static tempo_tracing::TempoSpanset
+make_timed_spanset(std::string_view operationName, int startMillis, int endMillis)
+{
+    auto recorder = tempo_tracing::TraceRecorder::create();
+    auto root = recorder->makeSpan();
+    root->setOperationName(operationName);
+    root->setStartTime(absl::FromUnixMillis(startMillis));
+    root->setEndTime(absl::FromUnixMillis(endMillis));
+    root->close();
+    recorder->close();
+    return recorder->toSpanset().orElseThrow();
+}
+
+TEST(ChromeTraceExporter, ReuseTracksOnceEventsHaveEnded)
+{
+    tempo_utils::TempfileMaker tempfileMaker(std::filesystem::current_path(), "trace.XXXXXXXX", std::string_view());
+    ASSERT_TRUE (tempfileMaker.isValid());
+    auto appender = std::make_shared<tempo_utils::FileAppender>(tempfileMaker.getTempfile(),
+        tempo_utils::FileAppenderMode::CREATE_OR_OVERWRITE);
+
+    tempo_tracing::ChromeTraceExporter exporter(appender);
+    ASSERT_THAT (exporter.exportSpanset(make_timed_spanset("first", 0, 100)), tempo_test::IsOk());
+    ASSERT_EQ (1, exporter.numTracks());
+
+    // second starts after first has ended, so it reuses the track of first
+    ASSERT_THAT (exporter.exportSpanset(make_timed_spanset("second", 200, 300)), tempo_test::IsOk());
+    ASSERT_EQ (1, exporter.numTracks());
+
+    // third overlaps second, so it is placed on a new track
+    ASSERT_THAT (exporter.exportSpanset(make_timed_spanset("third", 250, 400)), tempo_test::IsOk());
+    ASSERT_EQ (2, exporter.numTracks());
+    ASSERT_THAT (exporter.finish(), tempo_test::IsOk());
+
+    // one span event for each spanset and one metadata event for each track
+    ASSERT_EQ (5, exporter.numEvents());
+
+    auto json = read_file(tempfileMaker.getTempfile());
+    ASSERT_THAT (json, ::testing::HasSubstr(
+        R"("name":"second","cat":"span","ph":"X","ts":200000.000,"dur":100000.000,"pid":1,"tid":0)"));
+    ASSERT_THAT (json, ::testing::HasSubstr(
+        R"("name":"third","cat":"span","ph":"X","ts":250000.000,"dur":150000.000,"pid":1,"tid":1)"));
+}
+
+TEST(ChromeTraceExporter, ExportStreamedFragments)
+{
+    tempo_utils::TempfileMaker tempfileMaker(std::filesystem::current_path(), "trace.XXXXXXXX", std::string_view());
+    ASSERT_TRUE (tempfileMaker.isValid());
+    auto appender = std::make_shared<tempo_utils::FileAppender>(tempfileMaker.getTempfile(),
+        tempo_utils::FileAppenderMode::CREATE_OR_OVERWRITE);
+    auto exporter = std::make_shared<tempo_tracing::ChromeTraceExporter>(appender);
+
+    auto recorder = tempo_tracing::TraceRecorder::createStreaming(tempo_utils::TraceId::generate(),
+        tempo_tracing::export_chrome_trace_fragments(exporter));
+    auto root = recorder->makeSpan();
+    root->setOperationName("root");
+    make_timed_span(root, "child", 10, 20)->close();
+    root->close();
+    recorder->close();
+    ASSERT_THAT (recorder->flush(), tempo_test::IsOk());
+    ASSERT_THAT (exporter->finish(), tempo_test::IsOk());
+
+    auto json = read_file(tempfileMaker.getTempfile());
+    ASSERT_THAT (json, ::testing::HasSubstr(R"("name":"root")"));
+    ASSERT_THAT (json, ::testing::HasSubstr(R"("name":"child")"));
+}
@@ -85,3 +85,26 @@ TEST_F(EnterScope, ScopeConstructionFailsIfNoSpecifiedContext)
     auto span = scope.getSpan();
     ASSERT_TRUE (span == nullptr);
 }
+
+TEST_F(EnterScope, SkipSpanWhenTracingDisabled)
+{
+    tempo_tracing::TraceContext::makeContextAndSwitch("test");
+
+    tempo_tracing::set_tracing_enabled(false);
+    {
+        tempo_tracing::EnterScope scope("TestOperation");
+        ASSERT_FALSE (scope.isValid());
+        ASSERT_TRUE (scope.getStatus().isOk());
+        ASSERT_EQ (0, tempo_tracing::TraceContext::currentContext()->numSpans());
+    }
+    tempo_tracing::set_tracing_enabled(true);
+
+    // a scope entered while tracing is enabled is still exited after tracing is disabled
+    {
+        tempo_tracing::EnterScope scope("TestOperation");
+        ASSERT_TRUE (scope.isValid());
+        tempo_tracing::set_tracing_enabled(false);
+    }
+    tempo_tracing::set_tracing_enabled(true);
+    ASSERT_FALSE (tempo_tracing::TraceContext::currentContext()->peekSpan()->isActive());
+}
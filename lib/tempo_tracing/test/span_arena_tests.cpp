@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+
+#include <tempo_tracing/span_arena.h>
+
+TEST(SpanArena, AppendSpansAcrossChunks)
+{
+    tempo_tracing::SpanArena arena(4);
+    ASSERT_EQ (0, arena.size());
+    ASSERT_EQ (0, arena.numChunks());
+
+    for (tu_uint32 i = 0; i < 10; i++) {
+        auto &span = arena.append(i, tempo_utils::SpanId(1, i + 1), tempo_tracing::kInvalidAddressU32, {});
+        ASSERT_EQ (i, span.spanIndex);
+    }
+
+    ASSERT_EQ (10, arena.size());
+    ASSERT_EQ (3, arena.numChunks());
+    ASSERT_EQ (4, arena.getChunk(0).size());
+    ASSERT_EQ (4, arena.getChunk(1).size());
+    ASSERT_EQ (2, arena.getChunk(2).size());
+
+    tu_uint32 expected = 0;
+    for (int i = 0; i < arena.numChunks(); i++) {
+        for (const auto &span : arena.getChunk(i)) {
+            ASSERT_EQ (expected++, span.spanIndex);
+        }
+    }
+}
+
+TEST(SpanArena, SpanReferencesRemainValidAfterAppend)
+{
+    tempo_tracing::SpanArena arena(2);
+    auto &first = arena.append(0, tempo_utils::SpanId(1, 1), tempo_tracing::kInvalidAddressU32, {});
+    first.operationName = "first";
+
+    for (tu_uint32 i = 1; i < 100; i++) {
+        arena.append(i, tempo_utils::SpanId(1, i + 1), 0, first.spanId);
+    }
+
+    ASSERT_EQ (&first, &arena.getChunk(0).front());
+    ASSERT_EQ ("first", first.operationName);
+    ASSERT_EQ (50, arena.numChunks());
+}
@@ -0,0 +1,77 @@
+#include <thread>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <tempo_tracing/enter_scope.h>
+#include <tempo_tracing/internal/thread_context.h>
+#include <tempo_tracing/span_context.h>
+#include <tempo_tracing/span_walker.h>
+#include <tempo_tracing/trace_context.h>
+#include <tempo_tracing/trace_recorder.h>
+#include <tempo_test/result_matchers.h>
+
+TEST(SpanContext, DefaultContextIsInvalid)
+{
+    tempo_tracing::SpanContext context;
+    ASSERT_FALSE (context.isValid());
+    ASSERT_EQ (nullptr, context.makeSpan());
+}
+
+TEST(SpanContext, MakeChildSpansOnOtherThreads)
+{
+    auto recorder = tempo_tracing::TraceRecorder::create();
+    auto root = recorder->makeSpan();
+    root->setOperationName("root");
+    auto context = root->getContext();
+    ASSERT_TRUE (context.isValid());
+    ASSERT_EQ (root->spanId(), context.getSpanId());
+    ASSERT_EQ (recorder->traceId(), context.getTraceId());
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([context] {
+            auto span = context.makeSpan();
+            span->setOperationName("worker");
+            span->close();
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    root->close();
+    recorder->close();
+
+    auto spanset = recorder->toSpanset().orElseThrow();
+    auto rootWalker = spanset.getRoots().getRoot(0);
+    ASSERT_EQ (root->spanId(), rootWalker.getId());
+    ASSERT_EQ (4, rootWalker.numChildren());
+    for (int i = 0; i < rootWalker.numChildren(); i++) {
+        ASSERT_EQ ("worker", rootWalker.getChild(i).getOperationName());
+    }
+}
+
+TEST(SpanContext, ResumeContextOnOtherThread)
+{
+    auto recorder = tempo_tracing::TraceRecorder::create();
+    auto root = recorder->makeSpan();
+    root->setOperationName("root");
+    auto context = root->getContext();
+
+    std::thread thread([context] {
+        auto resumeContextResult = tempo_tracing::TraceContext::resumeContextAndSwitch(context, "worker");
+        ASSERT_THAT (resumeContextResult, tempo_test::IsResult());
+        {
+            tempo_tracing::EnterScope scope("resumed");
+        }
+        tempo_tracing::internal::reset_thread_context();
+    });
+    thread.join();
+    root->close();
+    recorder->close();
+
+    auto spanset = recorder->toSpanset().orElseThrow();
+    auto rootWalker = spanset.getRoots().getRoot(0);
+    ASSERT_EQ (1, rootWalker.numChildren());
+    ASSERT_EQ ("resumed", rootWalker.getChild(0).getOperationName());
+}
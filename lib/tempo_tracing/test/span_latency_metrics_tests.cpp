@@ -0,0 +1,150 @@
+#include <atomic>
+#include <thread>
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <tempo_tracing/span_latency_metrics.h>
+#include <tempo_tracing/trace_recorder.h>
+
+TEST(SpanLatencyMetrics, RecordClosedSpans)
+{
+    // the assertions below need more precision than the default two significant figures
+    tempo_tracing::SpanLatencyMetricsOptions options;
+    options.significantFigures = 3;
+    auto metrics = std::make_shared<tempo_tracing::SpanLatencyMetrics>(options);
+    auto recorder = tempo_tracing::TraceRecorder::create();
+    recorder->setLatencyMetrics(metrics);
+
+    for (int i = 1; i <= 4; i++) {
+        auto span = recorder->makeSpan();
+        span->setOperationName("op");
+        span->setActiveDuration(absl::Milliseconds(i * 10));
+        span->setFailed(i == 4);
+        span->close();
+    }
+
+    auto snapshot = metrics->takeSnapshot();
+    ASSERT_LE (snapshot.intervalStart, snapshot.intervalEnd);
+    ASSERT_EQ (1, snapshot.operations.size());
+    auto &op = snapshot.operations.at("op");
+    ASSERT_EQ (4, op.numSpans);
+    ASSERT_EQ (1, op.numFailed);
+    ASSERT_NEAR (absl::ToInt64Nanoseconds(absl::Milliseconds(10)), op.durations.getMinValue(), 100000);
+    ASSERT_NEAR (absl::ToInt64Nanoseconds(absl::Milliseconds(40)), op.durations.getMaxValue(), 100000);
+
+    // the snapshot reset the metrics
+    ASSERT_TRUE (metrics->takeSnapshot().operations.empty());
+}
+
+TEST(SpanLatencyMetrics, RecordUnsampledSpans)
+{
+    auto metrics = std::make_shared<tempo_tracing::SpanLatencyMetrics>();
+    tempo_tracing::SamplingPolicy policy;
+    policy.headSampleRate = 0.0;
+    auto recorder = tempo_tracing::TraceRecorder::create(policy);
+    recorder->setLatencyMetrics(metrics);
+    ASSERT_FALSE (recorder->isSampled());
+
+    auto root = recorder->makeSpan();
+    root->setOperationName("root");
+    for (int i = 1; i <= 4; i++) {
+        auto span = root->makeSpan();
+        span->setOperationName("op");
+        span->activate();
+        span->deactivate();
+        span->addToActiveDuration(absl::Milliseconds(10));
+        if (i == 4) {
+            span->logMessage("failed", tempo_tracing::LogSeverity::kError);
+        }
+        span->close();
+    }
+    root->close(tempo_utils::GenericCondition::kInternalViolation, tempo_tracing::LogSeverity::kError);
+
+    auto snapshot = metrics->takeSnapshot();
+    ASSERT_EQ (2, snapshot.operations.size());
+    auto &op = snapshot.operations.at("op");
+    ASSERT_EQ (4, op.numSpans);
+    ASSERT_EQ (1, op.numFailed);
+    ASSERT_LE (absl::ToInt64Nanoseconds(absl::Milliseconds(9)), op.durations.getMinValue());
+    auto &rootOp = snapshot.operations.at("root");
+    ASSERT_EQ (1, rootOp.numSpans);
+    ASSERT_EQ (1, rootOp.numFailed);
+}
+
+TEST(SpanLatencyMetrics, MergeThreadShardsInSnapshot)
+{
+    tempo_tracing::SpanLatencyMetrics metrics;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([&metrics] {
+            for (int j = 0; j < 100; j++) {
+                metrics.recordSpan("op", absl::Microseconds(j + 1), j % 10 == 0);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    auto snapshot = metrics.takeSnapshot(false);
+    auto &op = snapshot.operations.at("op");
+    ASSERT_EQ (400, op.numSpans);
+    ASSERT_EQ (40, op.numFailed);
+    ASSERT_NEAR (absl::ToInt64Nanoseconds(absl::Microseconds(50)), op.durations.getPercentileValue(50.0), 1000);
+
+    // the snapshot did not reset the metrics
+    ASSERT_EQ (400, metrics.takeSnapshot().operations.at("op").numSpans);
+}
+
+TEST(SpanLatencyMetrics, RecordWhileTakingSnapshots)
+{
+    tempo_tracing::SpanLatencyMetrics metrics;
+    std::atomic<int> numRunning{4};
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([&metrics, &numRunning] {
+            for (int j = 0; j < 100000; j++) {
+                metrics.recordSpan(j % 2 == 0? "even" : "odd", absl::Microseconds(j % 1000), false);
+            }
+            numRunning.fetch_sub(1);
+        });
+    }
+
+    // every span is counted by exactly one snapshot
+    tu_uint64 numSpans = 0;
+    bool running;
+    do {
+        running = numRunning.load() > 0;
+        for (auto &[operationName, latency] : metrics.takeSnapshot().operations) {
+            numSpans += latency.numSpans;
+        }
+    } while (running);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (auto &[operationName, latency] : metrics.takeSnapshot().operations) {
+        numSpans += latency.numSpans;
+    }
+    ASSERT_EQ (400000, numSpans);
+}
+
+TEST(SpanLatencyMetrics, ReclaimShardsOfExitedThreads)
+{
+    tempo_tracing::SpanLatencyMetrics metrics;
+
+    for (int i = 0; i < 4; i++) {
+        std::thread thread([&metrics] {
+            metrics.recordSpan("op", absl::Milliseconds(1), false);
+        });
+        thread.join();
+    }
+    ASSERT_EQ (4, metrics.numThreadShards());
+
+    // the latencies of the exited threads are included in the snapshot which reclaims their shards
+    auto snapshot = metrics.takeSnapshot();
+    ASSERT_EQ (4, snapshot.operations.at("op").numSpans);
+    ASSERT_EQ (0, metrics.numThreadShards());
+}
@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <tempo_tracing/internal/spanset_reader.h>
+#include <tempo_tracing/span_walker.h>
+#include <tempo_tracing/trace_recorder.h>
+#include <tempo_tracing/tracing_schema.h>
+#include <tempo_test/result_matchers.h>
+#include <tempo_test/status_matchers.h>
+
+#include "base_tracing_fixture.h"
+
+class SpanTags : public BaseTracingFixture {};
+
+TEST_F(SpanTags, FindTagsUsingTagIndex)
+{
+    auto span = recorder->makeSpan();
+    span->putTag(tempo_tracing::kOpentracingComponent, std::string("component"));
+    span->putTag(tempo_tracing::kOpentracingEvent, std::string("event"));
+    span->putTag(tempo_tracing::kTempoTracingErrorCode, tu_int64{42});
+    span->close();
+
+    recorder->close();
+    auto toSpansetResult = recorder->toSpanset();
+    ASSERT_THAT (toSpansetResult, tempo_test::IsResult());
+    auto spanset = toSpansetResult.getResult();
+    ASSERT_EQ (tempo_tracing::SpansetVersion::Version2, spanset.getABI());
+
+    auto spanWalker = spanset.getRoots().getRoot(0);
+    ASSERT_TRUE (spanWalker.isValid());
+    ASSERT_EQ (3, spanWalker.numTags());
+
+    std::string component;
+    ASSERT_THAT (spanWalker.parseTag(tempo_tracing::kOpentracingComponent, component), tempo_test::IsOk());
+    ASSERT_EQ ("component", component);
+    std::string event;
+    ASSERT_THAT (spanWalker.parseTag(tempo_tracing::kOpentracingEvent, event), tempo_test::IsOk());
+    ASSERT_EQ ("event", event);
+    tu_int64 errorCode;
+    ASSERT_THAT (spanWalker.parseTag(tempo_tracing::kTempoTracingErrorCode, errorCode), tempo_test::IsOk());
+    ASSERT_EQ (42, errorCode);
+
+    ASSERT_FALSE (spanWalker.hasTag(tempo_tracing::kOpentracingMessage));
+    ASSERT_FALSE (spanWalker.hasTag(tempo_schema::AttrKey{"dev.zuri.ns:missing", 0}));
+}
+
+TEST_F(SpanTags, FindTagsInVersion1Spanset)
+{
+    // build a spanset without a tag index, as written before Version2
+    flatbuffers::FlatBufferBuilder buffer;
+    auto key = tempo_tracing::kOpentracingEvent.getKey();
+    std::vector<flatbuffers::Offset<tts1::NamespaceDescriptor>> namespaces = {
+        tts1::CreateNamespaceDescriptor(buffer, buffer.CreateString(key.ns)),
+    };
+    auto value = tts1::CreateStringValue(buffer, buffer.CreateString("event"));
+    std::vector<flatbuffers::Offset<tts1::AttributeDescriptor>> attrs = {
+        tts1::CreateAttributeDescriptor(buffer, 0, key.id, tts1::Value::StringValue, value.Union()),
+    };
+    std::vector<tu_uint32> tags = {0};
+    std::vector<flatbuffers::Offset<tts1::SpanDescriptor>> spans = {
+        tts1::CreateSpanDescriptor(buffer, 1, buffer.CreateString("op"), tempo_tracing::kInvalidAddressU32, 0,
+            0, false, 0, 0, 0, buffer.CreateVector(tags)),
+    };
+    std::vector<tu_uint32> roots = {0};
+    auto spansetOffset = tts1::CreateSpanset(buffer, tts1::SpansetVersion::Version1, 1, 1,
+        buffer.CreateVector(namespaces), buffer.CreateVector(spans), buffer.CreateVector(attrs),
+        0, buffer.CreateVector(roots));
+    buffer.Finish(spansetOffset, tts1::SpansetIdentifier());
+
+    tempo_tracing::TempoSpanset spanset(std::span<const tu_uint8>(buffer.GetBufferPointer(), buffer.GetSize()));
+    ASSERT_TRUE (spanset.isValid());
+    ASSERT_EQ (tempo_tracing::SpansetVersion::Version1, spanset.getABI());
+
+    auto spanWalker = spanset.getRoots().getRoot(0);
+    ASSERT_TRUE (spanWalker.isValid());
+
+    std::string event;
+    ASSERT_THAT (spanWalker.parseTag(tempo_tracing::kOpentracingEvent, event), tempo_test::IsOk());
+    ASSERT_EQ ("event", event);
+    ASSERT_FALSE (spanWalker.hasTag(tempo_tracing::kOpentracingComponent));
+}
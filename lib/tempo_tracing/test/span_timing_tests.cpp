@@ -92,3 +92,25 @@ TEST_F(TraceSpanTiming, CloseSetsEndTimeAndActiveDuration)
     // TODO: parameterize expected value based on test runner
     ASSERT_GE (100.0, std::abs(activeDuration - sleepDuration));
 }
+
+TEST_F(TraceSpanTiming, SpansetPreservesNanosecondTimes)
+{
+    recorder = tempo_tracing::TraceRecorder::create();
+    auto span = recorder->makeSpan();
+
+    auto startTime = absl::FromUnixNanos(1700000000123456789);
+    auto endTime = absl::FromUnixNanos(1700000000987654321);
+    span->setStartTime(startTime);
+    span->setEndTime(endTime);
+    span->close();
+    recorder->close();
+
+    auto toSpansetResult = recorder->toSpanset();
+    ASSERT_THAT (toSpansetResult, tempo_test::IsResult());
+    auto spanset = toSpansetResult.getResult();
+
+    auto walker = spanset.getRoots().getRoot(0);
+    ASSERT_TRUE (walker.isValid());
+    ASSERT_EQ (startTime, walker.getStartTime());
+    ASSERT_EQ (endTime, walker.getEndTime());
+}
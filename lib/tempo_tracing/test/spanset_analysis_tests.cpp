@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <tempo_tracing/spanset_analysis.h>
+#include <tempo_tracing/trace_recorder.h>
+#include <tempo_test/result_matchers.h>
+#include <tempo_test/status_matchers.h>
+
+static std::shared_ptr<tempo_tracing::TraceSpan>
+make_timed_span(
+    std::shared_ptr<tempo_tracing::TraceSpan> parent,
+    std::string_view operationName,
+    int startMillis,
+    int endMillis)
+{
+    auto span = parent->makeSpan();
+    span->setOperationName(operationName);
+    span->setStartTime(absl::FromUnixMillis(startMillis));
+    span->setEndTime(absl::FromUnixMillis(endMillis));
+    return span;
+}
+
+// root [0, 100] has concurrent children a [10, 50] and b [20, 80]
+static tempo_tracing::TempoSpanset
+make_concurrent_spanset()
+{
+    auto recorder = tempo_tracing::TraceRecorder::create();
+    auto root = recorder->makeSpan();
+    root->setOperationName("root");
+    root->setStartTime(absl::FromUnixMillis(0));
+    root->setEndTime(absl::FromUnixMillis(100));
+    make_timed_span(root, "a", 10, 50)->close();
+    make_timed_span(root, "b", 20, 80)->close();
+    root->close();
+    recorder->close();
+    return recorder->toSpanset().orElseThrow();
+}
+
+TEST(SpansetAnalysis, ComputeSelfAndCriticalTime)
+{
+    auto analyzeResult = tempo_tracing::analyze_span_timings(make_concurrent_spanset());
+    ASSERT_THAT (analyzeResult, tempo_test::IsResult());
+    auto timings = analyzeResult.getResult();
+    ASSERT_EQ (3, timings.size());
+
+    auto &root = timings.at(0);
+    ASSERT_EQ ("root", root.operationName);
+    ASSERT_EQ (absl::Milliseconds(100), root.duration);
+    ASSERT_EQ (absl::Milliseconds(30), root.selfTime);
+    ASSERT_EQ (absl::Milliseconds(30), root.criticalTime);
+
+    // b ends last so it is entirely on the critical path, and a is only on the critical path
+    // until b starts
+    auto &a = timings.at(1);
+    ASSERT_EQ ("a", a.operationName);
+    ASSERT_EQ (absl::Milliseconds(40), a.selfTime);
+    ASSERT_EQ (absl::Milliseconds(10), a.criticalTime);
+    auto &b = timings.at(2);
+    ASSERT_EQ ("b", b.operationName);
+    ASSERT_EQ (absl::Milliseconds(60), b.selfTime);
+    ASSERT_EQ (absl::Milliseconds(60), b.criticalTime);
+}
+
+TEST(SpansetAnalysis, AggregateProfileAcrossSpansets)
+{
+    tempo_tracing::SpansetProfile profile;
+    ASSERT_THAT (profile.addSpanset(make_concurrent_spanset()), tempo_test::IsOk());
+    ASSERT_THAT (profile.addSpanset(make_concurrent_spanset()), tempo_test::IsOk());
+    ASSERT_EQ (2, profile.numSpansets());
+
+    auto operations = profile.listOperations();
+    ASSERT_EQ (3, operations.size());
+    ASSERT_EQ ("b", operations.at(0).first);
+    ASSERT_EQ (2, operations.at(0).second.count);
+    ASSERT_EQ (absl::Milliseconds(120), operations.at(0).second.selfTime);
+    ASSERT_EQ (absl::Milliseconds(120), operations.at(0).second.criticalTime);
+
+    ASSERT_EQ ("root 60000000\n"
+               "root;a 80000000\n"
+               "root;b 120000000\n", profile.toFoldedStacks());
+}
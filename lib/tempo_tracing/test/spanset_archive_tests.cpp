@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <tempo_tracing/spanset_archive.h>
+#include <tempo_tracing/spanset_archive_writer.h>
+#include <tempo_tracing/trace_recorder.h>
+#include <tempo_tracing/tracing_schema.h>
+#include <tempo_test/result_matchers.h>
+#include <tempo_test/status_matchers.h>
+#include <tempo_utils/bytes_appender.h>
+#include <tempo_utils/tempfile_maker.h>
+
+static tempo_tracing::TempoSpanset
+make_spanset(std::string_view component, absl::Duration parentDuration, bool childFailed)
+{
+    auto recorder = tempo_tracing::TraceRecorder::create();
+    auto start = absl::FromUnixSeconds(1700000000);
+
+    auto parent = recorder->makeSpan();
+    parent->setOperationName("parent");
+    parent->putTag(tempo_tracing::kOpentracingComponent, std::string(component));
+    parent->setStartTime(start);
+    parent->setEndTime(start + parentDuration);
+
+    auto child = parent->makeSpan();
+    child->setOperationName("child");
+    child->setStartTime(start);
+    child->setEndTime(start + absl::Milliseconds(1));
+    child->setFailed(childFailed);
+
+    child->close();
+    parent->close();
+    recorder->close();
+    return recorder->toSpanset().orElseThrow();
+}
+
+TEST(SpansetArchive, AggregateSpansMatchingQuery)
+{
+    tempo_tracing::SpansetArchiveWriter writer(tempo_tracing::SpansetArchiveOptions{.maxBlockSpans = 8});
+    for (int i = 1; i <= 10; i++) {
+        auto component = i % 2 == 0? "even" : "odd";
+        ASSERT_THAT (writer.appendSpanset(make_spanset(component, absl::Milliseconds(i), i == 3)),
+            tempo_test::IsOk());
+    }
+    ASSERT_EQ (2, writer.numBlocks());
+
+    tempo_utils::TempfileMaker tempfileMaker(std::filesystem::current_path(), "archive.XXXXXXXX", writer.finish());
+    ASSERT_TRUE (tempfileMaker.isValid());
+
+    auto openArchiveResult = tempo_tracing::SpansetArchive::open(tempfileMaker.getTempfile());
+    ASSERT_THAT (openArchiveResult, tempo_test::IsResult());
+    auto archive = openArchiveResult.getResult();
+    ASSERT_EQ (3, archive.numBlocks());
+    ASSERT_EQ (20, archive.numSpans());
+
+    tempo_tracing::ArchiveQuery query;
+    query.operationName = "parent";
+    query.tags.emplace_back(tempo_tracing::kOpentracingComponent.getKey(), "even");
+    auto aggregateResult = archive.aggregate(query);
+    ASSERT_THAT (aggregateResult, tempo_test::IsResult());
+    auto aggregate = aggregateResult.getResult();
+    ASSERT_EQ (5, aggregate.numSpans);
+    ASSERT_EQ (0, aggregate.numFailed);
+    ASSERT_TRUE (aggregate.durations.isValid());
+    ASSERT_NEAR (absl::ToInt64Nanoseconds(absl::Milliseconds(10)),
+        aggregate.durations.getPercentileValue(99.0), absl::ToInt64Nanoseconds(absl::Microseconds(100)));
+
+    tempo_tracing::ArchiveQuery failedQuery;
+    failedQuery.failedOnly = true;
+    aggregate = archive.aggregate(failedQuery).orElseThrow();
+    ASSERT_EQ (1, aggregate.numSpans);
+    ASSERT_EQ (1, aggregate.numFailed);
+
+    tempo_tracing::ArchiveQuery missingQuery;
+    missingQuery.operationName = "missing";
+    aggregate = archive.aggregate(missingQuery).orElseThrow();
+    ASSERT_EQ (0, aggregate.numSpans);
+}
+
+TEST(SpansetArchive, LoadFailsForInvalidArchive)
+{
+    tempo_utils::BytesAppender appender;
+    appender.appendBytes(std::string_view("NOPE"));
+    auto loadArchiveResult = tempo_tracing::SpansetArchive::load(appender.finish());
+    ASSERT_TRUE (loadArchiveResult.isStatus());
+    ASSERT_TRUE (loadArchiveResult.getStatus().matchesCondition(tempo_tracing::TracingCondition::kInvalidArchive));
+}
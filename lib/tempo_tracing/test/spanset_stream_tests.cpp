@@ -0,0 +1,189 @@
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <tempo_tracing/internal/spanset_reader.h>
+#include <tempo_tracing/span_walker.h>
+#include <tempo_tracing/spanset_stream.h>
+#include <tempo_tracing/trace_recorder.h>
+#include <tempo_test/result_matchers.h>
+
+TEST(SpansetStream, StreamSpansAndConcatenateFragments)
+{
+    std::vector<tu_uint8> bytes;
+    int numFragments = 0;
+    auto callback = [&](std::span<const tu_uint8> fragment) -> tempo_utils::Status {
+        bytes.insert(bytes.end(), fragment.begin(), fragment.end());
+        numFragments++;
+        return {};
+    };
+    tempo_tracing::SpansetStreamOptions options;
+    options.maxFragmentSpans = 2;
+    auto recorder = tempo_tracing::TraceRecorder::createStreaming(
+        tempo_utils::TraceId::generate(), callback, options);
+    ASSERT_TRUE (recorder->isStreaming());
+
+    auto root = recorder->makeSpan();
+    root->setOperationName("root");
+    std::vector<tempo_utils::SpanId> childIds;
+    for (int i = 0; i < 3; i++) {
+        auto child = root->makeSpan();
+        childIds.push_back(child->spanId());
+        auto grandchild = child->makeSpan();
+        grandchild->close();
+        child->close();
+    }
+    root->close();
+    recorder->close();
+
+    ASSERT_EQ (4, numFragments);
+    ASSERT_THAT (recorder->toSpanset(), tempo_test::IsStatus());
+
+    auto concatenateResult = tempo_tracing::concatenate_spanset_fragments(bytes);
+    ASSERT_THAT (concatenateResult, tempo_test::IsResult());
+    auto spanset = concatenateResult.getResult();
+    ASSERT_TRUE (spanset.isValid());
+    ASSERT_EQ (recorder->traceId(), spanset.getTraceId());
+    ASSERT_EQ (7, spanset.getReader()->numSpans());
+
+    auto rootWalker = spanset.getRoots().getRoot(0);
+    ASSERT_EQ (root->spanId(), rootWalker.getId());
+    ASSERT_EQ ("root", rootWalker.getOperationName());
+    ASSERT_EQ (3, rootWalker.numChildren());
+    for (int i = 0; i < rootWalker.numChildren(); i++) {
+        auto childWalker = rootWalker.getChild(i);
+        ASSERT_EQ (childIds.at(i), childWalker.getId());
+        ASSERT_EQ (root->spanId(), childWalker.getParent().getId());
+        ASSERT_EQ (1, childWalker.numChildren());
+    }
+}
+
+TEST(SpansetStream, PropagateFailureWhenParentClosesBeforeChild)
+{
+    std::vector<tu_uint8> bytes;
+    auto recorder = tempo_tracing::TraceRecorder::createStreaming(tempo_utils::TraceId::generate(),
+        [&](std::span<const tu_uint8> fragment) -> tempo_utils::Status {
+            bytes.insert(bytes.end(), fragment.begin(), fragment.end());
+            return {};
+        });
+
+    auto root = recorder->makeSpan(tempo_tracing::FailurePropagation::NoPropagation,
+        tempo_tracing::FailureCollection::AnyChildFailed);
+    auto child = root->makeSpan(tempo_tracing::FailurePropagation::PropagatesToParent);
+    root->close();
+    recorder->close();
+    ASSERT_TRUE (bytes.empty());
+
+    // the root span is written once its last child is closed
+    child->setFailed(true);
+    child->close();
+    ASSERT_TRUE (recorder->flush().isOk());
+
+    auto concatenateResult = tempo_tracing::concatenate_spanset_fragments(bytes);
+    ASSERT_THAT (concatenateResult, tempo_test::IsResult());
+    auto spanset = concatenateResult.getResult();
+    ASSERT_EQ (2, spanset.getReader()->numSpans());
+    ASSERT_EQ (2, spanset.getErrors().numErrors());
+}
+
+TEST(SpansetStream, MakeChildSpansFromContextAfterParentIsWritten)
+{
+    std::vector<tu_uint8> bytes;
+    auto recorder = tempo_tracing::TraceRecorder::createStreaming(tempo_utils::TraceId::generate(),
+        [&](std::span<const tu_uint8> fragment) -> tempo_utils::Status {
+            bytes.insert(bytes.end(), fragment.begin(), fragment.end());
+            return {};
+        });
+
+    auto root = recorder->makeSpan();
+    root->setOperationName("root");
+    auto context = root->getContext();
+    root->close();
+    ASSERT_TRUE (recorder->flush().isOk());
+    ASSERT_FALSE (bytes.empty());
+
+    // fan out tasks which hold the context of the root span, which has already been written
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([context] {
+            auto span = context.makeSpan();
+            ASSERT_NE (nullptr, span);
+            span->setOperationName("worker");
+            auto grandchild = span->makeSpan();
+            grandchild->close();
+            span->close();
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    recorder->close();
+    ASSERT_TRUE (recorder->flush().isOk());
+
+    auto concatenateResult = tempo_tracing::concatenate_spanset_fragments(bytes);
+    ASSERT_THAT (concatenateResult, tempo_test::IsResult());
+    auto spanset = concatenateResult.getResult();
+    ASSERT_EQ (9, spanset.getReader()->numSpans());
+    ASSERT_EQ (1, spanset.getRoots().numRoots());
+
+    auto rootWalker = spanset.getRoots().getRoot(0);
+    ASSERT_EQ (root->spanId(), rootWalker.getId());
+    ASSERT_EQ (4, rootWalker.numChildren());
+    for (int i = 0; i < rootWalker.numChildren(); i++) {
+        auto childWalker = rootWalker.getChild(i);
+        ASSERT_EQ ("worker", childWalker.getOperationName());
+        ASSERT_EQ (1, childWalker.numChildren());
+    }
+}
+
+TEST(SpansetStream, ConcatenateRecordsOrphanedSpansAsRoots)
+{
+    std::vector<std::vector<tu_uint8>> fragments;
+    auto recorder = tempo_tracing::TraceRecorder::createStreaming(tempo_utils::TraceId::generate(),
+        [&](std::span<const tu_uint8> fragment) -> tempo_utils::Status {
+            fragments.emplace_back(fragment.begin(), fragment.end());
+            return {};
+        });
+
+    auto root = recorder->makeSpan();
+    auto context = root->getContext();
+    root->close();
+    ASSERT_TRUE (recorder->flush().isOk());
+    ASSERT_EQ (1, fragments.size());
+
+    std::vector<tempo_utils::SpanId> childIds;
+    for (int i = 0; i < 2; i++) {
+        auto child = context.makeSpan();
+        childIds.push_back(child->spanId());
+        auto grandchild = child->makeSpan();
+        grandchild->close();
+        child->close();
+    }
+    recorder->close();
+    ASSERT_TRUE (recorder->flush().isOk());
+
+    // drop the fragment containing the root span, so its children are orphaned
+    std::vector<tu_uint8> bytes;
+    for (tu_uint32 i = 1; i < fragments.size(); i++) {
+        bytes.insert(bytes.end(), fragments[i].begin(), fragments[i].end());
+    }
+
+    auto concatenateResult = tempo_tracing::concatenate_spanset_fragments(bytes);
+    ASSERT_THAT (concatenateResult, tempo_test::IsResult());
+    auto spanset = concatenateResult.getResult();
+    ASSERT_EQ (4, spanset.getReader()->numSpans());
+
+    auto roots = spanset.getRoots();
+    ASSERT_EQ (2, roots.numRoots());
+    for (int i = 0; i < roots.numRoots(); i++) {
+        auto rootWalker = roots.getRoot(i);
+        ASSERT_EQ (childIds.at(i), rootWalker.getId());
+        ASSERT_EQ (1, rootWalker.numChildren());
+    }
+}
+
+TEST(SpansetStream, ConcatenateFailsOnTruncatedFragment)
+{
+    std::vector<tu_uint8> bytes = {16, 0, 0, 0, 1, 2, 3};
+    ASSERT_THAT (tempo_tracing::concatenate_spanset_fragments(bytes), tempo_test::IsStatus());
+}
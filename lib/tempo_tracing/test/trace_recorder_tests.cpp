@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+
+#include <absl/container/flat_hash_set.h>
+
+#include <tempo_tracing/internal/spanset_reader.h>
+#include <tempo_tracing/span_walker.h>
+#include <tempo_tracing/trace_recorder.h>
+#include <tempo_tracing/tracing_schema.h>
+#include <tempo_test/result_matchers.h>
+
+TEST(TraceRecorder, MakeSpansFromMultipleThreads)
+{
+    auto recorder = tempo_tracing::TraceRecorder::create();
+    auto root = recorder->makeSpan();
+
+    constexpr int kNumThreads = 8;
+    constexpr int kSpansPerThread = 100;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kNumThreads; i++) {
+        threads.emplace_back([&]{
+            for (int j = 0; j < kSpansPerThread; j++) {
+                auto child = recorder->makeSpan(root);
+                auto grandchild = recorder->makeSpan(child);
+                grandchild->close();
+                child->close();
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    root->close();
+
+    recorder->close();
+    ASSERT_EQ (nullptr, recorder->makeSpan());
+    auto toSpansetResult = recorder->toSpanset();
+    ASSERT_THAT (toSpansetResult, tempo_test::IsResult());
+    auto spanset = toSpansetResult.getResult();
+
+    auto reader = spanset.getReader();
+    ASSERT_EQ (1 + 2 * kNumThreads * kSpansPerThread, reader->numSpans());
+
+    auto rootWalker = spanset.getRoots().getRoot(0);
+    ASSERT_EQ (root->spanId(), rootWalker.getId());
+    ASSERT_EQ (kNumThreads * kSpansPerThread, rootWalker.numChildren());
+
+    absl::flat_hash_set<tu_uint64> childIds;
+    for (int i = 0; i < rootWalker.numChildren(); i++) {
+        auto childWalker = rootWalker.getChild(i);
+        ASSERT_TRUE (childWalker.isValid());
+        ASSERT_EQ (root->spanId(), childWalker.getParent().getId());
+        ASSERT_EQ (1, childWalker.numChildren());
+        childIds.insert(childWalker.getId().getId());
+    }
+    ASSERT_EQ (kNumThreads * kSpansPerThread, childIds.size());
+}
+
+TEST(TraceRecorder, ToSpansetFailsIfRecorderIsNotClosed)
+{
+    auto recorder = tempo_tracing::TraceRecorder::create();
+    auto span = recorder->makeSpan();
+    span->close();
+    ASSERT_THAT (recorder->toSpanset(), tempo_test::IsStatus());
+}
+
+TEST(TraceRecorder, UnsampledTraceRecordsNoSpans)
+{
+    tempo_tracing::SamplingPolicy policy;
+    policy.headSampleRate = 0.0;
+    auto recorder = tempo_tracing::TraceRecorder::create(policy);
+    ASSERT_FALSE (recorder->isSampled());
+
+    auto root = recorder->makeSpan();
+    ASSERT_TRUE (root != nullptr);
+    ASSERT_FALSE (root->isSampled());
+    root->putTag(tempo_tracing::kOpentracingEvent, std::string("test"));
+    ASSERT_FALSE (root->hasTag(tempo_tracing::kOpentracingEvent.getKey()));
+
+    auto child = root->makeSpan();
+    ASSERT_FALSE (child->spanId().isValid());
+    ASSERT_TRUE (child->isOpen());
+    child->logMessage("first", tempo_tracing::LogSeverity::kError);
+    child->logMessage("second", tempo_tracing::LogSeverity::kError);
+    ASSERT_TRUE (child->isFailed());
+    child->close();
+    ASSERT_FALSE (child->isOpen());
+    root->close();
+
+    recorder->close();
+    auto toSpansetResult = recorder->toSpanset();
+    ASSERT_THAT (toSpansetResult, tempo_test::IsResult());
+    ASSERT_FALSE (toSpansetResult.getResult().isValid());
+}
+
+TEST(TraceRecorder, TailSamplingKeepsFailedTrace)
+{
+    tempo_tracing::SamplingPolicy policy;
+    policy.tailSampling = true;
+    auto recorder = tempo_tracing::TraceRecorder::create(policy);
+
+    auto root = recorder->makeSpan(tempo_tracing::FailurePropagation::NoPropagation,
+        tempo_tracing::FailureCollection::AnyChildFailed);
+    auto child = root->makeSpan(tempo_tracing::FailurePropagation::PropagatesToParent);
+    child->setFailed(true);
+    child->close();
+    root->close();
+
+    recorder->close();
+    auto toSpansetResult = recorder->toSpanset();
+    ASSERT_THAT (toSpansetResult, tempo_test::IsResult());
+    auto spanset = toSpansetResult.getResult();
+    ASSERT_TRUE (spanset.isValid());
+    ASSERT_EQ (2, spanset.getReader()->numSpans());
+    ASSERT_EQ (2, spanset.getErrors().numErrors());
+}
+
+TEST(TraceRecorder, TailSamplingKeepsSlowTrace)
+{
+    tempo_tracing::SamplingPolicy policy;
+    policy.tailSampling = true;
+    policy.latencyThreshold = absl::Milliseconds(100);
+    auto recorder = tempo_tracing::TraceRecorder::create(policy);
+
+    auto root = recorder->makeSpan();
+    root->setActiveDuration(absl::Milliseconds(150));
+    root->close();
+
+    recorder->close();
+    auto toSpansetResult = recorder->toSpanset();
+    ASSERT_THAT (toSpansetResult, tempo_test::IsResult());
+    ASSERT_TRUE (toSpansetResult.getResult().isValid());
+}
+
+TEST(TraceRecorder, TailSamplingDropsFastSuccessfulTrace)
+{
+    tempo_tracing::SamplingPolicy policy;
+    policy.tailSampling = true;
+    policy.latencyThreshold = absl::Milliseconds(100);
+    auto recorder = tempo_tracing::TraceRecorder::create(policy);
+
+    auto root = recorder->makeSpan();
+    root->setActiveDuration(absl::Milliseconds(10));
+    root->close();
+
+    recorder->close();
+    auto toSpansetResult = recorder->toSpanset();
+    ASSERT_THAT (toSpansetResult, tempo_test::IsResult());
+    ASSERT_FALSE (toSpansetResult.getResult().isValid());
+}
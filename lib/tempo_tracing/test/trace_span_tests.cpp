@@ -120,3 +120,36 @@ TEST(TraceSpan, CheckResultNotOk)
     ASSERT_TRUE (logWalker.parseField(tempo_tracing::kOpentracingMessage, message).isOk());
     ASSERT_EQ ("foobar", message);
 }
+
+#if defined(__linux__)
+TEST(TraceSpan, TagPerfCountersWhenEnabled)
+{
+    auto recorder = tempo_tracing::TraceRecorder::create();
+    recorder->setPerfCountersEnabled(true);
+
+    auto span = recorder->makeSpan();
+    span->activate();
+    volatile tu_uint64 sum = 0;
+    for (int i = 0; i < 100000; i++) {
+        sum = sum + i;
+    }
+    // sleeping gives up the processor, so the span records at least one context switch
+    absl::SleepFor(absl::Milliseconds(1));
+    span->deactivate();
+    span->close();
+
+    // hardware counters may be unavailable, but the software counters are always recorded
+    ASSERT_TRUE (span->hasTag(tempo_tracing::kTempoTracingPerfContextSwitches.getKey()));
+    ASSERT_LE (1, span->getTag(tempo_tracing::kTempoTracingPerfContextSwitches.getKey()).getUInt64());
+    ASSERT_TRUE (span->hasTag(tempo_tracing::kTempoTracingPerfTaskClock.getKey()));
+    ASSERT_LT (0, span->getTag(tempo_tracing::kTempoTracingPerfTaskClock.getKey()).getUInt64());
+    if (span->hasTag(tempo_tracing::kTempoTracingPerfInstructions.getKey())) {
+        ASSERT_LE (100000, span->getTag(tempo_tracing::kTempoTracingPerfInstructions.getKey()).getUInt64());
+    }
+
+    auto unrecorded = tempo_tracing::TraceRecorder::create()->makeSpan();
+    unrecorded->activate();
+    unrecorded->close();
+    ASSERT_FALSE (unrecorded->hasTag(tempo_tracing::kTempoTracingPerfTaskClock.getKey()));
+}
+#endif
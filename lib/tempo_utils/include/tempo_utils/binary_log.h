@@ -0,0 +1,188 @@
+#ifndef TEMPO_UTILS_BINARY_LOG_H
+#define TEMPO_UTILS_BINARY_LOG_H
+
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include <absl/container/flat_hash_map.h>
+#include <absl/time/clock.h>
+#include <absl/time/time.h>
+
+#include "integer_types.h"
+#include "logging.h"
+#include "result.h"
+
+// write a binary log message with the specified severity. the format string uses fmt syntax
+// and is not expanded at the log site; only the raw argument values are recorded, and the
+// message is formatted when the log is decoded.
+
+#define TU_BINLOG(severity, format, ...)                                                        \
+    do {                                                                                        \
+        if (tempo_utils::log_severity_is_enabled(severity)) {                                   \
+            static tempo_utils::BinaryLogSite tu_binlog_site_{severity, __FILE__, __LINE__, format};    \
+            tempo_utils::write_binary_log_args(tu_binlog_site_ __VA_OPT__(,) __VA_ARGS__);      \
+        }                                                                                       \
+    } while (false)
+
+#define TU_BINLOG_ERROR(format, ...)    TU_BINLOG(tempo_utils::LogSeverity::kError, format __VA_OPT__(,) __VA_ARGS__)
+#define TU_BINLOG_WARN(format, ...)     TU_BINLOG(tempo_utils::LogSeverity::kWarn, format __VA_OPT__(,) __VA_ARGS__)
+#define TU_BINLOG_INFO(format, ...)     TU_BINLOG(tempo_utils::LogSeverity::kInfo, format __VA_OPT__(,) __VA_ARGS__)
+#define TU_BINLOG_V(format, ...)        TU_BINLOG(tempo_utils::LogSeverity::kVerbose, format __VA_OPT__(,) __VA_ARGS__)
+#define TU_BINLOG_VV(format, ...)       TU_BINLOG(tempo_utils::LogSeverity::kVeryVerbose, format __VA_OPT__(,) __VA_ARGS__)
+
+namespace tempo_utils {
+
+    constexpr const char *kBinaryLogMagic = "TBLG";
+    constexpr tu_uint32 kBinaryLogVersion = 1;
+
+    /**
+     * Type of a record in a binary log file.
+     */
+    enum class BinaryLogRecordType : tu_uint8 {
+        kInvalid = 0,
+        kSite = 1,          /**< static descriptor of a binary log site. */
+        kEvent = 2,         /**< binary log event referencing a site. */
+        kText = 3,          /**< log message which was formatted at the log site. */
+    };
+
+    /**
+     * Type tag preceding each encoded argument of a binary log event.
+     */
+    enum class BinaryLogArgType : tu_uint8 {
+        kInvalid = 0,
+        kBool = 1,
+        kChar = 2,
+        kInt64 = 3,
+        kUInt64 = 4,
+        kDouble = 5,
+        kString = 6,
+        kPointer = 7,
+    };
+
+    /**
+     * Static descriptor of a binary log site. The site id is assigned the first time the site
+     * writes a message, and is stable for the lifetime of the process.
+     */
+    struct BinaryLogSite {
+        LogSeverity severity;
+        const char *filePath;
+        int lineNr;
+        const char *format;
+        std::atomic<tu_uint32> siteId = 0;
+
+        tu_uint32 getSiteId();
+    };
+
+    /**
+     * A decoded entry from a binary log file.
+     */
+    struct BinaryLogEntry {
+        absl::Time ts;
+        LogSeverity severity;
+        std::string filePath;
+        int lineNr;
+        std::string message;
+    };
+
+    /**
+     * Sequential reader of the records in a binary log file. Site records are consumed
+     * internally, so each call to `readEntry` returns the next formatted log message.
+     */
+    class BinaryLogReader {
+    public:
+        explicit BinaryLogReader(std::string_view bytes);
+
+        Status readHeader();
+        Result<bool> readEntry(BinaryLogEntry &entry);
+
+    private:
+        struct SiteDescriptor {
+            LogSeverity severity;
+            std::string filePath;
+            int lineNr;
+            std::string format;
+        };
+
+        std::string_view m_bytes;
+        absl::flat_hash_map<tu_uint32,SiteDescriptor> m_sites;
+    };
+
+    std::string format_binary_log_message(std::string_view format, std::string_view args);
+
+    namespace internal {
+        std::string& get_binary_log_buffer();
+
+        void write_binary_log_to_sink(
+            AbstractLogSink *sink,
+            const absl::Time &ts,
+            const BinaryLogSite *site,
+            std::string_view args);
+
+        template<typename T>
+        void append_binary_log_value(std::string &buffer, BinaryLogArgType type, const T &value)
+        {
+            buffer.push_back(static_cast<char>(type));
+            buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+
+        inline void append_binary_log_string(std::string &buffer, std::string_view str)
+        {
+            buffer.push_back(static_cast<char>(BinaryLogArgType::kString));
+            auto size = static_cast<tu_uint32>(str.size());
+            buffer.append(reinterpret_cast<const char *>(&size), sizeof(size));
+            buffer.append(str.data(), size);
+        }
+
+        template<typename T>
+        void encode_binary_log_arg(std::string &buffer, const T &arg)
+        {
+            using U = std::decay_t<T>;
+            if constexpr (std::is_same_v<U, bool>) {
+                append_binary_log_value(buffer, BinaryLogArgType::kBool, static_cast<tu_uint8>(arg));
+            } else if constexpr (std::is_same_v<U, char>) {
+                append_binary_log_value(buffer, BinaryLogArgType::kChar, arg);
+            } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+                append_binary_log_value(buffer, BinaryLogArgType::kInt64, static_cast<tu_int64>(arg));
+            } else if constexpr (std::is_integral_v<U>) {
+                append_binary_log_value(buffer, BinaryLogArgType::kUInt64, static_cast<tu_uint64>(arg));
+            } else if constexpr (std::is_enum_v<U>) {
+                encode_binary_log_arg(buffer, static_cast<std::underlying_type_t<U>>(arg));
+            } else if constexpr (std::is_floating_point_v<U>) {
+                append_binary_log_value(buffer, BinaryLogArgType::kDouble, static_cast<double>(arg));
+            } else if constexpr (std::is_same_v<U, const char *> || std::is_same_v<U, char *>) {
+                // copy to a local pointer first, because T may be an array type which is never null
+                const char *str = arg;
+                append_binary_log_string(buffer, str != nullptr? std::string_view(str) : std::string_view("(null)"));
+            } else if constexpr (std::is_convertible_v<const U &, std::string_view>) {
+                append_binary_log_string(buffer, std::string_view(arg));
+            } else if constexpr (std::is_pointer_v<U>) {
+                append_binary_log_value(buffer, BinaryLogArgType::kPointer,
+                    reinterpret_cast<tu_uint64>(static_cast<const void *>(arg)));
+            } else {
+                static_assert(std::is_pointer_v<U>, "unsupported binary log argument type");
+            }
+        }
+    }
+
+    /**
+     * Encode the arguments into the thread-local binary log buffer and write them to the
+     * current log sink. The arguments are not formatted.
+     *
+     * @param site The binary log site.
+     * @param args The arguments referenced by the site format string.
+     */
+    template<typename... Args>
+    void write_binary_log_args(BinaryLogSite &site, const Args&... args)
+    {
+        auto ts = absl::Now();
+        auto &buffer = internal::get_binary_log_buffer();
+        buffer.clear();
+        (internal::encode_binary_log_arg(buffer, args), ...);
+        write_binary_log(ts, &site, buffer);
+    }
+}
+
+#endif // TEMPO_UTILS_BINARY_LOG_H
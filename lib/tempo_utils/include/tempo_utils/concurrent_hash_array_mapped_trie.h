@@ -0,0 +1,273 @@
+#ifndef TEMPO_UTILS_CONCURRENT_HASH_ARRAY_MAPPED_TRIE_H
+#define TEMPO_UTILS_CONCURRENT_HASH_ARRAY_MAPPED_TRIE_H
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "hash_array_mapped_trie.h"
+
+namespace tempo_utils {
+
+    /**
+     * A hash array mapped trie which may be read and updated by multiple threads without external locking.
+     * The slots of the root level are atomic pointers, and each slot holds an immutable subtree built from
+     * the same nodes as HashArrayMappedTrie. An update copies the path to the entry within the subtree and
+     * publishes the new subtree with a compare-and-swap on the slot, retrying if another writer published
+     * to the same slot first. Writers to different slots never contend, since each slot occupies its own
+     * cache line.
+     *
+     * This is not a Ctrie: only the root slots are updated in place, so writers to the same slot serialize
+     * on its compare-and-swap, and there are no indirection nodes below the root. Slots are accessed through
+     * std::atomic<std::shared_ptr>, which is not lock-free in libstdc++; readers and writers hold the
+     * internal lock of a slot only long enough to copy or swap the pointer, and readers never wait for an
+     * update to be built.
+     *
+     * snapshot() returns an immutable HashArrayMappedTrie containing the entries at a single point in time.
+     * The snapshot shares every subtree with the concurrent trie, so its cost depends only on the number of
+     * root slots and not on the number of entries.
+     *
+     * @tparam KeyType The key type.
+     * @tparam ValueType The value type.
+     * @tparam Hash The hash functor type.
+     * @tparam KeyEqual The key equals functor type.
+     * @tparam BitsPerLevel The number of hash bits consumed by each level of the trie.
+     */
+    template<
+        class KeyType,
+        class ValueType,
+        class Hash = std::hash<KeyType>,
+        class KeyEqual = std::equal_to<KeyType>,
+        int BitsPerLevel = kHamtBitsPerLevel
+    >
+    class ConcurrentHashArrayMappedTrie {
+
+        using Node = HamtNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>;
+        using ValueNode = HamtValueNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>;
+        using IndexNode = HamtIndexNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>;
+        using Trie = HashArrayMappedTrie<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>;
+
+    public:
+        ConcurrentHashArrayMappedTrie() = default;
+
+        /**
+         * Constructs a ConcurrentHashArrayMappedTrie containing the entries of `trie`. The subtrees of
+         * the trie are shared rather than copied.
+         *
+         * @param trie The initial entries.
+         */
+        explicit ConcurrentHashArrayMappedTrie(const Trie &trie)
+        {
+            auto root = trie.getRoot();
+            if (root == nullptr)
+                return;
+            switch (root->getType()) {
+                case HamtNodeType::VALUE: {
+                    auto *value = static_cast<const ValueNode *>(root.get());
+                    auto index = KeyHash<BitsPerLevel>(value->getHash()).getIndex();
+                    m_slots[index].node.store(std::move(root));
+                    break;
+                }
+                case HamtNodeType::INDEX: {
+                    auto *index = static_cast<const IndexNode *>(root.get());
+                    for (tu_uint32 i = 0; i < m_slots.size(); i++) {
+                        m_slots[i].node.store(index->at(i));
+                    }
+                    break;
+                }
+                default:
+                    TU_UNREACHABLE();
+            }
+        }
+
+        ConcurrentHashArrayMappedTrie(const ConcurrentHashArrayMappedTrie &other) = delete;
+        ConcurrentHashArrayMappedTrie& operator=(const ConcurrentHashArrayMappedTrie &other) = delete;
+
+        /**
+         * Returns whether an entry with the specified `key` is present in the trie.
+         *
+         * @param key The entry key.
+         * @return true if the trie contains the entry, otherwise false.
+         */
+        bool contains(const KeyType &key) const
+        {
+            KeyHash<BitsPerLevel> hash(Hash()(key));
+            auto node = m_slots[hash.getIndex()].node.load(std::memory_order_acquire);
+            if (node == nullptr)
+                return false;
+            return node->lookup(key, hash.next()) != nullptr;
+        }
+
+        /**
+         * Returns the entry with the specified `key` in the trie. If no such key is present in the trie then
+         * the entry is invalid. The entry shares ownership of the key-value pair, so it remains valid after
+         * the entry is replaced or removed.
+         *
+         * @param key The entry key.
+         * @return The entry corresponding to the key in the trie, or an invalid HamtEntry if the key is not present.
+         */
+        HamtEntry<KeyType,ValueType> get(const KeyType &key) const
+        {
+            KeyHash<BitsPerLevel> hash(Hash()(key));
+            auto node = m_slots[hash.getIndex()].node.load(std::memory_order_acquire);
+            return hamt_find(node, key, hash.next());
+        }
+
+        /**
+         * Inserts the entry into the trie. If the trie already contains an entry with the specified `key`
+         * then that entry is replaced with the specified `value`.
+         *
+         * @param key The key of the entry to insert or replace.
+         * @param value The value of the entry.
+         */
+        void update(const KeyType &key, const ValueType &value)
+        {
+            KeyHash<BitsPerLevel> hash(Hash()(key));
+            auto &slot = m_slots[hash.getIndex()];
+            auto next = hash.next();
+
+            beginWrite(slot);
+            auto node = slot.node.load(std::memory_order_acquire);
+            std::shared_ptr<Node> updated;
+            do {
+                updated = hamt_update(node, key, value, next);
+            } while (!slot.node.compare_exchange_weak(node, updated));
+            slot.numEnded.fetch_add(1);
+        }
+
+        /**
+         * Removes the entry with the specified `key` from the trie.
+         *
+         * @param key The key of the entry to remove.
+         * @return true if the entry was removed, or false if the trie does not contain `key`.
+         */
+        bool remove(const KeyType &key)
+        {
+            KeyHash<BitsPerLevel> hash(Hash()(key));
+            auto &slot = m_slots[hash.getIndex()];
+            auto next = hash.next();
+
+            beginWrite(slot);
+            auto node = slot.node.load(std::memory_order_acquire);
+            bool removed = false;
+            for (;;) {
+                auto updated = hamt_remove(node, key, next);
+                if (updated == node)
+                    break;
+                if (slot.node.compare_exchange_weak(node, updated)) {
+                    removed = true;
+                    break;
+                }
+            }
+            slot.numEnded.fetch_add(1);
+            return removed;
+        }
+
+        /**
+         * Returns an immutable trie containing the entries of the concurrent trie at a single point in
+         * time. Writers increment the begun counter of a slot before publishing to it and the ended counter
+         * afterwards. The snapshot loads every slot which has no write in progress, then verifies that no
+         * write began on any slot while the slots were being loaded, so every loaded subtree was current at
+         * the moment the last slot was loaded.
+         *
+         * If writes overlap each of the first kMaxOptimisticAttempts passes then the snapshot freezes the
+         * trie instead of retrying: new writers wait until the snapshot completes, so the snapshot only
+         * waits for the writes which were already in progress, and a single pass always succeeds.
+         *
+         * @return The trie.
+         */
+        Trie snapshot() const
+        {
+            std::array<std::shared_ptr<Node>,kNumSlots> nodes;
+
+            bool consistent = false;
+            for (int attempt = 0; attempt < kMaxOptimisticAttempts && !consistent; attempt++) {
+                consistent = tryLoadSlots(nodes);
+            }
+
+            if (!consistent) {
+                m_numFreezing.fetch_add(1);
+                for (tu_uint32 i = 0; i < kNumSlots; i++) {
+                    const auto &slot = m_slots[i];
+                    while (slot.numEnded.load() != slot.numBegun.load()) {
+                        std::this_thread::yield();
+                    }
+                    nodes[i] = slot.node.load();
+                }
+                if (m_numFreezing.fetch_sub(1) == 1) {
+                    m_numFreezing.notify_all();
+                }
+            }
+
+            HamtBitmap bitmap = 0;
+            typename IndexNode::Children children;
+            for (tu_uint32 i = 0; i < kNumSlots; i++) {
+                if (nodes[i] != nullptr) {
+                    bitmap |= static_cast<HamtBitmap>(1) << i;
+                    children.push_back(std::move(nodes[i]));
+                }
+            }
+            auto root = internal::hamt_make_node<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>(
+                nullptr, nullptr, bitmap, std::move(children));
+            if (root == nullptr)
+                return {};
+            return Trie(std::move(root));
+        }
+
+    private:
+        static constexpr tu_uint32 kNumSlots = table_slots(BitsPerLevel);
+        static constexpr int kMaxOptimisticAttempts = 2;
+
+        struct alignas(64) Slot {
+            std::atomic<std::shared_ptr<Node>> node;
+            std::atomic<tu_uint64> numBegun{0};
+            std::atomic<tu_uint64> numEnded{0};
+        };
+
+        std::array<Slot,kNumSlots> m_slots;
+        mutable std::atomic<tu_uint32> m_numFreezing{0};
+
+        /**
+         * Marks the beginning of a write to `slot`. The begun counter is incremented before the freeze
+         * count is checked, so a snapshot which froze the trie either observes the write and waits for
+         * it to end, or the writer observes the freeze and backs out until the snapshot completes.
+         */
+        void beginWrite(Slot &slot)
+        {
+            for (;;) {
+                slot.numBegun.fetch_add(1);
+                auto numFreezing = m_numFreezing.load();
+                if (numFreezing == 0)
+                    return;
+                slot.numEnded.fetch_add(1);
+                m_numFreezing.wait(numFreezing);
+            }
+        }
+
+        /**
+         * Loads every slot into `nodes` without blocking writers.
+         *
+         * @return true if no write was published while the slots were loaded, otherwise false.
+         */
+        bool tryLoadSlots(std::array<std::shared_ptr<Node>,kNumSlots> &nodes) const
+        {
+            std::array<tu_uint64,kNumSlots> begun;
+            for (tu_uint32 i = 0; i < kNumSlots; i++) {
+                const auto &slot = m_slots[i];
+                auto numEnded = slot.numEnded.load();
+                begun[i] = slot.numBegun.load();
+                if (begun[i] != numEnded)
+                    return false;
+                nodes[i] = slot.node.load();
+            }
+            for (tu_uint32 i = 0; i < kNumSlots; i++) {
+                if (m_slots[i].numBegun.load() != begun[i])
+                    return false;
+            }
+            return true;
+        }
+    };
+}
+
+#endif // TEMPO_UTILS_CONCURRENT_HASH_ARRAY_MAPPED_TRIE_H
@@ -0,0 +1,28 @@
+#ifndef TEMPO_UTILS_FAST_CLOCK_H
+#define TEMPO_UTILS_FAST_CLOCK_H
+
+#include <absl/time/time.h>
+
+#include "integer_types.h"
+
+namespace tempo_utils {
+
+    /**
+     * Monotonic clock with nanosecond resolution which is cheaper to read than the system wall
+     * clock. If the processor has an invariant TSC then the clock reads the TSC directly,
+     * otherwise it reads CLOCK_MONOTONIC. The clock is calibrated once, the first time it is
+     * read, so that its timestamps are comparable with wall clock time; adjustments to the
+     * wall clock after calibration are not reflected in the fast clock.
+     */
+    class FastClock {
+
+    public:
+        static tu_int64 nanosSinceEpoch();
+        static absl::Time now();
+
+        static bool isTscClock();
+        static void calibrate();
+    };
+}
+
+#endif // TEMPO_UTILS_FAST_CLOCK_H
@@ -12,6 +12,12 @@ namespace tempo_utils {
      */
     void invoke_fault_handler(int signum, const char *message);
 
+    /**
+     * Install a signal handler which invokes the fault handler when the process receives
+     * a fatal signal, including the SIGABRT raised by a fatal log message.
+     */
+    bool install_fault_handler();
+
 };
 
 #endif // TEMPO_UTILS_FAULT_HANDLER_H
@@ -0,0 +1,42 @@
+#ifndef TEMPO_UTILS_FLIGHT_RECORDER_H
+#define TEMPO_UTILS_FLIGHT_RECORDER_H
+
+#include <string_view>
+
+#include <absl/time/time.h>
+
+#include "integer_types.h"
+#include "logging.h"
+
+namespace tempo_utils {
+
+    /**
+     * The number of records retained by the flight recorder. Once the recorder is full, each
+     * new record replaces the oldest record.
+     */
+    constexpr int kFlightRecorderCapacity = 4096;
+
+    /**
+     * The maximum number of bytes of a log message or span operation name which are retained
+     * in a flight record. Longer text is truncated.
+     */
+    constexpr int kFlightRecordTextSize = 192;
+
+    void record_flight_log(
+        const absl::Time &ts,
+        LogSeverity severity,
+        const char *filePath,
+        int lineNr,
+        std::string_view message);
+
+    void record_flight_span(
+        const absl::Time &ts,
+        tu_uint64 spanId,
+        std::string_view operationName,
+        absl::Duration activeDuration,
+        bool failed);
+
+    void dump_flight_recorder(int fd);
+}
+
+#endif // TEMPO_UTILS_FLIGHT_RECORDER_H
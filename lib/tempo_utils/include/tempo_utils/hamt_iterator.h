@@ -15,8 +15,9 @@ namespace tempo_utils {
      * @tparam V The value type.
      * @tparam H The hash functor type.
      * @tparam E The key equals functor type.
+     * @tparam B The number of hash bits consumed by each level of the trie.
      */
-    template<class K, class V, class H, class E>
+    template<class K, class V, class H, class E, int B>
     class HamtIterator : public AbstractIterator<HamtEntry<K,V>> {
     public:
 
@@ -25,7 +26,7 @@ namespace tempo_utils {
          *
          * @param root The root node of the trie.
          */
-        explicit HamtIterator(std::shared_ptr<HamtNode<K,V,H,E>> root)
+        explicit HamtIterator(std::shared_ptr<HamtNode<K,V,H,E,B>> root)
             : m_priv(std::make_shared<Priv>(std::move(root)))
         {
             load(m_priv->root, 0);
@@ -53,9 +54,8 @@ namespace tempo_utils {
             for (const auto &pair : m_priv->stack) {
                 switch (pair.first->getType()) {
                     case HamtNodeType::VALUE: {
-                        auto value = std::static_pointer_cast<HamtValueNode<K,V,H,E>>(pair.first);
-                        auto e = value->getEntry();
-                        TU_LOG_INFO << "  " << e.entryKey() << " -> " << e.entryValue();
+                        auto value = std::static_pointer_cast<HamtValueNode<K,V,H,E,B>>(pair.first);
+                        TU_LOG_INFO << "  " << value->entryKey() << " -> " << value->entryValue();
                         break;
                     }
                     case HamtNodeType::INDEX: {
@@ -78,8 +78,8 @@ namespace tempo_utils {
 
             // top of the stack is always a value node
             TU_ASSERT (currNode->getType() == HamtNodeType::VALUE);
-            auto currValue = std::static_pointer_cast<HamtValueNode<K,V,H,E>>(currNode);
-            entry = currValue->getEntry();
+            auto currValue = std::static_pointer_cast<HamtValueNode<K,V,H,E,B>>(currNode);
+            entry = HamtValueNode<K,V,H,E,B>::toEntry(currValue);
 
             // find the next value node
             while (!m_priv->stack.empty()) {
@@ -89,11 +89,11 @@ namespace tempo_utils {
                 nextOffset++;
 
                 TU_ASSERT (nextNode->getType() == HamtNodeType::INDEX);
-                auto nextIndex = std::static_pointer_cast<HamtIndexNode<K,V,H,E>>(nextNode);
+                auto nextIndex = std::static_pointer_cast<HamtIndexNode<K,V,H,E,B>>(nextNode);
                 auto child = findNextChild(nextIndex, nextOffset);
 
                 if (child != nullptr) {
-                    load(child, nextOffset);
+                    load(child, 0);
                     break;
                 }
 
@@ -105,29 +105,25 @@ namespace tempo_utils {
 
     private:
         struct Priv {
-            std::shared_ptr<HamtNode<K,V,H,E>> root;
+            std::shared_ptr<HamtNode<K,V,H,E,B>> root;
             std::vector<
                 std::pair<
-                    std::shared_ptr<HamtNode<K,V,H,E>>,
+                    std::shared_ptr<HamtNode<K,V,H,E,B>>,
                     int>>
             stack;
         };
         std::shared_ptr<Priv> m_priv;
 
-        static std::shared_ptr<HamtNode<K,V,H,E>>
-        findNextChild(std::shared_ptr<HamtIndexNode<K,V,H,E>> node, int &offset)
+        static std::shared_ptr<HamtNode<K,V,H,E,B>>
+        findNextChild(std::shared_ptr<HamtIndexNode<K,V,H,E,B>> node, int &offset)
         {
-            for (int i = offset; i < table_slots(kHamtBitsPerLevel); ++i) {
-                auto child = node->at(i);
-                if (child != nullptr) {
-                    offset = i;
-                    return child;
-                }
-            }
+            // index nodes contain only occupied slots, so the child at any valid offset is non-null
+            if (offset < static_cast<int>(node->numChildren()))
+                return node->childAt(offset);
             return nullptr;
         }
 
-        void load(std::shared_ptr<HamtNode<K,V,H,E>> node, int offset)
+        void load(std::shared_ptr<HamtNode<K,V,H,E,B>> node, int offset)
         {
             if (node == nullptr)
                 return;
@@ -138,10 +134,12 @@ namespace tempo_utils {
                         return;
                     }
                     case HamtNodeType::INDEX: {
-                        auto index = std::static_pointer_cast<HamtIndexNode<K,V,H,E>>(node);
+                        auto index = std::static_pointer_cast<HamtIndexNode<K,V,H,E,B>>(node);
                         node = findNextChild(index, offset);
                         TU_NOTNULL (node);
                         m_priv->stack.push_back(std::make_pair(index, offset));
+                        // descendants of the node are searched from their first child
+                        offset = 0;
                         break;
                     }
                     default:
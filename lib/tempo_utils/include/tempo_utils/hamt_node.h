@@ -1,7 +1,12 @@
 #ifndef TEMPO_UTILS_HAMT_NODE_H
 #define TEMPO_UTILS_HAMT_NODE_H
 
+#include <atomic>
+#include <bit>
+#include <bitset>
+#include <limits>
 #include <memory>
+#include <vector>
 
 #include "hashing.h"
 #include "integer_types.h"
@@ -12,6 +17,7 @@
 namespace tempo_utils {
 
     constexpr int kHamtBitsPerLevel = 4;
+    constexpr int kHamtMaxBitsPerLevel = 6;
 
     constexpr int table_slots(int bitsPerLevel) {
         int numSlots = 1;
@@ -21,27 +27,55 @@ namespace tempo_utils {
         return numSlots;
     }
 
+    /**
+     * Bitmap of the occupied slots in an index node. A level consumes at most kHamtMaxBitsPerLevel bits
+     * of the hash, so the slots of any index node fit in 64 bits.
+     */
+    using HamtBitmap = tu_uint64;
+
+    static_assert(table_slots(kHamtMaxBitsPerLevel) <= std::numeric_limits<HamtBitmap>::digits);
+
+    /**
+     * Returns a new edit token identifying a transient. Tokens are never reused, and the zero token is
+     * reserved for nodes which belong to a persistent trie and therefore must never be modified.
+     *
+     * @return The edit token.
+     */
+    inline tu_uint64 hamt_next_edit()
+    {
+        static std::atomic<tu_uint64> nextEdit{1};
+        return nextEdit.fetch_add(1, std::memory_order_relaxed);
+    }
+
     // forward declarations
-    template<class KeyType, class ValueType, class Hash, class KeyEqual>
+    template<class KeyType, class ValueType, class Hash, class KeyEqual, int BitsPerLevel>
     class HamtNode;
-    template<class KeyType, class ValueType, class Hash, class KeyEqual>
+    template<class KeyType, class ValueType, class Hash, class KeyEqual, int BitsPerLevel>
     class HamtValueNode;
-    template<class KeyType, class ValueType, class Hash, class KeyEqual>
+    template<class KeyType, class ValueType, class Hash, class KeyEqual, int BitsPerLevel>
     class HamtIndexNode;
 
     /**
-     * KeyHash encapsulates the state used when searching and modifying the trie.
+     * KeyHash encapsulates the state used when searching and modifying the trie. Each level consumes
+     * `BitsPerLevel` bits of the hash, starting from the most significant bit. If the width of the hash
+     * is not a multiple of `BitsPerLevel` then the last level has fewer bits remaining, and the missing
+     * low bits of its index are zero.
+     *
+     * @tparam BitsPerLevel The number of hash bits consumed by each level of the trie.
      */
+    template<int BitsPerLevel>
     class KeyHash
     {
+        static_assert(BitsPerLevel > 0 && BitsPerLevel <= kHamtMaxBitsPerLevel, "invalid BitsPerLevel");
+
     public:
         explicit KeyHash(size_t init, tu_uint32 level = 0)
             : m_init(init), m_curr(init), m_level(level)
         {
             for (tu_uint32 i = 0; i < level; ++i) {
-                TU_ASSERT (m_bits >= kHamtBitsPerLevel);
-                m_bits -= kHamtBitsPerLevel;
-                m_curr <<= kHamtBitsPerLevel;
+                TU_ASSERT (m_bits > 0);
+                m_bits = consume(m_bits);
+                m_curr <<= BitsPerLevel;
             }
         }
 
@@ -52,20 +86,20 @@ namespace tempo_utils {
 
         size_t getInit() const { return m_init; }
         size_t getHash() const { return m_curr; }
-        tu_uint32 getIndex() const { return m_curr >> (kHashBits - kHamtBitsPerLevel); }
+        tu_uint32 getIndex() const { return m_curr >> (kHashBits - BitsPerLevel); }
         tu_uint8 getBitsRemaining() const { return m_bits; }
         tu_uint32 getLevel() const { return m_level; }
 
         KeyHash next() const
         {
             TU_ASSERT (m_bits > 0);
-            auto curr = m_curr << kHamtBitsPerLevel;
-            auto bits = m_bits - kHamtBitsPerLevel;
+            auto curr = m_curr << BitsPerLevel;
+            auto bits = consume(m_bits);
             auto level = m_level + 1;
             return KeyHash(m_init, curr, bits, level);
         }
 
-        bool needsRehash() const { return m_bits < kHamtBitsPerLevel; }
+        bool needsRehash() const { return m_bits == 0; }
 
         KeyHash rehash(size_t init) const {
             TU_ASSERT (needsRehash());
@@ -88,8 +122,21 @@ namespace tempo_utils {
             : m_init(init), m_curr(curr), m_bits(bits), m_level(level)
         {
         }
+
+        static tu_uint8 consume(tu_uint8 bits)
+        {
+            return bits > BitsPerLevel? static_cast<tu_uint8>(bits - BitsPerLevel) : 0;
+        }
     };
 
+    template<class KeyType, class ValueType, class Hash, class KeyEqual, int BitsPerLevel>
+    std::shared_ptr<HamtIndexNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>> hamt_split(
+        std::shared_ptr<HamtValueNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>> existing,
+        const KeyType &key,
+        const ValueType &value,
+        const KeyHash<BitsPerLevel> &hash,
+        tu_uint64 edit = 0);
+
     enum class HamtNodeType {
         VALUE,
         INDEX,
@@ -97,7 +144,9 @@ namespace tempo_utils {
     };
 
     /**
-     * Immutable value class containing an entry key-value pair.
+     * Immutable value class containing an entry key-value pair. An entry returned from a trie shares
+     * ownership of the value node which stores the pair, so the entry remains valid after the trie is
+     * destroyed.
      *
      * @tparam KeyType The key type.
      * @tparam ValueType The value type.
@@ -110,6 +159,10 @@ namespace tempo_utils {
             : m_entry(std::make_shared<std::pair<KeyType,ValueType>>(std::make_pair(key, value)))
         {
         }
+        explicit HamtEntry(std::shared_ptr<const std::pair<KeyType,ValueType>> entry)
+            : m_entry(std::move(entry))
+        {
+        }
 
         bool isValid() const { return m_entry != nullptr; }
         const std::pair<KeyType,ValueType>& entryPair() const { return *m_entry; }
@@ -120,14 +173,6 @@ namespace tempo_utils {
         std::shared_ptr<const std::pair<KeyType,ValueType>> m_entry;
     };
 
-    /**
-     * Fixed size array containing node pointers.
-     */
-    template<class KeyType, class ValueType, class Hash, class KeyEqual>
-    using HamtIndexTable = std::array<
-        std::shared_ptr<HamtNode<KeyType,ValueType,Hash,KeyEqual>>,
-        table_slots(kHamtBitsPerLevel)>;
-
     /**
      * The HAMT base node.
      *
@@ -135,8 +180,9 @@ namespace tempo_utils {
      * @tparam ValueType The value type.
      * @tparam Hash The hash functor type.
      * @tparam KeyEqual The key equals functor type.
+     * @tparam BitsPerLevel The number of hash bits consumed by each level of the trie.
      */
-    template<class KeyType, class ValueType, class Hash, class KeyEqual>
+    template<class KeyType, class ValueType, class Hash, class KeyEqual, int BitsPerLevel>
     class HamtNode {
     public:
         explicit HamtNode(HamtNodeType type): m_type(type) {}
@@ -144,7 +190,9 @@ namespace tempo_utils {
 
         HamtNodeType getType() const { return m_type; }
 
-        virtual HamtEntry<KeyType,ValueType> find(const KeyType &key, const KeyHash &hash) const = 0;
+        virtual const std::pair<KeyType,ValueType> *lookup(
+            const KeyType &key,
+            const KeyHash<BitsPerLevel> &hash) const = 0;
 
         virtual size_t numEntries() const = 0;
 
@@ -159,122 +207,203 @@ namespace tempo_utils {
     };
 
     /**
-     * A HAMT leaf node which contains the entry and hash.
+     * A HAMT leaf node which contains the entry key-value pair inline, and the hash of the key.
      *
      * @tparam KeyType The key type.
      * @tparam ValueType The value type.
      * @tparam Hash The hash functor type.
      * @tparam KeyEqual The key equals functor type.
+     * @tparam BitsPerLevel The number of hash bits consumed by each level of the trie.
      */
-    template<class KeyType, class ValueType, class Hash, class KeyEqual>
-    class HamtValueNode : public HamtNode<KeyType,ValueType,Hash,KeyEqual> {
+    template<class KeyType, class ValueType, class Hash, class KeyEqual, int BitsPerLevel>
+    class HamtValueNode : public HamtNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel> {
 
         struct Private { explicit Private() = default; };
 
     public:
-        HamtValueNode(HamtEntry<KeyType,ValueType> entry, size_t hash, Private)
-            : HamtNode<KeyType,ValueType,Hash,KeyEqual>(HamtNodeType::VALUE),
-              m_entry(std::move(entry)),
+        HamtValueNode(KeyType key, ValueType value, size_t hash, Private)
+            : HamtNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>(HamtNodeType::VALUE),
+              m_pair(std::move(key), std::move(value)),
               m_hash(hash)
         {
-            TU_ASSERT (m_entry.isValid());
         }
 
-        static std::shared_ptr<HamtValueNode> create(HamtEntry<KeyType,ValueType> entry, size_t hash)
+        static std::shared_ptr<HamtValueNode> create(const HamtEntry<KeyType,ValueType> &entry, size_t hash)
         {
-            return std::make_shared<HamtValueNode>(entry, hash, Private{});
+            TU_ASSERT (entry.isValid());
+            return std::make_shared<HamtValueNode>(entry.entryKey(), entry.entryValue(), hash, Private{});
         }
 
         static std::shared_ptr<HamtValueNode> create(KeyType key, ValueType value, size_t hash)
         {
-            return std::make_shared<HamtValueNode>(HamtEntry(key, value), hash, Private{});
+            return std::make_shared<HamtValueNode>(std::move(key), std::move(value), hash, Private{});
         }
 
-        HamtEntry<KeyType,ValueType> find(const KeyType &key, const KeyHash &hash) const override
+        /**
+         * Returns an entry which shares ownership of the value node `node`. The entry refers to the
+         * pair stored inline in the node, so no additional allocation is made.
+         *
+         * @param node The value node.
+         * @return The entry.
+         */
+        static HamtEntry<KeyType,ValueType> toEntry(const std::shared_ptr<HamtValueNode> &node)
         {
-            if (m_hash == hash.getInit() && KeyEqual()(key, m_entry.entryKey())) {
-                TU_LOG_VV << "found entry for key " << m_entry.entryKey()
+            TU_NOTNULL (node);
+            return HamtEntry<KeyType,ValueType>(
+                std::shared_ptr<const std::pair<KeyType,ValueType>>(node, &node->m_pair));
+        }
+
+        const std::pair<KeyType,ValueType> *lookup(
+            const KeyType &key,
+            const KeyHash<BitsPerLevel> &hash) const override
+        {
+            if (m_hash == hash.getInit() && KeyEqual()(key, m_pair.first)) {
+                TU_LOG_VV << "found entry for key " << m_pair.first
                             << " with hash " << Bin((tu_uint64) m_hash);
-                return m_entry;
+                return &m_pair;
             }
             TU_LOG_VV << "entry not found for key " << key;
-            return {};
+            return nullptr;
         }
 
         size_t numEntries() const override { return 1; }
 
-        HamtEntry<KeyType,ValueType> getEntry() const { return m_entry; }
         size_t getHash() const { return m_hash; }
 
-        const std::pair<KeyType,ValueType>& getPair() const { return m_entry.entryPair(); }
-        const KeyType& entryKey() const { return m_entry.entryKey(); }
-        const ValueType& entryValue() const { return m_entry.entryValue(); }
+        const std::pair<KeyType,ValueType>& getPair() const { return m_pair; }
+        const KeyType& entryKey() const { return m_pair.first; }
+        const ValueType& entryValue() const { return m_pair.second; }
 
     private:
-        HamtEntry<KeyType,ValueType> m_entry;
+        std::pair<KeyType,ValueType> m_pair;
         size_t m_hash;
     };
 
     /**
-     * A HAMT intermediate node which contains a table of pointers to child nodes.
+     * A HAMT intermediate node which contains the child nodes of the occupied slots. The node stores a
+     * bitmap of the occupied slots and an array containing only the occupied slots, so the size of the
+     * node is proportional to the number of children rather than to the branching factor. The position
+     * of a slot in the array is the number of occupied slots preceding it in the bitmap.
      *
      * @tparam KeyType The key type.
      * @tparam ValueType The value type.
      * @tparam Hash The hash functor type.
      * @tparam KeyEqual The key equals functor type.
+     * @tparam BitsPerLevel The number of hash bits consumed by each level of the trie.
      */
-    template<class KeyType, class ValueType, class Hash, class KeyEqual>
-    class HamtIndexNode : public HamtNode<KeyType,ValueType,Hash,KeyEqual> {
+    template<class KeyType, class ValueType, class Hash, class KeyEqual, int BitsPerLevel>
+    class HamtIndexNode : public HamtNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel> {
 
         struct Private {};
 
+        using Node = HamtNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>;
+        using ValueNode = HamtValueNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>;
+
     public:
-        explicit HamtIndexNode(Private)
-            : HamtNode<KeyType,ValueType,Hash,KeyEqual>(HamtNodeType::INDEX)
+        using Children = std::vector<std::shared_ptr<Node>>;
+
+        HamtIndexNode(tu_uint64 edit, Private)
+            : Node(HamtNodeType::INDEX),
+              m_bitmap(0),
+              m_edit(edit)
         {
         }
-        HamtIndexNode(HamtIndexTable<KeyType,ValueType,Hash,KeyEqual> table, Private)
-            : HamtNode<KeyType,ValueType,Hash,KeyEqual>(HamtNodeType::INDEX),
-              m_table(std::move(table))
+        HamtIndexNode(HamtBitmap bitmap, Children children, tu_uint64 edit, Private)
+            : Node(HamtNodeType::INDEX),
+              m_bitmap(bitmap),
+              m_children(std::move(children)),
+              m_edit(edit)
         {
+            TU_ASSERT (static_cast<size_t>(std::popcount(m_bitmap)) == m_children.size());
         }
 
         /**
          * Create a new empty index node.
          *
+         * @param edit The edit token of the transient which owns the node, or 0 if the node is persistent.
          * @return shared ptr containing the new index node.
          */
-        static std::shared_ptr<HamtIndexNode<KeyType,ValueType,Hash,KeyEqual>> create()
+        static std::shared_ptr<HamtIndexNode> create(tu_uint64 edit = 0)
         {
-            return std::make_shared<HamtIndexNode>(Private{});
+            return std::make_shared<HamtIndexNode>(edit, Private{});
         }
 
         /**
-         * Create a new index node with the specified `table`.
+         * Create a new index node with the specified occupied slots.
          *
-         * @param table The index table.
+         * @param bitmap The bitmap of occupied slots.
+         * @param children The child nodes of the occupied slots, in slot order.
+         * @param edit The edit token of the transient which owns the node, or 0 if the node is persistent.
          * @return shared ptr containing the new index node.
          */
-        static std::shared_ptr<HamtIndexNode<KeyType,ValueType,Hash,KeyEqual>> create(
-            HamtIndexTable<KeyType,ValueType,Hash,KeyEqual> table)
+        static std::shared_ptr<HamtIndexNode> create(
+            HamtBitmap bitmap,
+            Children children,
+            tu_uint64 edit = 0)
         {
-            return std::make_shared<HamtIndexNode>(table, Private{});
+            return std::make_shared<HamtIndexNode>(bitmap, std::move(children), edit, Private{});
         }
 
-        std::shared_ptr<HamtNode<KeyType,ValueType,Hash,KeyEqual>> at(tu_uint32 offset)
+        /**
+         * Returns `node` if it is owned by the transient identified by `edit`, otherwise returns a copy of
+         * `node` which is owned by the transient. A transient copies each shared node at most once, and
+         * afterwards modifies the copy in place.
+         *
+         * @param node The index node.
+         * @param edit The edit token of the transient.
+         * @return shared ptr containing an index node owned by the transient.
+         */
+        static std::shared_ptr<HamtIndexNode> ensureEditable(std::shared_ptr<HamtIndexNode> node, tu_uint64 edit)
         {
-            if (offset < m_table.size())
-                return m_table.at(offset);
+            TU_ASSERT (edit != 0);
+            if (node->m_edit == edit)
+                return node;
+            return create(node->m_bitmap, node->m_children, edit);
+        }
+
+        tu_uint64 getEdit() const { return m_edit; }
+        HamtBitmap getBitmap() const { return m_bitmap; }
+
+        bool isEmpty() const { return m_bitmap == 0; }
+
+        size_t numChildren() const { return m_children.size(); }
+
+        /**
+         * Returns the child at `position` in the array of occupied slots.
+         *
+         * @param position The position of the child, which must be less than numChildren().
+         * @return The child node.
+         */
+        const std::shared_ptr<Node>& childAt(size_t position) const
+        {
+            TU_ASSERT (position < m_children.size());
+            return m_children[position];
+        }
+
+        /**
+         * Returns the child in the slot `index`, or nullptr if the slot is not occupied.
+         *
+         * @param index The slot index.
+         * @return The child node, or nullptr.
+         */
+        std::shared_ptr<Node> at(tu_uint32 index) const
+        {
+            if (index < table_slots(BitsPerLevel) && hasSlot(index))
+                return m_children[position(index)];
             return {};
         }
 
         /**
+         * Returns a pointer to the pair stored in the value node with the specified `key`, or nullptr if the
+         * key is not present. The pointer remains valid as long as the node is reachable from a live trie.
          *
-         * @param key
-         * @param hash
-         * @return
+         * @param key The entry key.
+         * @param hash The key hash at the level of this node.
+         * @return The pair, or nullptr if the key is not present.
          */
-        HamtEntry<KeyType,ValueType> find(const KeyType &key, const KeyHash &hash) const override
+        const std::pair<KeyType,ValueType> *lookup(
+            const KeyType &key,
+            const KeyHash<BitsPerLevel> &hash) const override
         {
             TU_ASSERT (!hash.needsRehash());
 
@@ -284,17 +413,49 @@ namespace tempo_utils {
                         << " level=" << hash.getLevel();
 
             tu_uint32 index = hash.getIndex();
-            auto child = m_table.at(index);
 
-            // if table element at index is nullptr then key is not present in map
-            if (child == nullptr) {
+            // if slot at index is not occupied then key is not present in map
+            if (!hasSlot(index)) {
                 TU_LOG_VV << "entry not found for key " << key << " at index " << index;
-                return {};
+                return nullptr;
             }
 
             // otherwise continue search in child node
             TU_LOG_VV << "continuing search at index " << index;
-            return child->find(key, hash.next());
+            return m_children[position(index)]->lookup(key, hash.next());
+        }
+
+        /**
+         * Returns the entry with the specified `key`, or an invalid entry if the key is not present. The
+         * entry shares ownership of the value node.
+         *
+         * @param key The entry key.
+         * @param hash The key hash at the level of this node.
+         * @return The entry.
+         */
+        HamtEntry<KeyType,ValueType> find(const KeyType &key, const KeyHash<BitsPerLevel> &hash) const
+        {
+            TU_ASSERT (!hash.needsRehash());
+
+            tu_uint32 index = hash.getIndex();
+            if (!hasSlot(index))
+                return {};
+            const auto &child = m_children[position(index)];
+
+            switch (child->getType()) {
+                case HamtNodeType::VALUE: {
+                    auto value = std::static_pointer_cast<ValueNode>(child);
+                    if (value->lookup(key, hash.next()) == nullptr)
+                        return {};
+                    return ValueNode::toEntry(value);
+                }
+                case HamtNodeType::INDEX: {
+                    auto childNode = std::static_pointer_cast<HamtIndexNode>(child);
+                    return childNode->find(key, hash.next());
+                }
+                default:
+                    TU_UNREACHABLE();
+            }
         }
 
         /**
@@ -304,67 +465,60 @@ namespace tempo_utils {
         size_t numEntries() const override
         {
             size_t total = 0;
-            for (const auto &child : m_table) {
-                if (child != nullptr) {
-                    total += child->numEntries();
-                }
+            for (const auto &child : m_children) {
+                total += child->numEntries();
             }
             return total;
         }
 
         /**
+         * Returns a new index node containing the entries of this node and the new entry. If this node
+         * already contains an entry with the specified `key` then that entry is replaced with the specified
+         * `value`. Only the nodes on the path to the entry are copied.
          *
-         * @param key
-         * @param value
-         * @param hash
+         * @param key The key of the entry to insert or replace.
+         * @param value The value of the entry.
+         * @param hash The key hash at the level of this node.
+         * @return The new index node.
          */
-        void insert(
+        std::shared_ptr<HamtIndexNode> update(
             const KeyType &key,
             const ValueType &value,
-            const KeyHash &hash)
+            const KeyHash<BitsPerLevel> &hash) const
         {
             TU_ASSERT (!hash.needsRehash());
 
-            size_t childIndex = hash.getIndex();
-            auto child = m_table[childIndex];
+            tu_uint32 index = hash.getIndex();
 
-            // case 1: table value at index is nullptr, so key is not present in map
-            if (child == nullptr) {
+            // case 1: slot at index is not occupied, so key is not present in trie
+            if (!hasSlot(index)) {
                 TU_LOG_VV << "inserting entry for key " << key
-                            << " at index " << (tu_uint8) childIndex
+                            << " at index " << (tu_uint8) index
                             << " hash=" << Bin(static_cast<tu_uint64>(hash.getInit()))
                             << " level=" << hash.getLevel();
-                m_table[childIndex] = HamtValueNode<KeyType,ValueType,Hash,KeyEqual>::create(key, value, hash.getInit());
-                return;
+                return copyWithChild(index, ValueNode::create(key, value, hash.getInit()));
             }
 
+            const auto &child = m_children[position(index)];
             switch (child->getType()) {
 
-                // case 2: table value at index is a value node
+                // case 2: slot at index contains a value node
                 case HamtNodeType::VALUE: {
-                    auto childNode = std::static_pointer_cast<HamtValueNode<KeyType,ValueType,Hash,KeyEqual>>(child);
-                    if (HamtNode<KeyType,ValueType,Hash,KeyEqual>::isEqual(childNode->entryKey(), key)) {
-                        TU_LOG_VV << "replacing entry for key " << key
-                                    << " at index " << (tu_uint8) childIndex
+                    auto existing = std::static_pointer_cast<ValueNode>(child);
+                    if (Node::isEqual(existing->entryKey(), key)) {
+                        TU_LOG_VV << "updating entry for key " << key
+                                    << " at index " << (tu_uint8) index
                                     << " hash=" << Bin(static_cast<tu_uint64>(hash.getInit()))
                                     << " level=" << hash.getLevel();
-                        // if the existing value node has the same key, then replace the value and hash
-                        m_table[childIndex] = HamtValueNode<KeyType,ValueType,Hash,KeyEqual>::create(key, value, hash.getInit());
-                    } else {
-                        // otherwise replace the slot with an index node containing both the existing key and the new key
-                        auto existing = std::static_pointer_cast<HamtValueNode<KeyType,ValueType,Hash,KeyEqual>>(child);
-                        TU_LOG_VV << "splitting entry at index " << (tu_uint8) childIndex
-                                    << " level=" << hash.getLevel();
-                        m_table[childIndex] = hamt_split(existing, key, value, hash.next());
+                        return copyWithChild(index, ValueNode::create(key, value, hash.getInit()));
                     }
-                    return;
+                    return copyWithChild(index, hamt_split(existing, key, value, hash.next()));
                 }
-                // case 3: table value at index is an index node
+
+                // case 3: slot at index contains an index node
                 case HamtNodeType::INDEX: {
-                    auto childNode = std::static_pointer_cast<HamtIndexNode>(child);
-                        TU_LOG_VV << "continuing insert for key " << key << " at index " << (tu_uint8) childIndex;
-                        childNode->insert(key, value, hash.next());
-                    return;
+                    auto existing = std::static_pointer_cast<HamtIndexNode>(child);
+                    return copyWithChild(index, existing->update(key, value, hash.next()));
                 }
 
                 default:
@@ -373,67 +527,105 @@ namespace tempo_utils {
         }
 
         /**
+         * Returns a new index node containing the entries of this node excluding the entry specified by
+         * `key`. Child index nodes which become empty are removed, so the returned node is empty if the
+         * removed entry was the last entry.
          *
-         * @param key
-         * @param value
-         * @param hash
-         * @return
+         * @param key The key of the entry to remove.
+         * @param hash The key hash at the level of this node.
+         * @return The new index node, or nullptr if the key is not present.
          */
-        std::shared_ptr<HamtNode<KeyType,ValueType,Hash,KeyEqual>> update(
-            const KeyType &key,
-            const ValueType &value,
-            const KeyHash &hash)
+        std::shared_ptr<HamtIndexNode> remove(const KeyType &key, const KeyHash<BitsPerLevel> &hash) const
         {
             TU_ASSERT (!hash.needsRehash());
 
             tu_uint32 index = hash.getIndex();
-            HamtIndexTable<KeyType,ValueType,Hash,KeyEqual> table;
 
-            // copy all slots into updated node except the node at index
-            for (tu_uint32 i = 0; i < m_table.size(); i++) {
-                if (i != index) {
-                    auto node = m_table[i];
-                    table[i] = node;
+            // case 1: slot at index is not occupied, so key is not present
+            if (!hasSlot(index))
+                return nullptr;
+
+            const auto &child = m_children[position(index)];
+            switch (child->getType())
+            {
+                // case 2: slot at index contains a value node
+                case HamtNodeType::VALUE: {
+                    auto existing = std::static_pointer_cast<ValueNode>(child);
+
+                    // if key does not match existing value, then return nullptr indicating the key is not present
+                    if (!Node::isEqual(existing->entryKey(), key))
+                        return nullptr;
+
+                    // otherwise we create a copy of the index node with the value removed
+                    return copyWithChild(index, nullptr);
                 }
+
+                // case 3: slot at index contains an index node
+                case HamtNodeType::INDEX: {
+                    auto existing = std::static_pointer_cast<HamtIndexNode>(child);
+                    auto removed = existing->remove(key, hash.next());
+
+                    // propagate the nullptr if the key is not present
+                    if (removed == nullptr)
+                        return nullptr;
+
+                    if (removed->isEmpty())
+                        return copyWithChild(index, nullptr);
+                    return copyWithChild(index, std::move(removed));
+                }
+
+                default:
+                    TU_UNREACHABLE();
             }
-            auto child = m_table.at(index);
+        }
 
-            // case 1: table value at index is nullptr, so key is not present in trie
-            if (child == nullptr) {
-                TU_LOG_VV << "inserting entry for key " << key
-                            << " at index " << (tu_uint8) index
-                            << " hash=" << Bin(static_cast<tu_uint64>(hash.getInit()))
-                            << " level=" << hash.getLevel();
-                auto added = HamtValueNode<KeyType,ValueType,Hash,KeyEqual>::create(key, value, hash.getInit());
-                table[index] = added;
-                return HamtIndexNode::create(std::move(table));
+        /**
+         * Insert the entry in place, or replace the existing entry with the same key. The node must be owned
+         * by the transient identified by `edit`. Child index nodes on the path which are not owned by the
+         * transient are copied before they are modified, so nodes shared with a persistent trie never change.
+         *
+         * @param key The key of the entry to insert or replace.
+         * @param value The value of the entry.
+         * @param hash The key hash at the level of this node.
+         * @param edit The edit token of the transient.
+         */
+        void transientInsert(
+            const KeyType &key,
+            const ValueType &value,
+            const KeyHash<BitsPerLevel> &hash,
+            tu_uint64 edit)
+        {
+            TU_ASSERT (m_edit == edit);
+            TU_ASSERT (!hash.needsRehash());
+
+            tu_uint32 index = hash.getIndex();
+
+            // case 1: slot at index is not occupied, so key is not present in map
+            if (!hasSlot(index)) {
+                putChild(index, ValueNode::create(key, value, hash.getInit()));
+                return;
             }
 
+            auto &child = m_children[position(index)];
             switch (child->getType()) {
 
-                // case 2: table value at index is a value node
+                // case 2: slot at index contains a value node
                 case HamtNodeType::VALUE: {
-                    auto existing = std::static_pointer_cast<HamtValueNode<KeyType,ValueType,Hash,KeyEqual>>(child);
-                    if (HamtNode<KeyType,ValueType,Hash,KeyEqual>::isEqual(existing->entryKey(), key)) {
-                        TU_LOG_VV << "updating entry for key " << key
-                                    << " at index " << (tu_uint8) index
-                                    << " hash=" << Bin(static_cast<tu_uint64>(hash.getInit()))
-                                    << " level=" << hash.getLevel();
-                        table[index] = HamtValueNode<KeyType,ValueType,Hash,KeyEqual>::create(key, value, hash.getInit());
+                    auto existing = std::static_pointer_cast<ValueNode>(child);
+                    if (Node::isEqual(existing->entryKey(), key)) {
+                        child = ValueNode::create(key, value, hash.getInit());
                     } else {
-                        auto added = HamtIndexNode::create();
-                        KeyHash existingHash(existing->getHash(), hash.getLevel());
-                        auto entry = existing->getEntry();
-                        added->insert(entry.entryKey(), entry.entryValue(), existingHash);
-                        added->insert(key, value, hash);
+                        child = hamt_split(existing, key, value, hash.next(), edit);
                     }
-                    return HamtIndexNode::create(std::move(table));
+                    return;
                 }
 
-                // case 3: table value at index is an IndexMapNode
+                // case 3: slot at index contains an index node
                 case HamtNodeType::INDEX: {
-                        auto existing = std::static_pointer_cast<HamtIndexNode>(child);
-                        return existing->update(key, value, hash.next());
+                    auto childNode = ensureEditable(std::static_pointer_cast<HamtIndexNode>(child), edit);
+                    child = childNode;
+                    childNode->transientInsert(key, value, hash.next(), edit);
+                    return;
                 }
 
                 default:
@@ -442,63 +634,52 @@ namespace tempo_utils {
         }
 
         /**
+         * Remove the entry with the specified `key` in place. The node must be owned by the transient
+         * identified by `edit`. Child index nodes on the path are copied only if the key is present, and
+         * child index nodes which become empty are pruned.
          *
-         * @param key
-         * @param hash
-         * @return
+         * @param key The key of the entry to remove.
+         * @param hash The key hash at the level of this node.
+         * @param edit The edit token of the transient.
+         * @return true if the entry was removed, otherwise false.
          */
-        std::shared_ptr<HamtNode<KeyType,ValueType,Hash,KeyEqual>> remove(const KeyType &key, const KeyHash &hash)
+        bool transientRemove(const KeyType &key, const KeyHash<BitsPerLevel> &hash, tu_uint64 edit)
         {
+            TU_ASSERT (m_edit == edit);
             TU_ASSERT (!hash.needsRehash());
 
             tu_uint32 index = hash.getIndex();
-            auto child = m_table.at(index);
 
-            // case 1: table value at index is nullptr, so key is not present
-            if (child == nullptr)
-                return nullptr;
+            // case 1: slot at index is not occupied, so key is not present
+            if (!hasSlot(index))
+                return false;
 
-            switch (child->getType())
-            {
-                // case 2: table value at index is a value node
-                case HamtNodeType::VALUE: {
-                    auto existing = std::static_pointer_cast<HamtValueNode<KeyType,ValueType,Hash,KeyEqual>>(child);
-
-                    // if key does not match existing value, then return nullptr indicating the key is not present
-                    if (!HamtNode<KeyType,ValueType,Hash,KeyEqual>::isEqual(existing->entryKey(), key))
-                        return nullptr;
+            auto &child = m_children[position(index)];
+            switch (child->getType()) {
 
-                    // otherwise we create a copy of the index node with the value removed
-                    HamtIndexTable<KeyType,ValueType,Hash,KeyEqual> table;
-                    for (tu_uint32 i = 0; i < m_table.size(); ++i) {
-                        if (i != index) {
-                            table[i] = m_table[i];
-                        }
-                    }
-                    return HamtIndexNode::create(std::move(table));
+                // case 2: slot at index contains a value node
+                case HamtNodeType::VALUE: {
+                    auto existing = std::static_pointer_cast<ValueNode>(child);
+                    if (!Node::isEqual(existing->entryKey(), key))
+                        return false;
+                    putChild(index, nullptr);
+                    return true;
                 }
 
-                // case 3: table value at index is an index node
+                // case 3: slot at index contains an index node
                 case HamtNodeType::INDEX: {
                     auto existing = std::static_pointer_cast<HamtIndexNode>(child);
-
-                    child = existing->remove(key, hash.next());
-
-                    // propagate the nullptr if the key is not present
-                    if (child == nullptr)
-                        return nullptr;
-
-                    // insert the new child into the removed node
-                    HamtIndexTable<KeyType,ValueType,Hash,KeyEqual> table;
-                    table[index] = child;
-
-                    // copy all slots into removed node except the node at index
-                    for (tu_uint32 i = 0; i < m_table.size(); i++) {
-                        if (i != index) {
-                            table[i] = m_table[i];
-                        }
+                    auto next = hash.next();
+                    if (existing->lookup(key, next) == nullptr)
+                        return false;
+                    auto childNode = ensureEditable(std::move(existing), edit);
+                    childNode->transientRemove(key, next, edit);
+                    if (childNode->isEmpty()) {
+                        putChild(index, nullptr);
+                    } else {
+                        child = std::move(childNode);
                     }
-                    return HamtIndexNode::create(std::move(table));
+                    return true;
                 }
 
                 default:
@@ -507,8 +688,72 @@ namespace tempo_utils {
         }
 
     private:
-        HamtIndexTable<KeyType,ValueType,Hash,KeyEqual> m_table;
-        size_t m_total = 0;
+        HamtBitmap m_bitmap;
+        Children m_children;
+        tu_uint64 m_edit;
+
+        static HamtBitmap slotBit(tu_uint32 index)
+        {
+            return static_cast<HamtBitmap>(1) << index;
+        }
+
+        bool hasSlot(tu_uint32 index) const
+        {
+            return (m_bitmap & slotBit(index)) != 0;
+        }
+
+        size_t position(tu_uint32 index) const
+        {
+            return std::popcount(m_bitmap & (slotBit(index) - 1));
+        }
+
+        /**
+         * Returns a persistent copy of the node in which the slot `index` contains `child`. If `child` is
+         * nullptr then the slot is removed from the copy.
+         */
+        std::shared_ptr<HamtIndexNode> copyWithChild(tu_uint32 index, std::shared_ptr<Node> child) const
+        {
+            auto pos = position(index);
+            auto bitmap = m_bitmap;
+            Children children;
+
+            if (hasSlot(index) && child != nullptr) {
+                children = m_children;
+                children[pos] = std::move(child);
+            } else if (hasSlot(index)) {
+                bitmap &= ~slotBit(index);
+                children.reserve(m_children.size() - 1);
+                children.insert(children.end(), m_children.begin(), m_children.begin() + pos);
+                children.insert(children.end(), m_children.begin() + pos + 1, m_children.end());
+            } else {
+                TU_NOTNULL (child);
+                bitmap |= slotBit(index);
+                children.reserve(m_children.size() + 1);
+                children.insert(children.end(), m_children.begin(), m_children.begin() + pos);
+                children.push_back(std::move(child));
+                children.insert(children.end(), m_children.begin() + pos, m_children.end());
+            }
+
+            return create(bitmap, std::move(children));
+        }
+
+        /**
+         * Places `child` in the slot `index` in place. If `child` is nullptr then the slot is removed.
+         */
+        void putChild(tu_uint32 index, std::shared_ptr<Node> child)
+        {
+            auto pos = position(index);
+            if (hasSlot(index) && child != nullptr) {
+                m_children[pos] = std::move(child);
+            } else if (hasSlot(index)) {
+                m_bitmap &= ~slotBit(index);
+                m_children.erase(m_children.begin() + pos);
+            } else {
+                TU_NOTNULL (child);
+                m_bitmap |= slotBit(index);
+                m_children.insert(m_children.begin() + pos, std::move(child));
+            }
+        }
     };
 
     /**
@@ -517,12 +762,13 @@ namespace tempo_utils {
      * @tparam ValueType The value type.
      * @tparam Hash The hash functor type.
      * @tparam KeyEqual The key equals functor type.
+     * @tparam BitsPerLevel The number of hash bits consumed by each level of the trie.
      */
-    template<class KeyType, class ValueType, class Hash, class KeyEqual>
-    class HamtChainNode : public HamtNode<KeyType,ValueType,Hash,KeyEqual> {
+    template<class KeyType, class ValueType, class Hash, class KeyEqual, int BitsPerLevel>
+    class HamtChainNode : public HamtNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel> {
     public:
         HamtChainNode()
-            : HamtNode<KeyType,ValueType,Hash,KeyEqual>(HamtNodeType::CHAIN)
+            : HamtNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>(HamtNodeType::CHAIN)
         {
         }
 
@@ -538,39 +784,50 @@ namespace tempo_utils {
      * @param key
      * @param value
      * @param hash
+     * @param edit The edit token of the transient which owns the new index nodes, or 0 if they are persistent.
      * @return
      */
-    template<class KeyType, class ValueType, class Hash, class KeyEqual>
-    std::shared_ptr<HamtIndexNode<KeyType,ValueType,Hash,KeyEqual>> hamt_split(
-        std::shared_ptr<HamtValueNode<KeyType,ValueType,Hash,KeyEqual>> existing,
+    template<class KeyType, class ValueType, class Hash, class KeyEqual, int BitsPerLevel>
+    std::shared_ptr<HamtIndexNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>> hamt_split(
+        std::shared_ptr<HamtValueNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>> existing,
         const KeyType &key,
         const ValueType &value,
-        const KeyHash &hash)
+        const KeyHash<BitsPerLevel> &hash,
+        tu_uint64 edit)
     {
+        using IndexNode = HamtIndexNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>;
         TU_ASSERT (!hash.needsRehash());
 
-        KeyHash existingHash(existing->getHash(), hash.getLevel());
-        HamtIndexTable<KeyType,ValueType,Hash,KeyEqual> table;
+        KeyHash<BitsPerLevel> existingHash(existing->getHash(), hash.getLevel());
+        auto index = hash.getIndex();
+        auto existingIndex = existingHash.getIndex();
+        HamtBitmap bitmap = static_cast<HamtBitmap>(1) << index;
+        typename IndexNode::Children children;
 
-        if (hash.getIndex() != existingHash.getIndex()) {
-            TU_LOG_VV << "reinserting entry for existing key " << existing->getEntry().entryKey()
-                        << " at index " << existingHash.getIndex()
+        if (index != existingIndex) {
+            TU_LOG_VV << "reinserting entry for existing key " << existing->entryKey()
+                        << " at index " << existingIndex
                         << " hash=" << Bin(static_cast<tu_uint64>(existingHash.getInit()))
                         << " level=" << existingHash.getLevel();
-            table[existingHash.getIndex()] = existing;
-            auto added = HamtValueNode<KeyType,ValueType,Hash,KeyEqual>::create(key, value, hash.getInit());
+            auto added = HamtValueNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>::create(
+                key, value, hash.getInit());
             TU_LOG_VV << "inserting entry for key " << key
-                        << " at index " << hash.getIndex()
+                        << " at index " << index
                         << " hash=" << Bin(static_cast<tu_uint64>(hash.getInit()))
                         << " level=" << hash.getLevel();
-            table[hash.getIndex()] = added;
-            return HamtIndexNode<KeyType,ValueType,Hash,KeyEqual>::create(std::move(table));
+            bitmap |= static_cast<HamtBitmap>(1) << existingIndex;
+            if (existingIndex < index) {
+                children = {std::move(existing), std::move(added)};
+            } else {
+                children = {std::move(added), std::move(existing)};
+            }
+            return IndexNode::create(bitmap, std::move(children), edit);
         }
 
-        TU_LOG_VV << "splitting entry at index " << hash.getIndex()
+        TU_LOG_VV << "splitting entry at index " << index
                     << " level=" << hash.getLevel();
-        table[hash.getIndex()] = hamt_split(existing, key, value, hash.next());
-        return HamtIndexNode<KeyType,ValueType,Hash,KeyEqual>::create(std::move(table));
+        children.push_back(hamt_split(existing, key, value, hash.next(), edit));
+        return IndexNode::create(bitmap, std::move(children), edit);
     }
 }
 
@@ -0,0 +1,458 @@
+#ifndef TEMPO_UTILS_HAMT_OPERATIONS_H
+#define TEMPO_UTILS_HAMT_OPERATIONS_H
+
+#include <bit>
+#include <vector>
+
+#include "hamt_node.h"
+
+namespace tempo_utils {
+
+    // generic type alias for shared ptr to a trie node
+    template<class K, class V, class H, class E, int B>
+    using SharedHamtNode = std::shared_ptr<HamtNode<K,V,H,E,B>>;
+
+    /**
+     * The type of change to an entry between two versions of a trie.
+     */
+    enum class HamtChangeType {
+        Added,                  /**< Entry is present only in the newer trie. */
+        Removed,                /**< Entry is present only in the older trie. */
+        Updated,                /**< Entry is present in both tries with different values. */
+    };
+
+    /**
+     * How a merge resolves keys which are present in a subtree shared by both tries.
+     */
+    enum class HamtMergeMode {
+        ResolveAll,             /**< Every common key is resolved, including keys in shared subtrees. */
+        ReuseShared,            /**< Shared subtrees are reused, which requires resolver(key, value, value) == value. */
+    };
+
+    /**
+     * A change to an entry between two versions of a trie. The previous entry is invalid if the change
+     * type is Added, and the current entry is invalid if the change type is Removed.
+     *
+     * @tparam K The key type.
+     * @tparam V The value type.
+     */
+    template<class K, class V>
+    struct HamtChange {
+        HamtChangeType type;
+        HamtEntry<K,V> previous;
+        HamtEntry<K,V> current;
+    };
+
+    namespace internal {
+
+        /**
+         * Returns the bitmap of the slots occupied by `node` at `level`. A value node occupies the single
+         * slot selected by its hash, as if it were wrapped in an index node.
+         */
+        template<class K, class V, class H, class E, int B>
+        HamtBitmap hamt_slots(const SharedHamtNode<K,V,H,E,B> &node, tu_uint32 level)
+        {
+            if (node == nullptr)
+                return 0;
+            switch (node->getType()) {
+                case HamtNodeType::VALUE: {
+                    auto *value = static_cast<const HamtValueNode<K,V,H,E,B> *>(node.get());
+                    return static_cast<HamtBitmap>(1) << KeyHash<B>(value->getHash(), level).getIndex();
+                }
+                case HamtNodeType::INDEX:
+                    return static_cast<const HamtIndexNode<K,V,H,E,B> *>(node.get())->getBitmap();
+                default:
+                    TU_UNREACHABLE();
+            }
+        }
+
+        /**
+         * Returns the child of `node` in the slot `index` at `level`, or nullptr if the slot is not
+         * occupied. A value node is its own child in the slot selected by its hash.
+         */
+        template<class K, class V, class H, class E, int B>
+        SharedHamtNode<K,V,H,E,B> hamt_slot(const SharedHamtNode<K,V,H,E,B> &node, tu_uint32 index, tu_uint32 level)
+        {
+            if (node == nullptr)
+                return {};
+            switch (node->getType()) {
+                case HamtNodeType::VALUE:
+                    return (hamt_slots(node, level) & (static_cast<HamtBitmap>(1) << index))? node : nullptr;
+                case HamtNodeType::INDEX:
+                    return static_cast<const HamtIndexNode<K,V,H,E,B> *>(node.get())->at(index);
+                default:
+                    TU_UNREACHABLE();
+            }
+        }
+
+        /**
+         * Returns true if `node` is an index node containing exactly the specified slots and children.
+         */
+        template<class K, class V, class H, class E, int B>
+        bool hamt_has_children(
+            const SharedHamtNode<K,V,H,E,B> &node,
+            HamtBitmap bitmap,
+            const typename HamtIndexNode<K,V,H,E,B>::Children &children)
+        {
+            if (node == nullptr || node->getType() != HamtNodeType::INDEX)
+                return false;
+            auto *index = static_cast<const HamtIndexNode<K,V,H,E,B> *>(node.get());
+            if (index->getBitmap() != bitmap)
+                return false;
+            for (size_t i = 0; i < children.size(); i++) {
+                if (index->childAt(i) != children[i])
+                    return false;
+            }
+            return true;
+        }
+
+        /**
+         * Returns a node containing the specified slots and children. If `lhs` or `rhs` already contains
+         * exactly the same children then it is returned instead of a new node, so unchanged subtrees stay
+         * shared. A single value child is returned directly, since value nodes may occupy a slot at any level.
+         */
+        template<class K, class V, class H, class E, int B>
+        SharedHamtNode<K,V,H,E,B> hamt_make_node(
+            const SharedHamtNode<K,V,H,E,B> &lhs,
+            const SharedHamtNode<K,V,H,E,B> &rhs,
+            HamtBitmap bitmap,
+            typename HamtIndexNode<K,V,H,E,B>::Children children)
+        {
+            if (children.empty())
+                return {};
+            if (hamt_has_children(lhs, bitmap, children))
+                return lhs;
+            if (hamt_has_children(rhs, bitmap, children))
+                return rhs;
+            if (children.size() == 1 && children.front()->getType() == HamtNodeType::VALUE)
+                return children.front();
+            return HamtIndexNode<K,V,H,E,B>::create(bitmap, std::move(children));
+        }
+
+        /**
+         * Apply `op` to the children of `lhs` and `rhs` in each slot of `mask`, and return a node
+         * containing the non-null results.
+         */
+        template<class K, class V, class H, class E, int B, class Op>
+        SharedHamtNode<K,V,H,E,B> hamt_combine(
+            const SharedHamtNode<K,V,H,E,B> &lhs,
+            const SharedHamtNode<K,V,H,E,B> &rhs,
+            HamtBitmap mask,
+            tu_uint32 level,
+            Op op)
+        {
+            HamtBitmap bitmap = 0;
+            typename HamtIndexNode<K,V,H,E,B>::Children children;
+            children.reserve(std::popcount(mask));
+            while (mask != 0) {
+                auto index = static_cast<tu_uint32>(std::countr_zero(mask));
+                mask &= mask - 1;
+                auto child = op(hamt_slot(lhs, index, level), hamt_slot(rhs, index, level), level + 1);
+                if (child != nullptr) {
+                    bitmap |= static_cast<HamtBitmap>(1) << index;
+                    children.push_back(std::move(child));
+                }
+            }
+            return hamt_make_node(lhs, rhs, bitmap, std::move(children));
+        }
+
+        template<class K, class V, class H, class E, int B>
+        const HamtValueNode<K,V,H,E,B> *hamt_as_value(const SharedHamtNode<K,V,H,E,B> &node)
+        {
+            if (node->getType() != HamtNodeType::VALUE)
+                return nullptr;
+            return static_cast<const HamtValueNode<K,V,H,E,B> *>(node.get());
+        }
+
+        template<class K, class V, class H, class E, int B>
+        void hamt_collect(
+            const SharedHamtNode<K,V,H,E,B> &node,
+            HamtChangeType type,
+            std::vector<HamtChange<K,V>> &changes)
+        {
+            if (node == nullptr)
+                return;
+            switch (node->getType()) {
+                case HamtNodeType::VALUE: {
+                    auto entry = HamtValueNode<K,V,H,E,B>::toEntry(
+                        std::static_pointer_cast<HamtValueNode<K,V,H,E,B>>(node));
+                    if (type == HamtChangeType::Added) {
+                        changes.push_back({type, {}, std::move(entry)});
+                    } else {
+                        changes.push_back({type, std::move(entry), {}});
+                    }
+                    return;
+                }
+                case HamtNodeType::INDEX: {
+                    auto *index = static_cast<const HamtIndexNode<K,V,H,E,B> *>(node.get());
+                    for (size_t i = 0; i < index->numChildren(); i++) {
+                        hamt_collect(index->childAt(i), type, changes);
+                    }
+                    return;
+                }
+                default:
+                    TU_UNREACHABLE();
+            }
+        }
+    }
+
+    /**
+     * Returns the entry with the specified `key` in the subtree rooted at `node`. If no such key is present
+     * then the entry is invalid.
+     *
+     * @param node The root of the subtree, or nullptr.
+     * @param key The entry key.
+     * @param hash The key hash at the level of `node`.
+     * @return The entry corresponding to the key, or an invalid HamtEntry if the key is not present.
+     */
+    template<class K, class V, class H, class E, int B>
+    HamtEntry<K,V> hamt_find(const SharedHamtNode<K,V,H,E,B> &node, const K &key, const KeyHash<B> &hash)
+    {
+        if (node == nullptr)
+            return {};
+        switch (node->getType()) {
+            case HamtNodeType::VALUE: {
+                auto existing = std::static_pointer_cast<HamtValueNode<K,V,H,E,B>>(node);
+                if (existing->lookup(key, hash) == nullptr)
+                    return {};
+                return HamtValueNode<K,V,H,E,B>::toEntry(existing);
+            }
+            case HamtNodeType::INDEX:
+                return static_cast<const HamtIndexNode<K,V,H,E,B> *>(node.get())->find(key, hash);
+            default:
+                TU_UNREACHABLE();
+        }
+    }
+
+    /**
+     * Returns a node containing the entries of the subtree rooted at `node` and the new entry. If the
+     * subtree already contains an entry with the specified `key` then that entry is replaced with the
+     * specified `value`. Nodes on the path to the entry are copied, and all other nodes are shared.
+     *
+     * @param node The root of the subtree, or nullptr.
+     * @param key The key of the entry to insert or replace.
+     * @param value The value of the entry.
+     * @param hash The key hash at the level of `node`.
+     * @return The new node.
+     */
+    template<class K, class V, class H, class E, int B>
+    SharedHamtNode<K,V,H,E,B> hamt_update(
+        const SharedHamtNode<K,V,H,E,B> &node,
+        const K &key,
+        const V &value,
+        const KeyHash<B> &hash)
+    {
+        if (node == nullptr)
+            return HamtValueNode<K,V,H,E,B>::create(key, value, hash.getInit());
+        switch (node->getType()) {
+            case HamtNodeType::VALUE: {
+                auto existing = std::static_pointer_cast<HamtValueNode<K,V,H,E,B>>(node);
+                if (existing->lookup(key, hash) != nullptr)
+                    return HamtValueNode<K,V,H,E,B>::create(key, value, hash.getInit());
+                return hamt_split(std::move(existing), key, value, hash);
+            }
+            case HamtNodeType::INDEX:
+                return static_cast<const HamtIndexNode<K,V,H,E,B> *>(node.get())->update(key, value, hash);
+            default:
+                TU_UNREACHABLE();
+        }
+    }
+
+    /**
+     * Returns a node containing the entries of the subtree rooted at `node` excluding the entry specified
+     * by `key`. If the subtree does not contain `key` then `node` itself is returned, so callers can detect
+     * that nothing was removed by comparing the result with `node`.
+     *
+     * @param node The root of the subtree, or nullptr.
+     * @param key The key of the entry to remove.
+     * @param hash The key hash at the level of `node`.
+     * @return The new node, `node` if the key is not present, or nullptr if the subtree becomes empty.
+     */
+    template<class K, class V, class H, class E, int B>
+    SharedHamtNode<K,V,H,E,B> hamt_remove(
+        const SharedHamtNode<K,V,H,E,B> &node,
+        const K &key,
+        const KeyHash<B> &hash)
+    {
+        if (node == nullptr)
+            return {};
+        switch (node->getType()) {
+            case HamtNodeType::VALUE:
+                return node->lookup(key, hash) != nullptr? nullptr : node;
+            case HamtNodeType::INDEX: {
+                auto removed = static_cast<const HamtIndexNode<K,V,H,E,B> *>(node.get())->remove(key, hash);
+                if (removed == nullptr)
+                    return node;
+                if (removed->isEmpty())
+                    return {};
+                return removed;
+            }
+            default:
+                TU_UNREACHABLE();
+        }
+    }
+
+    /**
+     * Returns a node containing the union of the entries of `lhs` and `rhs`. If both contain an entry with
+     * the same key then the value is `resolver(key, lhsValue, rhsValue)`. If `mode` is ReuseShared then
+     * subtrees which are shared by `lhs` and `rhs` are returned without being visited, so the cost is
+     * proportional to the size of the difference between the tries rather than to their size. Otherwise
+     * the resolver is applied to every entry of a shared subtree.
+     *
+     * @param lhs The first node, or nullptr.
+     * @param rhs The second node, or nullptr.
+     * @param level The level of the nodes in the trie.
+     * @param mode Whether shared subtrees are reused or resolved.
+     * @param resolver The functor which resolves the value of keys present in both nodes.
+     * @return The merged node, or nullptr if both nodes are empty.
+     */
+    template<class K, class V, class H, class E, int B, class Resolver>
+    SharedHamtNode<K,V,H,E,B> hamt_merge(
+        const SharedHamtNode<K,V,H,E,B> &lhs,
+        const SharedHamtNode<K,V,H,E,B> &rhs,
+        tu_uint32 level,
+        HamtMergeMode mode,
+        Resolver &resolver)
+    {
+        if (rhs == nullptr || (lhs == rhs && mode == HamtMergeMode::ReuseShared))
+            return lhs;
+        if (lhs == nullptr)
+            return rhs;
+
+        auto *lhsValue = internal::hamt_as_value(lhs);
+        auto *rhsValue = internal::hamt_as_value(rhs);
+        if (lhsValue != nullptr && rhsValue != nullptr && lhsValue->getHash() == rhsValue->getHash()
+            && E()(lhsValue->entryKey(), rhsValue->entryKey())) {
+            return HamtValueNode<K,V,H,E,B>::create(lhsValue->entryKey(),
+                resolver(lhsValue->entryKey(), lhsValue->entryValue(), rhsValue->entryValue()),
+                lhsValue->getHash());
+        }
+
+        auto mask = internal::hamt_slots(lhs, level) | internal::hamt_slots(rhs, level);
+        return internal::hamt_combine(lhs, rhs, mask, level,
+            [&](const SharedHamtNode<K,V,H,E,B> &l, const SharedHamtNode<K,V,H,E,B> &r, tu_uint32 next) {
+                return hamt_merge(l, r, next, mode, resolver);
+            });
+    }
+
+    /**
+     * Returns a node containing the entries of `lhs` whose keys are also present in `rhs`. Subtrees which
+     * are shared by `lhs` and `rhs` are returned without being visited.
+     *
+     * @param lhs The first node, or nullptr.
+     * @param rhs The second node, or nullptr.
+     * @param level The level of the nodes in the trie.
+     * @return The intersected node, or nullptr if no keys are common to both nodes.
+     */
+    template<class K, class V, class H, class E, int B>
+    SharedHamtNode<K,V,H,E,B> hamt_intersect(
+        const SharedHamtNode<K,V,H,E,B> &lhs,
+        const SharedHamtNode<K,V,H,E,B> &rhs,
+        tu_uint32 level)
+    {
+        if (lhs == rhs)
+            return lhs;
+        if (lhs == nullptr || rhs == nullptr)
+            return {};
+
+        auto *lhsValue = internal::hamt_as_value(lhs);
+        auto *rhsValue = internal::hamt_as_value(rhs);
+        if (lhsValue != nullptr && rhsValue != nullptr) {
+            if (lhsValue->getHash() == rhsValue->getHash() && E()(lhsValue->entryKey(), rhsValue->entryKey()))
+                return lhs;
+            return {};
+        }
+
+        auto mask = internal::hamt_slots(lhs, level) & internal::hamt_slots(rhs, level);
+        return internal::hamt_combine(lhs, rhs, mask, level,
+            [](const SharedHamtNode<K,V,H,E,B> &l, const SharedHamtNode<K,V,H,E,B> &r, tu_uint32 next) {
+                return hamt_intersect(l, r, next);
+            });
+    }
+
+    /**
+     * Returns a node containing the entries of `lhs` whose keys are not present in `rhs`. Subtrees which
+     * are shared by `lhs` and `rhs` are dropped without being visited.
+     *
+     * @param lhs The first node, or nullptr.
+     * @param rhs The second node, or nullptr.
+     * @param level The level of the nodes in the trie.
+     * @return The difference node, or nullptr if every key of `lhs` is present in `rhs`.
+     */
+    template<class K, class V, class H, class E, int B>
+    SharedHamtNode<K,V,H,E,B> hamt_difference(
+        const SharedHamtNode<K,V,H,E,B> &lhs,
+        const SharedHamtNode<K,V,H,E,B> &rhs,
+        tu_uint32 level)
+    {
+        if (lhs == rhs || lhs == nullptr)
+            return {};
+        if (rhs == nullptr)
+            return lhs;
+
+        auto *lhsValue = internal::hamt_as_value(lhs);
+        auto *rhsValue = internal::hamt_as_value(rhs);
+        if (lhsValue != nullptr && rhsValue != nullptr) {
+            if (lhsValue->getHash() == rhsValue->getHash() && E()(lhsValue->entryKey(), rhsValue->entryKey()))
+                return {};
+            return lhs;
+        }
+
+        auto mask = internal::hamt_slots(lhs, level);
+        return internal::hamt_combine(lhs, rhs, mask, level,
+            [](const SharedHamtNode<K,V,H,E,B> &l, const SharedHamtNode<K,V,H,E,B> &r, tu_uint32 next) {
+                return hamt_difference(l, r, next);
+            });
+    }
+
+    /**
+     * Append the changes which transform `lhs` into `rhs` to `changes`. An entry whose key is present in
+     * both nodes is reported as updated if the values compare unequal. Subtrees which are shared by `lhs`
+     * and `rhs` are skipped without being visited, so the cost is proportional to the number of changes.
+     *
+     * @param lhs The older node, or nullptr.
+     * @param rhs The newer node, or nullptr.
+     * @param level The level of the nodes in the trie.
+     * @param changes The vector which receives the changes.
+     */
+    template<class K, class V, class H, class E, int B>
+    void hamt_diff(
+        const SharedHamtNode<K,V,H,E,B> &lhs,
+        const SharedHamtNode<K,V,H,E,B> &rhs,
+        tu_uint32 level,
+        std::vector<HamtChange<K,V>> &changes)
+    {
+        if (lhs == rhs)
+            return;
+        if (lhs == nullptr) {
+            internal::hamt_collect(rhs, HamtChangeType::Added, changes);
+            return;
+        }
+        if (rhs == nullptr) {
+            internal::hamt_collect(lhs, HamtChangeType::Removed, changes);
+            return;
+        }
+
+        auto *lhsValue = internal::hamt_as_value(lhs);
+        auto *rhsValue = internal::hamt_as_value(rhs);
+        if (lhsValue != nullptr && rhsValue != nullptr && lhsValue->getHash() == rhsValue->getHash()
+            && E()(lhsValue->entryKey(), rhsValue->entryKey())) {
+            if (!(lhsValue->entryValue() == rhsValue->entryValue())) {
+                changes.push_back({HamtChangeType::Updated,
+                    HamtValueNode<K,V,H,E,B>::toEntry(std::static_pointer_cast<HamtValueNode<K,V,H,E,B>>(lhs)),
+                    HamtValueNode<K,V,H,E,B>::toEntry(std::static_pointer_cast<HamtValueNode<K,V,H,E,B>>(rhs))});
+            }
+            return;
+        }
+
+        auto mask = internal::hamt_slots(lhs, level) | internal::hamt_slots(rhs, level);
+        while (mask != 0) {
+            auto index = static_cast<tu_uint32>(std::countr_zero(mask));
+            mask &= mask - 1;
+            hamt_diff(internal::hamt_slot(lhs, index, level), internal::hamt_slot(rhs, index, level),
+                level + 1, changes);
+        }
+    }
+}
+
+#endif // TEMPO_UTILS_HAMT_OPERATIONS_H
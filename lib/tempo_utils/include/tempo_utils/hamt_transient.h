@@ -0,0 +1,171 @@
+#ifndef TEMPO_UTILS_HAMT_TRANSIENT_H
+#define TEMPO_UTILS_HAMT_TRANSIENT_H
+
+#include "hamt_node.h"
+
+namespace tempo_utils {
+
+    // forward declarations
+    template<class KeyType, class ValueType, class Hash, class KeyEqual, int BitsPerLevel>
+    class HashArrayMappedTrie;
+
+    /**
+     * A mutable builder for a trie. The transient starts from the root of an existing trie, and copies
+     * each index node which it modifies the first time the node is touched. Copied and newly created index
+     * nodes are owned by the transient and are modified in place by subsequent updates, so a batch of
+     * updates allocates at most one copy of each node on the modified paths rather than one copy per update.
+     * Once the batch is complete, persistent() releases ownership of the nodes and returns an immutable trie.
+     *
+     * A transient is not thread safe, and cannot be used after persistent() is called.
+     *
+     * @tparam K The key type.
+     * @tparam V The value type.
+     * @tparam H The hash functor type.
+     * @tparam E The key equals functor type.
+     * @tparam B The number of hash bits consumed by each level of the trie.
+     */
+    template<class K, class V, class H, class E, int B>
+    class HamtTransient {
+    public:
+
+        /**
+         * Constructs a HamtTransient containing no entries.
+         */
+        HamtTransient()
+            : m_edit(hamt_next_edit()),
+              m_root(HamtIndexNode<K,V,H,E,B>::create(m_edit))
+        {
+        }
+
+        /**
+         * Constructs a HamtTransient containing the entries of the trie rooted at the `root` node. The
+         * nodes of the trie are shared with the transient but are never modified.
+         *
+         * @param root The root node of the trie, or nullptr if the trie is empty.
+         */
+        explicit HamtTransient(std::shared_ptr<HamtNode<K,V,H,E,B>> root)
+            : m_edit(hamt_next_edit())
+        {
+            if (root == nullptr) {
+                m_root = HamtIndexNode<K,V,H,E,B>::create(m_edit);
+                return;
+            }
+            switch (root->getType()) {
+                case HamtNodeType::VALUE: {
+                    auto value = std::static_pointer_cast<HamtValueNode<K,V,H,E,B>>(root);
+                    m_root = HamtIndexNode<K,V,H,E,B>::create(m_edit);
+                    m_root->transientInsert(value->entryKey(), value->entryValue(), KeyHash<B>(value->getHash()), m_edit);
+                    break;
+                }
+                case HamtNodeType::INDEX: {
+                    auto index = std::static_pointer_cast<HamtIndexNode<K,V,H,E,B>>(std::move(root));
+                    m_root = HamtIndexNode<K,V,H,E,B>::ensureEditable(std::move(index), m_edit);
+                    break;
+                }
+                default:
+                    TU_UNREACHABLE();
+            }
+        }
+
+        HamtTransient(const HamtTransient &other) = delete;
+        HamtTransient& operator=(const HamtTransient &other) = delete;
+
+        /**
+         * Returns whether the transient is empty.
+         *
+         * @return true if the transient is empty, otherwise false.
+         */
+        bool isEmpty() const
+        {
+            TU_ASSERT (m_root != nullptr);
+            return m_root->isEmpty();
+        }
+
+        /**
+         * Returns the total number of entries in the transient.
+         *
+         * @return The number of entries.
+         */
+        size_t numEntries() const
+        {
+            TU_ASSERT (m_root != nullptr);
+            return m_root->numEntries();
+        }
+
+        /**
+         * Returns whether an entry with the specified `key` is present in the transient.
+         *
+         * @param key The entry key.
+         * @return true if the transient contains the entry, otherwise false.
+         */
+        bool contains(const K &key) const
+        {
+            TU_ASSERT (m_root != nullptr);
+            KeyHash<B> hash(H()(key));
+            return m_root->lookup(key, hash) != nullptr;
+        }
+
+        /**
+         * Returns the entry with the specified `key` in the transient. If no such key is present then the
+         * entry is invalid.
+         *
+         * @param key The entry key.
+         * @return The entry corresponding to the key, or an invalid HamtEntry if the key is not present.
+         */
+        HamtEntry<K,V> get(const K &key) const
+        {
+            TU_ASSERT (m_root != nullptr);
+            KeyHash<B> hash(H()(key));
+            return m_root->find(key, hash);
+        }
+
+        /**
+         * Inserts the entry into the transient. If the transient already contains an entry with the
+         * specified `key` then that entry is replaced with the specified `value`.
+         *
+         * @param key The key of the entry to insert or replace.
+         * @param value The value of the entry.
+         */
+        void update(const K &key, const V &value)
+        {
+            TU_ASSERT (m_root != nullptr);
+            KeyHash<B> hash(H()(key));
+            m_root->transientInsert(key, value, hash, m_edit);
+        }
+
+        /**
+         * Removes the entry with the specified `key` from the transient.
+         *
+         * @param key The key of the entry to remove.
+         * @return true if the entry was removed, or false if the transient does not contain `key`.
+         */
+        bool remove(const K &key)
+        {
+            TU_ASSERT (m_root != nullptr);
+            KeyHash<B> hash(H()(key));
+            return m_root->transientRemove(key, hash, m_edit);
+        }
+
+        /**
+         * Returns an immutable trie containing the entries of the transient. The transient releases
+         * ownership of its nodes, so they are never modified again, and the transient cannot be used
+         * afterwards.
+         *
+         * @return The trie.
+         */
+        HashArrayMappedTrie<K,V,H,E,B> persistent()
+        {
+            TU_ASSERT (m_root != nullptr);
+            auto root = std::move(m_root);
+            if (root->isEmpty())
+                return HashArrayMappedTrie<K,V,H,E,B>();
+            return HashArrayMappedTrie<K,V,H,E,B>(std::move(root));
+        }
+
+    private:
+        tu_uint64 m_edit;
+        std::shared_ptr<HamtIndexNode<K,V,H,E,B>> m_root;
+    };
+}
+
+#endif // TEMPO_UTILS_HAMT_TRANSIENT_H
@@ -3,6 +3,8 @@
 
 #include "hamt_iterator.h"
 #include "hamt_node.h"
+#include "hamt_operations.h"
+#include "hamt_transient.h"
 #include "log_message.h"
 
 namespace tempo_utils {
@@ -11,14 +13,15 @@ namespace tempo_utils {
         class KeyType,
         class ValueType,
         class Hash = std::hash<KeyType>,
-        class KeyEqual = std::equal_to<KeyType>
+        class KeyEqual = std::equal_to<KeyType>,
+        int BitsPerLevel = kHamtBitsPerLevel
     >
     class HashArrayMappedTrie {
 
     public:
         HashArrayMappedTrie() = default;
 
-        explicit HashArrayMappedTrie(std::shared_ptr<HamtNode<KeyType,ValueType,Hash,KeyEqual>> root)
+        explicit HashArrayMappedTrie(std::shared_ptr<HamtNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>> root)
             : m_root(std::move(root))
         {
             TU_NOTNULL (m_root);
@@ -26,51 +29,47 @@ namespace tempo_utils {
 
         explicit HashArrayMappedTrie(const std::vector<std::pair<KeyType,ValueType>> &entries)
         {
-            auto root = HamtIndexNode<KeyType,ValueType,Hash,KeyEqual>::create();
+            HamtTransient<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel> transient;
             for (const auto &entry : entries) {
-                KeyHash hash(Hash()(entry.first));
-                root->insert(entry.first, entry.second, hash);
+                transient.update(entry.first, entry.second);
             }
-            m_root = std::move(root);
+            *this = transient.persistent();
         }
 
         HashArrayMappedTrie(std::initializer_list<std::pair<KeyType,ValueType>> init)
         {
-            auto root = HamtIndexNode<KeyType,ValueType,Hash,KeyEqual>::create();
+            HamtTransient<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel> transient;
             for (const auto &entry : init) {
-                KeyHash hash(Hash()(entry.first));
-                root->insert(entry.first, entry.second, hash);
+                transient.update(entry.first, entry.second);
             }
-            m_root = std::move(root);
+            *this = transient.persistent();
         }
 
         template<class InputIt>
-        static HashArrayMappedTrie<KeyType,ValueType> fromMap(InputIt begin, InputIt end)
+        static HashArrayMappedTrie fromMap(InputIt begin, InputIt end)
         {
-            auto root = HamtIndexNode<KeyType,ValueType,Hash,KeyEqual>::create();
+            HamtTransient<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel> transient;
             for (auto it = begin; it != end; ++it) {
-                KeyHash hash(Hash()(it->first));
-                root->insert(it->first, it->second, hash);
+                transient.update(it->first, it->second);
             }
-            return HashArrayMappedTrie(root);
+            return transient.persistent();
         }
 
         template<class InputIt>
-        static HashArrayMappedTrie<KeyType,ValueType> fromPairs(InputIt begin, InputIt end)
+        static HashArrayMappedTrie fromPairs(InputIt begin, InputIt end)
         {
-            auto root = HamtIndexNode<KeyType,ValueType,Hash,KeyEqual>::create();
+            HamtTransient<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel> transient;
             for (auto it = begin; it != end; ++it) {
                 const auto &pair = *it;
-                KeyHash hash(Hash()(pair.first));
-                root->insert(pair.first, pair.second, hash);
+                transient.update(pair.first, pair.second);
             }
-            return HashArrayMappedTrie(root);
+            return transient.persistent();
         }
 
-        static HashArrayMappedTrie<KeyType,ValueType> of(KeyType key, ValueType value)
+        static HashArrayMappedTrie of(KeyType key, ValueType value)
         {
             auto hash = Hash()(key);
-            auto root = HamtValueNode<KeyType,ValueType,Hash,KeyEqual>::create(key, value, hash);
+            auto root = HamtValueNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>::create(key, value, hash);
             return HashArrayMappedTrie(root);
         }
 
@@ -84,6 +83,16 @@ namespace tempo_utils {
             return m_root == nullptr;
         }
 
+        /**
+         * Returns the root node of the trie, or nullptr if the trie is empty.
+         *
+         * @return The root node.
+         */
+        std::shared_ptr<HamtNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>> getRoot() const
+        {
+            return m_root;
+        }
+
         /**
          * Returns the total number of entries in the trie.
          *
@@ -102,25 +111,40 @@ namespace tempo_utils {
          * @param key The entry key.
          * @return true if the trie contains the entry, otherwise false.
          */
-        bool contains(const KeyType &key)
+        bool contains(const KeyType &key) const
+        {
+            return find(key) != nullptr;
+        }
+
+        /**
+         * Returns a pointer to the key-value pair with the specified `key` in the trie, or nullptr if no such
+         * key is present. The pair is stored inline in the trie, so the lookup neither allocates nor touches
+         * any reference counts. The pointer remains valid as long as the trie, or any trie derived from it
+         * which still contains the entry, is alive.
+         *
+         * @param key The entry key.
+         * @return The key-value pair, or nullptr if the key is not present.
+         */
+        const std::pair<KeyType,ValueType> *find(const KeyType &key) const
         {
-            auto entry = get(key);
-            return entry.isValid();
+            if (m_root == nullptr)
+                return nullptr;
+            KeyHash<BitsPerLevel> hash(Hash()(key));
+            return m_root->lookup(key, hash);
         }
 
         /**
          * Returns the entry with the specified `key` in the trie. If no such key is present in the trie then
-         * the entry is invalid.
+         * the entry is invalid. The entry shares ownership of the key-value pair, so it remains valid after
+         * the trie is destroyed.
          *
          * @param key
          * @return The entry corresponding to the key in the trie, or an invalid HamtEntry if the key is not present.
          */
-        HamtEntry<KeyType,ValueType> get(const KeyType &key)
+        HamtEntry<KeyType,ValueType> get(const KeyType &key) const
         {
-            if (m_root == nullptr)
-                return {};
-            KeyHash hash(Hash()(key));
-            return m_root->find(key, hash);
+            KeyHash<BitsPerLevel> hash(Hash()(key));
+            return hamt_find(m_root, key, hash);
         }
 
         /**
@@ -134,23 +158,8 @@ namespace tempo_utils {
          */
         HashArrayMappedTrie update(const KeyType &key, const ValueType &value)
         {
-            if (m_root == nullptr)
-                return of(key, value);
-            KeyHash hash(Hash()(key));
-            switch (m_root->getType()) {
-                case HamtNodeType::VALUE: {
-                    auto existing = std::static_pointer_cast<HamtValueNode<KeyType,ValueType,Hash,KeyEqual>>(m_root);
-                    auto root = hamt_split(existing, key, value, hash);
-                    return HashArrayMappedTrie(root);
-                }
-                case HamtNodeType::INDEX: {
-                    auto existing = std::static_pointer_cast<HamtIndexNode<KeyType,ValueType,Hash,KeyEqual>>(m_root);
-                    auto root = existing->update(key, value, hash);
-                    return HashArrayMappedTrie(root);
-                }
-                default:
-                    return HashArrayMappedTrie();
-            }
+            KeyHash<BitsPerLevel> hash(Hash()(key));
+            return HashArrayMappedTrie(hamt_update(m_root, key, value, hash));
         }
 
         /**
@@ -162,49 +171,117 @@ namespace tempo_utils {
          */
         HashArrayMappedTrie remove(const KeyType &key)
         {
-            if (m_root == nullptr)
-                return {};
-            KeyHash hash(Hash()(key));
-            switch (m_root->getType()) {
-                case HamtNodeType::VALUE: {
-                    auto existing = std::static_pointer_cast<HamtValueNode<KeyType,ValueType,Hash,KeyEqual>>(m_root);
-                    auto entry = existing->find(key, hash);
-                    if (entry.isValid())
-                        return {};
-                    return *this;
-                }
-                case HamtNodeType::INDEX: {
-                    auto existing = std::static_pointer_cast<HamtIndexNode<KeyType,ValueType,Hash,KeyEqual>>(m_root);
-                    auto root = existing->remove(key, hash);
-                    return HashArrayMappedTrie(root);
-                }
-            default:
-                return HashArrayMappedTrie();
-            }
+            KeyHash<BitsPerLevel> hash(Hash()(key));
+            auto root = hamt_remove(m_root, key, hash);
+            if (root == m_root)
+                return *this;
+            return fromRoot(root);
         }
 
         /**
+         * Returns a new trie containing the entries of this trie and of `other`. If both tries contain an
+         * entry with the same key then the value of the entry is `resolver(key, value, otherValue)`. By default
+         * the resolver is called for every common key, including keys in subtrees shared by both tries. If
+         * the resolver returns `value` whenever `value` and `otherValue` are the same, then passing ReuseShared
+         * reuses shared subtrees without visiting them, so merging two versions of a trie costs time
+         * proportional to the size of the difference between them.
          *
-         * @param key
-         * @return
+         * @tparam Resolver Functor type callable as `ValueType(const KeyType &, const ValueType &, const ValueType &)`.
+         * @param other The other trie.
+         * @param resolver The functor which resolves the value of keys present in both tries.
+         * @param mode Whether subtrees shared by both tries are reused or resolved.
+         * @return The merged trie.
+         */
+        template<class Resolver>
+        HashArrayMappedTrie merge(
+            const HashArrayMappedTrie &other,
+            Resolver resolver,
+            HamtMergeMode mode = HamtMergeMode::ResolveAll) const
+        {
+            return fromRoot(hamt_merge(m_root, other.m_root, 0, mode, resolver));
+        }
+
+        /**
+         * Returns a new trie containing the entries of this trie whose keys are also present in `other`.
+         *
+         * @param other The other trie.
+         * @return The intersected trie.
+         */
+        HashArrayMappedTrie intersect(const HashArrayMappedTrie &other) const
+        {
+            return fromRoot(hamt_intersect(m_root, other.m_root, 0));
+        }
+
+        /**
+         * Returns a new trie containing the entries of this trie whose keys are not present in `other`.
+         *
+         * @param other The other trie.
+         * @return The difference trie.
+         */
+        HashArrayMappedTrie difference(const HashArrayMappedTrie &other) const
+        {
+            return fromRoot(hamt_difference(m_root, other.m_root, 0));
+        }
+
+        /**
+         * Returns the changes which transform this trie into `other`. Subtrees shared by both tries are
+         * skipped without being visited, so the cost is proportional to the number of changes rather than
+         * to the number of entries. Values are compared using `operator==`.
+         *
+         * @param other The newer version of the trie.
+         * @return The added, removed and updated entries, in no particular order.
+         */
+        std::vector<HamtChange<KeyType,ValueType>> diff(const HashArrayMappedTrie &other) const
+        {
+            std::vector<HamtChange<KeyType,ValueType>> changes;
+            hamt_diff(m_root, other.m_root, 0, changes);
+            return changes;
+        }
+
+        /**
+         * Returns a transient containing the entries of the trie. The transient can apply a batch of
+         * updates and removals in place and then be converted back into a trie using persistent(). The
+         * trie itself is not modified.
+         *
+         * @return The transient.
          */
-        const ValueType& valueAt(const KeyType &key)
+        HamtTransient<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel> transient() const
         {
-            auto node = find(key);
-            return node->entryValue();
+            return HamtTransient<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>(m_root);
+        }
+
+        /**
+         * Returns a reference to the value of the entry with the specified `key`. The key must be present
+         * in the trie.
+         *
+         * @param key The entry key.
+         * @return The entry value.
+         */
+        const ValueType& valueAt(const KeyType &key) const
+        {
+            auto *pair = find(key);
+            TU_NOTNULL (pair);
+            return pair->second;
         }
 
         /**
          *
          * @return
          */
-        HamtIterator<KeyType,ValueType,Hash,KeyEqual> iterate()
+        HamtIterator<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel> iterate()
         {
-            return HamtIterator<KeyType,ValueType,Hash,KeyEqual>(m_root);
+            return HamtIterator<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>(m_root);
         }
 
     private:
-        std::shared_ptr<HamtNode<KeyType,ValueType,Hash,KeyEqual>> m_root;
+        std::shared_ptr<HamtNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>> m_root;
+
+        static HashArrayMappedTrie fromRoot(std::shared_ptr<HamtNode<KeyType,ValueType,Hash,KeyEqual,BitsPerLevel>> root)
+        {
+            if (root == nullptr)
+                return {};
+            return HashArrayMappedTrie(std::move(root));
+        }
     };
 }
 
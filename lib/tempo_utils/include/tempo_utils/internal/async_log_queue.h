@@ -0,0 +1,80 @@
+#ifndef TEMPO_UTILS_INTERNAL_ASYNC_LOG_QUEUE_H
+#define TEMPO_UTILS_INTERNAL_ASYNC_LOG_QUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include <tempo_utils/internal/circular_log_buffer.h>
+#include <tempo_utils/logging.h>
+
+namespace tempo_utils::internal {
+
+    /**
+     * Bounded multi-producer queue of log messages which is drained by a background flusher
+     * thread. Producers never take a lock; each slot carries a sequence number which hands
+     * ownership of the slot back and forth between producers and the consumer.
+     */
+    class AsyncLogQueue final {
+    public:
+        AsyncLogQueue(
+            AbstractLogSink *sink,
+            int queueSize,
+            LogQueuePolicy policy,
+            bool flushEveryBatch);
+        ~AsyncLogQueue();
+
+        void start();
+        void shutdown();
+
+        bool enqueue(
+            const absl::Time &ts,
+            LogSeverity severity,
+            const char *filePath,
+            int lineNr,
+            std::string_view message,
+            const BinaryLogSite *site);
+        void flush();
+
+        LoggingStatistics getStatistics() const;
+
+    private:
+        struct Slot {
+            std::atomic<tu_uint64> sequence;
+            BufferEntry entry;
+        };
+
+        AbstractLogSink *m_sink;
+        LogQueuePolicy m_policy;
+        bool m_flushEveryBatch;
+        std::unique_ptr<Slot[]> m_slots;
+        tu_uint64 m_mask;
+        std::thread m_flusher;
+        std::atomic<bool> m_running;
+
+        alignas(64) std::atomic<tu_uint64> m_enqueuePos;
+        alignas(64) std::atomic<tu_uint64> m_dequeuePos;
+        alignas(64) std::atomic<tu_uint32> m_signal;
+        alignas(64) std::atomic<tu_uint64> m_numCompleted;
+        std::atomic<tu_uint64> m_numFlushed;
+        std::atomic<bool> m_flushRequested;
+
+        std::atomic<tu_uint64> m_numEnqueued;
+        std::atomic<tu_uint64> m_numWritten;
+        std::atomic<tu_uint64> m_numDroppedOldest;
+        std::atomic<tu_uint64> m_numDroppedNewest;
+        std::atomic<tu_uint64> m_numBlocked;
+
+        bool tryPush(
+            const absl::Time &ts,
+            LogSeverity severity,
+            const char *filePath,
+            int lineNr,
+            std::string_view message,
+            const BinaryLogSite *site);
+        bool tryPop(AbstractLogSink *sink);
+        void runFlusher();
+    };
+}
+
+#endif // TEMPO_UTILS_INTERNAL_ASYNC_LOG_QUEUE_H
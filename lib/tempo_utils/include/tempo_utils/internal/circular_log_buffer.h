@@ -14,6 +14,7 @@ namespace tempo_utils::internal {
         const char *filePath;
         int lineNr;
         std::string message;
+        const BinaryLogSite *site = nullptr;   // if not nullptr then message contains encoded binary log arguments
     };
 
     class CircularLogBuffer final {
@@ -0,0 +1,34 @@
+#ifndef TEMPO_UTILS_INTERNAL_SIGNAL_SAFE_WRITER_H
+#define TEMPO_UTILS_INTERNAL_SIGNAL_SAFE_WRITER_H
+
+#include <string_view>
+
+#include <tempo_utils/integer_types.h>
+
+namespace tempo_utils::internal {
+
+    /**
+     * Line-buffered writer which only uses async-signal-safe operations, so it can be used from
+     * a signal handler. Output is accumulated in a fixed-size buffer on the stack and written to
+     * the file descriptor with write(2); nothing is allocated and no locks are taken.
+     */
+    class SignalSafeWriter final {
+    public:
+        explicit SignalSafeWriter(int fd);
+        ~SignalSafeWriter();
+
+        SignalSafeWriter& append(std::string_view str);
+        SignalSafeWriter& appendUnsigned(tu_uint64 u64, int minWidth = 0);
+        SignalSafeWriter& appendSigned(tu_int64 i64);
+        SignalSafeWriter& appendHex(tu_uint64 u64, int minWidth = 0);
+        SignalSafeWriter& appendTimestamp(tu_int64 nanosSinceEpoch);
+        void flush();
+
+    private:
+        int m_fd;
+        char m_buffer[512];
+        size_t m_size;
+    };
+}
+
+#endif // TEMPO_UTILS_INTERNAL_SIGNAL_SAFE_WRITER_H
@@ -1,9 +1,10 @@
 #ifndef TEMPO_UTILS_LOG_MESSAGE_H
 #define TEMPO_UTILS_LOG_MESSAGE_H
 
-#include <sstream>
+#include <atomic>
 
 #include <absl/time/time.h>
+#include <fmt/format.h>
 
 #include "logging.h"
 
@@ -18,29 +19,90 @@
 // if true, strip debug assertions
 #define TU_LOG_STRIP_ASSERT             false
 
+// evaluate the log message only if enabled is true. if enabled is false then the message is
+// not constructed, so it is neither timestamped nor are any of the streamed values formatted.
+
+#define TU_LOG_IF_ENABLED_(enabled)     !(enabled) ? (void) 0 : tempo_utils::LogVoidify() &
+
 // construct basic log message with the specified severity
 
 #define TU_LOG_FATAL                    tempo_utils::Fatal(__FILE__, __LINE__, true)
-#define TU_LOG_ERROR                    tempo_utils::Error(__FILE__, __LINE__, true)
-#define TU_LOG_WARN                     tempo_utils::Warn(__FILE__, __LINE__, true)
-#define TU_LOG_INFO                     tempo_utils::Info(__FILE__, __LINE__, true)
+#define TU_LOG_ERROR                    TU_LOG_IF_ENABLED_(tempo_utils::log_severity_is_enabled(tempo_utils::LogSeverity::kError)) \
+                                          tempo_utils::Error(__FILE__, __LINE__, true)
+#define TU_LOG_WARN                     TU_LOG_IF_ENABLED_(tempo_utils::log_severity_is_enabled(tempo_utils::LogSeverity::kWarn)) \
+                                          tempo_utils::Warn(__FILE__, __LINE__, true)
+#define TU_LOG_INFO                     TU_LOG_IF_ENABLED_(tempo_utils::log_severity_is_enabled(tempo_utils::LogSeverity::kInfo)) \
+                                          tempo_utils::Info(__FILE__, __LINE__, true)
 
 // construct basic log message if the specified condition is true
 
 #define TU_LOG_FATAL_IF(cond)           tempo_utils::Fatal(__FILE__, __LINE__, cond? true : false)
-#define TU_LOG_ERROR_IF(cond)           tempo_utils::Error(__FILE__, __LINE__, cond? true : false)
-#define TU_LOG_WARN_IF(cond)            tempo_utils::Warn(__FILE__, __LINE__, cond? true : false)
-#define TU_LOG_INFO_IF(cond)            tempo_utils::Info(__FILE__, __LINE__, cond? true : false)
+#define TU_LOG_ERROR_IF(cond)           TU_LOG_IF_ENABLED_((cond) && tempo_utils::log_severity_is_enabled(tempo_utils::LogSeverity::kError)) \
+                                          tempo_utils::Error(__FILE__, __LINE__, true)
+#define TU_LOG_WARN_IF(cond)            TU_LOG_IF_ENABLED_((cond) && tempo_utils::log_severity_is_enabled(tempo_utils::LogSeverity::kWarn)) \
+                                          tempo_utils::Warn(__FILE__, __LINE__, true)
+#define TU_LOG_INFO_IF(cond)            TU_LOG_IF_ENABLED_((cond) && tempo_utils::log_severity_is_enabled(tempo_utils::LogSeverity::kInfo)) \
+                                          tempo_utils::Info(__FILE__, __LINE__, true)
 
 // construct verbose log message
 
-#define TU_LOG_V                        tempo_utils::Verbose(__FILE__, __LINE__, true)
-#define TU_LOG_VV                       tempo_utils::VeryVerbose(__FILE__, __LINE__, true)
+#define TU_LOG_V                        TU_LOG_IF_ENABLED_(tempo_utils::log_severity_is_enabled(tempo_utils::LogSeverity::kVerbose)) \
+                                          tempo_utils::Verbose(__FILE__, __LINE__, true)
+#define TU_LOG_VV                       TU_LOG_IF_ENABLED_(tempo_utils::log_severity_is_enabled(tempo_utils::LogSeverity::kVeryVerbose)) \
+                                          tempo_utils::VeryVerbose(__FILE__, __LINE__, true)
+
+// construct verbose log message if the specified category is enabled and the specified condition is true
+
+#define TU_LOG_V_IF(category, cond)     TU_LOG_IF_ENABLED_(tempo_utils::log_category_is_enabled(category, tempo_utils::LogSeverity::kVerbose) && (cond)) \
+                                          tempo_utils::Verbose(__FILE__, __LINE__, category, true)
+#define TU_LOG_VV_IF(category, cond)    TU_LOG_IF_ENABLED_(tempo_utils::log_category_is_enabled(category, tempo_utils::LogSeverity::kVeryVerbose) && (cond)) \
+                                          tempo_utils::VeryVerbose(__FILE__, __LINE__, category, true)
+
+// map a severity name (ERROR, WARN, INFO, V, VV) to its severity and log message type. used
+// by the rate limited log macros, which take the severity name as their first argument.
+
+#define TU_LOG_SEVERITY_ERROR_          tempo_utils::LogSeverity::kError
+#define TU_LOG_SEVERITY_WARN_           tempo_utils::LogSeverity::kWarn
+#define TU_LOG_SEVERITY_INFO_           tempo_utils::LogSeverity::kInfo
+#define TU_LOG_SEVERITY_V_              tempo_utils::LogSeverity::kVerbose
+#define TU_LOG_SEVERITY_VV_             tempo_utils::LogSeverity::kVeryVerbose
+#define TU_LOG_MESSAGE_ERROR_           tempo_utils::Error
+#define TU_LOG_MESSAGE_WARN_            tempo_utils::Warn
+#define TU_LOG_MESSAGE_INFO_            tempo_utils::Info
+#define TU_LOG_MESSAGE_V_               tempo_utils::Verbose
+#define TU_LOG_MESSAGE_VV_              tempo_utils::VeryVerbose
+
+// evaluate the log message only if the severity is enabled and the rate limiter of type Limiter
+// admits the message. each expansion of the macro instantiates a distinct lambda, so each log
+// site has its own statically allocated limiter. the limiter is not consulted when the severity
+// is filtered, so filtered messages do not count towards the limit.
+
+#define TU_LOG_LIMITED_(name, Limiter, ...)                                                     \
+    for (tempo_utils::LogAdmission tu_log_admission_ =                                          \
+            tempo_utils::log_severity_is_enabled(TU_LOG_SEVERITY_##name##_)?                    \
+            []() -> Limiter& { static Limiter tu_log_limiter_; return tu_log_limiter_; }()      \
+                .admit(__VA_ARGS__) : tempo_utils::LogAdmission{};                              \
+        tu_log_admission_.admitted; tu_log_admission_.admitted = false)                         \
+        TU_LOG_MESSAGE_##name##_(__FILE__, __LINE__, true) << tu_log_admission_
+
+// construct log message with the specified severity name at most once every n occurrences,
+// starting with the first occurrence
+
+#define TU_LOG_EVERY_N(name, n)         TU_LOG_LIMITED_(name, tempo_utils::LogEveryN, n)
+
+// construct log message with the specified severity name for the first n occurrences only
+
+#define TU_LOG_FIRST_N(name, n)         TU_LOG_LIMITED_(name, tempo_utils::LogFirstN, n)
 
-// construct verbose log message if the specified condition is true
+// construct log message with the specified severity name at most once per absl::Duration period
 
-#define TU_LOG_V_IF(category, cond)     tempo_utils::Verbose(__FILE__, __LINE__, category, cond? true : false)
-#define TU_LOG_VV_IF(category, cond)    tempo_utils::VeryVerbose(__FILE__, __LINE__, category, cond? true : false)
+#define TU_LOG_EVERY_T(name, period)    TU_LOG_LIMITED_(name, tempo_utils::LogEveryT, period)
+
+// construct log message with the specified severity name at a sustained rate of at most
+// perSecond messages per second, allowing bursts of up to burst messages
+
+#define TU_LOG_RATE_LIMITED(name, perSecond, burst) \
+                                        TU_LOG_LIMITED_(name, tempo_utils::LogTokenBucket, perSecond, burst)
 
 // construct assert log message if the specified condition is false
 
@@ -63,13 +125,28 @@
 namespace tempo_utils {
 
     /**
-     * Base log message implementation which contains only the buffer.
+     * Base log message implementation which contains only the buffer. The buffer is borrowed
+     * from a thread-local pool when the message is first appended to and returned when the
+     * message is destroyed, so building a log message does not allocate once the pool is warm.
      */
     struct LogMessage {
-        std::ostringstream buffer;
         LogMessage() = default;
+        ~LogMessage();
         LogMessage(LogMessage &&other) noexcept;
         LogMessage& operator=(LogMessage &&other) noexcept;
+
+        void append(std::string_view str);
+        template<typename... Args>
+        void appendFormat(fmt::format_string<Args...> format, Args&&... args)
+        {
+            fmt::format_to(std::back_inserter(getBuffer()), format, std::forward<Args>(args)...);
+        }
+        std::string_view view() const;
+
+    private:
+        fmt::memory_buffer *m_buffer = nullptr;
+
+        fmt::memory_buffer& getBuffer();
     };
 
     /**
@@ -129,11 +206,13 @@ namespace tempo_utils {
 
     struct LogVerbose : ConditionalLogMessage {
         LogVerbose(char const *filePath, int lineNr, bool enabled);
+        LogVerbose(char const *filePath, int lineNr, LogCategory const *category, bool enabled);
         ~LogVerbose();
     };
 
     struct LogVeryVerbose : ConditionalLogMessage {
         LogVeryVerbose(char const *filePath, int lineNr, bool enabled);
+        LogVeryVerbose(char const *filePath, int lineNr, LogCategory const *category, bool enabled);
         ~LogVeryVerbose();
     };
 
@@ -159,6 +238,85 @@ namespace tempo_utils {
                        [[maybe_unused]] bool enabled) {};
     };
 
+    /**
+     * Converts a streamed log message expression to void, so that the log macros can select
+     * between the message and a no-op in a conditional expression. operator& binds less tightly
+     * than operator<<, so the entire stream expression is evaluated first.
+     */
+    struct LogVoidify {
+        void operator&(LogMessage &&) {}
+        void operator&(DiscardMessage &&) {}
+    };
+
+    /**
+     * Result of consulting a log rate limiter. If the message is admitted then `suppressed`
+     * contains the number of messages from the same log site which were suppressed since the
+     * last admitted message.
+     */
+    struct LogAdmission {
+        bool admitted = false;
+        tu_uint64 suppressed = 0;
+    };
+
+    /**
+     * Admits the first of every n messages.
+     */
+    class LogEveryN {
+    public:
+        LogAdmission admit(tu_uint64 n)
+        {
+            auto count = m_count.fetch_add(1, std::memory_order_relaxed);
+            if (n > 1 && count % n != 0)
+                return {};
+            return {true, count > 0 && n > 1? n - 1 : 0};
+        }
+    private:
+        std::atomic<tu_uint64> m_count = 0;
+    };
+
+    /**
+     * Admits the first n messages, after which every message is suppressed.
+     */
+    class LogFirstN {
+    public:
+        LogAdmission admit(tu_uint64 n)
+        {
+            // stop counting once the limit is reached so that the counter cannot wrap around
+            if (m_count.load(std::memory_order_relaxed) >= n)
+                return {};
+            auto count = m_count.fetch_add(1, std::memory_order_relaxed);
+            return {count < n, 0};
+        }
+    private:
+        std::atomic<tu_uint64> m_count = 0;
+    };
+
+    /**
+     * Admits at most one message per period.
+     */
+    class LogEveryT {
+    public:
+        LogAdmission admit(absl::Duration period);
+    private:
+        std::atomic<tu_int64> m_nextNanos = 0;
+        std::atomic<tu_uint64> m_suppressed = 0;
+    };
+
+    /**
+     * Token bucket which admits messages at a sustained rate of perSecond messages per second,
+     * with bursts of up to burst messages. The bucket is implemented as a generic cell rate
+     * algorithm, so the entire state is a single timestamp which is updated with compare-and-swap.
+     */
+    class LogTokenBucket {
+    public:
+        LogAdmission admit(double perSecond, int burst);
+    private:
+        std::atomic<tu_int64> m_theoreticalArrivalNanos = 0;
+        std::atomic<tu_uint64> m_suppressed = 0;
+    };
+
+    LogMessage&& operator<<(LogMessage &&message, const LogAdmission &admission);
+
     // internal macro to define bool type parameter for std::conditional
     #define SEVERITY_STRIP_CONDITION(severity) TU_LOG_STRIP_SEVERITY >= static_cast<int>(LogSeverity::severity)
 
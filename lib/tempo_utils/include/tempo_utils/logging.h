@@ -1,11 +1,13 @@
 #ifndef TEMPO_UTILS_LOGGING_H
 #define TEMPO_UTILS_LOGGING_H
 
+#include <atomic>
 #include <filesystem>
 #include <string>
 
 #include <absl/time/time.h>
 
+#include "integer_types.h"
 #include "status.h"
 
 namespace tempo_utils {
@@ -30,6 +32,45 @@ namespace tempo_utils {
         kVeryVerbose,
     };
 
+    /**
+     * Policy applied by the asynchronous logging queue when a message is written while the
+     * queue is full.
+     */
+    enum class LogQueuePolicy {
+        kBlock,             /**< writer blocks until the flusher thread frees a slot. */
+        kDropOldest,        /**< the oldest queued message is discarded to make room. */
+        kDropNewest,        /**< the message being written is discarded. */
+    };
+
+    constexpr bool log_severity_enabled(SeverityFilter filter, LogSeverity severity) {
+        switch (filter) {
+            case SeverityFilter::kSilent:               return severity == LogSeverity::kFatal;
+            case SeverityFilter::kErrorsOnly:           return severity <= LogSeverity::kError;
+            case SeverityFilter::kWarningsAndErrors:    return severity <= LogSeverity::kWarn;
+            case SeverityFilter::kDefault:              return severity <= LogSeverity::kInfo;
+            case SeverityFilter::kVerbose:              return severity <= LogSeverity::kVerbose;
+            case SeverityFilter::kVeryVerbose:          return true;
+            default:                                    return true;
+        }
+    }
+
+    /**
+     * Return the bitmask of severities which pass the specified filter, where bit N is set if
+     * the severity with numeric value N is enabled. Console severities are always enabled.
+     */
+    constexpr tu_uint32 log_severity_mask(SeverityFilter filter) {
+        tu_uint32 mask = 0;
+        for (int i = 0; i <= static_cast<int>(LogSeverity::kConsoleStderr); i++) {
+            auto severity = static_cast<LogSeverity>(i);
+            if (severity >= LogSeverity::kConsoleStdout || log_severity_enabled(filter, severity)) {
+                mask |= 1u << i;
+            }
+        }
+        return mask;
+    }
+
+    constexpr tu_uint32 kAllLogSeveritiesMask = 0xFFu;
+
     constexpr const char *log_severity_name(LogSeverity severity) {
         switch (severity) {
             case LogSeverity::kFatal:           return "FATAL";
@@ -44,6 +85,8 @@ namespace tempo_utils {
         }
     }
 
+    struct BinaryLogSite;
+
     class AbstractLogSink {
     public:
         virtual ~AbstractLogSink() = default;
@@ -54,6 +97,15 @@ namespace tempo_utils {
             const char *filePath,
             int lineNr,
             std::string_view message) = 0;
+        /**
+         * Write a binary log event containing the encoded arguments for the specified site.
+         * Sinks which do not record binary logs return false, in which case the caller formats
+         * the message and writes it with `writeLog` instead.
+         */
+        virtual bool writeBinaryLog(
+            const absl::Time &ts,
+            const BinaryLogSite *site,
+            std::string_view args) { return false; }
         virtual void flushSink() = 0;
         virtual void closeSink() = 0;
     };
@@ -61,14 +113,73 @@ namespace tempo_utils {
     struct LoggingConfiguration {
         SeverityFilter severityFilter = SeverityFilter::kDefault;
         bool flushEveryMessage = false;
+        bool asyncLogging = false;
+        int asyncQueueSize = 8192;
+        LogQueuePolicy asyncQueuePolicy = LogQueuePolicy::kBlock;
+        SeverityFilter flightRecorderFilter = SeverityFilter::kSilent; /**< additional severities captured by the flight recorder. */
+        bool installFaultHandler = false;   /**< dump the flight recorder to stderr when the process receives a fatal signal. */
+    };
+
+    struct LoggingStatistics {
+        tu_uint64 numEnqueued = 0;          /**< messages accepted by the async queue. */
+        tu_uint64 numWritten = 0;           /**< messages written to the sink by the flusher thread. */
+        tu_uint64 numDroppedOldest = 0;     /**< queued messages discarded under kDropOldest. */
+        tu_uint64 numDroppedNewest = 0;     /**< messages discarded under kDropNewest. */
+        tu_uint64 numBlocked = 0;           /**< writes which blocked on a full queue under kBlock. */
+        tu_uint64 numLockTimeouts = 0;      /**< synchronous writes dropped because the lock timed out. */
     };
 
+    namespace internal {
+        // severities which pass the current severity filter, mirrored from the logging
+        // configuration so that log sites can be tested without taking the global lock
+        extern std::atomic<tu_uint32> enabledSeverityMask;
+    }
+
+    /**
+     * Returns true if a log message with the specified severity would pass the current severity
+     * filter. This is a single relaxed load, so it is suitable for testing at the log site before
+     * the message is timestamped and formatted.
+     */
+    inline bool log_severity_is_enabled(LogSeverity severity) {
+        auto mask = internal::enabledSeverityMask.load(std::memory_order_relaxed);
+        return (mask >> static_cast<int>(severity)) & 1u;
+    }
+
+    /**
+     * Named category of verbose log messages which can be enabled or disabled independently of
+     * the global severity filter. A category must have static storage duration.
+     */
     struct LogCategory {
         char const *m_category;
         LogCategory(char const *category);
+        ~LogCategory();
+        LogCategory(const LogCategory &other) = delete;
+        LogCategory& operator=(const LogCategory &other) = delete;
         const char *category() const;
+
+        /**
+         * Returns true if messages in the category with the specified severity are enabled both
+         * by the category and by the global severity filter.
+         */
+        bool isEnabled(LogSeverity severity) const {
+            auto mask = m_effectiveMask.load(std::memory_order_relaxed);
+            return (mask >> static_cast<int>(severity)) & 1u;
+        }
+        void setEnabled(LogSeverity severity, bool enabled);
+
+        static void updateAllCategories(tu_uint32 severityMask);
+
+    private:
+        std::atomic<tu_uint32> m_categoryMask;
+        std::atomic<tu_uint32> m_effectiveMask;
+        LogCategory *m_prev;
+        LogCategory *m_next;
     };
 
+    inline bool log_category_is_enabled(LogCategory const *category, LogSeverity severity) {
+        return category == nullptr? log_severity_is_enabled(severity) : category->isEnabled(severity);
+    }
+
     Status init_logging(
         const LoggingConfiguration &config,
         std::unique_ptr<AbstractLogSink> &&logSink);
@@ -80,6 +191,8 @@ namespace tempo_utils {
 
     LoggingConfiguration get_logging_configuration();
 
+    LoggingStatistics get_logging_statistics();
+
     bool write_log(
         const absl::Time &ts,
         LogSeverity severity,
@@ -87,6 +200,11 @@ namespace tempo_utils {
         int lineNr,
         std::string_view message);
 
+    bool write_binary_log(
+        const absl::Time &ts,
+        BinaryLogSite *site,
+        std::string_view args);
+
     bool cleanup_logging(bool finished = true);
 
     bool write_console(LogSeverity severity, std::string_view message);
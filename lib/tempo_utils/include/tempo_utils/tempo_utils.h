@@ -8,16 +8,19 @@
  */
 namespace tempo_utils {}
 
+#include "binary_log.h"
 #include "compressed_bitmap.h"
 #include "date_time.h"
 #include "directory_maker.h"
 #include "either_template.h"
+#include "fast_clock.h"
 #include "fault_handler.h"
 #include "file_appender.h"
 #include "file_reader.h"
 #include "file_result.h"
 #include "file_utilities.h"
 #include "file_writer.h"
+#include "flight_recorder.h"
 #include "fp_compensation.h"
 #include "hdr_histogram.h"
 #include "integer_types.h"
@@ -0,0 +1,258 @@
+
+#include <fmt/args.h>
+#include <fmt/format.h>
+
+#include <tempo_utils/binary_log.h>
+
+static std::atomic<tu_uint32> nextBinaryLogSiteId = 1;
+
+/**
+ * Return the id of the binary log site, assigning a new id if the site has not been used yet.
+ *
+ * @return The site id, which is always greater than zero.
+ */
+tu_uint32
+tempo_utils::BinaryLogSite::getSiteId()
+{
+    auto id = siteId.load(std::memory_order_acquire);
+    if (id != 0) [[likely]]
+        return id;
+    auto nextId = nextBinaryLogSiteId.fetch_add(1, std::memory_order_relaxed);
+    // another thread may have assigned the site id concurrently, in which case we use its id
+    // and discard the one we allocated
+    if (siteId.compare_exchange_strong(id, nextId, std::memory_order_acq_rel))
+        return nextId;
+    return id;
+}
+
+std::string&
+tempo_utils::internal::get_binary_log_buffer()
+{
+    thread_local std::string buffer;
+    return buffer;
+}
+
+/**
+ * Write the binary log event to the sink. If the sink does not record binary logs then the
+ * message is formatted and written as text.
+ */
+void
+tempo_utils::internal::write_binary_log_to_sink(
+    AbstractLogSink *sink,
+    const absl::Time &ts,
+    const BinaryLogSite *site,
+    std::string_view args)
+{
+    if (!sink->writeBinaryLog(ts, site, args)) {
+        auto message = format_binary_log_message(site->format, args);
+        sink->writeLog(ts, site->severity, site->filePath, site->lineNr, message);
+    }
+}
+
+template<typename T>
+static bool
+read_value(std::string_view &bytes, T &value)
+{
+    if (bytes.size() < sizeof(T))
+        return false;
+    std::memcpy(&value, bytes.data(), sizeof(T));
+    bytes.remove_prefix(sizeof(T));
+    return true;
+}
+
+static bool
+read_string(std::string_view &bytes, std::string_view &str)
+{
+    tu_uint32 size;
+    if (!read_value(bytes, size) || bytes.size() < size)
+        return false;
+    str = bytes.substr(0, size);
+    bytes.remove_prefix(size);
+    return true;
+}
+
+/**
+ * Expand the format string using the encoded binary log arguments. If the arguments are
+ * malformed or do not match the format string then the returned message describes the error
+ * instead.
+ *
+ * @param format The fmt format string of the binary log site.
+ * @param args The encoded arguments.
+ * @return The formatted message.
+ */
+std::string
+tempo_utils::format_binary_log_message(std::string_view format, std::string_view args)
+{
+    fmt::dynamic_format_arg_store<fmt::format_context> store;
+
+    while (!args.empty()) {
+        tu_uint8 tag;
+        read_value(args, tag);
+        bool valid = false;
+        switch (static_cast<BinaryLogArgType>(tag)) {
+            case BinaryLogArgType::kBool: {
+                tu_uint8 b;
+                if ((valid = read_value(args, b)))
+                    store.push_back(b != 0);
+                break;
+            }
+            case BinaryLogArgType::kChar: {
+                char c;
+                if ((valid = read_value(args, c)))
+                    store.push_back(c);
+                break;
+            }
+            case BinaryLogArgType::kInt64: {
+                tu_int64 i64;
+                if ((valid = read_value(args, i64)))
+                    store.push_back(i64);
+                break;
+            }
+            case BinaryLogArgType::kUInt64: {
+                tu_uint64 u64;
+                if ((valid = read_value(args, u64)))
+                    store.push_back(u64);
+                break;
+            }
+            case BinaryLogArgType::kDouble: {
+                double dbl;
+                if ((valid = read_value(args, dbl)))
+                    store.push_back(dbl);
+                break;
+            }
+            case BinaryLogArgType::kString: {
+                std::string_view str;
+                if ((valid = read_string(args, str)))
+                    store.push_back(std::string(str));
+                break;
+            }
+            case BinaryLogArgType::kPointer: {
+                tu_uint64 p;
+                if ((valid = read_value(args, p)))
+                    store.push_back(reinterpret_cast<const void *>(p));
+                break;
+            }
+            default:
+                break;
+        }
+        if (!valid)
+            return fmt::format("[invalid binary log arguments for format '{}']", format);
+    }
+
+    try {
+        return fmt::vformat(fmt::string_view(format.data(), format.size()), store);
+    } catch (const fmt::format_error &ex) {
+        return fmt::format("[failed to format binary log message '{}': {}]", format, ex.what());
+    }
+}
+
+tempo_utils::BinaryLogReader::BinaryLogReader(std::string_view bytes)
+    : m_bytes(bytes)
+{
+}
+
+/**
+ * Read and verify the binary log file header. Must be called before reading any entries.
+ *
+ * @return Status
+ */
+tempo_utils::Status
+tempo_utils::BinaryLogReader::readHeader()
+{
+    std::string_view magic(kBinaryLogMagic);
+    if (m_bytes.size() < magic.size() || m_bytes.substr(0, magic.size()) != magic)
+        return GenericStatus::forCondition(GenericCondition::kInternalViolation,
+            "invalid binary log; missing file header");
+    m_bytes.remove_prefix(magic.size());
+    tu_uint32 version;
+    if (!read_value(m_bytes, version))
+        return GenericStatus::forCondition(GenericCondition::kInternalViolation,
+            "invalid binary log; missing file version");
+    if (version != kBinaryLogVersion)
+        return GenericStatus::forCondition(GenericCondition::kInternalViolation,
+            "unsupported binary log version {}", version);
+    return {};
+}
+
+/**
+ * Read the next log entry.
+ *
+ * @param entry The entry to populate.
+ * @return true if an entry was read, or false if there are no more entries.
+ */
+tempo_utils::Result<bool>
+tempo_utils::BinaryLogReader::readEntry(BinaryLogEntry &entry)
+{
+    while (!m_bytes.empty()) {
+        tu_uint8 type;
+        read_value(m_bytes, type);
+
+        switch (static_cast<BinaryLogRecordType>(type)) {
+
+            case BinaryLogRecordType::kSite: {
+                tu_uint32 siteId;
+                tu_uint8 severity;
+                tu_int32 lineNr;
+                std::string_view filePath, format;
+                if (!read_value(m_bytes, siteId) || !read_value(m_bytes, severity)
+                    || !read_value(m_bytes, lineNr) || !read_string(m_bytes, filePath)
+                    || !read_string(m_bytes, format))
+                    return GenericStatus::forCondition(GenericCondition::kInternalViolation,
+                        "invalid binary log; truncated site record");
+                // site ids are read from the file, so they are only used as map keys and never
+                // to size a table
+                if (siteId == 0)
+                    return GenericStatus::forCondition(GenericCondition::kInternalViolation,
+                        "invalid binary log; site record has invalid site id");
+                m_sites[siteId] = SiteDescriptor{static_cast<LogSeverity>(severity),
+                    std::string(filePath), lineNr, std::string(format)};
+                break;
+            }
+
+            case BinaryLogRecordType::kEvent: {
+                tu_uint32 siteId;
+                tu_int64 tsNanos;
+                std::string_view args;
+                if (!read_value(m_bytes, siteId) || !read_value(m_bytes, tsNanos)
+                    || !read_string(m_bytes, args))
+                    return GenericStatus::forCondition(GenericCondition::kInternalViolation,
+                        "invalid binary log; truncated event record");
+                auto siteEntry = m_sites.find(siteId);
+                if (siteEntry == m_sites.cend())
+                    return GenericStatus::forCondition(GenericCondition::kInternalViolation,
+                        "invalid binary log; event references unknown site {}", siteId);
+                const auto &site = siteEntry->second;
+                entry.ts = absl::FromUnixNanos(tsNanos);
+                entry.severity = site.severity;
+                entry.filePath = site.filePath;
+                entry.lineNr = site.lineNr;
+                entry.message = format_binary_log_message(site.format, args);
+                return true;
+            }
+
+            case BinaryLogRecordType::kText: {
+                tu_uint8 severity;
+                tu_int64 tsNanos;
+                tu_int32 lineNr;
+                std::string_view filePath, message;
+                if (!read_value(m_bytes, severity) || !read_value(m_bytes, tsNanos)
+                    || !read_value(m_bytes, lineNr) || !read_string(m_bytes, filePath)
+                    || !read_string(m_bytes, message))
+                    return GenericStatus::forCondition(GenericCondition::kInternalViolation,
+                        "invalid binary log; truncated text record");
+                entry.ts = absl::FromUnixNanos(tsNanos);
+                entry.severity = static_cast<LogSeverity>(severity);
+                entry.filePath = filePath;
+                entry.lineNr = lineNr;
+                entry.message = message;
+                return true;
+            }
+
+            default:
+                return GenericStatus::forCondition(GenericCondition::kInternalViolation,
+                    "invalid binary log; unknown record type {}", type);
+        }
+    }
+
+    return false;
+}
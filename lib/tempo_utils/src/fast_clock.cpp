@@ -0,0 +1,165 @@
+
+#include <ctime>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define TEMPO_UTILS_HAS_TSC 1
+#endif
+
+#include <absl/time/clock.h>
+
+#include <tempo_utils/fast_clock.h>
+
+/**
+ * How long the TSC frequency is measured against CLOCK_MONOTONIC during calibration.
+ */
+constexpr tu_int64 kTscCalibrationNanos = 10'000'000;
+
+namespace {
+    /**
+     * Maps clock ticks to nanoseconds since the epoch, where the nanos per tick is stored as a
+     * 32.32 fixed point number. When the TSC is not used a tick is one nanosecond of
+     * CLOCK_MONOTONIC.
+     */
+    struct Calibration {
+        bool useTsc = false;
+        tu_int64 baseTicks = 0;
+        tu_int64 baseNanos = 0;
+        tu_uint64 nanosPerTick = 1ull << 32;
+    };
+}
+
+static tu_int64
+read_monotonic_nanos()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<tu_int64>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+#ifdef TEMPO_UTILS_HAS_TSC
+
+/**
+ * Returns true if the processor reports an invariant TSC, which ticks at a constant rate
+ * regardless of frequency scaling or sleep states and is synchronized across cores.
+ */
+static bool
+has_invariant_tsc()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007)
+        return false;
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+        return false;
+    return (edx & (1u << 8)) != 0;
+}
+
+static tu_int64
+read_ticks(bool useTsc)
+{
+    if (useTsc)
+        return static_cast<tu_int64>(__rdtsc());
+    return read_monotonic_nanos();
+}
+
+#else
+
+static bool
+has_invariant_tsc()
+{
+    return false;
+}
+
+static tu_int64
+read_ticks(bool useTsc)
+{
+    return read_monotonic_nanos();
+}
+
+#endif
+
+/**
+ * Read the current tick count and the wall clock as close together as possible. The ticks are
+ * read on either side of the wall clock and the midpoint is used.
+ */
+static void
+read_ticks_and_wall_nanos(bool useTsc, tu_int64 &ticks, tu_int64 &wallNanos)
+{
+    auto before = read_ticks(useTsc);
+    wallNanos = absl::GetCurrentTimeNanos();
+    auto after = read_ticks(useTsc);
+    ticks = before + (after - before) / 2;
+}
+
+static Calibration
+measure_calibration()
+{
+    Calibration calibration;
+    calibration.useTsc = has_invariant_tsc();
+
+    if (calibration.useTsc) {
+        // measure the TSC frequency against CLOCK_MONOTONIC
+        auto startTicks = read_ticks(true);
+        auto startNanos = read_monotonic_nanos();
+        absl::SleepFor(absl::Nanoseconds(kTscCalibrationNanos));
+        auto endTicks = read_ticks(true);
+        auto endNanos = read_monotonic_nanos();
+        auto elapsedTicks = endTicks - startTicks;
+        if (elapsedTicks > 0) {
+            auto nanosPerTick = static_cast<long double>(endNanos - startNanos) / elapsedTicks;
+            calibration.nanosPerTick = static_cast<tu_uint64>(nanosPerTick * (1ull << 32));
+        } else {
+            calibration.useTsc = false;
+        }
+    }
+
+    read_ticks_and_wall_nanos(calibration.useTsc, calibration.baseTicks, calibration.baseNanos);
+    return calibration;
+}
+
+static const Calibration&
+get_calibration()
+{
+    static const Calibration calibration = measure_calibration();
+    return calibration;
+}
+
+/**
+ * Returns the current time in nanoseconds since the epoch.
+ */
+tu_int64
+tempo_utils::FastClock::nanosSinceEpoch()
+{
+    const auto &calibration = get_calibration();
+    __int128 elapsedTicks = read_ticks(calibration.useTsc) - calibration.baseTicks;
+    auto elapsedNanos = static_cast<tu_int64>((elapsedTicks * calibration.nanosPerTick) >> 32);
+    return calibration.baseNanos + elapsedNanos;
+}
+
+absl::Time
+tempo_utils::FastClock::now()
+{
+    return absl::FromUnixNanos(nanosSinceEpoch());
+}
+
+/**
+ * Returns true if the clock reads the TSC, or false if it reads CLOCK_MONOTONIC.
+ */
+bool
+tempo_utils::FastClock::isTscClock()
+{
+    return get_calibration().useTsc;
+}
+
+/**
+ * Calibrate the clock if it has not been calibrated yet. Calibration takes about 10ms when the
+ * TSC is used, so programs which are sensitive to the latency of the first timestamp should
+ * call this during startup. `init_logging` calls this, so programs which initialize logging
+ * are calibrated before the first log message.
+ */
+void
+tempo_utils::FastClock::calibrate()
+{
+    get_calibration();
+}
@@ -1,22 +1,73 @@
-#include <iostream>
+#include <csignal>
+#include <cstring>
+#include <iterator>
+
+#include <unistd.h>
 
 #include <tempo_utils/fault_handler.h>
+#include <tempo_utils/flight_recorder.h>
+#include <tempo_utils/internal/signal_safe_writer.h>
 
 #define BOOST_STACKTRACE_GNU_SOURCE_NOT_REQUIRED 1
 
 #include <boost/stacktrace.hpp>
 
+/**
+ * Print the fault to stderr followed by the contents of the flight recorder. Only
+ * async-signal-safe operations are used, so this function may be called from a signal handler.
+ */
 void tempo_utils::invoke_fault_handler(int signum, const char *message)
 {
-    std::cerr << "INVOKED FAULT HANDLER";
-    if (signum < 0) {
-        std::cerr << std::endl;
-    } else {
-        std::cerr << " (caught signal " << signum << ")" << std::endl;
-    }
-    if (message != nullptr) {
-        std::cerr << "Message was: " << message << std::endl;
+    {
+        internal::SignalSafeWriter writer(STDERR_FILENO);
+        writer.append("INVOKED FAULT HANDLER");
+        if (signum < 0) {
+            writer.append("\n");
+        } else {
+            writer.append(" (caught signal ").appendSigned(signum).append(")\n");
+        }
+        if (message != nullptr) {
+            writer.append("Message was: ").append(std::string_view(message, strlen(message))).append("\n");
+        }
     }
+    dump_flight_recorder(STDERR_FILENO);
     // TODO: capture stacktrace in Status instead of printing it
     //std::cerr << boost::stacktrace::stacktrace();
 }
+
+static void
+on_fault_signal(int signum)
+{
+    tempo_utils::invoke_fault_handler(signum, nullptr);
+    // the default disposition was restored when the signal was delivered, so re-raising the
+    // signal terminates the process (and produces a core dump if enabled)
+    raise(signum);
+}
+
+/**
+ * Install a handler for fatal signals (SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT) which invokes
+ * the fault handler and then terminates the process with the original signal. If the handler
+ * cannot be installed for every signal then the previous handlers are restored.
+ *
+ * @return true if the handler was installed for every signal, otherwise false.
+ */
+bool tempo_utils::install_fault_handler()
+{
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_fault_signal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESETHAND | SA_NODEFER;
+
+    constexpr int kFaultSignals[] = {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT};
+    struct sigaction previous[std::size(kFaultSignals)];
+    for (size_t i = 0; i < std::size(kFaultSignals); i++) {
+        if (sigaction(kFaultSignals[i], &action, &previous[i]) < 0) {
+            while (i-- > 0) {
+                sigaction(kFaultSignals[i], &previous[i], nullptr);
+            }
+            return false;
+        }
+    }
+    return true;
+}
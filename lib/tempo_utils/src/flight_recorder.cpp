@@ -0,0 +1,229 @@
+
+#include <atomic>
+#include <cstring>
+
+#include <tempo_utils/flight_recorder.h>
+#include <tempo_utils/internal/signal_safe_writer.h>
+
+static_assert((tempo_utils::kFlightRecorderCapacity & (tempo_utils::kFlightRecorderCapacity - 1)) == 0,
+    "flight recorder capacity must be a power of two");
+
+// the maximum number of trailing bytes of the source file path retained in a flight record
+constexpr int kFlightRecordFileSize = 48;
+
+// the number of record positions a thread reserves at once from the shared recorder position
+constexpr int kFlightRecordBatchSize = 16;
+
+// the maximum distance behind the shared recorder position at which a thread may still write into
+// its reserved batch, which bounds how far out of order records may be dumped
+constexpr int kFlightRecordMaxDisplacement = 4 * kFlightRecordBatchSize;
+
+enum class FlightRecordType : tu_uint8 {
+    kLog,
+    kSpan,
+};
+
+/**
+ * A flight record is written in place and never refers to memory outside of the record, so the
+ * recorder can be dumped from a signal handler. The sequence is cleared while the record is
+ * being written and set to the record position + 1 once the record is committed, which lets the
+ * reader detect records which were torn by a concurrent writer.
+ */
+struct FlightRecord {
+    std::atomic<tu_uint64> sequence;
+    tu_int64 tsNanos;
+    tu_int64 durationNanos;
+    tu_uint64 spanId;
+    tu_int32 lineNr;
+    FlightRecordType type;
+    tempo_utils::LogSeverity severity;
+    bool failed;
+    tu_uint8 fileSize;
+    tu_uint16 textSize;
+    char file[kFlightRecordFileSize];
+    char text[tempo_utils::kFlightRecordTextSize];
+};
+
+// records are statically allocated so the recorder is usable at any time without allocating
+static FlightRecord flightRecords[tempo_utils::kFlightRecorderCapacity];
+static std::atomic<tu_uint64> flightRecorderPosition = 0;
+
+/**
+ * The positions reserved by the current thread. Each thread reserves a batch of positions with
+ * a single update of the shared recorder position, so threads which record concurrently only
+ * contend on the shared position once per batch.
+ */
+struct FlightRecordBatch {
+    tu_uint64 next = 0;
+    tu_uint64 end = 0;
+};
+static thread_local FlightRecordBatch flightRecordBatch;
+
+static FlightRecord&
+begin_record(tu_uint64 &pos)
+{
+    auto &batch = flightRecordBatch;
+    // if other threads have reserved many positions since the batch was reserved then records in
+    // the remaining positions would be dumped as if they were much older, so the rest of the batch
+    // is abandoned
+    if (batch.next == batch.end || flightRecorderPosition.load(std::memory_order_relaxed) - batch.next
+            > kFlightRecordMaxDisplacement) {
+        batch.next = flightRecorderPosition.fetch_add(kFlightRecordBatchSize, std::memory_order_relaxed);
+        batch.end = batch.next + kFlightRecordBatchSize;
+    }
+    pos = batch.next++;
+    auto &record = flightRecords[pos & (tempo_utils::kFlightRecorderCapacity - 1)];
+    record.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return record;
+}
+
+static void
+commit_record(FlightRecord &record, tu_uint64 pos)
+{
+    record.sequence.store(pos + 1, std::memory_order_release);
+}
+
+static tu_uint16
+copy_text(char *dst, size_t dstSize, std::string_view src)
+{
+    auto size = std::min(src.size(), dstSize);
+    std::memcpy(dst, src.data(), size);
+    return static_cast<tu_uint16>(size);
+}
+
+/**
+ * Record a log message in the flight recorder.
+ *
+ * @param ts Timestamp when the log event was generated.
+ * @param severity The severity of the log event.
+ * @param filePath Path to the file where the log event was generated.
+ * @param lineNr Line number in where the log event was generated.
+ * @param message The log message.
+ */
+void
+tempo_utils::record_flight_log(
+    const absl::Time &ts,
+    LogSeverity severity,
+    const char *filePath,
+    int lineNr,
+    std::string_view message)
+{
+    tu_uint64 pos;
+    auto &record = begin_record(pos);
+    record.type = FlightRecordType::kLog;
+    record.tsNanos = absl::ToUnixNanos(ts);
+    record.severity = severity;
+    record.lineNr = lineNr;
+    // retain the tail of the file path, which is the most useful part
+    std::string_view path(filePath != nullptr? filePath : "");
+    if (path.size() > kFlightRecordFileSize) {
+        path.remove_prefix(path.size() - kFlightRecordFileSize);
+    }
+    record.fileSize = static_cast<tu_uint8>(copy_text(record.file, kFlightRecordFileSize, path));
+    record.textSize = copy_text(record.text, kFlightRecordTextSize, message);
+    commit_record(record, pos);
+}
+
+/**
+ * Record a summary of a closed span in the flight recorder.
+ *
+ * @param ts Timestamp when the span was closed.
+ * @param spanId The span id.
+ * @param operationName The span operation name.
+ * @param activeDuration The total time the span was active.
+ * @param failed true if the span failed.
+ */
+void
+tempo_utils::record_flight_span(
+    const absl::Time &ts,
+    tu_uint64 spanId,
+    std::string_view operationName,
+    absl::Duration activeDuration,
+    bool failed)
+{
+    tu_uint64 pos;
+    auto &record = begin_record(pos);
+    record.type = FlightRecordType::kSpan;
+    record.tsNanos = absl::ToUnixNanos(ts);
+    record.spanId = spanId;
+    record.durationNanos = absl::ToInt64Nanoseconds(activeDuration);
+    record.failed = failed;
+    record.fileSize = 0;
+    record.textSize = copy_text(record.text, kFlightRecordTextSize, operationName);
+    commit_record(record, pos);
+}
+
+/**
+ * Write the contents of the flight recorder to the specified file descriptor, in the order the
+ * record positions were reserved. Threads reserve positions in batches, so records of different
+ * threads may be interleaved slightly out of timestamp order. This function is async-signal-safe,
+ * so it may be called from a signal handler. Records which are being written concurrently are
+ * skipped.
+ *
+ * @param fd The file descriptor to write to.
+ */
+void
+tempo_utils::dump_flight_recorder(int fd)
+{
+    internal::SignalSafeWriter writer(fd);
+
+    // reserved positions which have not been written yet still hold older records, so the scan
+    // starts earlier by the maximum displacement. each slot matches the sequence of at most one
+    // position.
+    auto end = flightRecorderPosition.load(std::memory_order_acquire);
+    tu_uint64 window = kFlightRecorderCapacity + kFlightRecordMaxDisplacement;
+    auto start = end > window? end - window : 0;
+
+    tu_uint64 numRecords = 0;
+    for (auto pos = start; pos < end; pos++) {
+        auto &record = flightRecords[pos & (kFlightRecorderCapacity - 1)];
+        if (record.sequence.load(std::memory_order_relaxed) == pos + 1) {
+            numRecords++;
+        }
+    }
+    writer.append("--- flight recorder: ").appendUnsigned(numRecords).append(" records ---\n");
+
+    FlightRecord copy;
+    for (auto pos = start; pos < end; pos++) {
+        auto &record = flightRecords[pos & (kFlightRecorderCapacity - 1)];
+        auto sequence = record.sequence.load(std::memory_order_acquire);
+        if (sequence != pos + 1)
+            continue;
+        copy.tsNanos = record.tsNanos;
+        copy.durationNanos = record.durationNanos;
+        copy.spanId = record.spanId;
+        copy.lineNr = record.lineNr;
+        copy.type = record.type;
+        copy.severity = record.severity;
+        copy.failed = record.failed;
+        copy.fileSize = std::min<tu_uint8>(record.fileSize, kFlightRecordFileSize);
+        copy.textSize = std::min<tu_uint16>(record.textSize, kFlightRecordTextSize);
+        std::memcpy(copy.file, record.file, copy.fileSize);
+        std::memcpy(copy.text, record.text, copy.textSize);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (record.sequence.load(std::memory_order_relaxed) != sequence)
+            continue;
+
+        writer.appendTimestamp(copy.tsNanos);
+        switch (copy.type) {
+            case FlightRecordType::kLog:
+                writer.append(" ").append(log_severity_name(copy.severity))
+                    .append(" ").append(std::string_view(copy.file, copy.fileSize))
+                    .append(":").appendSigned(copy.lineNr)
+                    .append(" ").append(std::string_view(copy.text, copy.textSize));
+                break;
+            case FlightRecordType::kSpan:
+                writer.append(" SPAN ").appendHex(copy.spanId, 16)
+                    .append(" ").append(std::string_view(copy.text, copy.textSize))
+                    .append(" active=").appendSigned(copy.durationNanos / 1000).append("us");
+                if (copy.failed) {
+                    writer.append(" FAILED");
+                }
+                break;
+        }
+        writer.append("\n");
+    }
+
+    writer.append("--- end of flight recorder ---\n");
+}
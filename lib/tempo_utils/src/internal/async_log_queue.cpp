@@ -0,0 +1,281 @@
+
+#include <tempo_utils/binary_log.h>
+#include <tempo_utils/internal/async_log_queue.h>
+#include <tempo_utils/log_message.h>
+
+// slots holding a message larger than this are released after being consumed
+constexpr size_t kMaxRetainedMessageCapacity = 4096;
+
+// wake any producers blocked on a full queue after this many messages are consumed
+constexpr tu_uint64 kNotifyProducersInterval = 64;
+
+static tu_uint64
+round_up_to_power_of_two(int queueSize)
+{
+    tu_uint64 capacity = 2;
+    while (capacity < static_cast<tu_uint64>(queueSize)) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+tempo_utils::internal::AsyncLogQueue::AsyncLogQueue(
+    AbstractLogSink *sink,
+    int queueSize,
+    LogQueuePolicy policy,
+    bool flushEveryBatch)
+    : m_sink(sink),
+      m_policy(policy),
+      m_flushEveryBatch(flushEveryBatch),
+      m_running(false),
+      m_enqueuePos(0),
+      m_dequeuePos(0),
+      m_signal(0),
+      m_numCompleted(0),
+      m_numFlushed(0),
+      m_flushRequested(false),
+      m_numEnqueued(0),
+      m_numWritten(0),
+      m_numDroppedOldest(0),
+      m_numDroppedNewest(0),
+      m_numBlocked(0)
+{
+    TU_NOTNULL (m_sink);
+    auto capacity = round_up_to_power_of_two(queueSize);
+    m_slots = std::make_unique<Slot[]>(capacity);
+    for (tu_uint64 i = 0; i < capacity; i++) {
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    m_mask = capacity - 1;
+}
+
+tempo_utils::internal::AsyncLogQueue::~AsyncLogQueue()
+{
+    shutdown();
+}
+
+/**
+ * Start the flusher thread.
+ */
+void
+tempo_utils::internal::AsyncLogQueue::start()
+{
+    TU_ASSERT (!m_flusher.joinable());
+    m_running.store(true, std::memory_order_release);
+    m_flusher = std::thread(&AsyncLogQueue::runFlusher, this);
+}
+
+/**
+ * Stop the flusher thread after it has drained all queued messages. The caller must ensure
+ * that no producer is concurrently calling `enqueue`.
+ */
+void
+tempo_utils::internal::AsyncLogQueue::shutdown()
+{
+    if (!m_flusher.joinable())
+        return;
+    m_running.store(false, std::memory_order_release);
+    m_signal.fetch_add(1, std::memory_order_release);
+    m_signal.notify_one();
+    m_flusher.join();
+}
+
+bool
+tempo_utils::internal::AsyncLogQueue::tryPush(
+    const absl::Time &ts,
+    LogSeverity severity,
+    const char *filePath,
+    int lineNr,
+    std::string_view message,
+    const BinaryLogSite *site)
+{
+    Slot *slot;
+    auto pos = m_enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        slot = &m_slots[pos & m_mask];
+        auto seq = slot->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<tu_int64>(seq) - static_cast<tu_int64>(pos);
+        if (diff == 0) {
+            if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return false;   // queue is full
+        } else {
+            pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    // we own the slot, so copy the message into the slot buffer
+    auto &entry = slot->entry;
+    entry.ts = ts;
+    entry.severity = severity;
+    entry.filePath = filePath;
+    entry.lineNr = lineNr;
+    entry.message.assign(message.data(), message.size());
+    entry.site = site;
+
+    // publish the slot to the consumer
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * Remove the oldest message from the queue. If `sink` is not nullptr then the message is
+ * written to the sink, otherwise the message is discarded.
+ */
+bool
+tempo_utils::internal::AsyncLogQueue::tryPop(AbstractLogSink *sink)
+{
+    Slot *slot;
+    auto pos = m_dequeuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        slot = &m_slots[pos & m_mask];
+        auto seq = slot->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<tu_int64>(seq) - static_cast<tu_int64>(pos + 1);
+        if (diff == 0) {
+            if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return false;   // queue is empty
+        } else {
+            pos = m_dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    auto &entry = slot->entry;
+    if (sink != nullptr) {
+        if (entry.site != nullptr) {
+            write_binary_log_to_sink(sink, entry.ts, entry.site, entry.message);
+        } else {
+            sink->writeLog(entry.ts, entry.severity, entry.filePath, entry.lineNr, entry.message);
+        }
+        m_numWritten.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (entry.message.capacity() > kMaxRetainedMessageCapacity) {
+        std::string().swap(entry.message);
+    }
+
+    // release the slot back to the producers
+    slot->sequence.store(pos + m_mask + 1, std::memory_order_release);
+    m_numCompleted.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * Enqueue a log message, applying the queue policy if the queue is full. If `site` is not
+ * nullptr then `message` contains the encoded arguments of a binary log event.
+ *
+ * @return true if the message was enqueued, otherwise false if the message was dropped.
+ */
+bool
+tempo_utils::internal::AsyncLogQueue::enqueue(
+    const absl::Time &ts,
+    LogSeverity severity,
+    const char *filePath,
+    int lineNr,
+    std::string_view message,
+    const BinaryLogSite *site)
+{
+    if (!tryPush(ts, severity, filePath, lineNr, message, site)) {
+        // the flusher thread must never block on itself, so treat a full queue as drop-newest
+        auto policy = m_policy;
+        if (std::this_thread::get_id() == m_flusher.get_id()) {
+            policy = LogQueuePolicy::kDropNewest;
+        }
+
+        switch (policy) {
+            case LogQueuePolicy::kDropNewest:
+                m_numDroppedNewest.fetch_add(1, std::memory_order_relaxed);
+                return false;
+
+            case LogQueuePolicy::kDropOldest:
+                do {
+                    if (tryPop(nullptr)) {
+                        m_numDroppedOldest.fetch_add(1, std::memory_order_relaxed);
+                    } else {
+                        std::this_thread::yield();
+                    }
+                } while (!tryPush(ts, severity, filePath, lineNr, message, site));
+                break;
+
+            case LogQueuePolicy::kBlock:
+                m_numBlocked.fetch_add(1, std::memory_order_relaxed);
+                for (;;) {
+                    auto completed = m_numCompleted.load(std::memory_order_acquire);
+                    if (tryPush(ts, severity, filePath, lineNr, message, site))
+                        break;
+                    m_numCompleted.wait(completed, std::memory_order_acquire);
+                }
+                break;
+        }
+    }
+
+    m_numEnqueued.fetch_add(1, std::memory_order_relaxed);
+    m_signal.fetch_add(1, std::memory_order_release);
+    m_signal.notify_one();
+    return true;
+}
+
+/**
+ * Block until every message enqueued before the call has been written and the sink has been
+ * flushed.
+ */
+void
+tempo_utils::internal::AsyncLogQueue::flush()
+{
+    if (!m_flusher.joinable() || std::this_thread::get_id() == m_flusher.get_id())
+        return;
+
+    auto target = m_enqueuePos.load(std::memory_order_acquire);
+    m_flushRequested.store(true, std::memory_order_release);
+    m_signal.fetch_add(1, std::memory_order_release);
+    m_signal.notify_one();
+
+    auto flushed = m_numFlushed.load(std::memory_order_acquire);
+    while (flushed < target) {
+        m_numFlushed.wait(flushed, std::memory_order_acquire);
+        flushed = m_numFlushed.load(std::memory_order_acquire);
+    }
+}
+
+void
+tempo_utils::internal::AsyncLogQueue::runFlusher()
+{
+    for (;;) {
+        auto signal = m_signal.load(std::memory_order_acquire);
+        auto running = m_running.load(std::memory_order_acquire);
+
+        tu_uint64 count = 0;
+        while (tryPop(m_sink)) {
+            if (++count % kNotifyProducersInterval == 0) {
+                m_numCompleted.notify_all();
+            }
+        }
+
+        auto flushRequested = m_flushRequested.exchange(false, std::memory_order_acq_rel);
+        if (count > 0 || flushRequested) {
+            if (m_flushEveryBatch || flushRequested || !running) {
+                m_sink->flushSink();
+            }
+            m_numCompleted.notify_all();
+            m_numFlushed.store(m_numCompleted.load(std::memory_order_acquire), std::memory_order_release);
+            m_numFlushed.notify_all();
+        }
+
+        if (!running)
+            break;
+        m_signal.wait(signal, std::memory_order_acquire);
+    }
+}
+
+tempo_utils::LoggingStatistics
+tempo_utils::internal::AsyncLogQueue::getStatistics() const
+{
+    LoggingStatistics statistics;
+    statistics.numEnqueued = m_numEnqueued.load(std::memory_order_relaxed);
+    statistics.numWritten = m_numWritten.load(std::memory_order_relaxed);
+    statistics.numDroppedOldest = m_numDroppedOldest.load(std::memory_order_relaxed);
+    statistics.numDroppedNewest = m_numDroppedNewest.load(std::memory_order_relaxed);
+    statistics.numBlocked = m_numBlocked.load(std::memory_order_relaxed);
+    return statistics;
+}
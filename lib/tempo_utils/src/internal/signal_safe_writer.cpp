@@ -0,0 +1,145 @@
+
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
+
+#include <tempo_utils/internal/signal_safe_writer.h>
+
+tempo_utils::internal::SignalSafeWriter::SignalSafeWriter(int fd)
+    : m_fd(fd),
+      m_size(0)
+{
+}
+
+tempo_utils::internal::SignalSafeWriter::~SignalSafeWriter()
+{
+    flush();
+}
+
+tempo_utils::internal::SignalSafeWriter&
+tempo_utils::internal::SignalSafeWriter::append(std::string_view str)
+{
+    while (!str.empty()) {
+        if (m_size == sizeof(m_buffer)) {
+            flush();
+        }
+        auto count = std::min(str.size(), sizeof(m_buffer) - m_size);
+        for (size_t i = 0; i < count; i++) {
+            m_buffer[m_size++] = str[i];
+        }
+        str.remove_prefix(count);
+    }
+    return *this;
+}
+
+tempo_utils::internal::SignalSafeWriter&
+tempo_utils::internal::SignalSafeWriter::appendUnsigned(tu_uint64 u64, int minWidth)
+{
+    char digits[20];
+    int ndigits = 0;
+    do {
+        digits[ndigits++] = static_cast<char>('0' + (u64 % 10));
+        u64 /= 10;
+    } while (u64 > 0);
+    for (int i = ndigits; i < minWidth; i++) {
+        append("0");
+    }
+    char reversed[20];
+    for (int i = 0; i < ndigits; i++) {
+        reversed[i] = digits[ndigits - i - 1];
+    }
+    return append(std::string_view(reversed, ndigits));
+}
+
+tempo_utils::internal::SignalSafeWriter&
+tempo_utils::internal::SignalSafeWriter::appendSigned(tu_int64 i64)
+{
+    if (i64 < 0) {
+        append("-");
+        return appendUnsigned(static_cast<tu_uint64>(-(i64 + 1)) + 1);
+    }
+    return appendUnsigned(static_cast<tu_uint64>(i64));
+}
+
+tempo_utils::internal::SignalSafeWriter&
+tempo_utils::internal::SignalSafeWriter::appendHex(tu_uint64 u64, int minWidth)
+{
+    constexpr const char *kHexDigits = "0123456789abcdef";
+    char digits[16];
+    int ndigits = 0;
+    do {
+        digits[ndigits++] = kHexDigits[u64 & 0xF];
+        u64 >>= 4;
+    } while (u64 > 0);
+    for (int i = ndigits; i < minWidth; i++) {
+        append("0");
+    }
+    char reversed[16];
+    for (int i = 0; i < ndigits; i++) {
+        reversed[i] = digits[ndigits - i - 1];
+    }
+    return append(std::string_view(reversed, ndigits));
+}
+
+/**
+ * Append the timestamp in UTC using the form YYYY-MM-DDTHH:MM:SS.uuuuuuZ. The civil date is
+ * computed directly, because gmtime and the absl time functions are not async-signal-safe.
+ */
+tempo_utils::internal::SignalSafeWriter&
+tempo_utils::internal::SignalSafeWriter::appendTimestamp(tu_int64 nanosSinceEpoch)
+{
+    auto seconds = nanosSinceEpoch / 1000000000;
+    auto micros = (nanosSinceEpoch % 1000000000) / 1000;
+    if (micros < 0) {
+        seconds -= 1;
+        micros += 1000000;
+    }
+    auto days = seconds / 86400;
+    auto secondOfDay = seconds % 86400;
+    if (secondOfDay < 0) {
+        days -= 1;
+        secondOfDay += 86400;
+    }
+
+    // convert days since the unix epoch to a civil date in the proleptic gregorian calendar
+    auto z = days + 719468;
+    auto era = (z >= 0? z : z - 146096) / 146097;
+    auto doe = z - era * 146097;
+    auto yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    auto doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    auto mp = (5 * doy + 2) / 153;
+    auto day = doy - (153 * mp + 2) / 5 + 1;
+    auto month = mp < 10? mp + 3 : mp - 9;
+    auto year = yoe + era * 400 + (month <= 2? 1 : 0);
+
+    appendSigned(year);
+    append("-");
+    appendUnsigned(month, 2);
+    append("-");
+    appendUnsigned(day, 2);
+    append("T");
+    appendUnsigned(secondOfDay / 3600, 2);
+    append(":");
+    appendUnsigned((secondOfDay % 3600) / 60, 2);
+    append(":");
+    appendUnsigned(secondOfDay % 60, 2);
+    append(".");
+    appendUnsigned(micros, 6);
+    return append("Z");
+}
+
+void
+tempo_utils::internal::SignalSafeWriter::flush()
+{
+    size_t offset = 0;
+    while (offset < m_size) {
+        auto ret = ::write(m_fd, m_buffer + offset, m_size - offset);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        offset += ret;
+    }
+    m_size = 0;
+}
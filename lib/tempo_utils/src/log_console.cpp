@@ -4,8 +4,7 @@
 tempo_utils::LogStdout::~LogStdout()
 {
     if (m_severity == LogSeverity::kConsoleStdout) {
-        auto log = std::move(*buffer.rdbuf());
-        if (!write_console(m_severity, log.str()))
+        if (!write_console(m_severity, view()))
             std::abort();
     }
 }
@@ -13,8 +12,7 @@ tempo_utils::LogStdout::~LogStdout()
 tempo_utils::LogStderr::~LogStderr()
 {
     if (m_severity == LogSeverity::kConsoleStderr) {
-        auto log = std::move(*buffer.rdbuf());
-        if (!write_console(m_severity, log.str()))
+        if (!write_console(m_severity, view()))
             std::abort();
     }
 }
\ No newline at end of file
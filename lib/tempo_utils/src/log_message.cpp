@@ -1,22 +1,111 @@
 
+#include <algorithm>
+#include <vector>
+
 #include <absl/time/clock.h>
 
+#include <tempo_utils/fast_clock.h>
 #include <tempo_utils/log_message.h>
 
+// buffers which have grown beyond this capacity are freed rather than returned to the pool
+constexpr size_t kMaxPooledBufferCapacity = 64 * 1024;
+
+// maximum number of free buffers retained per thread
+constexpr size_t kMaxPooledBuffers = 8;
+
+namespace {
+    // set when the pool for the current thread has been destroyed, after which buffers are
+    // allocated and freed directly (i.e. when logging from a static destructor)
+    thread_local bool logBufferPoolDestroyed = false;
+
+    struct LogBufferPool {
+        std::vector<fmt::memory_buffer *> buffers;
+        ~LogBufferPool() {
+            for (auto *buffer : buffers) {
+                delete buffer;
+            }
+            logBufferPoolDestroyed = true;
+        }
+    };
+
+    thread_local LogBufferPool logBufferPool;
+}
+
+static fmt::memory_buffer *
+acquire_log_buffer()
+{
+    if (logBufferPoolDestroyed || logBufferPool.buffers.empty())
+        return new fmt::memory_buffer();
+    auto *buffer = logBufferPool.buffers.back();
+    logBufferPool.buffers.pop_back();
+    return buffer;
+}
+
+static void
+release_log_buffer(fmt::memory_buffer *buffer)
+{
+    if (logBufferPoolDestroyed || logBufferPool.buffers.size() >= kMaxPooledBuffers
+        || buffer->capacity() > kMaxPooledBufferCapacity) {
+        delete buffer;
+        return;
+    }
+    buffer->clear();
+    logBufferPool.buffers.push_back(buffer);
+}
+
+tempo_utils::LogMessage::~LogMessage()
+{
+    if (m_buffer != nullptr) {
+        release_log_buffer(m_buffer);
+    }
+}
+
 tempo_utils::LogMessage::LogMessage(LogMessage &&other) noexcept
 {
-    buffer = std::move(other.buffer);
+    m_buffer = other.m_buffer;
+    other.m_buffer = nullptr;
 }
 
 tempo_utils::LogMessage&
 tempo_utils::LogMessage::operator=(LogMessage &&other) noexcept
 {
     if (this != &other) {
-        buffer = std::move(other.buffer);
+        if (m_buffer != nullptr) {
+            release_log_buffer(m_buffer);
+        }
+        m_buffer = other.m_buffer;
+        other.m_buffer = nullptr;
     }
     return *this;
 }
 
+fmt::memory_buffer&
+tempo_utils::LogMessage::getBuffer()
+{
+    if (m_buffer == nullptr) {
+        m_buffer = acquire_log_buffer();
+    }
+    return *m_buffer;
+}
+
+void
+tempo_utils::LogMessage::append(std::string_view str)
+{
+    getBuffer().append(str.data(), str.data() + str.size());
+}
+
+/**
+ * Return a view of the message contents. The view is invalidated when the message is appended
+ * to or destroyed.
+ */
+std::string_view
+tempo_utils::LogMessage::view() const
+{
+    if (m_buffer == nullptr)
+        return {};
+    return std::string_view(m_buffer->data(), m_buffer->size());
+}
+
 tempo_utils::LogToString::LogToString(std::string *output)
     : LogMessage(),
       m_output(output)
@@ -25,6 +114,7 @@ tempo_utils::LogToString::LogToString(std::string *output)
 }
 
 tempo_utils::LogToString::LogToString(LogToString &&other) noexcept
+    : LogMessage(std::move(other))
 {
     m_output = other.m_output;
     other.m_output = nullptr;
@@ -32,13 +122,16 @@ tempo_utils::LogToString::LogToString(LogToString &&other) noexcept
 
 tempo_utils::LogToString::~LogToString()
 {
-    m_output->append(buffer.str());
+    if (m_output != nullptr) {
+        m_output->append(view());
+    }
 }
 
 tempo_utils::LogToString&
 tempo_utils::LogToString::operator=(LogToString &&other) noexcept
 {
     if (this != &other) {
+        LogMessage::operator=(std::move(other));
         m_output = other.m_output;
         other.m_output = nullptr;
     }
@@ -52,7 +145,7 @@ tempo_utils::ConditionalLogMessage::ConditionalLogMessage(char const *filePath,
       m_severity(severity),
       m_category(nullptr),
       m_enabled(enabled),
-      m_ts(absl::Now())
+      m_ts(enabled? absl::Now() : absl::InfinitePast())
 {
 }
 
@@ -68,7 +161,7 @@ tempo_utils::ConditionalLogMessage::ConditionalLogMessage(
       m_severity(severity),
       m_category(category),
       m_enabled(enabled),
-      m_ts(absl::Now())
+      m_ts(enabled? absl::Now() : absl::InfinitePast())
 {
 }
 
@@ -76,6 +169,7 @@ tempo_utils::ConditionalLogMessage&
 tempo_utils::ConditionalLogMessage::operator=(ConditionalLogMessage &&other) noexcept
 {
     if (this != &other) {
+        LogMessage::operator=(std::move(other));
         m_filePath = other.m_filePath;
         m_lineNr = other.m_lineNr;
         m_severity = other.m_severity;
@@ -89,8 +183,7 @@ tempo_utils::ConditionalLogMessage::operator=(ConditionalLogMessage &&other) noe
 tempo_utils::ConditionalLogMessage::~ConditionalLogMessage()
 {
     if (m_enabled) {
-        auto log = std::move(*buffer.rdbuf());
-        write_log(m_ts, m_severity, m_filePath, m_lineNr, log.str());
+        write_log(m_ts, m_severity, m_filePath, m_lineNr, view());
         if (m_severity == LogSeverity::kFatal)
             std::abort();
     }
@@ -101,6 +194,15 @@ tempo_utils::LogVerbose::LogVerbose(char const *filePath, int lineNr, bool enabl
 {
 }
 
+tempo_utils::LogVerbose::LogVerbose(
+    char const *filePath,
+    int lineNr,
+    LogCategory const *category,
+    bool enabled)
+    : ConditionalLogMessage(filePath, lineNr, LogSeverity::kVerbose, category, enabled)
+{
+}
+
 tempo_utils::LogVerbose::~LogVerbose()
 {
 }
@@ -110,6 +212,15 @@ tempo_utils::LogVeryVerbose::LogVeryVerbose(char const *filePath, int lineNr, bo
 {
 }
 
+tempo_utils::LogVeryVerbose::LogVeryVerbose(
+    char const *filePath,
+    int lineNr,
+    LogCategory const *category,
+    bool enabled)
+    : ConditionalLogMessage(filePath, lineNr, LogSeverity::kVeryVerbose, category, enabled)
+{
+}
+
 tempo_utils::LogVeryVerbose::~LogVeryVerbose()
 {
 }
@@ -118,10 +229,68 @@ tempo_utils::LogAssert::LogAssert(char const *assertCode, char const *filePath,
     : ConditionalLogMessage(filePath, lineNr, LogSeverity::kFatal, enabled)
 {
     if (m_enabled) {
-        buffer << "ASSERT FAILED: " << assertCode;
+        append("ASSERT FAILED: ");
+        append(assertCode);
     }
 }
 
 tempo_utils::LogAssert::~LogAssert()
 {
-}
\ No newline at end of file
+}
+
+/**
+ * Admit the message if at least `period` has elapsed since the last admitted message.
+ */
+tempo_utils::LogAdmission
+tempo_utils::LogEveryT::admit(absl::Duration period)
+{
+    auto now = FastClock::nanosSinceEpoch();
+    auto next = m_nextNanos.load(std::memory_order_relaxed);
+    // only one thread can advance the deadline, every other thread is suppressed
+    if (now < next || !m_nextNanos.compare_exchange_strong(next,
+            now + absl::ToInt64Nanoseconds(period), std::memory_order_relaxed)) {
+        m_suppressed.fetch_add(1, std::memory_order_relaxed);
+        return {};
+    }
+    return {true, m_suppressed.exchange(0, std::memory_order_relaxed)};
+}
+
+/**
+ * Admit the message if the bucket contains a token. Each admitted message pushes the
+ * theoretical arrival time forward by the emission interval, and a message is admitted as
+ * long as the theoretical arrival time is no more than `burst` intervals in the future.
+ */
+tempo_utils::LogAdmission
+tempo_utils::LogTokenBucket::admit(double perSecond, int burst)
+{
+    if (perSecond <= 0) {
+        m_suppressed.fetch_add(1, std::memory_order_relaxed);
+        return {};
+    }
+    auto interval = static_cast<tu_int64>(1e9 / perSecond);
+    auto limit = interval * std::max(burst, 1);
+    auto now = FastClock::nanosSinceEpoch();
+    auto tat = m_theoreticalArrivalNanos.load(std::memory_order_relaxed);
+    for (;;) {
+        auto next = std::max(tat, now) + interval;
+        if (next - now > limit) {
+            m_suppressed.fetch_add(1, std::memory_order_relaxed);
+            return {};
+        }
+        if (m_theoreticalArrivalNanos.compare_exchange_weak(tat, next, std::memory_order_relaxed))
+            break;
+    }
+    return {true, m_suppressed.exchange(0, std::memory_order_relaxed)};
+}
+
+/**
+ * Prefix the message with the number of suppressed messages, if any were suppressed.
+ */
+tempo_utils::LogMessage&&
+tempo_utils::operator<<(LogMessage &&message, const LogAdmission &admission)
+{
+    if (admission.suppressed > 0) {
+        message.appendFormat("[{} messages suppressed] ", admission.suppressed);
+    }
+    return std::move(message);
+}
@@ -1,7 +1,16 @@
 
+#include <algorithm>
+#include <climits>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
 #include <absl/strings/str_cat.h>
 #include <boost/circular_buffer.hpp>
 
+#include <tempo_utils/binary_log.h>
 #include <tempo_utils/log_sink.h>
 #include <tempo_utils/posix_result.h>
 
@@ -110,4 +119,381 @@ tempo_utils::LogFileSink::closeSink()
         std::fclose(m_sink);
         m_sink = nullptr;
     }
-}
\ No newline at end of file
+}
+
+tempo_utils::RotatingLogFileSink::RotatingLogFileSink(
+    const std::filesystem::path &logFilePath,
+    const RotatingLogFileOptions &options)
+    : m_logFilePath(logFilePath),
+      m_options(options),
+      m_numSubmitted(0),
+      m_numWritten(0),
+      m_running(false),
+      m_fd(-1),
+      m_fileSize(0)
+{
+    TU_ASSERT (m_options.bufferSize > 0);
+    TU_ASSERT (m_options.maxPendingBuffers > 0);
+    TU_ASSERT (m_options.maxRetainedFiles >= 0);
+}
+
+tempo_utils::RotatingLogFileSink::~RotatingLogFileSink()
+{
+    RotatingLogFileSink::closeSink();
+}
+
+tempo_utils::Status
+tempo_utils::RotatingLogFileSink::openFile()
+{
+    m_fd = ::open(m_logFilePath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (m_fd < 0)
+        return PosixStatus::last("failed to open log file");
+    struct stat st;
+    m_fileSize = ::fstat(m_fd, &st) == 0? st.st_size : 0;
+    m_fileOpened = absl::Now();
+    return {};
+}
+
+tempo_utils::Status
+tempo_utils::RotatingLogFileSink::openSink()
+{
+    std::lock_guard lock(m_lock);
+    if (m_running)
+        return {};
+    // open the file before starting the writer thread so that errors are reported to the caller
+    TU_RETURN_IF_NOT_OK (openFile());
+    m_current.reserve(m_options.bufferSize);
+    m_running = true;
+    m_thread = std::thread(&RotatingLogFileSink::runWriter, this);
+    return {};
+}
+
+/**
+ * Hand the current buffer to the writer thread. Must be called while holding the lock. If no
+ * written buffer can be recycled then the new buffer starts empty and grows as messages are
+ * appended, so flushing small buffers does not allocate a full buffer each time.
+ */
+void
+tempo_utils::RotatingLogFileSink::submitUnlocked()
+{
+    if (m_current.empty())
+        return;
+    m_pending.push_back(std::move(m_current));
+    if (!m_free.empty()) {
+        m_current = std::move(m_free.back());
+        m_free.pop_back();
+    } else {
+        m_current = std::string();
+    }
+    m_numSubmitted++;
+    m_pendingCond.notify_one();
+}
+
+/**
+ * Block until the writer thread has fewer than the maximum number of pending buffers. Must be
+ * called while holding the lock.
+ */
+void
+tempo_utils::RotatingLogFileSink::waitForPendingUnlocked(std::unique_lock<std::mutex> &lock)
+{
+    m_writtenCond.wait(lock, [&]{
+        return m_pending.size() < static_cast<size_t>(m_options.maxPendingBuffers);
+    });
+}
+
+void
+tempo_utils::RotatingLogFileSink::writeLog(
+    const absl::Time &ts,
+    LogSeverity severity,
+    const char *filePath,
+    int lineNr,
+    std::string_view message)
+{
+    std::unique_lock lock(m_lock);
+    if (!m_running)
+        return;
+
+    if (m_options.displayShortForm) {
+        absl::StrAppend(&m_current, message, "\n");
+    } else {
+        absl::StrAppend(&m_current,
+            absl::FormatTime("%Y-%m-%d%ET%H:%M:%E6S%Ez", ts, absl::UTCTimeZone()),
+            " ", log_severity_name(severity),
+            " ", filePath, ":", lineNr,
+            " ", message, "\n");
+    }
+
+    if (severity == LogSeverity::kFatal) {
+        // the process is about to abort, so wait until every buffered message is written
+        submitUnlocked();
+        auto target = m_numSubmitted;
+        m_writtenCond.wait(lock, [&]{ return m_numWritten >= target; });
+        return;
+    }
+
+    if (m_current.size() >= m_options.bufferSize) {
+        // apply backpressure if the writer thread has fallen behind
+        waitForPendingUnlocked(lock);
+        submitUnlocked();
+    }
+}
+
+void
+tempo_utils::RotatingLogFileSink::flushSink()
+{
+    std::unique_lock lock(m_lock);
+    if (!m_running || m_current.empty())
+        return;
+    waitForPendingUnlocked(lock);
+    submitUnlocked();
+}
+
+/**
+ * Returns the number of buffers waiting to be written by the writer thread.
+ */
+int
+tempo_utils::RotatingLogFileSink::numPendingBuffers()
+{
+    std::lock_guard lock(m_lock);
+    return static_cast<int>(m_pending.size());
+}
+
+void
+tempo_utils::RotatingLogFileSink::closeSink()
+{
+    {
+        std::lock_guard lock(m_lock);
+        if (!m_running)
+            return;
+        submitUnlocked();
+        m_running = false;
+        m_pendingCond.notify_one();
+    }
+    m_thread.join();
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+/**
+ * Writer thread loop. Waits for submitted buffers or for the flush interval to elapse, then
+ * writes every pending buffer with as few writev(2) calls as possible and rotates the file
+ * if necessary. The lock is not held while writing or rotating.
+ */
+void
+tempo_utils::RotatingLogFileSink::runWriter()
+{
+    std::vector<std::string> buffers;
+    std::unique_lock lock(m_lock);
+
+    for (;;) {
+        auto woken = m_pendingCond.wait_for(lock, absl::ToChronoNanoseconds(m_options.flushInterval),
+            [&]{ return !m_pending.empty() || !m_running; });
+        // the flush interval elapsed, so write the partially filled buffer
+        if (!woken) {
+            submitUnlocked();
+        }
+        if (m_pending.empty() && !m_running)
+            break;
+
+        buffers.swap(m_pending);
+        auto target = m_numSubmitted;
+        lock.unlock();
+
+        writeBuffers(buffers);
+        if (needsRotation()) {
+            rotateFile();
+        }
+
+        lock.lock();
+        m_numWritten = target;
+        // recycle the written buffers so that writers do not allocate a new buffer each time
+        for (auto &buffer : buffers) {
+            if (m_free.size() >= static_cast<size_t>(m_options.maxPendingBuffers))
+                break;
+            buffer.clear();
+            m_free.push_back(std::move(buffer));
+        }
+        buffers.clear();
+        m_writtenCond.notify_all();
+    }
+
+    m_writtenCond.notify_all();
+}
+
+void
+tempo_utils::RotatingLogFileSink::writeBuffers(std::vector<std::string> &buffers)
+{
+    // if the file could not be reopened after rotation then try again before dropping the buffers
+    if (m_fd < 0 && !openFile().isOk())
+        return;
+
+    std::vector<struct iovec> iov;
+    iov.reserve(buffers.size());
+    for (auto &buffer : buffers) {
+        if (!buffer.empty()) {
+            iov.push_back({buffer.data(), buffer.size()});
+        }
+    }
+
+    size_t index = 0;
+    while (index < iov.size()) {
+        auto count = std::min<size_t>(iov.size() - index, IOV_MAX);
+        auto ret = ::writev(m_fd, &iov[index], static_cast<int>(count));
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        m_fileSize += ret;
+        // advance past the written bytes, which may end partway through a buffer
+        auto remaining = static_cast<size_t>(ret);
+        while (index < iov.size() && remaining >= iov[index].iov_len) {
+            remaining -= iov[index].iov_len;
+            index++;
+        }
+        if (remaining > 0) {
+            iov[index].iov_base = static_cast<char *>(iov[index].iov_base) + remaining;
+            iov[index].iov_len -= remaining;
+        }
+    }
+}
+
+bool
+tempo_utils::RotatingLogFileSink::needsRotation() const
+{
+    if (m_fd < 0 || m_fileSize == 0)
+        return false;
+    if (m_options.maxFileSize > 0 && m_fileSize >= m_options.maxFileSize)
+        return true;
+    if (m_options.maxFileAge > absl::ZeroDuration() && absl::Now() - m_fileOpened >= m_options.maxFileAge)
+        return true;
+    return false;
+}
+
+void
+tempo_utils::RotatingLogFileSink::rotateFile()
+{
+    ::close(m_fd);
+    m_fd = -1;
+
+    // shift each retained file up by one, which replaces the oldest retained file
+    auto rotatedPath = [this](int n) {
+        return absl::StrCat(m_logFilePath.string(), ".", n);
+    };
+    if (m_options.maxRetainedFiles > 0) {
+        for (int i = m_options.maxRetainedFiles - 1; i > 0; i--) {
+            ::rename(rotatedPath(i).c_str(), rotatedPath(i + 1).c_str());
+        }
+        ::rename(m_logFilePath.c_str(), rotatedPath(1).c_str());
+    } else {
+        ::unlink(m_logFilePath.c_str());
+    }
+
+    openFile();
+}
+
+tempo_utils::BinaryLogFileSink::BinaryLogFileSink(const std::filesystem::path &logFilePath)
+    : m_logFilePath(logFilePath),
+      m_sink(nullptr)
+{
+}
+
+tempo_utils::BinaryLogFileSink::~BinaryLogFileSink()
+{
+    BinaryLogFileSink::closeSink();
+}
+
+tempo_utils::Status
+tempo_utils::BinaryLogFileSink::openSink()
+{
+    m_sink = std::fopen(m_logFilePath.c_str(), "w+");
+    if (m_sink == nullptr)
+        return PosixStatus::last("failed to open binary log file");
+    m_writtenSites.clear();
+
+    std::string_view magic(kBinaryLogMagic);
+    std::fwrite(magic.data(), magic.size(), 1, m_sink);
+    std::fwrite(&kBinaryLogVersion, sizeof(kBinaryLogVersion), 1, m_sink);
+    return {};
+}
+
+template<typename T>
+static void
+append_value(std::string &record, const T &value)
+{
+    record.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+static void
+append_string(std::string &record, std::string_view str)
+{
+    append_value(record, static_cast<tu_uint32>(str.size()));
+    record.append(str.data(), str.size());
+}
+
+void
+tempo_utils::BinaryLogFileSink::writeLog(
+    const absl::Time &ts,
+    LogSeverity severity,
+    const char *filePath,
+    int lineNr,
+    std::string_view message)
+{
+    m_record.clear();
+    append_value(m_record, BinaryLogRecordType::kText);
+    append_value(m_record, static_cast<tu_uint8>(severity));
+    append_value(m_record, static_cast<tu_int64>(absl::ToUnixNanos(ts)));
+    append_value(m_record, static_cast<tu_int32>(lineNr));
+    append_string(m_record, filePath);
+    append_string(m_record, message);
+    std::fwrite(m_record.data(), m_record.size(), 1, m_sink);
+}
+
+bool
+tempo_utils::BinaryLogFileSink::writeBinaryLog(
+    const absl::Time &ts,
+    const BinaryLogSite *site,
+    std::string_view args)
+{
+    auto siteId = site->siteId.load(std::memory_order_acquire);
+    m_record.clear();
+
+    // write the site descriptor the first time the site appears in the file
+    if (m_writtenSites.size() <= siteId) {
+        m_writtenSites.resize(siteId + 1);
+    }
+    if (!m_writtenSites[siteId]) {
+        append_value(m_record, BinaryLogRecordType::kSite);
+        append_value(m_record, siteId);
+        append_value(m_record, static_cast<tu_uint8>(site->severity));
+        append_value(m_record, static_cast<tu_int32>(site->lineNr));
+        append_string(m_record, site->filePath);
+        append_string(m_record, site->format);
+        m_writtenSites[siteId] = true;
+    }
+
+    append_value(m_record, BinaryLogRecordType::kEvent);
+    append_value(m_record, siteId);
+    append_value(m_record, static_cast<tu_int64>(absl::ToUnixNanos(ts)));
+    append_string(m_record, args);
+    std::fwrite(m_record.data(), m_record.size(), 1, m_sink);
+    return true;
+}
+
+void
+tempo_utils::BinaryLogFileSink::flushSink()
+{
+    std::fflush(m_sink);
+}
+
+void
+tempo_utils::BinaryLogFileSink::closeSink()
+{
+    if (m_sink) {
+        std::fflush(m_sink);
+        std::fclose(m_sink);
+        m_sink = nullptr;
+    }
+}
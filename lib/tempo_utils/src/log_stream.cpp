@@ -12,7 +12,7 @@
  */
 tempo_utils::LogMessage&& tempo_utils::operator<<(LogMessage &&message, const char *str)
 {
-    message.buffer << str;
+    message.append(str);
     return std::move(message);
 }
 
@@ -25,85 +25,85 @@ tempo_utils::LogMessage&& tempo_utils::operator<<(LogMessage &&message, const ch
  */
 tempo_utils::LogMessage&& tempo_utils::operator<<(LogMessage &&message, const std::string &str)
 {
-    message.buffer << str;
+    message.append(str);
     return std::move(message);
 }
 
 tempo_utils::LogMessage&& tempo_utils::operator<<(LogMessage &&message, std::string_view view)
 {
-    message.buffer << view;
+    message.append(view);
     return std::move(message);
 }
 
 tempo_utils::LogMessage&& tempo_utils::operator<<(LogMessage &&message, const void *p)
 {
-    message.buffer << absl::Substitute("$0", p);
+    message.append(absl::Substitute("$0", p));
     return std::move(message);
 }
 
 tempo_utils::LogMessage&& tempo_utils::operator<<(LogMessage &&message, tu_int16 i16)
 {
-    message.buffer << i16;
+    message.appendFormat("{}", i16);
     return std::move(message);
 }
 
 tempo_utils::LogMessage&& tempo_utils::operator<<(LogMessage &&message, tu_uint16 u16)
 {
-    message.buffer << u16;
+    message.appendFormat("{}", u16);
     return std::move(message);
 }
 
 tempo_utils::LogMessage&& tempo_utils::operator<<(LogMessage &&message, tu_int32 i32)
 {
-    message.buffer << i32;
+    message.appendFormat("{}", i32);
     return std::move(message);
 }
 
 tempo_utils::LogMessage&& tempo_utils::operator<<(LogMessage &&message, tu_uint32 u32)
 {
-    message.buffer << u32;
+    message.appendFormat("{}", u32);
     return std::move(message);
 }
 
 tempo_utils::LogMessage&& tempo_utils::operator<<(LogMessage &&message, tu_int64 i64)
 {
-    message.buffer << i64;
+    message.appendFormat("{}", i64);
     return std::move(message);
 }
 
 tempo_utils::LogMessage&& tempo_utils::operator<<(LogMessage &&message, tu_uint64 u64)
 {
-    message.buffer << u64;
+    message.appendFormat("{}", u64);
     return std::move(message);
 }
 
 tempo_utils::LogMessage&& tempo_utils::operator<<(LogMessage &&message, float flt)
 {
-    message.buffer << flt;
+    message.appendFormat("{:g}", flt);
     return std::move(message);
 }
 
 tempo_utils::LogMessage&& tempo_utils::operator<<(LogMessage &&message, double dbl)
 {
-    message.buffer << dbl;
+    message.appendFormat("{:g}", dbl);
     return std::move(message);
 }
 
 tempo_utils::LogMessage&& tempo_utils::operator<<(LogMessage &&message, bool b)
 {
-    message.buffer << (b? "true" : "false");
+    message.append(b? "true" : "false");
     return std::move(message);
 }
 
 tempo_utils::LogMessage&& tempo_utils::operator<<(LogMessage &&message, const absl::Dec &dec)
 {
-    message.buffer << absl::StrCat(dec);
+    message.append(absl::StrCat(dec));
     return std::move(message);
 }
 
 tempo_utils::LogMessage&& tempo_utils::operator<<(LogMessage &&message, const absl::Hex &hex)
 {
-    message.buffer << absl::StrCat(hex);
+    message.append(absl::StrCat(hex));
     return std::move(message);
 }
 
@@ -1,8 +1,15 @@
 
+#include <atomic>
 #include <chrono>
 #include <iostream>
 #include <mutex>
+#include <thread>
 
+#include <tempo_utils/binary_log.h>
+#include <tempo_utils/fast_clock.h>
+#include <tempo_utils/fault_handler.h>
+#include <tempo_utils/flight_recorder.h>
+#include <tempo_utils/internal/async_log_queue.h>
 #include <tempo_utils/internal/circular_log_buffer.h>
 #include <tempo_utils/logging.h>
 #include <tempo_utils/log_sink.h>
@@ -17,6 +24,61 @@ static tempo_utils::LoggingConfiguration currentConfiguration = {
 static std::unique_ptr<tempo_utils::internal::CircularLogBuffer> initialBuffer;
 static std::unique_ptr<tempo_utils::AbstractLogSink> currentSink;
 static bool loggingFinished = false;
+static std::atomic<tu_uint64> numLockTimeouts = 0;
+
+// before logging is initialized every message is buffered, so every severity starts enabled
+std::atomic<tu_uint32> tempo_utils::internal::enabledSeverityMask = tempo_utils::kAllLogSeveritiesMask;
+
+// the enabled severity mask is the union of the severities which pass the sink filter and the
+// severities which are captured by the flight recorder, so each is also tracked separately. the
+// flight recorder captures every message which passes the sink filter, plus any severities
+// enabled by the flight recorder filter.
+static std::atomic<tu_uint32> sinkSeverityMask = tempo_utils::kAllLogSeveritiesMask;
+static std::atomic<tu_uint32> flightRecorderMask =
+    tempo_utils::log_severity_mask(tempo_utils::SeverityFilter::kDefault);
+
+// registered log categories. the category lock is separate from the global lock because
+// categories are registered during static initialization, and std::mutex is constant-initialized.
+static std::mutex categoryLock;
+static tempo_utils::LogCategory *categoryList = nullptr;
+static tu_uint32 categorySeverityMask = tempo_utils::kAllLogSeveritiesMask;
+
+/**
+ * Update the severity masks checked at each log site. Must be called while holding the global lock.
+ */
+static void
+set_enabled_severity_mask(tu_uint32 sinkMask, tu_uint32 recorderMask)
+{
+    sinkSeverityMask.store(sinkMask, std::memory_order_relaxed);
+    flightRecorderMask.store(recorderMask, std::memory_order_relaxed);
+    auto mask = sinkMask | recorderMask;
+    tempo_utils::internal::enabledSeverityMask.store(mask, std::memory_order_relaxed);
+    tempo_utils::LogCategory::updateAllCategories(mask);
+}
+
+// when async logging is enabled, writers enqueue into the current queue without taking the
+// global lock. activeWriters counts writers which may hold a pointer to the queue, so that the
+// queue is only destroyed once no writer can observe it.
+static std::atomic<tempo_utils::internal::AsyncLogQueue *> currentQueue = nullptr;
+static std::atomic<int> activeWriters = 0;
+
+/**
+ * Detach the current async queue (if any), then drain it and stop the flusher thread. Must be
+ * called while holding the global lock.
+ */
+static void
+stop_async_queue()
+{
+    auto *queue = currentQueue.exchange(nullptr, std::memory_order_seq_cst);
+    if (queue == nullptr)
+        return;
+    // wait for writers which loaded the queue pointer before it was detached
+    while (activeWriters.load(std::memory_order_seq_cst) > 0) {
+        std::this_thread::yield();
+    }
+    queue->shutdown();
+    delete queue;
+}
 
 /**
  * Initialize logging with the given configuration and sink.
@@ -32,8 +94,20 @@ tempo_utils::init_logging(
     const LoggingConfiguration &config,
     std::unique_ptr<AbstractLogSink> &&logSink)
 {
+    // calibrate the fast clock used by the rate limited log helpers now, rather than on the
+    // first rate limited log call
+    FastClock::calibrate();
+
     std::lock_guard lock(globalLock);
+    // install the fault handler before any logging state is changed, so a failure leaves logging
+    // uninitialized and init_logging may be retried
+    if (config.installFaultHandler && !install_fault_handler())
+        return GenericStatus::forCondition(GenericCondition::kInternalViolation,
+            "failed to install fault handler");
+    stop_async_queue();
     currentConfiguration = config;
+    auto sinkMask = log_severity_mask(config.severityFilter);
+    set_enabled_severity_mask(sinkMask, sinkMask | log_severity_mask(config.flightRecorderFilter));
     if (currentSink) {
         currentSink.reset();
     }
@@ -44,6 +118,12 @@ tempo_utils::init_logging(
         initialBuffer.reset();
     }
     currentSink = std::move(logSink);
+    if (config.asyncLogging) {
+        auto *queue = new internal::AsyncLogQueue(currentSink.get(), config.asyncQueueSize,
+            config.asyncQueuePolicy, config.flushEveryMessage);
+        queue->start();
+        currentQueue.store(queue, std::memory_order_seq_cst);
+    }
     return {};
 }
 
@@ -79,7 +159,26 @@ tempo_utils::get_logging_configuration()
 }
 
 /**
- * Clean up logging resources.
+ * Return counters describing the async logging queue and dropped messages.
+ *
+ * @return The logging statistics.
+ */
+tempo_utils::LoggingStatistics
+tempo_utils::get_logging_statistics()
+{
+    std::lock_guard lock(globalLock);
+    LoggingStatistics statistics;
+    auto *queue = currentQueue.load(std::memory_order_seq_cst);
+    if (queue != nullptr) {
+        statistics = queue->getStatistics();
+    }
+    statistics.numLockTimeouts = numLockTimeouts.load(std::memory_order_relaxed);
+    return statistics;
+}
+
+/**
+ * Clean up logging resources. If async logging is enabled then any queued messages are
+ * written to the sink before the sink is released.
  *
  * @return true if cleanup succeeds, otherwise false upon failure. As a special case,
  *   if initialization has already run, then this function does nothing and returns true.
@@ -88,14 +187,41 @@ bool
 tempo_utils::cleanup_logging(bool finished)
 {
     std::lock_guard lock(globalLock);
+    stop_async_queue();
     currentSink.reset();
     loggingFinished = finished;
+    // if logging is finished then only fatal messages have any effect, otherwise every message
+    // is buffered until logging is initialized again. the flight recorder keeps recording either way.
+    set_enabled_severity_mask(finished? 1u << static_cast<int>(LogSeverity::kFatal) : kAllLogSeveritiesMask,
+        flightRecorderMask.load(std::memory_order_relaxed));
     return true;
 }
 
 tempo_utils::LogCategory::LogCategory(char const *category)
-    : m_category(category)
+    : m_category(category),
+      m_categoryMask(kAllLogSeveritiesMask),
+      m_prev(nullptr)
 {
+    std::lock_guard lock(categoryLock);
+    m_effectiveMask.store(categorySeverityMask, std::memory_order_relaxed);
+    m_next = categoryList;
+    if (m_next != nullptr) {
+        m_next->m_prev = this;
+    }
+    categoryList = this;
+}
+
+tempo_utils::LogCategory::~LogCategory()
+{
+    std::lock_guard lock(categoryLock);
+    if (m_prev != nullptr) {
+        m_prev->m_next = m_next;
+    } else {
+        categoryList = m_next;
+    }
+    if (m_next != nullptr) {
+        m_next->m_prev = m_prev;
+    }
 }
 
 const char *
@@ -105,27 +231,88 @@ tempo_utils::LogCategory::category() const
 }
 
 /**
- * Write a log message.
+ * Enable or disable messages in the category with the specified severity. A message which is
+ * enabled in the category is still subject to the global severity filter.
  *
- * @param ts Timestamp when the log event was generated.
- * @param severity The severity of the log event.
- * @param filePath Path to the file where the log event was generated.
- * @param lineNr Line number in where the log event was generated.
- * @param message The log message.
- * @return true if the log was written to a sink, otherwise false.
+ * @param severity The log severity.
+ * @param enabled true to enable messages with the severity, false to disable them.
  */
-bool
-tempo_utils::write_log(
+void
+tempo_utils::LogCategory::setEnabled(LogSeverity severity, bool enabled)
+{
+    std::lock_guard lock(categoryLock);
+    auto mask = m_categoryMask.load(std::memory_order_relaxed);
+    auto bit = 1u << static_cast<int>(severity);
+    mask = enabled? mask | bit : mask & ~bit;
+    m_categoryMask.store(mask, std::memory_order_relaxed);
+    m_effectiveMask.store(mask & categorySeverityMask, std::memory_order_relaxed);
+}
+
+/**
+ * Recompute the effective mask of every registered category from the specified global
+ * severity mask.
+ *
+ * @param severityMask The mask of severities which pass the global severity filter.
+ */
+void
+tempo_utils::LogCategory::updateAllCategories(tu_uint32 severityMask)
+{
+    std::lock_guard lock(categoryLock);
+    categorySeverityMask = severityMask;
+    for (auto *category = categoryList; category != nullptr; category = category->m_next) {
+        auto mask = category->m_categoryMask.load(std::memory_order_relaxed);
+        category->m_effectiveMask.store(mask & severityMask, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Write a log entry to the current queue or sink. If `site` is not nullptr then `message`
+ * contains the encoded arguments of a binary log event.
+ */
+static bool
+write_log_entry(
     const absl::Time &ts,
-    LogSeverity severity,
+    tempo_utils::LogSeverity severity,
     const char *filePath,
     int lineNr,
-    std::string_view message)
+    std::string_view message,
+    const tempo_utils::BinaryLogSite *site)
 {
+    using namespace tempo_utils;
+
+    auto severityBit = 1u << static_cast<int>(severity);
+
+    // record the message in the flight recorder before it is queued or written, so that it is
+    // captured even if the sink never receives it. binary log events record the format string,
+    // because formatting the arguments here would defeat the purpose of deferred formatting.
+    if (flightRecorderMask.load(std::memory_order_relaxed) & severityBit) {
+        record_flight_log(ts, severity, filePath, lineNr, site != nullptr? site->format : message);
+    }
+
+    // if the message was only enabled for the flight recorder then there is nothing else to do
+    if ((sinkSeverityMask.load(std::memory_order_relaxed) & severityBit) == 0)
+        return false;
+
+    // if async logging is enabled then enqueue the message without taking the global lock
+    activeWriters.fetch_add(1, std::memory_order_seq_cst);
+    auto *queue = currentQueue.load(std::memory_order_seq_cst);
+    if (queue != nullptr) {
+        bool written = queue->enqueue(ts, severity, filePath, lineNr, message, site);
+        // the process is about to abort, so make sure the fatal message reaches the sink
+        if (severity == LogSeverity::kFatal) {
+            queue->flush();
+        }
+        activeWriters.fetch_sub(1, std::memory_order_release);
+        return written;
+    }
+    activeWriters.fetch_sub(1, std::memory_order_release);
+
     std::chrono::duration<int, std::milli> timeout(100);
     std::unique_lock sink_lock(globalLock, timeout);
-    if (!sink_lock.owns_lock())
+    if (!sink_lock.owns_lock()) {
+        numLockTimeouts.fetch_add(1, std::memory_order_relaxed);
         return false;
+    }
 
     if (!currentSink) [[unlikely]] {
         // if logging is finished then there is nothing to do
@@ -135,33 +322,26 @@ tempo_utils::write_log(
         if (initialBuffer == nullptr) {
             initialBuffer = std::make_unique<internal::CircularLogBuffer>(128);
         }
-        // buffer the message
-        initialBuffer->bufferLog(ts, severity, filePath, lineNr, message);
+        // buffer the message. binary log events are formatted, because the sink which
+        // eventually receives the buffered messages may not record binary logs.
+        if (site != nullptr) {
+            initialBuffer->bufferLog(ts, severity, filePath, lineNr,
+                format_binary_log_message(site->format, message));
+        } else {
+            initialBuffer->bufferLog(ts, severity, filePath, lineNr, message);
+        }
         return true;
     }
 
-    switch (currentConfiguration.severityFilter) {
-        case SeverityFilter::kSilent:
-            if (severity != LogSeverity::kFatal) return false;
-            break;
-        case SeverityFilter::kErrorsOnly:
-            if (severity > LogSeverity::kError) return false;
-            break;
-        case SeverityFilter::kWarningsAndErrors:
-            if (severity > LogSeverity::kWarn) return false;
-            break;
-        case SeverityFilter::kDefault:
-            if (severity > LogSeverity::kInfo) return false;
-            break;
-        case SeverityFilter::kVerbose:
-            if (severity > LogSeverity::kVerbose) return false;
-            break;
-        case SeverityFilter::kVeryVerbose:
-            break;
-    }
+    if (!log_severity_enabled(currentConfiguration.severityFilter, severity))
+        return false;
 
     // write log to sink, and flush if requested
-    currentSink->writeLog(ts, severity, filePath, lineNr, message);
+    if (site != nullptr) {
+        internal::write_binary_log_to_sink(currentSink.get(), ts, site, message);
+    } else {
+        currentSink->writeLog(ts, severity, filePath, lineNr, message);
+    }
     if (currentConfiguration.flushEveryMessage) {
         currentSink->flushSink();
     }
@@ -169,6 +349,47 @@ tempo_utils::write_log(
     return true;
 }
 
+/**
+ * Write a log message.
+ *
+ * @param ts Timestamp when the log event was generated.
+ * @param severity The severity of the log event.
+ * @param filePath Path to the file where the log event was generated.
+ * @param lineNr Line number in where the log event was generated.
+ * @param message The log message.
+ * @return true if the log was written to a sink, otherwise false.
+ */
+bool
+tempo_utils::write_log(
+    const absl::Time &ts,
+    LogSeverity severity,
+    const char *filePath,
+    int lineNr,
+    std::string_view message)
+{
+    return write_log_entry(ts, severity, filePath, lineNr, message, nullptr);
+}
+
+/**
+ * Write a binary log event. The arguments are recorded without formatting if the sink supports
+ * binary logs, otherwise the message is formatted and written as text.
+ *
+ * @param ts Timestamp when the log event was generated.
+ * @param site The binary log site.
+ * @param args The encoded arguments of the log event.
+ * @return true if the log was written to a sink, otherwise false.
+ */
+bool
+tempo_utils::write_binary_log(
+    const absl::Time &ts,
+    BinaryLogSite *site,
+    std::string_view args)
+{
+    // assign the site id on the calling thread, so the sink only ever reads it
+    site->getSiteId();
+    return write_log_entry(ts, site->severity, site->filePath, site->lineNr, args, site);
+}
+
 /**
  * Write log to the console.
  *
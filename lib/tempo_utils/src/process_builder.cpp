@@ -183,13 +183,15 @@ tempo_utils::ProcessInvoker::toString() const
 tempo_utils::LogMessage&& tempo_utils::operator<<(LogMessage &&message, const ProcessInvoker &invoker)
 {
     if (invoker.isValid()) {
-        message.buffer << "ProcessInvoker(" << invoker.getArg(0);
+        message.append("ProcessInvoker(");
+        message.append(invoker.getArg(0));
         for (int i = 1; i < invoker.getArgc(); i++) {
-            message.buffer << " " << invoker.getArg(i);
+            message.append(" ");
+            message.append(invoker.getArg(i));
         }
-        message.buffer << ")";
+        message.append(")");
     } else {
-        message.buffer << "ProcessInvoker()";
+        message.append("ProcessInvoker()");
     }
     return std::move(message);
 }
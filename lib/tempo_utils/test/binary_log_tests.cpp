@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+
+#include <tempo_utils/binary_log.h>
+#include <tempo_utils/file_reader.h>
+#include <tempo_utils/log_sink.h>
+#include <tempo_utils/tempdir_maker.h>
+
+TEST(BinaryLog, TestFormatMessage)
+{
+    std::string args;
+    tempo_utils::internal::encode_binary_log_arg(args, 42);
+    tempo_utils::internal::encode_binary_log_arg(args, "hello");
+    tempo_utils::internal::encode_binary_log_arg(args, 1.5);
+    tempo_utils::internal::encode_binary_log_arg(args, true);
+    tempo_utils::internal::encode_binary_log_arg(args, std::string("world"));
+
+    auto message = tempo_utils::format_binary_log_message("{} {} {} {} {}", args);
+    ASSERT_EQ ("42 hello 1.5 true world", message);
+}
+
+TEST(BinaryLog, TestFormatMessageWithMissingArgument)
+{
+    std::string args;
+    tempo_utils::internal::encode_binary_log_arg(args, 42);
+
+    auto message = tempo_utils::format_binary_log_message("{} {}", args);
+    ASSERT_TRUE (message.starts_with("[failed to format binary log message"));
+}
+
+static void
+write_and_read_binary_log_file(bool asyncLogging)
+{
+    tempo_utils::TempdirMaker tempdirMaker(std::filesystem::current_path(), "test.XXXXXXXX");
+    ASSERT_TRUE (tempdirMaker.isValid());
+    auto logFilePath = tempdirMaker.getTempdir() / "test.binlog";
+
+    tempo_utils::LoggingConfiguration config;
+    config.asyncLogging = asyncLogging;
+    ASSERT_TRUE (tempo_utils::init_logging(config,
+        std::make_unique<tempo_utils::BinaryLogFileSink>(logFilePath)).isOk());
+    for (int i = 0; i < 3; i++) {
+        TU_BINLOG_INFO("iteration {} of {}", i, "loop");
+    }
+    TU_LOG_WARN << "text message";
+    TU_BINLOG_V("filtered {}", 0);
+    tempo_utils::cleanup_logging(false);
+
+    tempo_utils::FileReader reader(logFilePath);
+    ASSERT_TRUE (reader.isValid());
+    tempo_utils::BinaryLogReader binaryLogReader(reader.getStringView());
+    ASSERT_TRUE (binaryLogReader.readHeader().isOk());
+
+    std::vector<tempo_utils::BinaryLogEntry> entries;
+    for (;;) {
+        tempo_utils::BinaryLogEntry entry;
+        auto readEntryResult = binaryLogReader.readEntry(entry);
+        ASSERT_TRUE (readEntryResult.isResult());
+        if (!readEntryResult.getResult())
+            break;
+        entries.push_back(entry);
+    }
+
+    ASSERT_EQ (4, entries.size());
+    ASSERT_EQ ("iteration 0 of loop", entries.at(0).message);
+    ASSERT_EQ ("iteration 1 of loop", entries.at(1).message);
+    ASSERT_EQ ("iteration 2 of loop", entries.at(2).message);
+    ASSERT_EQ (tempo_utils::LogSeverity::kInfo, entries.at(2).severity);
+    ASSERT_EQ (entries.at(0).lineNr, entries.at(2).lineNr);
+    ASSERT_EQ ("text message", entries.at(3).message);
+    ASSERT_EQ (tempo_utils::LogSeverity::kWarn, entries.at(3).severity);
+
+    std::filesystem::remove_all(tempdirMaker.getTempdir());
+}
+
+TEST(BinaryLog, TestWriteAndReadBinaryLogFile)
+{
+    write_and_read_binary_log_file(false);
+}
+
+TEST(BinaryLog, TestWriteAndReadBinaryLogFileAsync)
+{
+    write_and_read_binary_log_file(true);
+}
+
+template<typename T>
+static void
+append_record_value(std::string &bytes, const T &value)
+{
+    bytes.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+static void
+append_record_string(std::string &bytes, std::string_view str)
+{
+    append_record_value(bytes, static_cast<tu_uint32>(str.size()));
+    bytes.append(str);
+}
+
+static std::string
+make_binary_log_with_site(tu_uint32 siteId)
+{
+    std::string bytes(tempo_utils::kBinaryLogMagic);
+    append_record_value(bytes, tempo_utils::kBinaryLogVersion);
+    append_record_value(bytes, tempo_utils::BinaryLogRecordType::kSite);
+    append_record_value(bytes, siteId);
+    append_record_value(bytes, static_cast<tu_uint8>(tempo_utils::LogSeverity::kInfo));
+    append_record_value(bytes, static_cast<tu_int32>(1));
+    append_record_string(bytes, "file.cpp");
+    append_record_string(bytes, "message");
+    append_record_value(bytes, tempo_utils::BinaryLogRecordType::kEvent);
+    append_record_value(bytes, siteId);
+    append_record_value(bytes, static_cast<tu_int64>(0));
+    append_record_string(bytes, "");
+    return bytes;
+}
+
+TEST(BinaryLog, TestReadLargeSiteIdWithoutAllocatingTable)
+{
+    auto bytes = make_binary_log_with_site(0xFFFFFFFF);
+    tempo_utils::BinaryLogReader binaryLogReader(bytes);
+    ASSERT_TRUE (binaryLogReader.readHeader().isOk());
+
+    tempo_utils::BinaryLogEntry entry;
+    auto readEntryResult = binaryLogReader.readEntry(entry);
+    ASSERT_TRUE (readEntryResult.isResult());
+    ASSERT_TRUE (readEntryResult.getResult());
+    ASSERT_EQ ("message", entry.message);
+}
+
+TEST(BinaryLog, TestReadInvalidSiteIdFails)
+{
+    auto bytes = make_binary_log_with_site(0);
+    tempo_utils::BinaryLogReader binaryLogReader(bytes);
+    ASSERT_TRUE (binaryLogReader.readHeader().isOk());
+
+    tempo_utils::BinaryLogEntry entry;
+    ASSERT_TRUE (binaryLogReader.readEntry(entry).isStatus());
+}
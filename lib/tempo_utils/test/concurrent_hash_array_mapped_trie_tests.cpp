@@ -0,0 +1,173 @@
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <tempo_utils/concurrent_hash_array_mapped_trie.h>
+
+class ConcurrentHashArrayMappedTrie : public ::testing::Test {};
+
+TEST_F(ConcurrentHashArrayMappedTrie, ConstructEmpty)
+{
+    tempo_utils::ConcurrentHashArrayMappedTrie<std::string,std::string> trie;
+
+    ASSERT_FALSE (trie.contains("key"));
+    ASSERT_FALSE (trie.get("key").isValid());
+    ASSERT_TRUE (trie.snapshot().isEmpty());
+}
+
+TEST_F(ConcurrentHashArrayMappedTrie, ConstructFromTrie)
+{
+    tempo_utils::HashArrayMappedTrie<std::string,std::string> initial({
+            { "1", "one"},
+            { "2", "two"},
+            { "3", "three"},
+        });
+    tempo_utils::ConcurrentHashArrayMappedTrie<std::string,std::string> trie(initial);
+
+    ASSERT_EQ ("one", trie.get("1").entryValue());
+    ASSERT_EQ ("two", trie.get("2").entryValue());
+    ASSERT_EQ ("three", trie.get("3").entryValue());
+    ASSERT_EQ (3, trie.snapshot().numEntries());
+}
+
+TEST_F(ConcurrentHashArrayMappedTrie, UpdateAndRemove)
+{
+    tempo_utils::ConcurrentHashArrayMappedTrie<int,int> trie;
+
+    for (int i = 0; i < 1000; i++) {
+        trie.update(i, i);
+    }
+    trie.update(7, 700);
+    ASSERT_EQ (700, trie.get(7).entryValue());
+
+    for (int i = 0; i < 1000; i += 2) {
+        ASSERT_TRUE (trie.remove(i));
+    }
+    ASSERT_FALSE (trie.remove(0));
+
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_EQ (i % 2 == 1, trie.contains(i)) << "key " << i;
+    }
+    ASSERT_EQ (500, trie.snapshot().numEntries());
+}
+
+TEST_F(ConcurrentHashArrayMappedTrie, SnapshotIsUnchangedBySubsequentWrites)
+{
+    tempo_utils::ConcurrentHashArrayMappedTrie<int,int> trie;
+    for (int i = 0; i < 100; i++) {
+        trie.update(i, i);
+    }
+
+    auto snapshot = trie.snapshot();
+    for (int i = 0; i < 100; i++) {
+        trie.update(i, -i);
+    }
+    trie.remove(50);
+    trie.update(100, 100);
+
+    ASSERT_EQ (100, snapshot.numEntries());
+    for (int i = 0; i < 100; i++) {
+        ASSERT_EQ (i, snapshot.get(i).entryValue());
+    }
+    ASSERT_FALSE (snapshot.contains(100));
+    ASSERT_EQ (100, trie.snapshot().numEntries());
+}
+
+TEST_F(ConcurrentHashArrayMappedTrie, ConcurrentWritersAndSnapshots)
+{
+    constexpr int kNumWriters = 4;
+    constexpr int kEntriesPerWriter = 5000;
+    tempo_utils::ConcurrentHashArrayMappedTrie<int,int> trie;
+
+    std::vector<std::thread> writers;
+    for (int w = 0; w < kNumWriters; w++) {
+        writers.emplace_back([&trie, w] {
+            for (int i = 0; i < kEntriesPerWriter; i++) {
+                trie.update(w * kEntriesPerWriter + i, w);
+            }
+        });
+    }
+
+    // each writer inserts its keys in order, so a consistent snapshot containing a key of a writer
+    // must also contain every earlier key of the same writer
+    size_t lastSize = 0;
+    for (int n = 0; n < 50; n++) {
+        auto snapshot = trie.snapshot();
+        ASSERT_LE (lastSize, snapshot.numEntries());
+        lastSize = snapshot.numEntries();
+        for (int w = 0; w < kNumWriters; w++) {
+            int i = kEntriesPerWriter - 1;
+            while (i >= 0 && !snapshot.contains(w * kEntriesPerWriter + i)) {
+                i--;
+            }
+            for (; i >= 0; i--) {
+                ASSERT_TRUE (snapshot.contains(w * kEntriesPerWriter + i));
+            }
+        }
+    }
+
+    for (auto &writer : writers) {
+        writer.join();
+    }
+
+    auto snapshot = trie.snapshot();
+    ASSERT_EQ (kNumWriters * kEntriesPerWriter, snapshot.numEntries());
+    for (int w = 0; w < kNumWriters; w++) {
+        ASSERT_EQ (w, trie.get(w * kEntriesPerWriter).entryValue());
+    }
+}
+
+TEST_F(ConcurrentHashArrayMappedTrie, SnapshotsCompleteWhileWritersNeverPause)
+{
+    constexpr int kNumWriters = 4;
+    tempo_utils::ConcurrentHashArrayMappedTrie<int,int> trie;
+    std::atomic<int> numStarted{0};
+    std::atomic<bool> stop{false};
+
+    // writers overwrite their keys in a loop until every snapshot has been taken, so an optimistic
+    // snapshot would retry for as long as the writers run
+    std::vector<std::thread> writers;
+    for (int w = 0; w < kNumWriters; w++) {
+        writers.emplace_back([&trie, &numStarted, &stop, w] {
+            numStarted.fetch_add(1);
+            for (int n = 0; n == 0 || !stop.load(); n++) {
+                for (int i = 0; i < 64; i++) {
+                    trie.update(w * 64 + i, n);
+                }
+            }
+        });
+    }
+    while (numStarted.load() < kNumWriters) {
+        std::this_thread::yield();
+    }
+
+    // each writer updates its keys in order, so within a consistent snapshot the value of a key is
+    // either equal to the value of the previous key of the same writer or one less
+    for (int n = 0; n < 1000; n++) {
+        auto snapshot = trie.snapshot();
+        for (int w = 0; w < kNumWriters; w++) {
+            auto first = snapshot.get(w * 64);
+            if (!first.isValid())
+                continue;
+            int previous = first.entryValue();
+            for (int i = 1; i < 64; i++) {
+                auto entry = snapshot.get(w * 64 + i);
+                if (!entry.isValid())
+                    break;
+                ASSERT_TRUE (entry.entryValue() == previous || entry.entryValue() == previous - 1);
+                previous = entry.entryValue();
+            }
+        }
+    }
+
+    stop.store(true);
+    for (auto &writer : writers) {
+        writer.join();
+    }
+    ASSERT_EQ (kNumWriters * 64, trie.snapshot().numEntries());
+}
@@ -0,0 +1,32 @@
+#include <gtest/gtest.h>
+
+#include <absl/time/clock.h>
+
+#include <tempo_utils/fast_clock.h>
+
+TEST(FastClock, TestNowIsCloseToWallClock)
+{
+    tempo_utils::FastClock::calibrate();
+    auto wallNanos = absl::GetCurrentTimeNanos();
+    auto fastNanos = tempo_utils::FastClock::nanosSinceEpoch();
+    ASSERT_LE (std::abs(fastNanos - wallNanos), absl::ToInt64Nanoseconds(absl::Milliseconds(5)));
+}
+
+TEST(FastClock, TestClockIsMonotonic)
+{
+    auto prev = tempo_utils::FastClock::nanosSinceEpoch();
+    for (int i = 0; i < 100000; i++) {
+        auto curr = tempo_utils::FastClock::nanosSinceEpoch();
+        ASSERT_LE (prev, curr);
+        prev = curr;
+    }
+}
+
+TEST(FastClock, TestMeasureElapsedTime)
+{
+    auto start = tempo_utils::FastClock::now();
+    absl::SleepFor(absl::Milliseconds(10));
+    auto elapsed = tempo_utils::FastClock::now() - start;
+    ASSERT_LE (absl::Milliseconds(10), elapsed);
+    ASSERT_GE (absl::Seconds(1), elapsed);
+}
@@ -0,0 +1,108 @@
+#include <cstdio>
+#include <thread>
+
+#include <absl/strings/match.h>
+#include <absl/strings/str_cat.h>
+#include <absl/strings/str_split.h>
+#include <gtest/gtest.h>
+
+#include <tempo_utils/flight_recorder.h>
+
+static std::string
+dump_to_string()
+{
+    auto *file = std::tmpfile();
+    EXPECT_NE (nullptr, file);
+    tempo_utils::dump_flight_recorder(fileno(file));
+    std::fseek(file, 0, SEEK_END);
+    auto size = std::ftell(file);
+    std::rewind(file);
+    std::string dump(size, '\0');
+    std::fread(dump.data(), 1, size, file);
+    std::fclose(file);
+    return dump;
+}
+
+TEST(FlightRecorder, TestRecordAndDump)
+{
+    auto ts = absl::FromUnixSeconds(0);
+    tempo_utils::record_flight_log(ts, tempo_utils::LogSeverity::kWarn,
+        "/path/to/source.cpp", 42, "first message");
+    tempo_utils::record_flight_span(ts + absl::Seconds(1), 0xabcdef, "operation",
+        absl::Microseconds(250), true);
+    tempo_utils::record_flight_log(ts + absl::Seconds(2), tempo_utils::LogSeverity::kVerbose,
+        "source.cpp", 43, "second message");
+
+    auto dump = dump_to_string();
+    ASSERT_TRUE (absl::StrContains(dump,
+        "1970-01-01T00:00:00.000000Z WARN /path/to/source.cpp:42 first message\n"
+        "1970-01-01T00:00:01.000000Z SPAN 0000000000abcdef operation active=250us FAILED\n"
+        "1970-01-01T00:00:02.000000Z V source.cpp:43 second message\n"
+        "--- end of flight recorder ---\n"));
+}
+
+TEST(FlightRecorder, TestOldestRecordsAreReplaced)
+{
+    auto ts = absl::FromUnixSeconds(1000);
+    for (int i = 0; i < tempo_utils::kFlightRecorderCapacity + 10; i++) {
+        tempo_utils::record_flight_log(ts, tempo_utils::LogSeverity::kInfo,
+            "source.cpp", 1, absl::StrCat("replaced message ", i));
+    }
+
+    auto dump = dump_to_string();
+    std::vector<std::string> lines = absl::StrSplit(dump, '\n', absl::SkipEmpty());
+    ASSERT_EQ (tempo_utils::kFlightRecorderCapacity + 2, lines.size());
+    ASSERT_EQ (absl::StrCat("--- flight recorder: ", tempo_utils::kFlightRecorderCapacity, " records ---"),
+        lines.front());
+    ASSERT_TRUE (absl::StrContains(lines.at(1), "replaced message 10"));
+    ASSERT_TRUE (absl::StrContains(lines.at(tempo_utils::kFlightRecorderCapacity),
+        absl::StrCat("replaced message ", tempo_utils::kFlightRecorderCapacity + 9)));
+}
+
+TEST(FlightRecorder, TestRecordFromManyThreads)
+{
+    constexpr int kNumThreads = 4;
+    constexpr int kRecordsPerThread = 100;
+    auto ts = absl::FromUnixSeconds(2000);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kNumThreads; t++) {
+        threads.emplace_back([ts, t] {
+            for (int i = 0; i < kRecordsPerThread; i++) {
+                tempo_utils::record_flight_log(ts, tempo_utils::LogSeverity::kInfo,
+                    "source.cpp", 1, absl::StrCat("thread ", t, " message ", i));
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    // threads reserve positions in batches, so records of different threads may be interleaved,
+    // but the records of each thread are in order
+    auto dump = dump_to_string();
+    std::vector<std::string> lines = absl::StrSplit(dump, '\n', absl::SkipEmpty());
+    std::vector<int> nextMessage(kNumThreads, 0);
+    for (const auto &line : lines) {
+        for (int t = 0; t < kNumThreads; t++) {
+            if (absl::StrContains(line, absl::StrCat("thread ", t, " message "))) {
+                ASSERT_TRUE (absl::EndsWith(line, absl::StrCat("thread ", t, " message ", nextMessage[t])));
+                nextMessage[t]++;
+            }
+        }
+    }
+    for (int t = 0; t < kNumThreads; t++) {
+        ASSERT_EQ (kRecordsPerThread, nextMessage[t]);
+    }
+}
+
+TEST(FlightRecorder, TestLongMessageIsTruncated)
+{
+    std::string message(tempo_utils::kFlightRecordTextSize * 2, 'x');
+    tempo_utils::record_flight_log(absl::FromUnixSeconds(0), tempo_utils::LogSeverity::kError,
+        "source.cpp", 1, message);
+
+    auto dump = dump_to_string();
+    ASSERT_TRUE (absl::StrContains(dump,
+        absl::StrCat("source.cpp:1 ", std::string(tempo_utils::kFlightRecordTextSize, 'x'), "\n")));
+}
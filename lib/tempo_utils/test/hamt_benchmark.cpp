@@ -0,0 +1,147 @@
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <tempo_utils/hash_array_mapped_trie.h>
+
+// allocation counters, updated by the replaced global allocation functions below
+static size_t numAllocations = 0;
+static size_t numAllocatedBytes = 0;
+
+void *
+operator new(size_t size)
+{
+    numAllocations++;
+    numAllocatedBytes += size;
+    if (auto *ptr = std::malloc(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void
+operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void
+operator delete(void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+template<int BitsPerLevel>
+using BenchmarkTrie = tempo_utils::HashArrayMappedTrie<
+    std::string,int,std::hash<std::string>,std::equal_to<std::string>,BitsPerLevel>;
+
+/**
+ * Sum the depths of every value node under `node`, and count the index nodes.
+ */
+template<int BitsPerLevel>
+static void
+measure_depth(
+    const std::shared_ptr<tempo_utils::HamtNode<
+        std::string,int,std::hash<std::string>,std::equal_to<std::string>,BitsPerLevel>> &node,
+    size_t depth,
+    size_t &totalDepth,
+    size_t &maxDepth,
+    size_t &numIndexNodes)
+{
+    using IndexNode = tempo_utils::HamtIndexNode<
+        std::string,int,std::hash<std::string>,std::equal_to<std::string>,BitsPerLevel>;
+    if (node->getType() == tempo_utils::HamtNodeType::VALUE) {
+        totalDepth += depth;
+        maxDepth = std::max(maxDepth, depth);
+        return;
+    }
+    auto index = std::static_pointer_cast<IndexNode>(node);
+    numIndexNodes++;
+    for (size_t i = 0; i < index->numChildren(); i++) {
+        measure_depth<BitsPerLevel>(index->childAt(i), depth + 1, totalDepth, maxDepth, numIndexNodes);
+    }
+}
+
+static double
+nanos_per_op(std::chrono::steady_clock::duration elapsed, size_t count)
+{
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    return static_cast<double>(nanos) / count;
+}
+
+template<int BitsPerLevel>
+static void
+run_benchmark(const std::vector<std::pair<std::string,int>> &entries, size_t &total)
+{
+    auto numEntries = entries.size();
+
+    // bulk load through a transient
+    numAllocations = 0;
+    numAllocatedBytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto trie = BenchmarkTrie<BitsPerLevel>::fromPairs(entries.begin(), entries.end());
+    auto bulkElapsed = std::chrono::steady_clock::now() - start;
+    auto bulkAllocations = numAllocations;
+    auto bulkBytes = numAllocatedBytes;
+
+    // persistent updates, each of which copies the path to the entry
+    auto numUpdates = std::max<size_t>(numEntries / 10, 1);
+    numAllocations = 0;
+    auto updated = trie;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < numUpdates; i++) {
+        updated = updated.update(entries[i].first, -1);
+    }
+    auto updateElapsed = std::chrono::steady_clock::now() - start;
+    auto updateAllocations = numAllocations;
+
+    // lookups of every key
+    start = std::chrono::steady_clock::now();
+    for (const auto &entry : entries) {
+        total += trie.find(entry.first)->second;
+    }
+    auto lookupElapsed = std::chrono::steady_clock::now() - start;
+
+    size_t totalDepth = 0;
+    size_t maxDepth = 0;
+    size_t numIndexNodes = 0;
+    measure_depth<BitsPerLevel>(trie.getRoot(), 0, totalDepth, maxDepth, numIndexNodes);
+
+    std::cout << "bits per level " << BitsPerLevel << ":" << std::endl;
+    std::cout << "  bulk load: " << nanos_per_op(bulkElapsed, numEntries) << " ns/entry, "
+              << static_cast<double>(bulkAllocations) / numEntries << " allocations/entry, "
+              << static_cast<double>(bulkBytes) / numEntries << " bytes/entry" << std::endl;
+    std::cout << "  persistent update: " << nanos_per_op(updateElapsed, numUpdates) << " ns/update, "
+              << static_cast<double>(updateAllocations) / numUpdates << " allocations/update" << std::endl;
+    std::cout << "  lookup: " << nanos_per_op(lookupElapsed, numEntries) << " ns/lookup, "
+              << static_cast<double>(totalDepth) / numEntries << " mean depth, "
+              << maxDepth << " max depth, "
+              << numIndexNodes << " index nodes" << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+    size_t numEntries = 1000000;
+    if (argc > 1) {
+        numEntries = std::strtoul(argv[1], nullptr, 10);
+    }
+
+    std::vector<std::pair<std::string,int>> entries;
+    entries.reserve(numEntries);
+    for (size_t i = 0; i < numEntries; i++) {
+        entries.emplace_back("key" + std::to_string(i), static_cast<int>(i));
+    }
+
+    size_t total = 0;
+    run_benchmark<4>(entries, total);
+    run_benchmark<5>(entries, total);
+    run_benchmark<6>(entries, total);
+
+    // print the total so the compiler cannot discard the benchmarked work
+    std::cout << "total: " << total << std::endl;
+    return 0;
+}
@@ -170,3 +170,254 @@ TEST_F(HashArrayMappedTrie, IterateEntries)
 
     ASSERT_THAT (results, ::testing::UnorderedElementsAreArray(entries));
 }
+
+TEST_F(HashArrayMappedTrie, TransientDoesNotModifyExistingTrie)
+{
+    tempo_utils::HashArrayMappedTrie<std::string,std::string> trie({
+            { "1", "one"},
+            { "2", "two"},
+            { "3", "three"},
+    });
+
+    auto transient = trie.transient();
+    transient.update("2", "dos");
+    transient.update("4", "four");
+    ASSERT_TRUE (transient.remove("1"));
+    ASSERT_FALSE (transient.remove("5"));
+    auto updated = transient.persistent();
+
+    ASSERT_EQ (3, trie.numEntries());
+    ASSERT_TRUE (trie.contains("1"));
+    ASSERT_EQ ("two", trie.get("2").entryValue());
+    ASSERT_FALSE (trie.contains("4"));
+
+    ASSERT_EQ (3, updated.numEntries());
+    ASSERT_FALSE (updated.contains("1"));
+    ASSERT_EQ ("dos", updated.get("2").entryValue());
+    ASSERT_TRUE (updated.contains("3"));
+    ASSERT_TRUE (updated.contains("4"));
+}
+
+TEST_F(HashArrayMappedTrie, TransientBatchUpdatesAndRemovals)
+{
+    auto transient = tempo_utils::HashArrayMappedTrie<int,int>().transient();
+    for (int i = 0; i < 10000; i++) {
+        transient.update(i, i * 2);
+    }
+    for (int i = 0; i < 10000; i += 2) {
+        ASSERT_TRUE (transient.remove(i));
+    }
+    auto trie = transient.persistent();
+
+    ASSERT_EQ (5000, trie.numEntries());
+    for (int i = 0; i < 10000; i++) {
+        auto entry = trie.get(i);
+        if (i % 2 == 0) {
+            ASSERT_FALSE (entry.isValid());
+        } else {
+            ASSERT_TRUE (entry.isValid());
+            ASSERT_EQ (i * 2, entry.entryValue());
+        }
+    }
+}
+
+TEST_F(HashArrayMappedTrie, TransientRemovingAllEntriesReturnsEmptyTrie)
+{
+    auto trie = tempo_utils::HashArrayMappedTrie<std::string,std::string>::of("key", "value");
+
+    auto transient = trie.transient();
+    ASSERT_TRUE (transient.remove("key"));
+    ASSERT_TRUE (transient.isEmpty());
+    ASSERT_TRUE (transient.persistent().isEmpty());
+    ASSERT_FALSE (trie.isEmpty());
+}
+
+TEST_F(HashArrayMappedTrie, UpdateReplacesValueOfSingleEntry)
+{
+    auto trie = tempo_utils::HashArrayMappedTrie<std::string,std::string>::of("key", "value");
+
+    auto updated = trie.update("key", "other");
+    ASSERT_EQ (1, updated.numEntries());
+    ASSERT_EQ ("other", updated.get("key").entryValue());
+    ASSERT_EQ ("value", trie.get("key").entryValue());
+}
+
+TEST_F(HashArrayMappedTrie, FindReturnsPairStoredInTrie)
+{
+    tempo_utils::HashArrayMappedTrie<std::string,std::string> trie({
+            { "1", "one"},
+            { "2", "two"},
+            { "3", "three"},
+    });
+
+    auto *pair = trie.find("2");
+    ASSERT_TRUE (pair != nullptr);
+    ASSERT_EQ ("2", pair->first);
+    ASSERT_EQ ("two", pair->second);
+    ASSERT_EQ ("three", trie.valueAt("3"));
+    ASSERT_TRUE (trie.find("4") == nullptr);
+
+    // the entry refers to the same pair and outlives the trie
+    auto entry = trie.get("2");
+    ASSERT_EQ (pair, &entry.entryPair());
+    trie = {};
+    ASSERT_EQ ("two", entry.entryValue());
+}
+
+template<int BitsPerLevel>
+static void
+check_updates_and_removals()
+{
+    tempo_utils::HashArrayMappedTrie<int,int,std::hash<int>,std::equal_to<int>,BitsPerLevel> trie;
+    for (int i = 0; i < 2000; i++) {
+        trie = trie.update(i, i);
+    }
+    ASSERT_EQ (2000, trie.numEntries());
+
+    auto removed = trie.remove(2000);
+    ASSERT_EQ (2000, removed.numEntries());
+
+    for (int i = 0; i < 2000; i += 2) {
+        trie = trie.remove(i);
+    }
+    ASSERT_EQ (1000, trie.numEntries());
+    for (int i = 0; i < 2000; i++) {
+        ASSERT_EQ (i % 2 == 1, trie.contains(i));
+    }
+
+    auto it = trie.iterate();
+    tempo_utils::HamtEntry<int,int> entry;
+    int numIterated = 0;
+    while (it.getNext(entry)) {
+        ASSERT_EQ (1, entry.entryKey() % 2);
+        numIterated++;
+    }
+    ASSERT_EQ (1000, numIterated);
+}
+
+TEST_F(HashArrayMappedTrie, UpdateAndRemoveWithBranchingFactors)
+{
+    check_updates_and_removals<4>();
+    check_updates_and_removals<5>();
+    check_updates_and_removals<6>();
+}
+
+TEST_F(HashArrayMappedTrie, MergeResolvesCommonKeys)
+{
+    tempo_utils::HashArrayMappedTrie<std::string,int> lhs({
+            { "1", 1},
+            { "2", 2},
+            { "3", 3},
+    });
+    tempo_utils::HashArrayMappedTrie<std::string,int> rhs({
+            { "3", 30},
+            { "4", 40},
+    });
+
+    auto merged = lhs.merge(rhs, [](const std::string &, int value, int otherValue) {
+        return value + otherValue;
+    });
+
+    ASSERT_EQ (4, merged.numEntries());
+    ASSERT_EQ (1, merged.valueAt("1"));
+    ASSERT_EQ (2, merged.valueAt("2"));
+    ASSERT_EQ (33, merged.valueAt("3"));
+    ASSERT_EQ (40, merged.valueAt("4"));
+}
+
+TEST_F(HashArrayMappedTrie, MergeResolvesKeysInSharedSubtrees)
+{
+    tempo_utils::HashArrayMappedTrie<int,int> base;
+    auto transient = base.transient();
+    for (int i = 0; i < 1000; i++) {
+        transient.update(i, i);
+    }
+    base = transient.persistent();
+    auto derived = base.update(1000, 1000).update(5, 50);
+
+    auto sum = [](int, int value, int otherValue) { return value + otherValue; };
+
+    auto doubled = base.merge(base, sum);
+    ASSERT_EQ (1000, doubled.numEntries());
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_EQ (2 * i, doubled.valueAt(i)) << "key " << i;
+    }
+
+    auto merged = base.merge(derived, sum);
+    ASSERT_EQ (1001, merged.numEntries());
+    ASSERT_EQ (55, merged.valueAt(5));
+    ASSERT_EQ (1000, merged.valueAt(1000));
+    for (int i = 0; i < 1000; i++) {
+        if (i != 5) {
+            ASSERT_EQ (2 * i, merged.valueAt(i)) << "key " << i;
+        }
+    }
+
+    // reusing shared subtrees skips the resolver for entries which are shared by pointer
+    auto reused = base.merge(derived, sum, tempo_utils::HamtMergeMode::ReuseShared);
+    ASSERT_EQ (55, reused.valueAt(5));
+    ASSERT_EQ (999, reused.valueAt(999));
+}
+
+TEST_F(HashArrayMappedTrie, IntersectAndDifference)
+{
+    tempo_utils::HashArrayMappedTrie<std::string,int> lhs({
+            { "1", 1},
+            { "2", 2},
+            { "3", 3},
+    });
+    tempo_utils::HashArrayMappedTrie<std::string,int> rhs({
+            { "2", 20},
+            { "3", 30},
+            { "4", 40},
+    });
+
+    auto intersected = lhs.intersect(rhs);
+    ASSERT_EQ (2, intersected.numEntries());
+    ASSERT_EQ (2, intersected.valueAt("2"));
+    ASSERT_EQ (3, intersected.valueAt("3"));
+
+    auto difference = lhs.difference(rhs);
+    ASSERT_EQ (1, difference.numEntries());
+    ASSERT_EQ (1, difference.valueAt("1"));
+
+    ASSERT_TRUE (lhs.difference(lhs).isEmpty());
+    ASSERT_EQ (lhs.getRoot(), lhs.intersect(lhs).getRoot());
+}
+
+TEST_F(HashArrayMappedTrie, DiffReportsOnlyChangedEntries)
+{
+    auto transient = tempo_utils::HashArrayMappedTrie<int,int>().transient();
+    for (int i = 0; i < 10000; i++) {
+        transient.update(i, i);
+    }
+    auto previous = transient.persistent();
+    auto current = previous.update(10000, 10000).update(5, 50).remove(7);
+
+    auto changes = current.diff(current);
+    ASSERT_TRUE (changes.empty());
+
+    changes = previous.diff(current);
+    ASSERT_EQ (3, changes.size());
+    std::map<int,tempo_utils::HamtChange<int,int>> byKey;
+    for (const auto &change : changes) {
+        auto key = change.type == tempo_utils::HamtChangeType::Added?
+            change.current.entryKey() : change.previous.entryKey();
+        byKey.insert({key, change});
+    }
+    ASSERT_EQ (tempo_utils::HamtChangeType::Added, byKey.at(10000).type);
+    ASSERT_EQ (10000, byKey.at(10000).current.entryValue());
+    ASSERT_EQ (tempo_utils::HamtChangeType::Updated, byKey.at(5).type);
+    ASSERT_EQ (5, byKey.at(5).previous.entryValue());
+    ASSERT_EQ (50, byKey.at(5).current.entryValue());
+    ASSERT_EQ (tempo_utils::HamtChangeType::Removed, byKey.at(7).type);
+
+    // merging a trie with a derived version reuses the shared subtrees
+    auto merged = previous.merge(current, [](int, int, int otherValue) { return otherValue; },
+        tempo_utils::HamtMergeMode::ReuseShared);
+    ASSERT_EQ (10001, merged.numEntries());
+    ASSERT_EQ (50, merged.valueAt(5));
+    ASSERT_TRUE (merged.contains(7));
+    ASSERT_TRUE (merged.contains(10000));
+    ASSERT_EQ (1, merged.diff(current).size());
+}
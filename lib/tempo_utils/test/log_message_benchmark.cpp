@@ -0,0 +1,90 @@
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+#include <tempo_utils/log_stream.h>
+#include <tempo_utils/logging.h>
+
+/**
+ * Log sink which discards every message, so that the benchmark measures only the cost of
+ * building and dispatching the message.
+ */
+class NullLogSink : public tempo_utils::AbstractLogSink {
+public:
+    tempo_utils::Status openSink() override { return {}; }
+    void writeLog(
+        const absl::Time &ts,
+        tempo_utils::LogSeverity severity,
+        const char *filePath,
+        int lineNr,
+        std::string_view message) override { m_size += message.size(); }
+    void flushSink() override {}
+    void closeSink() override {}
+    size_t getSize() const { return m_size; }
+private:
+    size_t m_size = 0;
+};
+
+template<typename F>
+static void
+run_benchmark(const char *name, int iterations, F f)
+{
+    // warm up thread-local state and the allocator before timing
+    for (int i = 0; i < iterations / 10; i++) {
+        f(i);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        f(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    std::cout << name << ": " << static_cast<double>(nanos) / iterations << " ns/message" << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int iterations = 1000000;
+    if (argc > 1) {
+        iterations = std::atoi(argv[1]);
+    }
+
+    size_t total = 0;
+
+    // the message construction used by LogMessage before it was backed by a pooled fmt buffer
+    run_benchmark("ostringstream baseline", iterations, [&](int i) {
+        std::ostringstream buffer;
+        buffer << "iteration " << i << " of " << iterations << " value " << 3.14159;
+        auto log = std::move(*buffer.rdbuf());
+        total += log.str().size();
+    });
+
+    std::string output;
+    run_benchmark("LogToString", iterations, [&](int i) {
+        output.clear();
+        tempo_utils::LogToString(&output) << "iteration " << i << " of " << iterations << " value " << 3.14159;
+        total += output.size();
+    });
+
+    auto sink = std::make_unique<NullLogSink>();
+    auto *nullSink = sink.get();
+    tempo_utils::LoggingConfiguration config;
+    tempo_utils::init_logging(config, std::move(sink));
+
+    run_benchmark("TU_LOG_INFO to null sink", iterations, [&](int i) {
+        TU_LOG_INFO << "iteration " << i << " of " << iterations << " value " << 3.14159;
+    });
+
+    run_benchmark("TU_LOG_V filtered", iterations, [&](int i) {
+        TU_LOG_V << "iteration " << i << " of " << iterations << " value " << 3.14159;
+    });
+
+    total += nullSink->getSize();
+    tempo_utils::cleanup_logging();
+
+    // print the total so the compiler cannot discard the benchmarked work
+    std::cout << "total bytes: " << total << std::endl;
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include <absl/strings/str_cat.h>
+#include <absl/strings/str_split.h>
+#include <absl/time/clock.h>
+#include <gtest/gtest.h>
+
+#include <tempo_utils/file_reader.h>
+#include <tempo_utils/log_sink.h>
+#include <tempo_utils/tempdir_maker.h>
+
+static std::vector<std::string>
+read_lines(const std::filesystem::path &path)
+{
+    tempo_utils::FileReader reader(path);
+    if (!reader.isValid())
+        return {};
+    std::string contents(reader.getStringView());
+    return absl::StrSplit(contents, '\n', absl::SkipEmpty());
+}
+
+class RotatingLogFileSink : public ::testing::Test {
+protected:
+    std::unique_ptr<tempo_utils::TempdirMaker> tempdirMaker;
+    std::filesystem::path logFilePath;
+
+    void SetUp() override {
+        tempdirMaker = std::make_unique<tempo_utils::TempdirMaker>(
+            std::filesystem::current_path(), "test.XXXXXXXX");
+        ASSERT_TRUE (tempdirMaker->isValid());
+        logFilePath = tempdirMaker->getTempdir() / "test.log";
+    }
+    void TearDown() override {
+        std::filesystem::remove_all(tempdirMaker->getTempdir());
+    }
+};
+
+TEST_F(RotatingLogFileSink, TestWriteMessagesInOrder)
+{
+    tempo_utils::RotatingLogFileOptions options;
+    options.displayShortForm = true;
+    options.bufferSize = 64;
+    options.maxPendingBuffers = 2;
+
+    tempo_utils::RotatingLogFileSink sink(logFilePath, options);
+    ASSERT_TRUE (sink.openSink().isOk());
+    for (int i = 0; i < 1000; i++) {
+        sink.writeLog(absl::Now(), tempo_utils::LogSeverity::kInfo, __FILE__, __LINE__, absl::StrCat(i));
+        sink.flushSink();
+    }
+    sink.closeSink();
+
+    auto lines = read_lines(logFilePath);
+    ASSERT_EQ (1000, lines.size());
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_EQ (absl::StrCat(i), lines.at(i));
+    }
+}
+
+TEST_F(RotatingLogFileSink, TestFlushEveryMessageWithDefaultBufferSize)
+{
+    tempo_utils::RotatingLogFileOptions options;
+    options.displayShortForm = true;
+
+    tempo_utils::RotatingLogFileSink sink(logFilePath, options);
+    ASSERT_TRUE (sink.openSink().isOk());
+    for (int i = 0; i < 10000; i++) {
+        sink.writeLog(absl::Now(), tempo_utils::LogSeverity::kInfo, __FILE__, __LINE__, absl::StrCat(i));
+        sink.flushSink();
+        // flushing applies the same backpressure as a full buffer
+        ASSERT_LE (sink.numPendingBuffers(), options.maxPendingBuffers);
+    }
+    sink.closeSink();
+
+    auto lines = read_lines(logFilePath);
+    ASSERT_EQ (10000, lines.size());
+    for (int i = 0; i < 10000; i++) {
+        ASSERT_EQ (absl::StrCat(i), lines.at(i));
+    }
+}
+
+TEST_F(RotatingLogFileSink, TestFlushAfterInterval)
+{
+    tempo_utils::RotatingLogFileOptions options;
+    options.displayShortForm = true;
+    options.flushInterval = absl::Milliseconds(10);
+
+    tempo_utils::RotatingLogFileSink sink(logFilePath, options);
+    ASSERT_TRUE (sink.openSink().isOk());
+    sink.writeLog(absl::Now(), tempo_utils::LogSeverity::kInfo, __FILE__, __LINE__, "buffered");
+
+    std::vector<std::string> lines;
+    for (int i = 0; i < 100 && lines.empty(); i++) {
+        absl::SleepFor(absl::Milliseconds(10));
+        lines = read_lines(logFilePath);
+    }
+    ASSERT_EQ (1, lines.size());
+    ASSERT_EQ ("buffered", lines.at(0));
+    sink.closeSink();
+}
+
+TEST_F(RotatingLogFileSink, TestRotateBySize)
+{
+    tempo_utils::RotatingLogFileOptions options;
+    options.displayShortForm = true;
+    options.bufferSize = 100;
+    options.maxFileSize = 1000;
+    options.maxRetainedFiles = 2;
+
+    // each message is 10 bytes including the newline
+    tempo_utils::RotatingLogFileSink sink(logFilePath, options);
+    ASSERT_TRUE (sink.openSink().isOk());
+    for (int i = 0; i < 10000; i++) {
+        sink.writeLog(absl::Now(), tempo_utils::LogSeverity::kInfo, __FILE__, __LINE__,
+            absl::StrCat(100000000 + i));
+    }
+    sink.closeSink();
+
+    auto rotated1 = absl::StrCat(logFilePath.string(), ".1");
+    auto rotated2 = absl::StrCat(logFilePath.string(), ".2");
+    auto rotated3 = absl::StrCat(logFilePath.string(), ".3");
+    ASSERT_TRUE (std::filesystem::exists(rotated1));
+    ASSERT_TRUE (std::filesystem::exists(rotated2));
+    ASSERT_FALSE (std::filesystem::exists(rotated3));
+
+    // the retained files contain the most recent messages, oldest first
+    auto lines2 = read_lines(rotated2);
+    auto lines1 = read_lines(rotated1);
+    auto lines0 = read_lines(logFilePath);
+    ASSERT_FALSE (lines2.empty());
+    ASSERT_FALSE (lines1.empty());
+    std::vector<std::string> lines;
+    lines.insert(lines.end(), lines2.begin(), lines2.end());
+    lines.insert(lines.end(), lines1.begin(), lines1.end());
+    lines.insert(lines.end(), lines0.begin(), lines0.end());
+    ASSERT_EQ (absl::StrCat(100000000 + 9999), lines.back());
+    for (size_t i = 1; i < lines.size(); i++) {
+        ASSERT_LT (lines.at(i - 1), lines.at(i));
+    }
+    ASSERT_LE (std::filesystem::file_size(rotated1), 1000 + options.bufferSize * options.maxPendingBuffers);
+}
@@ -10,6 +10,19 @@ main(int argc, char *argv[])
         if (line == "--start") {
             tempo_utils::LoggingConfiguration config;
             tempo_utils::init_logging(config, true, true);
+        } else if (line == "--async-start") {
+            tempo_utils::LoggingConfiguration config;
+            config.asyncLogging = true;
+            config.asyncQueueSize = 4;
+            tempo_utils::init_logging(config, true, true);
+        } else if (line == "--recorder-start") {
+            tempo_utils::LoggingConfiguration config;
+            config.flightRecorderFilter = tempo_utils::SeverityFilter::kVeryVerbose;
+            config.installFaultHandler = true;
+            tempo_utils::init_logging(config, true, true);
+            TU_LOG_V << "recorded but not written";
+        } else if (line == "--crash") {
+            TU_LOG_FATAL << "crashing";
         } else if (line == "--stop") {
             tempo_utils::cleanup_logging(false);
         } else if (line == "--finish") {
@@ -1,4 +1,7 @@
+#include <absl/strings/match.h>
+#include <absl/strings/str_cat.h>
 #include <absl/strings/str_split.h>
+#include <absl/time/clock.h>
 #include <gtest/gtest.h>
 
 #include <tempo_utils/tempo_utils.h>
@@ -86,3 +89,188 @@ TEST(Logging, TestRestartLogging)
     ASSERT_EQ ("3", lines.at(2));
     ASSERT_EQ ("4", lines.at(3));
 }
+
+TEST(Logging, TestAsyncLogging)
+{
+
+    tempo_utils::ProcessBuilder builder(LOGGING_CHILD_EXECUTABLE);
+    builder.appendArg("1");
+    builder.appendArg("--async-start");
+    for (int i = 2; i <= 100; i++) {
+        builder.appendArg(absl::StrCat(i));
+    }
+    builder.appendArg("--finish");
+    builder.appendArg("101");
+
+    tempo_utils::ProcessRunner runner(builder.toInvoker());
+    ASSERT_TRUE (runner.isValid());
+    ASSERT_TRUE (runner.getStatus().isOk());
+    ASSERT_EQ (0, runner.getExitStatus());
+    ASSERT_EQ ("", runner.getChildError());
+
+    std::vector<std::string> lines = absl::StrSplit(runner.getChildOutput(), '\n', absl::SkipEmpty());
+    ASSERT_EQ (100, lines.size());
+    for (int i = 0; i < 100; i++) {
+        ASSERT_EQ (absl::StrCat(i + 1), lines.at(i));
+    }
+}
+
+TEST(Logging, TestFlightRecorderDumpedOnFatal)
+{
+
+    tempo_utils::ProcessBuilder builder(LOGGING_CHILD_EXECUTABLE);
+    builder.appendArg("--recorder-start");
+    builder.appendArg("1");
+    builder.appendArg("--crash");
+
+    // the child is terminated by SIGABRT, so the runner reports an error status
+    tempo_utils::ProcessRunner runner(builder.toInvoker());
+    ASSERT_FALSE (runner.isValid());
+
+    auto childError = runner.getChildError();
+    ASSERT_TRUE (absl::StrContains(childError, "INVOKED FAULT HANDLER"));
+    ASSERT_TRUE (absl::StrContains(childError, "--- flight recorder:"));
+    auto verbose = childError.find(" V ");
+    auto info = childError.find(" INFO ");
+    auto fatal = childError.find(" FATAL ");
+    ASSERT_NE (std::string::npos, verbose);
+    ASSERT_NE (std::string::npos, info);
+    ASSERT_NE (std::string::npos, fatal);
+    ASSERT_LT (verbose, info);
+    ASSERT_LT (info, fatal);
+    ASSERT_TRUE (absl::StrContains(childError, "recorded but not written"));
+    ASSERT_TRUE (absl::StrContains(childError, "crashing"));
+}
+
+static int format_count = 0;
+
+struct CountFormatting {};
+
+static tempo_utils::LogMessage&&
+operator<<(tempo_utils::LogMessage &&message, const CountFormatting &)
+{
+    format_count++;
+    return std::move(message);
+}
+
+TEST(Logging, TestFilteredMessageIsNotFormatted)
+{
+    tempo_utils::LoggingConfiguration config;
+    config.severityFilter = tempo_utils::SeverityFilter::kWarningsAndErrors;
+    ASSERT_TRUE (tempo_utils::init_logging(config).isOk());
+    ASSERT_FALSE (tempo_utils::log_severity_is_enabled(tempo_utils::LogSeverity::kInfo));
+    ASSERT_TRUE (tempo_utils::log_severity_is_enabled(tempo_utils::LogSeverity::kWarn));
+
+    format_count = 0;
+    TU_LOG_INFO << CountFormatting{};
+    TU_LOG_V << CountFormatting{};
+    TU_LOG_WARN_IF(false) << CountFormatting{};
+    ASSERT_EQ (0, format_count);
+    TU_LOG_WARN << CountFormatting{};
+    ASSERT_EQ (1, format_count);
+
+    tempo_utils::cleanup_logging(false);
+}
+
+static tempo_utils::LogCategory kTestCategory("test");
+
+TEST(Logging, TestCategoryEnabled)
+{
+    tempo_utils::LoggingConfiguration config;
+    config.severityFilter = tempo_utils::SeverityFilter::kVerbose;
+    ASSERT_TRUE (tempo_utils::init_logging(config).isOk());
+    ASSERT_TRUE (kTestCategory.isEnabled(tempo_utils::LogSeverity::kVerbose));
+    ASSERT_FALSE (kTestCategory.isEnabled(tempo_utils::LogSeverity::kVeryVerbose));
+
+    format_count = 0;
+    kTestCategory.setEnabled(tempo_utils::LogSeverity::kVerbose, false);
+    ASSERT_FALSE (kTestCategory.isEnabled(tempo_utils::LogSeverity::kVerbose));
+    TU_LOG_V_IF(&kTestCategory, true) << CountFormatting{};
+    ASSERT_EQ (0, format_count);
+
+    kTestCategory.setEnabled(tempo_utils::LogSeverity::kVerbose, true);
+    TU_LOG_V_IF(&kTestCategory, true) << CountFormatting{};
+    TU_LOG_VV_IF(&kTestCategory, true) << CountFormatting{};
+    ASSERT_EQ (1, format_count);
+
+    tempo_utils::cleanup_logging(false);
+}
+
+TEST(Logging, TestLogEveryN)
+{
+    ASSERT_TRUE (tempo_utils::init_logging(tempo_utils::LoggingConfiguration{}).isOk());
+
+    format_count = 0;
+    for (int i = 0; i < 10; i++) {
+        TU_LOG_EVERY_N(INFO, 4) << CountFormatting{};
+    }
+    ASSERT_EQ (3, format_count);
+
+    // filtered messages do not count towards the limit
+    format_count = 0;
+    for (int i = 0; i < 10; i++) {
+        TU_LOG_EVERY_N(V, 4) << CountFormatting{};
+    }
+    ASSERT_EQ (0, format_count);
+
+    tempo_utils::cleanup_logging(false);
+}
+
+TEST(Logging, TestLogFirstN)
+{
+    ASSERT_TRUE (tempo_utils::init_logging(tempo_utils::LoggingConfiguration{}).isOk());
+
+    format_count = 0;
+    for (int i = 0; i < 10; i++) {
+        TU_LOG_FIRST_N(WARN, 3) << CountFormatting{};
+    }
+    ASSERT_EQ (3, format_count);
+
+    tempo_utils::cleanup_logging(false);
+}
+
+TEST(Logging, TestLogEveryT)
+{
+    tempo_utils::LogEveryT limiter;
+    ASSERT_TRUE (limiter.admit(absl::Hours(1)).admitted);
+    ASSERT_FALSE (limiter.admit(absl::Hours(1)).admitted);
+    ASSERT_FALSE (limiter.admit(absl::Hours(1)).admitted);
+
+    tempo_utils::LogEveryT expiring;
+    ASSERT_TRUE (expiring.admit(absl::Milliseconds(10)).admitted);
+    ASSERT_FALSE (expiring.admit(absl::Milliseconds(10)).admitted);
+    absl::SleepFor(absl::Milliseconds(20));
+    auto admission = expiring.admit(absl::Milliseconds(10));
+    ASSERT_TRUE (admission.admitted);
+    ASSERT_EQ (1, admission.suppressed);
+}
+
+TEST(Logging, TestLogTokenBucket)
+{
+    tempo_utils::LogTokenBucket bucket;
+    // the burst is admitted immediately, after which the bucket is empty
+    for (int i = 0; i < 5; i++) {
+        ASSERT_TRUE (bucket.admit(1.0, 5).admitted);
+    }
+    ASSERT_FALSE (bucket.admit(1.0, 5).admitted);
+    ASSERT_FALSE (bucket.admit(1.0, 5).admitted);
+
+    tempo_utils::LogTokenBucket fast;
+    ASSERT_TRUE (fast.admit(100.0, 1).admitted);
+    ASSERT_FALSE (fast.admit(100.0, 1).admitted);
+    absl::SleepFor(absl::Milliseconds(20));
+    auto admission = fast.admit(100.0, 1);
+    ASSERT_TRUE (admission.admitted);
+    ASSERT_EQ (1, admission.suppressed);
+}
+
+TEST(Logging, TestSuppressedMessageCount)
+{
+    std::string output;
+    tempo_utils::LogToString(&output) << tempo_utils::LogAdmission{true, 0} << "message";
+    ASSERT_EQ ("message", output);
+
+    output.clear();
+    tempo_utils::LogToString(&output) << tempo_utils::LogAdmission{true, 3} << "message";
+    ASSERT_EQ ("[3 messages suppressed] message", output);
+}